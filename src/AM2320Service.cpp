@@ -29,6 +29,8 @@ void AM2320Service::init(UEventLoop *eventLoop, CommandMgr *commandMgr, SystemSe
     isMeasured = false;
     temp = 9999;
     humidity = 9999;
+    tempSeries = nullptr;
+    humiditySeries = nullptr;
 
     // load config
     String msg;
@@ -43,13 +45,27 @@ void AM2320Service::init(UEventLoop *eventLoop, CommandMgr *commandMgr, SystemSe
     // init data structures
 
     // init hardware
+    bus = nullptr;
+    tx.address = i2cAddress;
+    tx.timeoutMillis = 20;
+    tx.eventLoop = eventLoop;
+    tx.onDone = [this](I2cBus::Transaction *t) {
+        logger->debug("Transfer done: {}", esp_err_to_name(t->result));
+        if (t->readLen > 0 && t->result == ESP_OK) {
+            onRegsRead();
+        }
+    };
     if (isEnabled) {
-        rc = systemService->getIdf(i2cPort);
-        if (!rc) {
+        bus = systemService->getI2cBus(i2cPort);
+        if (bus == nullptr) {
             logger->error("Cannot retrieve i2c port {} in IDF form from System service", (int)(i2cPort));
             isEnabled = false;
         }
     }
+    if (isEnabled) {
+        tempSeries = systemService->getTimeSeries()->addMetric("am2320.temp", "m°C", 32, 60, 24);
+        humiditySeries = systemService->getTimeSeries()->addMetric("am2320.humidity", "m%", 32, 60, 24);
+    }
 }
 
 unsigned short AM2320Service::crc16(unsigned char *ptr, unsigned char len)
@@ -71,42 +87,35 @@ unsigned short AM2320Service::crc16(unsigned char *ptr, unsigned char len)
 }
 
 bool AM2320Service::wakeUp() {
-    i2c_cmd_handle_t cmd = i2c_cmd_link_create();
-    i2c_master_start(cmd);
-    i2c_master_write_byte(cmd, (i2cAddress << 1) | 0x0 /* write */, true);
-    i2c_master_stop(cmd);
-    esp_err_t err = i2c_master_cmd_begin(i2cPort, cmd, 20 / portTICK_PERIOD_MS);
-    i2c_cmd_link_delete(cmd);
-    return (err == ESP_OK);
+    // address only, the sensor doesn't acknowledge while it wakes up
+    tx.headerLen = 0;
+    tx.writeLen = 0;
+    tx.readLen = 0;
+    return bus->submit(&tx);
 }
 
 bool AM2320Service::setReadRegs()
 {
-    i2c_cmd_handle_t cmd = i2c_cmd_link_create();
-    i2c_master_start(cmd);
-    i2c_master_write_byte(cmd, (i2cAddress << 1) | 0x0 /* write */, true);
-    i2c_master_write_byte(cmd, 0x03, true);
-    i2c_master_write_byte(cmd, 0, true);
-    i2c_master_write_byte(cmd, 4, true);
-    i2c_master_stop(cmd);
-    esp_err_t err = i2c_master_cmd_begin(i2cPort, cmd, 20 / portTICK_PERIOD_MS);
-    i2c_cmd_link_delete(cmd);
-    return (err == ESP_OK);
+    static const uint8_t readCmd[3] = { 0x03, 0, 4 }; // read 4 registers from 0
+    tx.headerLen = 0;
+    tx.writeData = readCmd;
+    tx.writeLen = sizeof(readCmd);
+    tx.readLen = 0;
+    return bus->submit(&tx);
 }
 
 bool AM2320Service::readRegs() {
-    uint8_t buf[8] = { 0, 0, 0, 0, 0, 0, 0, 0 };
-    i2c_cmd_handle_t cmd = i2c_cmd_link_create();
-    i2c_master_start(cmd);
-    i2c_master_write_byte(cmd, (i2cAddress << 1) | 0x1 /* read */, true);
-    i2c_master_read(cmd, buf, 8, i2c_ack_type_t::I2C_MASTER_LAST_NACK);
-    i2c_master_stop(cmd);
-    esp_err_t err = i2c_master_cmd_begin(i2cPort, cmd, 20 / portTICK_PERIOD_MS);
-    i2c_cmd_link_delete(cmd);
-    if (err != ESP_OK) {
-        return false;
-    }
+    memset(readBuf, 0, sizeof(readBuf));
+    tx.headerLen = 0;
+    tx.writeLen = 0;
+    tx.readData = readBuf;
+    tx.readLen = sizeof(readBuf);
+    return bus->submit(&tx);
+}
 
+void AM2320Service::onRegsRead()
+{
+    uint8_t *buf = readBuf;
     uint16_t humidityTmp = (buf[2] << 8) | buf[3];
     uint16_t tempTmp = (buf[4] << 8) | buf[5];
     uint16_t crc = (buf[7] << 8) | buf[6];
@@ -118,9 +127,9 @@ bool AM2320Service::readRegs() {
         temp = (int16_t)tempTmp; // TODO check whether negative values are OK, or are they 1's complement?
         humidity = humidityTmp;
         isMeasured = true;
+        TimeSeries::add(tempSeries, temp * 100);
+        TimeSeries::add(humiditySeries, humidity * 100);
     }
-
-    return true;
 }
 
 void AM2320Service::startMeasuring()
@@ -154,7 +163,7 @@ void AM2320Service::initDfa()
                 isMeasured = false;
                 if (isEnabled) {
                     bool rc = wakeUp();
-                    logger->debug("Wakeup: {}", rc);
+                    logger->debug("Wakeup queued: {}", rc);
                 }
                 return dfa->transitionTo(MEASURE_1, 5);
             }
@@ -162,7 +171,7 @@ void AM2320Service::initDfa()
             if (input.is(Dfa::Input::TIMEOUT)) {
                 if (isEnabled) {
                     bool rc = setReadRegs();
-                    logger->debug("Set regs: {}", rc);
+                    logger->debug("Set regs queued: {}", rc);
                 }
                 return dfa->transitionTo(MEASURE_2, 2);
             }
@@ -170,7 +179,7 @@ void AM2320Service::initDfa()
             if (input.is(Dfa::Input::TIMEOUT)) {
                 if (isEnabled) {
                     bool rc = readRegs();
-                    logger->debug("Read regs: {}", rc);
+                    logger->debug("Read regs queued: {}", rc);
                 }
                 return dfa->transitionTo(IDLE);
             }
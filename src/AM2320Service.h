@@ -13,6 +13,7 @@
 #include "Dfa.h"
 #include "SystemService.h"
 #include <driver/i2c.h>
+#include "I2cBus.h"
 
 class AM2320Service {
 public:
@@ -42,15 +43,22 @@ private:
     bool isEnabled;
     i2c_port_t i2cPort;
     int i2cAddress;
+    I2cBus *bus;
+    I2cBus::Transaction tx; // completes in eventLoop
+    uint8_t readBuf[8];
 
     int16_t temp;
     int16_t humidity;
     bool isMeasured;
+    TimeSeries::Metric *tempSeries;
+    TimeSeries::Metric *humiditySeries;
 
     unsigned short crc16(unsigned char *ptr, unsigned char len);
+    // the transfers are queued, false if they couldn't be
     bool wakeUp();
     bool setReadRegs();
     bool readRegs();
+    void onRegsRead();
 
 };
 
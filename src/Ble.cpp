@@ -18,12 +18,44 @@ BleSensor::BleSensor(const BleAddress &address, const char *name, const char *or
     this->name = name; // copying into String
     this->origName = origName; // copying into String
     this->type = type;
+    tempSeries = nullptr;
+    humiditySeries = nullptr;
+    batterySeries = nullptr;
+    rssiSeries = nullptr;
 }
 
 BleSensor::~BleSensor()
 {
 }
 
+void BleSensor::initSeries(TimeSeries *timeSeries)
+{
+    // a measure per sensor scan, so no minute tier
+    String prefix = String("ble.") + name;
+    tempSeries = timeSeries->addMetric((prefix + ".temp").c_str(), "m°C", 32, 0, 48);
+    humiditySeries = timeSeries->addMetric((prefix + ".humidity").c_str(), "0.01%", 32, 0, 48);
+    batterySeries = timeSeries->addMetric((prefix + ".battery").c_str(), "0.01%", 32, 0, 48);
+    rssiSeries = timeSeries->addMetric((prefix + ".rssi").c_str(), "dBm", 32, 0, 48);
+}
+
+void BleSensor::recordMeasures()
+{
+    BleSensorMeasures measures;
+    getMeasures(&measures);
+    if (measures.temp != 99999) {
+        TimeSeries::add(tempSeries, measures.temp);
+    }
+    if (measures.humidity != 99999) {
+        TimeSeries::add(humiditySeries, measures.humidity);
+    }
+    if (measures.sensorBatteryPct != 99999) {
+        TimeSeries::add(batterySeries, measures.sensorBatteryPct);
+    }
+    if (measures.sensorRssi != 99999) {
+        TimeSeries::add(rssiSeries, measures.sensorRssi);
+    }
+}
+
 template <class T>
 T* BleSensor::as()
 {
@@ -160,9 +192,9 @@ void BleSensor_LYWSDCGQ::getMeasures(JsonObject *data)
 
 void BleSensor_LYWSDCGQ::getMeasures(BleSensorMeasures *measures)
 {
-    measures->temp = 99999 ? 99999 : temp * 100;
-    measures->humidity = 99999 ? 99999 : hum * 10;
-    measures->sensorBatteryPct = 99999 ? 99999 : battPct * 10;
+    measures->temp = temp == 99999 ? 99999 : temp * 100;
+    measures->humidity = hum == 99999 ? 99999 : hum * 10;
+    measures->sensorBatteryPct = battPct == 99999 ? 99999 : battPct * 10;
     measures->sensorRssi = rssi;
 }
 
@@ -291,9 +323,9 @@ void BleSensor_LYWSD03MMC_ATC::getMeasures(JsonObject *data)
 
 void BleSensor_LYWSD03MMC_ATC::getMeasures(BleSensorMeasures *measures)
 {
-    measures->temp = 99999 ? 99999 : temp * 100;
-    measures->humidity = 99999 ? 99999 : hum * 100;
-    measures->sensorBatteryPct = 99999 ? 99999 : battPct * 100;
+    measures->temp = temp == 99999 ? 99999 : temp * 100;
+    measures->humidity = hum == 99999 ? 99999 : hum * 100;
+    measures->sensorBatteryPct = battPct == 99999 ? 99999 : battPct * 100;
     measures->sensorBatteryVoltage = battVoltage;
     measures->sensorRssi = rssi;
 }
@@ -439,9 +471,9 @@ void BleSensor_LYWSD03MMC_PVVX::getMeasures(JsonObject *data)
 
 void BleSensor_LYWSD03MMC_PVVX::getMeasures(BleSensorMeasures *measures)
 {
-    measures->temp = 99999 ? 99999 : temp * 100;
-    measures->humidity = 99999 ? 99999 : hum * 100;
-    measures->sensorBatteryPct = 99999 ? 99999 : battPct * 100;
+    measures->temp = temp == 99999 ? 99999 : temp * 100;
+    measures->humidity = hum == 99999 ? 99999 : hum * 100;
+    measures->sensorBatteryPct = battPct == 99999 ? 99999 : battPct * 100;
     measures->sensorBatteryVoltage = battVoltage;
     measures->sensorRssi = rssi;
     measures->counter = counter;
@@ -465,11 +497,12 @@ void BleSensor_LYWSD03MMC_PVVX::getMeasures(BleSensorMeasures *measures)
 
 BleService *BleService::thisService;
 
-void BleService::init(UEventLoop *eventLoop, CommandMgr *commandMgr, LogMgr *logMgr)
+void BleService::init(UEventLoop *eventLoop, CommandMgr *commandMgr, SystemService *systemService, LogMgr *logMgr)
 {
     this->eventLoop = eventLoop;
     this->commandMgr = commandMgr;
     this->logger = logMgr->newLogger("ble");
+    this->timeSeries = systemService->getTimeSeries();
 
     sensorTypes.push_back(new BleSensorType_LYWSDCGQ());
 //    sensorTypes.push_back(new BleSensorType_LYWSD03MMC_ATC());
@@ -589,6 +622,9 @@ Serial.printf("Recognized %s of type %s\n", AddressToString(dev->getAddress()).c
             if ((*sl)->getAddress() == addr) {
 Serial.printf("Got advertisement for %s: ", str.c_str());
                 (*sl)->advertisement(dev);
+                if ((*sl)->hasMeasures()) {
+                    (*sl)->recordMeasures();
+                }
 DynamicJsonBuffer buf;
 JsonObject &obj = buf.createObject();
 (*sl)->getMeasures(&obj);
@@ -602,6 +638,12 @@ Serial.println(str);
 
 }
 
+void BleService::addSensor(BleSensor *sensor)
+{
+    sensor->initSeries(timeSeries);
+    sensorList.push_back(sensor);
+}
+
 void BleService::staticScanComplete(NimBLEScanResults results)
 {
     thisService->scanComplete(results);
@@ -834,7 +876,7 @@ void BleService::initCommands(ServiceCommands *cmd)
                     }
                 }
 
-                sensorList.push_back(scanItem->type->newSensor(addr, name, scanItem->name.c_str()));
+                addSensor(scanItem->type->newSensor(addr, name, scanItem->name.c_str()));
             }
 
             *msg = "Added to sensor list";
@@ -875,7 +917,7 @@ void BleService::initCommands(ServiceCommands *cmd)
                     BleAddress addr(list[i]["addr"].as<char *>());
                     const char *name = list[i]["name"].as<char *>();
                     if (!addr.isNull() && name != nullptr && name[0] != '\0') {
-                        sensorList.push_back(sensorType->newSensor(addr, name, ""));
+                        addSensor(sensorType->newSensor(addr, name, ""));
                     }
                 }
             }
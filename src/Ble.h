@@ -11,6 +11,7 @@
 #include "CommandMgr.h"
 #include "LogMgr.h"
 #include "Dfa.h"
+#include "SystemService.h"
 #include "NimBLEDevice.h"
 
 #define AddressToString(addr) std::string(addr)
@@ -121,6 +122,10 @@ class BleSensor {
     String name;
     String origName;
     BleSensorType *type;
+    TimeSeries::Metric *tempSeries;
+    TimeSeries::Metric *humiditySeries;
+    TimeSeries::Metric *batterySeries;
+    TimeSeries::Metric *rssiSeries;
 public:
     BleSensor(const BleAddress &address, const char *name, const char *origName, BleSensorType *type);
     virtual ~BleSensor();
@@ -132,6 +137,11 @@ public:
     template <class T>
     T* as();
 
+    // adds the time series of the measures, named after the sensor
+    void initSeries(TimeSeries *timeSeries);
+    // adds the current measures to the time series
+    void recordMeasures();
+
     // whether more advertisements are needed to complete the measurements
     virtual bool isMeasurementComplete() = 0;
     virtual void clearMeasurements() = 0;
@@ -249,11 +259,12 @@ struct BleScanItem {
 
 class BleService: public NimBLEAdvertisedDeviceCallbacks {
 public:
-    void init(UEventLoop *eventLoop, CommandMgr *commandMgr, LogMgr *logMgr);
+    void init(UEventLoop *eventLoop, CommandMgr *commandMgr, SystemService *systemService, LogMgr *logMgr);
 private:
     UEventLoop *eventLoop;
     CommandMgr *commandMgr;
     Logger *logger;
+    TimeSeries *timeSeries;
 
     NimBLEScan *scan;
     std::vector<BleSensorType *> sensorTypes;
@@ -290,6 +301,7 @@ private:
 
     void initCommands(ServiceCommands *cmd);
     void initDfa();
+    void addSensor(BleSensor *sensor);
 
     bool isEnabled;
 public:
@@ -1,4 +1,5 @@
 #include <WiFi.h>
+#include <esp_system.h>
 #include <ESPAsyncWebServer.h>
 #include "CommandHttpServer.h"
 #include "UEvent.h"
@@ -13,14 +14,45 @@ CommandHttpServer::~CommandHttpServer()
 {
 }
 
+static String menuEtag(uint32_t bootToken, uint32_t version, AsyncWebParameter *menuName)
+{
+  static const char hex[] = "0123456789ABCDEF";
+  String etag("\"");
+  etag.concat(String(bootToken, HEX));
+  etag.concat("-");
+  etag.concat(version);
+  if (menuName != nullptr) {
+    // percent-encoded, so that a quote or a non-ascii char can't end up in the ETag
+    etag.concat("-");
+    const String &name = menuName->value();
+    for (int i = 0; i < name.length(); i++) {
+      char c = name.charAt(i);
+      if (isalnum((unsigned char)c) || c == '.' || c == '_' || c == '-') {
+        etag.concat(c);
+      } else {
+        etag.concat('%');
+        etag.concat(hex[(c >> 4) & 0x0F]);
+        etag.concat(hex[c & 0x0F]);
+      }
+    }
+  }
+  etag.concat("\"");
+  return etag;
+}
+
 /**
  * URL format:
  * /cmd?c=<command>+<arg>+<arg>...
+ * /menu[?m=<service name>]
+ *     Menu list, or menu info of the service, as JSON. Served with an ETag
+ *     holding a random token of this boot and the menu version, so that clients
+ *     can revalidate with If-None-Match.
  */
 void CommandHttpServer::init(AsyncWebServer *server, CommandMgr *commandMgr, LogMgr *logMgr)
 {
   this->commandMgr = commandMgr;
   this->logger = logMgr->newLogger("CommandHttpServer");
+  bootToken = esp_random();
   server->on("/cmd", [this](AsyncWebServerRequest *request) {
     AsyncWebParameter *p = request->getParam("c");
     if (p == nullptr) {
@@ -49,4 +81,24 @@ void CommandHttpServer::init(AsyncWebServer *server, CommandMgr *commandMgr, Log
       }
     }
   });
+
+  server->on("/menu", [this](AsyncWebServerRequest *request) {
+    AsyncWebParameter *p = request->getParam("m");
+    String etag = menuEtag(bootToken, this->commandMgr->getMenuVersion(), p);
+    if (request->hasHeader("If-None-Match") && request->getHeader("If-None-Match")->value().equals(etag)) {
+      AsyncWebServerResponse *response = request->beginResponse(304);
+      response->addHeader("ETag", etag);
+      request->send(response);
+      return;
+    }
+
+    String menu;
+    uint32_t version = this->commandMgr->getMenuData(p == nullptr ? nullptr : p->value().c_str(), &menu);
+    // the version may have changed since the check above
+    etag = menuEtag(bootToken, version, p);
+    AsyncWebServerResponse *response = request->beginResponse(200, "application/json", menu);
+    response->addHeader("ETag", etag);
+    response->addHeader("Cache-Control", "no-cache");
+    request->send(response);
+  });
 }
@@ -15,6 +15,7 @@ public:
 private:
   CommandMgr *commandMgr;
   Logger *logger;
+  uint32_t bootToken; // in the menu ETag, as the menu version restarts at each boot
 
   void processCommand(String cmdm, AsyncWebSocketClient *client);
 
@@ -10,6 +10,8 @@
 #include <vector>
 
 CommandMgr::CommandMgr() {
+    menuVersion = 1;
+    menuListVersion = 0;
 }
 
 CommandMgr::~CommandMgr() {
@@ -124,40 +126,95 @@ void CommandMgr::init(UEventLoop *eventLoop) {
     eventSem = xSemaphoreCreateBinary();
     cmdInternalMenuList = eventLoop->getEventType("cmd:internal", "menuList");
     cmdInternalMenuInfo = eventLoop->getEventType("cmd:internal", "menuInfo");
+    // not in a "cmd:" class, so that it can't be invoked from a command line
+    batchEventType = eventLoop->getEventType("cmdMgr", "batch");
+    eventLoop->onEvent(batchEventType, [this](UEvent *event) -> bool {
+        CommandBatch *batch = reinterpret_cast<CommandBatch *>(event->dataPtr);
+        bool isAllProcessed = true;
+        for (size_t i = 0; i < batch->entries.size(); i++) {
+            CommandBatch::Entry &e = batch->entries[i];
+            CommandBatch::Result &r = batch->results[i];
+            if (e.eventType != 0) {
+                r.isProcessed = processEventDirect(e.eventType, e.args.c_str(), &r.msg);
+            }
+            isAllProcessed = isAllProcessed && r.isProcessed;
+        }
+        return isAllProcessed;
+    });
 }
 
 UEventLoop *CommandMgr::getEventLoop() {
     return eventLoop;
 }
 
+void CommandMgr::invalidateMenu() {
+    menuMon.enter();
+    ++menuVersion;
+    if (menuVersion == 0) { // 0 is used for "not generated"
+        menuVersion = 1;
+    }
+    menuMon.leave();
+}
+
+uint32_t CommandMgr::getMenuVersion() {
+    return menuVersion;
+}
+
+uint32_t CommandMgr::getMenuData(const char *menuName, String *buf) {
+    uint32_t version;
+    menuMon.enter();
+    version = menuVersion;
+    if (menuName == nullptr) {
+        getMenuList(*buf);
+    } else {
+        getMenuInfo(menuName, *buf);
+    }
+    menuMon.leave();
+    return version;
+}
+
+// called with menuMon held
 void CommandMgr::getMenuList(String &menuStr) {
-    DynamicJsonBuffer buf;
-    JsonArray &menu = buf.createArray();
-    for (auto service = serviceCommands.begin(); service != serviceCommands.end(); ++service) {
-        menu.add((*service)->serviceName);
+    if (menuListVersion != menuVersion) {
+        DynamicJsonBuffer buf;
+        JsonArray &menu = buf.createArray();
+        for (auto service = serviceCommands.begin(); service != serviceCommands.end(); ++service) {
+            menu.add((*service)->serviceName);
+        }
+        menuListCache.clear();
+        menu.printTo(menuListCache);
+        menuListVersion = menuVersion;
     }
-    menu.printTo(menuStr);
+    menuStr.concat(menuListCache);
 }
 
+// called with menuMon held
 void CommandMgr::getMenuInfo(const char *menuName, String &menuStr) {
-    DynamicJsonBuffer buf;
-    JsonObject &menu = buf.createObject();
     for (auto service = serviceCommands.begin(); service != serviceCommands.end(); ++service) {
         if (strcmp((*service)->getServiceName(), menuName) == 0) {
-            JsonObject &s = buf.createObject();
-            for (auto cmd = (*service)->commandEntries.begin(); cmd != (*service)->commandEntries.end(); ++cmd) {
-                (*cmd)->addMenuInfo(&s);
+            ServiceCommands *sc = *service;
+            if (sc->menuInfoVersion != menuVersion) {
+                DynamicJsonBuffer buf;
+                JsonObject &menu = buf.createObject();
+                JsonObject &s = buf.createObject();
+                for (auto cmd = sc->commandEntries.begin(); cmd != sc->commandEntries.end(); ++cmd) {
+                    (*cmd)->addMenuInfo(&s);
+                }
+                s["status"] = "Show the current status/configuration\n";
+                s["save"] = "save [config name]: Save the current config, optionally under a specified config name";
+                s["load"] = "load [config name]: Load the specified config, by default the one that was previously loaded, or \"default\" if none";
+                s["configs"] = "List the saved configs";
+                s["help"] = "List available commands and help";
+                menu[sc->getServiceName()] = s;
+                sc->menuInfoCache.clear();
+                menu.printTo(sc->menuInfoCache);
+                sc->menuInfoVersion = menuVersion;
             }
-            s["status"] = "Show the current status/configuration\n";
-            s["save"] = "save [config name]: Save the current config, optionally under a specified config name";
-            s["load"] = "load [config name]: Load the specified config, by default the one that was previously loaded, or \"default\" if none";
-            s["configs"] = "List the saved configs";
-            s["help"] = "List available commands and help";
-            menu[(*service)->getServiceName()] = s;
-            break;
+            menuStr.concat(sc->menuInfoCache);
+            return;
         }
     }
-    menu.printTo(menuStr);
+    menuStr.concat("{}");
 }
 
 /**
@@ -183,14 +240,8 @@ bool CommandMgr::processCommandLine(const char *channel, String *cmd) {
     }
 
     // handle internal commands
-    if (eventType == cmdInternalMenuList) {
-        *cmd = "@internal:menuList:";
-        getMenuList(*cmd);
-        return true;
-    } else if (eventType == cmdInternalMenuInfo) {
-        *cmd = "@internal:menuInfo:";
-        getMenuInfo(argsStr, *cmd);
-        return true;
+    if (eventType == cmdInternalMenuList || eventType == cmdInternalMenuInfo) {
+        return processEventDirect(eventType, argsStr, cmd);
     }
 
     *cmd = argsStr;
@@ -210,7 +261,7 @@ bool CommandMgr::processCommandLine(const char *channel, String *cmd) {
             // cannot wait on a semaphore for the processing signal.
             // Go process the event directly
 // Serial.printf("CommandMgr processing event while in event loop's thread\n");
-            isProcessed = eventLoop->processEvent(UEvent(eventType, cmd));
+            isProcessed = processEventDirect(eventType, cmd->c_str(), cmd);
 // Serial.printf("CommandMgr done processing event\n");
         } else {
             // bool queueEvent(UEvent &event, std::function<void(UEvent*)> finalizer,
@@ -222,9 +273,10 @@ bool CommandMgr::processCommandLine(const char *channel, String *cmd) {
             bool queued = eventLoop->queueEvent(
                 event,
                 [](UEvent *event) -> void {},
-                [&isProcessed](UEvent *event, bool inIsProcessed) {
+                [this, &isProcessed, cmd](UEvent *event, bool inIsProcessed) {
                     // Serial.printf("Event leaving the queue, %s\n", inIsProcessed ? "processed" : "not processed");
                     isProcessed = inIsProcessed;
+                    notifyCommand(event->eventType, inIsProcessed, cmd);
                     return;
                 },
                 eventSem);
@@ -246,6 +298,161 @@ bool CommandMgr::processCommandLine(const char *channel, String *cmd) {
     return isProcessed;
 }
 
+bool CommandMgr::queueCommandLine(const char *channel, const String &cmdLine,
+        std::function<void(bool isProcessed, String *result)> onDone) {
+    String cmd(cmdLine);
+    if (cmd.length() >= 1024) {
+        cmd = "Command too long, maximum size 1024 bytes";
+        onDone(false, &cmd);
+        return true;
+    }
+    StringSplitter<1024> splitter(&cmd);
+    const char *commandClassStr = splitter.nextWord("cmd:");
+    const char *commandStr = splitter.nextWord();
+    const char *argsStr = splitter.rest();
+
+    int eventType = eventLoop->findEventType(commandClassStr, commandStr);
+    if (eventType == 0) {
+        cmd = "Unrecognized command";
+        onDone(false, &cmd);
+        return true;
+    }
+    if (eventType == cmdInternalMenuList || eventType == cmdInternalMenuInfo) {
+        bool isProcessed = processEventDirect(eventType, argsStr, &cmd);
+        onDone(isProcessed, &cmd);
+        return true;
+    }
+
+    String *args = new String(argsStr);
+    bool queued = eventLoop->queueEvent(
+        UEvent(eventType, args),
+        [args](UEvent *event) {
+            delete args;
+        },
+        [this, args, onDone](UEvent *event, bool isProcessed) {
+            notifyCommand(event->eventType, isProcessed, args);
+            onDone(isProcessed, args);
+        });
+    return queued;
+}
+
+bool CommandMgr::processEventDirect(uint32_t eventType, const char *args, String *cmd) {
+    if (eventType == cmdInternalMenuList) {
+        *cmd = "@internal:menuList:";
+        getMenuData(nullptr, cmd);
+        return true;
+    } else if (eventType == cmdInternalMenuInfo) {
+        String menuName(args);
+        *cmd = "@internal:menuInfo:";
+        getMenuData(menuName.c_str(), cmd);
+        return true;
+    }
+    if (args != cmd->c_str()) {
+        *cmd = args;
+    }
+    bool isProcessed = eventLoop->processEvent(UEvent(eventType, cmd));
+    notifyCommand(eventType, isProcessed, cmd);
+    return isProcessed;
+}
+
+void CommandMgr::onChange(ChangeListener listener) {
+    changeListeners.push_back(listener);
+}
+
+void CommandMgr::onCommand(CommandListener listener) {
+    commandListeners.push_back(listener);
+}
+
+void CommandMgr::notifyChange(ServiceCommands *service, ServiceCommands::ParamData *data) {
+    for (auto l = changeListeners.begin(); l != changeListeners.end(); ++l) {
+        (*l)(service, data);
+    }
+}
+
+void CommandMgr::notifyCommand(uint32_t eventType, bool isProcessed, String *result) {
+    if (commandListeners.size() == 0) {
+        return;
+    }
+    for (auto service = serviceCommands.begin(); service != serviceCommands.end(); ++service) {
+        if ((uint32_t)(*service)->eventClass == (eventType & 0xFFFF0000)) {
+            for (auto l = commandListeners.begin(); l != commandListeners.end(); ++l) {
+                (*l)(*service, eventType, isProcessed, result);
+            }
+            break;
+        }
+    }
+}
+
+bool CommandMgr::addToBatch(CommandBatch *batch, const char *cmdLine, String *msg) {
+    String line(cmdLine);
+    if (line.length() >= 1024) {
+        if (msg != nullptr) {
+            *msg = "Command too long, maximum size 1024 bytes";
+        }
+        return false;
+    }
+    StringSplitter<1024> splitter(&line);
+    batch->entries.emplace_back();
+    CommandBatch::Entry &e = batch->entries.back();
+    e.cmdLine = line;
+    e.commandClass = splitter.nextWord("cmd:");
+    e.command = splitter.nextWord();
+    e.args = splitter.rest();
+    e.eventType = eventLoop->findEventType(e.commandClass.c_str(), e.command.c_str());
+    batch->results.emplace_back();
+    batch->results.back().isProcessed = false;
+    if (e.eventType == 0) {
+        if (msg != nullptr) {
+            *msg = "Unrecognized command";
+        }
+        return false;
+    }
+    return true;
+}
+
+int CommandMgr::processBatch(const char *channel, CommandBatch *batch) {
+    // resolve commands whose service was not yet registered when the batch was compiled
+    for (size_t i = 0; i < batch->entries.size(); i++) {
+        CommandBatch::Entry &e = batch->entries[i];
+        CommandBatch::Result &r = batch->results[i];
+        if (e.eventType == 0) {
+            e.eventType = eventLoop->findEventType(e.commandClass.c_str(), e.command.c_str());
+        }
+        r.isProcessed = false;
+        r.msg = e.eventType == 0 ? "Unrecognized command" : "";
+    }
+
+    if (xTaskGetCurrentTaskHandle() == eventLoop->getProcessingTask()) {
+        for (size_t i = 0; i < batch->entries.size(); i++) {
+            CommandBatch::Entry &e = batch->entries[i];
+            if (e.eventType != 0) {
+                CommandBatch::Result &r = batch->results[i];
+                r.isProcessed = processEventDirect(e.eventType, e.args.c_str(), &r.msg);
+            }
+        }
+    } else {
+        // one handoff to the event loop for the whole batch, unresolved entries are skipped
+        mon.enter();
+        bool queued = eventLoop->queueEvent(UEvent(batchEventType, batch), [](UEvent *event) -> void {}, nullptr, eventSem);
+        xSemaphoreTake(eventSem, portMAX_DELAY); // given also if the event couldn't be queued
+        mon.leave();
+        if (!queued) {
+            for (size_t i = 0; i < batch->results.size(); i++) {
+                batch->results[i].isProcessed = false;
+                batch->results[i].msg = "Error queueing the command";
+            }
+        }
+    }
+
+    int processedCount = 0;
+    for (size_t i = 0; i < batch->results.size(); i++) {
+        if (batch->results[i].isProcessed) {
+            ++processedCount;
+        }
+    }
+    return processedCount;
+}
+
 //
 // ServiceCommands' data
 //
@@ -267,6 +474,17 @@ void ServiceCommands::ParamData::addMenuInfo(JsonObject *menuInfo) {
         (*menuInfo)[cmd.get()] = help.get();
     }
 }
+void ServiceCommands::ParamData::addStatusInfo(String *msg) {
+    String val;
+    if (addValue(&val)) {
+        msg->concat("    ");
+        msg->concat(name.get());
+        msg->concat(": ");
+        msg->concat(val);
+        msg->concat("\n");
+    }
+}
+
 void ServiceCommands::ParamData::addHelpInfo(String *msg) {
     if (cmd.get() != nullptr && help.get() != nullptr) {
         msg->concat("    ");
@@ -297,11 +515,8 @@ ServiceCommands::IntData::IntData(const String *name) : ParamData(ParamData::Typ
     showAsHex = false;
 }
 
-void ServiceCommands::IntData::addStatusInfo(String *msg) {
+bool ServiceCommands::IntData::addValue(String *msg) {
     if (getFn != nullptr || ptr != nullptr) {
-        msg->concat("    ");
-        msg->concat(name.get());
-        msg->concat(": ");
         int val;
         if (getFn != nullptr) {
             val = getFn();
@@ -313,8 +528,9 @@ void ServiceCommands::IntData::addStatusInfo(String *msg) {
         } else {
             msg->concat(val);
         }
-        msg->concat("\n");
+        return true;
     }
+    return false;
 }
 
 void ServiceCommands::IntData::addMenuInfo(JsonObject *menuInfo) {
@@ -402,11 +618,8 @@ ServiceCommands::FloatData::FloatData(const String *name) : ParamData(ParamData:
     event = -1;
 }
 
-void ServiceCommands::FloatData::addStatusInfo(String *msg) {
+bool ServiceCommands::FloatData::addValue(String *msg) {
     if (getFn != nullptr || ptr != nullptr) {
-        msg->concat("    ");
-        msg->concat(name.get());
-        msg->concat(": ");
         float val;
         if (getFn != nullptr) {
             val = getFn();
@@ -414,8 +627,9 @@ void ServiceCommands::FloatData::addStatusInfo(String *msg) {
             val = *ptr;
         }
         msg->concat(val);
-        msg->concat("\n");
+        return true;
     }
+    return false;
 }
 
 void ServiceCommands::FloatData::addMenuInfo(JsonObject *menuInfo) {
@@ -546,19 +760,18 @@ void ServiceCommands::BoolData::addHelpInfo(String *msg) {
     }
 }
 
-void ServiceCommands::BoolData::addStatusInfo(String *msg) {
+bool ServiceCommands::BoolData::addValue(String *msg) {
     if (getFn != nullptr || ptr != nullptr) {
-        msg->concat("    ");
-        msg->concat(name.get());
-        msg->concat(": ");
         bool val;
         if (getFn != nullptr) {
             val = getFn();
         } else {  // (ptr != nullptr)
             val = *ptr;
         }
-        msg->concat(val ? "on\n" : "off\n");
+        msg->concat(val ? "on" : "off");
+        return true;
     }
+    return false;
 }
 
 bool ServiceCommands::BoolData::load(const JsonVariant &val, bool isCheckOnly, String *msg) {
@@ -617,11 +830,8 @@ ServiceCommands::StringData::StringData(const String *name) : ParamData(ParamDat
     event = -1;
 }
 
-void ServiceCommands::StringData::addStatusInfo(String *msg) {
+bool ServiceCommands::StringData::addValue(String *msg) {
     if (getFn != nullptr || ptr != nullptr) {
-        msg->concat("    ");
-        msg->concat(name.get());
-        msg->concat(": ");
         String val;
         if (getFn != nullptr) {
             getFn(&val);
@@ -629,8 +839,9 @@ void ServiceCommands::StringData::addStatusInfo(String *msg) {
             val = *ptr;
         }
         msg->concat(val);
-        msg->concat("\n");
+        return true;
     }
+    return false;
 }
 
 void ServiceCommands::StringData::addMenuInfo(JsonObject *menuInfo) {
@@ -695,14 +906,12 @@ ServiceCommands::SysPinData::SysPinData(const String *name) : ParamData(ParamDat
     event = -1;
 }
 
-void ServiceCommands::SysPinData::addStatusInfo(String *msg) {
+bool ServiceCommands::SysPinData::addValue(String *msg) {
     if (getFn != nullptr || ptr != nullptr) {
-        msg->concat("    ");
-        msg->concat(name.get());
-        msg->concat(": ");
         msg->concat(ptr->getPin());
-        msg->concat("\n");
+        return true;
     }
+    return false;
 }
 
 void ServiceCommands::SysPinData::addMenuInfo(JsonObject *menuInfo) {
@@ -768,6 +977,16 @@ ServiceCommands::JsonData::JsonData(const String *name) : ParamData(ParamData::T
     event = -1;
 }
 
+bool ServiceCommands::JsonData::addValue(String *msg) {
+    if (getFn != nullptr) {
+        DynamicJsonBuffer buf;
+        JsonVariant val = getFn(buf);
+        val.printTo(*msg);
+        return true;
+    }
+    return false;
+}
+
 void ServiceCommands::JsonData::addStatusInfo(String *msg) {
     if (getFn != nullptr) {
         msg->concat("    ");
@@ -828,6 +1047,15 @@ void ServiceCommands::JsonData::save(JsonBuffer *buf, JsonObject *params) {
 // Y88b  d88P Y8b.     888      Y8bd8P  888 Y88b.   Y8b.     Y88b  d88P Y88..88P 888  888  888 888  888  888 888  888 888  888 Y88b 888      X88 
 //  "Y8888P"   "Y8888  888       Y88P   888  "Y8888P "Y8888   "Y8888P"   "Y88P"  888  888  888 888  888  888 "Y888888 888  888  "Y88888  88888P' 
 
+ServiceCommands *CommandMgr::findServiceCommands(const char *serviceName) {
+    for (auto i = serviceCommands.begin(); i != serviceCommands.end(); i++) {
+        if ((*i)->serviceName.equals(serviceName)) {
+            return *i;
+        }
+    }
+    return nullptr;
+}
+
 ServiceCommands *CommandMgr::getServiceCommands(const char *serviceName) {
     for (auto i = serviceCommands.begin(); i != serviceCommands.end(); i++) {
         if ((*i)->serviceName.equals(serviceName)) {
@@ -838,12 +1066,14 @@ ServiceCommands *CommandMgr::getServiceCommands(const char *serviceName) {
     ServiceCommands *s = new ServiceCommands(serviceName, this);
 
     serviceCommands.push_back(s);
+    invalidateMenu();
     return s;
 }
 
 ServiceCommands::ServiceCommands(const char *serviceName, CommandMgr *cmdMgr) {
     this->serviceName = serviceName;
     this->cmdMgr = cmdMgr;
+    menuInfoVersion = 0;
     beforeLoadFn = nullptr;
     afterLoadFn = nullptr;
     beforeSaveFn = nullptr;
@@ -961,7 +1191,7 @@ void ServiceCommands::registerIntData(IntDataBuilder &builder) {
         sn.concat(serviceName);
         data->event = cmdMgr->getEventLoop()->getEventType(sn.c_str(), data->cmd);
         if (data->setFn != nullptr || data->getFn != nullptr || data->ptr != nullptr) {
-            cmdMgr->getEventLoop()->onEvent(data->event, [data](UEvent *event) -> bool {
+            cmdMgr->getEventLoop()->onEvent(data->event, [this, data](UEvent *event) -> bool {
                 String *msg = reinterpret_cast<String *>(const_cast<void *>(event->dataPtr));
                 const char *p = msg->c_str();
                 while (*p != '\0' && isspace(*p)) {
@@ -1018,6 +1248,9 @@ void ServiceCommands::registerIntData(IntDataBuilder &builder) {
                     } else {
                         rc = false;
                     }
+                    if (rc) {
+                        cmdMgr->notifyChange(this, data);
+                    }
                     return rc;
                 }
             });
@@ -1025,6 +1258,7 @@ void ServiceCommands::registerIntData(IntDataBuilder &builder) {
     }
 
     commandEntries.push_back(data);
+    cmdMgr->invalidateMenu();
 }
 
 void ServiceCommands::registerFloatData(FloatDataBuilder &builder) {
@@ -1034,7 +1268,7 @@ void ServiceCommands::registerFloatData(FloatDataBuilder &builder) {
         sn.concat(serviceName);
         data->event = cmdMgr->getEventLoop()->getEventType(sn.c_str(), data->cmd);
         if (data->setFn != nullptr || data->getFn != nullptr|| data->ptr != nullptr) {
-            cmdMgr->getEventLoop()->onEvent(data->event, [data](UEvent *event) -> bool {
+            cmdMgr->getEventLoop()->onEvent(data->event, [this, data](UEvent *event) -> bool {
                 String *msg = reinterpret_cast<String *>(const_cast<void *>(event->dataPtr));
                 const char *p = msg->c_str();
                 while (*p != '\0' && isspace(*p)) {
@@ -1083,6 +1317,9 @@ void ServiceCommands::registerFloatData(FloatDataBuilder &builder) {
                     } else {
                         rc = false;
                     }
+                    if (rc) {
+                        cmdMgr->notifyChange(this, data);
+                    }
                     return rc;
                 }
             });
@@ -1090,6 +1327,7 @@ void ServiceCommands::registerFloatData(FloatDataBuilder &builder) {
     }
 
     commandEntries.push_back(data);
+    cmdMgr->invalidateMenu();
 }
 
 void ServiceCommands::registerBoolData(BoolDataBuilder &builder) {
@@ -1099,7 +1337,7 @@ void ServiceCommands::registerBoolData(BoolDataBuilder &builder) {
     if (data->cmd != nullptr) {
         data->event = cmdMgr->getEventLoop()->getEventType(sn.c_str(), data->cmd);
         if (data->setFn != nullptr || data->getFn != nullptr || data->ptr != nullptr) {
-            cmdMgr->getEventLoop()->onEvent(data->event, [data](UEvent *event) -> bool {
+            cmdMgr->getEventLoop()->onEvent(data->event, [this, data](UEvent *event) -> bool {
                 String *msg = reinterpret_cast<String *>(const_cast<void *>(event->dataPtr));
                 const char *p = msg->c_str();
                 while (*p != '\0' && isspace(*p)) {
@@ -1133,6 +1371,9 @@ void ServiceCommands::registerBoolData(BoolDataBuilder &builder) {
                     } else {
                         rc = false;
                     }
+                    if (rc) {
+                        cmdMgr->notifyChange(this, data);
+                    }
                     return rc;
                 }
             });
@@ -1142,7 +1383,7 @@ void ServiceCommands::registerBoolData(BoolDataBuilder &builder) {
     if (data->cmdOn != nullptr) {
         data->eventOn = cmdMgr->getEventLoop()->getEventType(sn.c_str(), data->cmdOn);
         if (data->setFn != nullptr || data->ptr != nullptr) {
-            cmdMgr->getEventLoop()->onEvent(data->eventOn, [data](UEvent *event) -> bool {
+            cmdMgr->getEventLoop()->onEvent(data->eventOn, [this, data](UEvent *event) -> bool {
                 String *msg = reinterpret_cast<String *>(const_cast<void *>(event->dataPtr));
                 msg->clear();
                 bool rc;
@@ -1152,6 +1393,9 @@ void ServiceCommands::registerBoolData(BoolDataBuilder &builder) {
                     *data->ptr = true;
                     rc = true;
                 }
+                if (rc) {
+                    cmdMgr->notifyChange(this, data);
+                }
                 return rc;
             });
         }
@@ -1160,7 +1404,7 @@ void ServiceCommands::registerBoolData(BoolDataBuilder &builder) {
     if (data->cmdOff != nullptr) {
         data->eventOff = cmdMgr->getEventLoop()->getEventType(sn.c_str(), data->cmdOff);
         if (data->setFn != nullptr || data->ptr != nullptr) {
-            cmdMgr->getEventLoop()->onEvent(data->eventOff, [data](UEvent *event) -> bool {
+            cmdMgr->getEventLoop()->onEvent(data->eventOff, [this, data](UEvent *event) -> bool {
                 String *msg = reinterpret_cast<String *>(const_cast<void *>(event->dataPtr));
                 msg->clear();
                 bool rc;
@@ -1170,12 +1414,16 @@ void ServiceCommands::registerBoolData(BoolDataBuilder &builder) {
                     *data->ptr = false;
                     rc = true;
                 }
+                if (rc) {
+                    cmdMgr->notifyChange(this, data);
+                }
                 return rc;
             });
         }
     }
 
     commandEntries.push_back(data);
+    cmdMgr->invalidateMenu();
 }
 
 void ServiceCommands::registerStringData(StringDataBuilder &builder) {
@@ -1185,7 +1433,7 @@ void ServiceCommands::registerStringData(StringDataBuilder &builder) {
         sn.concat(serviceName);
         data->event = cmdMgr->getEventLoop()->getEventType(sn.c_str(), data->cmd);
         if (data->getFn != nullptr || data->setFn != nullptr || data->ptr != nullptr) {
-            cmdMgr->getEventLoop()->onEvent(data->event, [data](UEvent *event) -> bool {
+            cmdMgr->getEventLoop()->onEvent(data->event, [this, data](UEvent *event) -> bool {
                 String *msg = reinterpret_cast<String *>(const_cast<void *>(event->dataPtr));
                 const char *p = msg->c_str();
                 while (*p != '\0' && isspace(*p)) {
@@ -1218,6 +1466,9 @@ void ServiceCommands::registerStringData(StringDataBuilder &builder) {
                     } else {
                         rc = false;
                     }
+                    if (rc) {
+                        cmdMgr->notifyChange(this, data);
+                    }
                     return rc;
                 }
             });
@@ -1225,6 +1476,7 @@ void ServiceCommands::registerStringData(StringDataBuilder &builder) {
     }
 
     commandEntries.push_back(data);
+    cmdMgr->invalidateMenu();
 }
 
 void ServiceCommands::registerSysPinData(SysPinDataBuilder &builder) {
@@ -1234,7 +1486,7 @@ void ServiceCommands::registerSysPinData(SysPinDataBuilder &builder) {
         sn.concat(serviceName);
         data->event = cmdMgr->getEventLoop()->getEventType(sn.c_str(), data->cmd);
         if (data->setFn != nullptr || data->getFn != nullptr || data->ptr != nullptr) {
-            cmdMgr->getEventLoop()->onEvent(data->event, [data](UEvent *event) -> bool {
+            cmdMgr->getEventLoop()->onEvent(data->event, [this, data](UEvent *event) -> bool {
                 String *msg = reinterpret_cast<String *>(const_cast<void *>(event->dataPtr));
                 const char *p = msg->c_str();
                 while (*p != '\0' && isspace(*p)) {
@@ -1271,6 +1523,9 @@ void ServiceCommands::registerSysPinData(SysPinDataBuilder &builder) {
                     } else {
                         rc = false;
                     }
+                    if (rc) {
+                        cmdMgr->notifyChange(this, data);
+                    }
                     return rc;
                 }
             });
@@ -1278,6 +1533,7 @@ void ServiceCommands::registerSysPinData(SysPinDataBuilder &builder) {
     }
 
     commandEntries.push_back(data);
+    cmdMgr->invalidateMenu();
 }
 
 void ServiceCommands::registerJsonData(JsonDataBuilder &builder) {
@@ -1287,7 +1543,7 @@ void ServiceCommands::registerJsonData(JsonDataBuilder &builder) {
         sn.concat(serviceName);
         data->event = cmdMgr->getEventLoop()->getEventType(sn.c_str(), data->cmd);
         if (data->getFn != nullptr || data->setFn != nullptr) {
-            cmdMgr->getEventLoop()->onEvent(data->event, [data](UEvent *event) -> bool {
+            cmdMgr->getEventLoop()->onEvent(data->event, [this, data](UEvent *event) -> bool {
                 String *msg = reinterpret_cast<String *>(const_cast<void *>(event->dataPtr));
                 const char *p = msg->c_str();
                 while (*p != '\0' && isspace(*p)) {
@@ -1316,6 +1572,9 @@ void ServiceCommands::registerJsonData(JsonDataBuilder &builder) {
                     } else {
                         rc = false;
                     }
+                    if (rc) {
+                        cmdMgr->notifyChange(this, data);
+                    }
                     return rc;
                 }
             });
@@ -1323,6 +1582,7 @@ void ServiceCommands::registerJsonData(JsonDataBuilder &builder) {
     }
 
     commandEntries.push_back(data);
+    cmdMgr->invalidateMenu();
 }
 
 void ServiceCommands::onBeforeStatus(std::function<bool(String *msg)> beforeStatusFn) {
@@ -1486,6 +1746,7 @@ bool ServiceCommands::load(const char *keyName, String *msg) {
     if (afterLoadFn != nullptr) {
         afterLoadFn(msg);
     }
+    cmdMgr->notifyChange(this, nullptr);
     Serial.printf("Loaded config %s/%s\n", serviceName.c_str(), keyName);
     currentKeyName = keyName;
     return true;
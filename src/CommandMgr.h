@@ -65,7 +65,9 @@ public:
     ParamData(Type type, const String *theName);
     virtual void addMenuInfo(JsonObject *menuInfo);
     virtual void addHelpInfo(String *msg);
-    virtual void addStatusInfo(String *msg) = 0;
+    virtual void addStatusInfo(String *msg);
+    /** Appends the current value to *msg, returns false if the value can't be read */
+    virtual bool addValue(String *msg) = 0;
     virtual bool load(const JsonVariant &val, bool isCheckOnly, String *msg) = 0;
     virtual void save(JsonBuffer *buf, JsonObject *params) = 0;
   };
@@ -80,7 +82,7 @@ public:
     uint32_t event;
     IntData(const char *name, bool isConstant);
     IntData(const String *name);
-    virtual void addStatusInfo(String *msg);
+    virtual bool addValue(String *msg);
     virtual void addMenuInfo(JsonObject *menuInfo);
     virtual bool load(const JsonVariant &val, bool isCheckOnly, String *msg);
     virtual void save(JsonBuffer *buf, JsonObject *params);
@@ -123,7 +125,7 @@ public:
     uint32_t event;
     FloatData(const char *name, bool isConstant);
     FloatData(const String *name);
-    virtual void addStatusInfo(String *msg);
+    virtual bool addValue(String *msg);
     virtual void addMenuInfo(JsonObject *menuInfo);
     virtual bool load(const JsonVariant &val, bool isCheckOnly, String *msg);
     virtual void save(JsonBuffer *buf, JsonObject *params);
@@ -171,7 +173,7 @@ public:
     BoolData(String *name);
     virtual void addMenuInfo(JsonObject *menuInfo);
     virtual void addHelpInfo(String *msg);
-    virtual void addStatusInfo(String *msg);
+    virtual bool addValue(String *msg);
     virtual bool load(const JsonVariant &val, bool isCheckOnly, String *msg);
     virtual void save(JsonBuffer *buf, JsonObject *params);
   };
@@ -216,7 +218,7 @@ public:
     uint32_t event;
     StringData(const char *name, bool isConstant);
     StringData(const String *name);
-    virtual void addStatusInfo(String *msg);
+    virtual bool addValue(String *msg);
     virtual void addMenuInfo(JsonObject *menuInfo);
     virtual bool load(const JsonVariant &val, bool isCheckOnly, String *msg);
     virtual void save(JsonBuffer *buf, JsonObject *params);
@@ -253,7 +255,7 @@ public:
     uint32_t event;
     SysPinData(const char *name, bool isConstant);
     SysPinData(const String *name);
-    virtual void addStatusInfo(String *msg);
+    virtual bool addValue(String *msg);
     virtual void addMenuInfo(JsonObject *menuInfo);
     virtual bool load(const JsonVariant &val, bool isCheckOnly, String *msg);
     virtual void save(JsonBuffer *buf, JsonObject *params);
@@ -283,6 +285,7 @@ public:
     uint32_t event;
     JsonData(const char *name, bool isConstant);
     JsonData(const String *name);
+    virtual bool addValue(String *msg);
     virtual void addStatusInfo(String *msg);
     virtual void addMenuInfo(JsonObject *menuInfo);
     virtual bool load(const JsonVariant &val, bool isCheckOnly, String *msg);
@@ -323,6 +326,10 @@ public:
    */
   String currentKeyName;
 
+  /** Cached output of CommandMgr::getMenuInfo(), valid if menuInfoVersion is the current menu version */
+  String menuInfoCache;
+  uint32_t menuInfoVersion;
+
   std::function<bool(String *msg)> beforeLoadFn;
   std::function<void(String *msg)> afterLoadFn;
   std::function<bool(String *msg)> beforeSaveFn;
@@ -434,7 +441,41 @@ public:
     }
 };
 
+/**
+ * A sequence of command lines that are tokenized and resolved to event types once,
+ * when added with CommandMgr::addToBatch(), and can then be executed any number of
+ * times with CommandMgr::processBatch() without being parsed again.
+ */
+class CommandBatch {
+    friend class CommandMgr;
+public:
+    struct Result {
+        bool isProcessed;
+        String msg;
+    };
+private:
+    struct Entry {
+        String cmdLine; // original command line, for logging
+        String commandClass; // with "cmd:" prefix
+        String command;
+        String args;
+        uint32_t eventType; // 0 if not (yet) resolved
+    };
+    std::vector<Entry> entries;
+    std::vector<Result> results;
+public:
+    void clear() { entries.clear(); results.clear(); }
+    int size() { return entries.size(); }
+    const char *getCommandLine(int idx) { return entries[idx].cmdLine.c_str(); }
+    /** Valid after CommandMgr::processBatch() */
+    Result *getResult(int idx) { return &results[idx]; }
+};
+
 class CommandMgr {
+public:
+    typedef std::function<void(ServiceCommands *service, ServiceCommands::ParamData *data)> ChangeListener;
+    typedef std::function<void(ServiceCommands *service, uint32_t eventType, bool isProcessed, String *result)> CommandListener;
+
 private:
     UEventLoop *eventLoop;
     Monitor mon;
@@ -442,12 +483,26 @@ private:
 
     int cmdInternalMenuInfo;
     int cmdInternalMenuList;
+    uint32_t batchEventType;
 
     std::vector<ServiceCommands*> serviceCommands;
 
+    // menu list and menu infos are generated once, and regenerated only when
+    // commands are registered, which increments menuVersion
+    Monitor menuMon;
+    uint32_t menuVersion;
+    String menuListCache;
+    uint32_t menuListVersion;
+
   void getMenuList(String &buf);
   void getMenuInfo(const char *menuName, String &buf);
 
+  std::vector<ChangeListener> changeListeners;
+  std::vector<CommandListener> commandListeners;
+  void notifyCommand(uint32_t eventType, bool isProcessed, String *result);
+  /** Processes the command directly, must be called in the event loop's task */
+  bool processEventDirect(uint32_t eventType, const char *args, String *cmd);
+
 public:
     static bool getIntValue(UEvent *event, int *val);
     static bool getLongValue(UEvent *event, long *val);
@@ -474,7 +529,51 @@ public:
      **/
     bool processCommandLine(const char *channel, String *cmd);
 
+    /**
+     * Like processCommandLine(), but doesn't wait for the command to be processed: the
+     * command is queued to the event loop and onDone is called from the event loop's task
+     * with the processing result. Commands that are not recognized, and internal commands,
+     * complete immediately, calling onDone before returning.
+     * Returns false if the command couldn't be queued, onDone is then called with isProcessed false.
+     */
+    bool queueCommandLine(const char *channel, const String &cmd, std::function<void(bool isProcessed, String *result)> onDone);
+
+    /**
+     * Tokenizes the command line and resolves its event type, appending it to the batch.
+     * Returns false and sets *msg if the command is not (yet) recognized; the command is
+     * still added, and resolution is retried when the batch is processed.
+     */
+    bool addToBatch(CommandBatch *batch, const char *cmdLine, String *msg = nullptr);
+    /**
+     * Executes all commands of the batch in a single event loop turn: directly if
+     * called from the event loop's task, else with one queued event for the whole batch.
+     * Per-command results are available with batch->getResult(). Returns the number
+     * of commands that were processed successfully.
+     */
+    int processBatch(const char *channel, CommandBatch *batch);
+
     ServiceCommands *getServiceCommands(const char *serviceName);
+    /** Returns null if the service has no commands registered */
+    ServiceCommands *findServiceCommands(const char *serviceName);
+
+    /**
+     * Listener called from the event loop's task when a value is set by a command, or
+     * when a config is loaded (data is then null, as any value may have changed).
+     */
+    void onChange(ChangeListener listener);
+    /** Listener called from the event loop's task after a service's command is processed */
+    void onCommand(CommandListener listener);
+    void notifyChange(ServiceCommands *service, ServiceCommands::ParamData *data);
+
+    /** Called when commands are registered, so that cached menu data is regenerated */
+    void invalidateMenu();
+    /** Current version of the menu data, changes whenever commands are registered */
+    uint32_t getMenuVersion();
+    /**
+     * Appends the menu data to *buf, as JSON: the list of services if menuName is null,
+     * else the menu info of the service. Returns the menu version of the data.
+     */
+    uint32_t getMenuData(const char *menuName, String *buf);
 
 };
 
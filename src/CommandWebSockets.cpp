@@ -24,15 +24,225 @@ void WebSocketsServer::init(AsyncWebServer *server, CommandMgr *commandMgr, Syst
              { onWsEvent(server, client, type, arg, data, len); });
   server->addHandler(&ws);
 
+  // defaults
+  pushIntervalMillis = 200;
+  pushPollMillis = 1000;
+  pushMaxPendingEvents = 32;
+  broadcastStallMillis = 10000;
+  broadcastCount = 0;
+
+  ServiceCommands *cmd = commandMgr->getServiceCommands("ws");
+  initCommands(cmd);
+
+  // load config
+  String msg;
+  bool rc;
+  rc = cmd->load(nullptr, &msg);
+  if (rc) {
+    String keyName;
+    cmd->getCurrentKeyName(&keyName);
+    Serial.printf("Loaded config for %s/%s\n", cmd->getServiceName(), keyName.c_str());
+  }
+
+  commandMgr->onChange([this](ServiceCommands *service, ServiceCommands::ParamData *data) {
+    onValueChange(service, data);
+  });
+  commandMgr->onCommand([this](ServiceCommands *service, uint32_t eventType, bool isProcessed, String *result) {
+    onServiceCommand(service, eventType, isProcessed, result);
+  });
+  pushTimer.init(commandMgr->getEventLoop(), [this](UEventLoopTimer *timer) {
+    pushUpdates();
+  });
+  pushTimer.setInterval(20);
+
+  initLogBroadcast(logMgr);
+
   // events.onConnect([](AsyncEventSourceClient *client) {
   //   client->send("hello!", NULL, millis(), 1000);
   // });
   // server->addHandler(&events);
 }
 
+void WebSocketsServer::initCommands(ServiceCommands *cmd)
+{
+  cmd->registerIntData(
+    ServiceCommands::IntDataBuilder("pushIntervalMillis", true)
+    .cmd("pushIntervalMillis")
+    .help("--> Default minimum interval between subscription pushes to a client, in millis")
+    .vMin(20)
+    .vMax(3600000)
+    .ptr(&pushIntervalMillis)
+  );
+  cmd->registerIntData(
+    ServiceCommands::IntDataBuilder("pushPollMillis", true)
+    .cmd("pushPollMillis")
+    .help("--> Interval for reading subscribed fields that changed without a command, in millis")
+    .vMin(100)
+    .vMax(3600000)
+    .ptr(&pushPollMillis)
+  );
+  cmd->registerIntData(
+    ServiceCommands::IntDataBuilder("pushMaxPendingEvents", true)
+    .cmd("pushMaxPendingEvents")
+    .help("--> Events pending for a client, above which the client gets a snapshot instead")
+    .vMin(1)
+    .vMax(1000)
+    .ptr(&pushMaxPendingEvents)
+  );
+  cmd->registerIntData(
+    ServiceCommands::IntDataBuilder("broadcastStallMillis", true)
+    .cmd("broadcastStallMillis")
+    .help("--> A broadcast subscriber that keeps missing messages for this long is disconnected")
+    .vMin(1000)
+    .vMax(3600000)
+    .ptr(&broadcastStallMillis)
+  );
+  cmd->registerIntData(
+    ServiceCommands::IntDataBuilder("broadcastCount", true)
+    .cmd("broadcastCount")
+    .help("--> Number of messages broadcast")
+    .isPersistent(false)
+    .getFn([this]() {
+      return (int)broadcastCount;
+    })
+  );
+  cmd->registerStringData(
+    ServiceCommands::StringDataBuilder("broadcastClients", true)
+    .cmd("broadcastClients")
+    .help("--> Broadcast subscribers, with sent and dropped message counts")
+    .isPersistent(false)
+    .includeInStatus(false) // a line per client; reads under subsMon, never call it holding it
+    .getFn([this](String *val) {
+      subsMon.enter();
+      for (auto i = broadcastClients.begin(); i != broadcastClients.end(); ++i) {
+        *val += String("\n        client ") + i->first + ": sent " + i->second.sentCount
+          + ", dropped " + i->second.droppedCount;
+      }
+      subsMon.leave();
+    })
+  );
+  cmd->registerIntData(
+    ServiceCommands::IntDataBuilder("subscribedClients", true)
+    .cmd("subscribedClients")
+    .help("--> Number of clients having subscriptions")
+    .isPersistent(false)
+    .getFn([this]() {
+      subsMon.enter();
+      int n = clientSubscriptions.size();
+      subsMon.leave();
+      return n;
+    })
+  );
+}
+
 void WebSocketsServer::cleanupClients()
 {
- ws.cleanupClients();
+  // close broadcast subscribers that are behind for too long, their backlog would only grow
+  std::vector<uint32_t> stalled;
+  uint32_t now = millis();
+  subsMon.enter();
+  for (auto i = broadcastClients.begin(); i != broadcastClients.end(); ++i) {
+    if (i->second.stallStartMillis != 0 && now - i->second.stallStartMillis > (uint32_t)broadcastStallMillis) {
+      stalled.push_back(i->first);
+    }
+  }
+  for (auto id = stalled.begin(); id != stalled.end(); ++id) {
+    broadcastClients.erase(*id);
+  }
+  subsMon.leave();
+  for (auto id = stalled.begin(); id != stalled.end(); ++id) {
+    logger->debug("Client {} is behind on broadcasts for more than {} ms, closing", *id, broadcastStallMillis);
+    sendMon.enter();
+    ws.close(*id);
+    sendMon.leave();
+  }
+
+  sendMon.enter();
+  ws.cleanupClients();
+  sendMon.leave();
+}
+
+void WebSocketsServer::initLogBroadcast(LogMgr *logMgr)
+{
+  logMgr->addFlusher([this](LogMgr *logMgr, uint64_t flushFrom, int count) {
+    subsMon.enter();
+    bool hasSubscribers = broadcastClients.size() > 0;
+    subsMon.leave();
+    if (!hasSubscribers) {
+      return flushFrom + count;
+    }
+
+    String name;
+    uint32_t timestamp;
+    LogLevel level;
+    String str;
+    String line;
+    for (uint64_t i = flushFrom; i < flushFrom + count; i++) {
+      if (logMgr->getRecord(i, &name, &timestamp, &level, &str)) {
+        line = "@log:";
+        line.concat(timestamp);
+        line.concat(' ');
+        line.concat(name);
+        line.concat(' ');
+        line.concat(logMgr->levelName(level));
+        line.concat(' ');
+        line.concat(str);
+        broadcast(BROADCAST_LOG, line.c_str(), line.length());
+      }
+    }
+    return flushFrom + count;
+  });
+}
+
+void WebSocketsServer::broadcast(BroadcastChannel channel, const char *msg, size_t len)
+{
+  AsyncWebSocketMessageBuffer *buffer = nullptr;
+  uint32_t now = millis();
+  subsMon.enter();
+  sendMon.enter();
+  for (auto i = broadcastClients.begin(); i != broadcastClients.end(); ++i) {
+    BroadcastClient &bc = i->second;
+    if ((bc.channels & channel) == 0) {
+      continue;
+    }
+    AsyncWebSocketClient *client = ws.client(i->first);
+    if (client == nullptr || client->status() != WS_CONNECTED) {
+      continue;
+    }
+    if (client->queueIsFull()) {
+      ++bc.droppedCount;
+      ++bc.unreportedDropCount;
+      if (bc.stallStartMillis == 0) {
+        bc.stallStartMillis = now == 0 ? 1 : now;
+      }
+      continue;
+    }
+    if (bc.unreportedDropCount > 0) {
+      String dropped("@dropped:");
+      dropped.concat(bc.unreportedDropCount);
+      client->text(dropped);
+      bc.unreportedDropCount = 0;
+    }
+    bc.stallStartMillis = 0;
+    if (buffer == nullptr) {
+      // serialized once, on the first client that takes it
+      buffer = ws.makeBuffer(len);
+      if (buffer == nullptr) {
+        break;
+      }
+      memcpy(buffer->get(), msg, len);
+      buffer->lock();
+    }
+    client->text(buffer);
+    ++bc.sentCount;
+  }
+  sendMon.leave();
+  subsMon.leave();
+  ++broadcastCount;
+  if (buffer != nullptr) {
+    buffer->unlock();
+    releaseBuffers(); // frees the buffer if no client queued it
+  }
 }
 
 void WebSocketsServer::onWsEvent(AsyncWebSocket *server, AsyncWebSocketClient *client,
@@ -44,13 +254,20 @@ void WebSocketsServer::onWsEvent(AsyncWebSocket *server, AsyncWebSocketClient *c
   // Serial.printf("ws[%s][%u] connect\n", server->url(), client->id());
     String uptimeStr;
     Util::durationToStr(&uptimeStr, system->uptime());
+    sendMon.enter();
     client->printf("Welcome to esp32, client %u! :) Uptime %s, current reboot level: %s ",
                    client->id(), uptimeStr.c_str(), rebootDetector->isActive() ? rebootDetector->getRebootLevelStr() : "N/A");
+    sendMon.leave();
     //    client->ping(); --> crashes after receipt of pong when browser is from iOS
   }
   else if (type == WS_EVT_DISCONNECT)
   {
     logger->debug("Client {} disconnect", client->id());
+    rxBuffers.erase(client->id());
+    subsMon.enter();
+    clientSubscriptions.erase(client->id());
+    broadcastClients.erase(client->id());
+    subsMon.leave();
   }
   else if (type == WS_EVT_ERROR)
   {
@@ -66,113 +283,269 @@ void WebSocketsServer::onWsEvent(AsyncWebSocket *server, AsyncWebSocketClient *c
     AwsFrameInfo *info = (AwsFrameInfo *)arg;
     // Serial.printf("WebSocketsServer: Called onWsEvent, type = WS_EVT_DATA, opcode: %s, info->final: %d, info->index: %llu, info->len: %llu\n",
     //               (info->opcode == WS_TEXT ? "text" : "binary"), info->final, info->index, info->len);
-    String msg = "";
     if (info->final && info->index == 0 && info->len == len)
     {
-      // the whole message is in a single frame and we got all of it's data
-      // Serial.printf("ws[%s][%u] %s-message[%llu]\n", server->url(), client->id(),
-      //               (info->opcode == WS_TEXT) ? "text" : "binary", info->len);
-
-      if (info->opcode == WS_TEXT)
-      {
-        for (size_t i = 0; i < info->len; i++)
-        {
-          msg += (char)data[i];
-        }
-      }
-      else
-      {
-        char buff[4];
-        for (size_t i = 0; i < info->len; i++)
-        {
-          sprintf(buff, "%02x ", (uint8_t)data[i]);
-          msg += buff;
-        }
-      }
-
-      if (info->opcode == WS_TEXT)
-      {
-        if (msg.equals("noop"))
-        {
-          // ignore
-        }
-        else
-        {
-          logger->debug("Client {} received command \"{}\"", client->id(), msg.c_str());
-          char buf[256];
-          strcpy(buf, "Command: ");
-          strncat(buf, msg.c_str(), sizeof(buf) - strlen(buf));
-          buf[sizeof(buf) - 1] = '\0';
-          client->text(buf);
-
-          processCommand(msg, client);
-        }
-      }
-      else
-      {
-        client->binary("I got your binary message");
-      }
+      // the whole message is in a single frame and we got all of it's data, use it in place
+      processMessage(client, (AwsFrameType)info->opcode, data, len);
     }
     else
     {
       // message is comprised of multiple frames or the frame is split into multiple packets
+      RxBuffer &rx = rxBuffers[client->id()];
       if (info->index == 0)
       {
         if (info->num == 0)
         {
           logger->debug("Client {} {} message start", client->id(),
                         (info->message_opcode == WS_TEXT) ? "text" : "binary");
+          rx.data.clear();
+          rx.opcode = (AwsFrameType)info->message_opcode;
+          rx.isOverflow = false;
+        }
+        if (!rx.isOverflow && rx.data.size() + info->len <= WS_MAX_MESSAGE_SIZE)
+        {
+          rx.data.reserve(rx.data.size() + info->len + 1); // one allocation per frame
         }
-        logger->debug("Client {} frame {} start {}", client->id(), info->num, info->len);
       }
 
-      logger->debug("Client {} frame {} {}[{} - {}]", client->id(), info->num,
-                    (info->message_opcode == WS_TEXT) ? "text" : "binary", info->index, info->index + len);
-
-      if (info->opcode == WS_TEXT)
+      if (rx.data.size() + len > WS_MAX_MESSAGE_SIZE)
       {
-        for (size_t i = 0; i < info->len; i++)
-        {
-          msg += (char)data[i];
-        }
+        rx.isOverflow = true;
       }
-      else
+      if (!rx.isOverflow)
       {
-        char buff[4];
-        for (size_t i = 0; i < info->len; i++)
-        {
-          sprintf(buff, "%02x ", (uint8_t)data[i]);
-          msg += buff;
-        }
+        rx.data.insert(rx.data.end(), data, data + len);
       }
 
-      if ((info->index + len) == info->len)
+      if ((info->index + len) == info->len && info->final)
       {
-        logger->debug("Client {} frame {} end {}", client->id(), info->num, info->len);
-        if (info->final)
+        logger->debug("Client {} {} message end, {} bytes", client->id(),
+                      (rx.opcode == WS_TEXT) ? "text" : "binary", rx.data.size());
+        if (rx.isOverflow)
         {
-          logger->debug("Client {} {} message end", client->id(),
-                        (info->message_opcode == WS_TEXT) ? "text" : "binary");
-          if (info->message_opcode == WS_TEXT)
-          {
-            logger->debug("Client {} received command \"{}\"", client->id(), msg.c_str());
-            char r[512];
-            snprintf(r, sizeof(r), "> %s", msg.c_str());
-            r[sizeof(r) - 1] = '\0';
-            client->text(r);
-
-            processCommand(msg, client);
-          }
-          else
-          {
-            client->binary("I got your binary message");
-          }
+          logger->debug("Client {} message exceeds {} bytes, ignored", client->id(), WS_MAX_MESSAGE_SIZE);
+        }
+        else
+        {
+          size_t msgLen = rx.data.size();
+          rx.data.push_back('\0'); // text messages are used as C strings
+          processMessage(client, rx.opcode, rx.data.data(), msgLen);
         }
+        rxBuffers.erase(client->id());
+      }
+    }
+  }
+}
+
+void WebSocketsServer::processMessage(AsyncWebSocketClient *client, AwsFrameType opcode, uint8_t *data, size_t len)
+{
+  if (opcode == WS_TEXT)
+  {
+    // AsyncWebSocket null-terminates received data, and so do we for assembled messages
+    String msg((const char *)data);
+    if (msg.equals("noop"))
+    {
+      // ignore
+    }
+    else if (msg.startsWith("@"))
+    {
+      processSubscriptionCommand(client, msg);
+    }
+    else
+    {
+      logger->debug("Client {} received command \"{}\"", client->id(), msg.c_str());
+      char buf[256];
+      strcpy(buf, "Command: ");
+      strncat(buf, msg.c_str(), sizeof(buf) - strlen(buf) - 1);
+      buf[sizeof(buf) - 1] = '\0';
+      sendText(client, buf);
+
+      processCommand(msg, client);
+    }
+  }
+  else
+  {
+    processBinaryCommand(client, data, len);
+  }
+}
+
+static bool wsReadVarint(const uint8_t **p, const uint8_t *end, uint32_t *val)
+{
+  uint32_t result = 0;
+  int b = 0;
+  uint8_t v;
+  do {
+    if (*p >= end || b > 28) {
+      return false;
+    }
+    v = **p;
+    result |= ((uint32_t)(v & 0x7F) << b);
+    ++(*p);
+    b += 7;
+  } while ((v & 0x80) != 0);
+  *val = result;
+  return true;
+}
+
+static void wsAddVarint(std::vector<uint8_t> &vect, uint32_t n)
+{
+  while (n & ~0x7F) {
+    vect.push_back((n & 0x7F) | 0x80);
+    n = n >> 7;
+  }
+  vect.push_back(n);
+}
+
+// Appends the value at *p, as text, to *str
+static bool wsReadValue(const uint8_t **p, const uint8_t *end, String *str)
+{
+  if (*p >= end) {
+    return false;
+  }
+  uint8_t tag = **p;
+  ++(*p);
+  switch (tag) {
+    case 's': {
+      uint32_t len;
+      if (!wsReadVarint(p, end, &len) || len > (uint32_t)(end - *p)) {
+        return false;
+      }
+      str->reserve(str->length() + len);
+      for (uint32_t i = 0; i < len; i++) {
+        str->concat((char)(*p)[i]);
+      }
+      *p += len;
+      return true;
+    }
+    case 'i': {
+      uint32_t v;
+      if (!wsReadVarint(p, end, &v)) {
+        return false;
+      }
+      int32_t n = (int32_t)(v >> 1) ^ -(int32_t)(v & 1);
+      str->concat(n);
+      return true;
+    }
+    case 'f': {
+      if (end - *p < 4) {
+        return false;
       }
+      float f;
+      memcpy(&f, *p, 4);
+      *p += 4;
+      str->concat(String(f, 6));
+      return true;
     }
+    case 'b': {
+      if (*p >= end) {
+        return false;
+      }
+      str->concat(**p ? "on" : "off");
+      ++(*p);
+      return true;
+    }
+    default:
+      return false;
   }
 }
 
+void WebSocketsServer::processBinaryCommand(AsyncWebSocketClient *client, const uint8_t *data, size_t len)
+{
+  const uint8_t *p = data;
+  const uint8_t *end = data + len;
+  if (len < 5 || *p != WS_REQUEST_TAG) {
+    logger->debug("Client {} sent an invalid binary message, {} bytes", client->id(), len);
+    sendBinaryResponse(client->id(), 0, WS_STATUS_BAD_REQUEST, "Invalid request header");
+    return;
+  }
+  ++p;
+  uint32_t requestId;
+  memcpy(&requestId, p, 4);
+  p += 4;
+
+  String cmd;
+  if (p >= end || *p != 's' || !wsReadValue(&p, end, &cmd)) {
+    sendBinaryResponse(client->id(), requestId, WS_STATUS_BAD_REQUEST, "Expecting a string command");
+    return;
+  }
+  while (p < end) {
+    cmd.concat(' ');
+    if (!wsReadValue(&p, end, &cmd)) {
+      sendBinaryResponse(client->id(), requestId, WS_STATUS_BAD_REQUEST, "Invalid argument");
+      return;
+    }
+  }
+
+  logger->trace("Client {} request {} processing command: {}", client->id(), requestId, cmd.c_str());
+  uint32_t clientId = client->id();
+  bool queued = commandMgr->queueCommandLine("WS", cmd, [this, clientId, requestId](bool isProcessed, String *result) {
+    sendBinaryResponse(clientId, requestId, isProcessed ? WS_STATUS_OK : WS_STATUS_NOT_PROCESSED, result->c_str());
+  });
+  if (!queued) {
+    sendBinaryResponse(clientId, requestId, WS_STATUS_QUEUE_ERROR, "Error queueing the command");
+  }
+}
+
+void WebSocketsServer::sendBinaryResponse(uint32_t clientId, uint32_t requestId, WsStatus status, const char *result)
+{
+  size_t resultLen = strlen(result);
+  std::vector<uint8_t> buf;
+  buf.reserve(1 + 4 + 1 + 1 + 5 + resultLen);
+  buf.push_back(WS_RESPONSE_TAG);
+  const uint8_t *id = (const uint8_t *)&requestId;
+  buf.insert(buf.end(), id, id + 4);
+  buf.push_back((uint8_t)status);
+  buf.push_back('s');
+  wsAddVarint(buf, resultLen);
+  buf.insert(buf.end(), (const uint8_t *)result, (const uint8_t *)result + resultLen);
+  sendMessage(clientId, true, buf.data(), buf.size());
+}
+
+// Called from any task. The message is copied in a buffer made by ws, which creates and frees its
+// buffers under its own lock, and queued to the client under sendMon; the client may have
+// disconnected meanwhile, it is looked up by ID. Returns false if the message was not queued.
+bool WebSocketsServer::sendMessage(uint32_t clientId, bool isBinary, const uint8_t *data, size_t len)
+{
+  AsyncWebSocketMessageBuffer *buffer = ws.makeBuffer(len);
+  if (buffer == nullptr) {
+    return false;
+  }
+  memcpy(buffer->get(), data, len);
+  buffer->lock();
+  sendMon.enter();
+  AsyncWebSocketClient *client = ws.client(clientId);
+  bool isQueued = (client != nullptr && client->status() == WS_CONNECTED && !client->queueIsFull());
+  if (isQueued) {
+    if (isBinary) {
+      client->binary(buffer);
+    } else {
+      client->text(buffer);
+    }
+  }
+  sendMon.leave();
+  buffer->unlock();
+  releaseBuffers(); // frees the buffer if it wasn't queued
+  return isQueued;
+}
+
+/**
+ * Frees the buffers of ws that are no longer queued to any client. AsyncWebSocket has no supported
+ * call for it: _cleanBuffers() is public, among the internal methods, in the pinned
+ * ESPAsyncWebServer fork, and takes the lock of ws. This is the only place that depends on it,
+ * to check if the library is changed.
+ */
+void WebSocketsServer::releaseBuffers()
+{
+  ws._cleanBuffers();
+}
+
+void WebSocketsServer::sendText(AsyncWebSocketClient *client, const char *msg)
+{
+  sendMon.enter();
+  client->text(msg);
+  sendMon.leave();
+}
+
 void WebSocketsServer::processCommand(String msg, AsyncWebSocketClient *client)
 {
 //  client->text(":)\n");
@@ -181,12 +554,293 @@ void WebSocketsServer::processCommand(String msg, AsyncWebSocketClient *client)
   bool processed = commandMgr->processCommandLine("WS", &msg);
   if (processed) {
     logger->trace("Client {} command processed: {}", client->id(), msg.c_str());
-    client->text(msg.c_str());
+    sendText(client, msg.c_str());
   } else {
     logger->trace("Client {} command not processed: {}", client->id(), msg.c_str());
     char r[512];
     snprintf(r, sizeof(r), "Message not processed: %s", msg.c_str());
     r[sizeof(r) - 1] = '\0';
-    client->text(r);
+    sendText(client, r);
+  }
+}
+
+void WebSocketsServer::processSubscriptionCommand(AsyncWebSocketClient *client, String &msg)
+{
+  StringSplitter<256> splitter(&msg);
+  String op = splitter.nextWord();
+  String serviceName = splitter.nextWord();
+  String reply;
+
+  subsMon.enter();
+  if (op.equals("@subscribe") || op.equals("@subscribeEvents")) {
+    ServiceCommands *service = serviceName.isEmpty() ? nullptr : commandMgr->findServiceCommands(serviceName.c_str());
+    if (service == nullptr) {
+      reply = "@subscribe:error:Unknown service ";
+      reply.concat(serviceName);
+    } else {
+      bool isNew = clientSubscriptions.find(client->id()) == clientSubscriptions.end();
+      ClientSubscriptions &cs = clientSubscriptions[client->id()];
+      if (isNew) {
+        cs.intervalMillis = pushIntervalMillis;
+        cs.lastPushMillis = millis();
+        cs.lastPollMillis = cs.lastPushMillis;
+        cs.droppedCount = 0;
+      }
+      Subscription sub;
+      sub.service = service;
+      sub.isEvents = op.equals("@subscribeEvents");
+      if (!sub.isEvents) {
+        std::vector<String> names;
+        for (String name = splitter.nextWord(); !name.isEmpty(); name = splitter.nextWord()) {
+          names.push_back(name);
+        }
+        for (auto c = service->commandEntries.begin(); c != service->commandEntries.end(); ++c) {
+          bool isIncluded = names.size() == 0 && (*c)->includeInStatus;
+          for (auto n = names.begin(); !isIncluded && n != names.end(); ++n) {
+            isIncluded = n->equals((*c)->name.get());
+          }
+          if (isIncluded) {
+            sub.fields.push_back(*c);
+          }
+        }
+        sub.lastValues.resize(sub.fields.size());
+        sub.isDirty.resize(sub.fields.size(), true);
+      }
+      cs.subscriptions.push_back(sub);
+      cs.needsSnapshot = true; // new subscribers start with a full snapshot
+      reply = "@subscribe:ok:";
+      reply.concat(serviceName);
+    }
+  } else if (op.equals("@unsubscribe")) {
+    auto i = clientSubscriptions.find(client->id());
+    if (i != clientSubscriptions.end()) {
+      std::vector<Subscription> &subs = i->second.subscriptions;
+      for (auto sub = subs.begin(); sub != subs.end(); ) {
+        if (serviceName.isEmpty() || serviceName.equals(sub->service->getServiceName())) {
+          sub = subs.erase(sub);
+        } else {
+          ++sub;
+        }
+      }
+      if (subs.size() == 0) {
+        clientSubscriptions.erase(i);
+      }
+    }
+    reply = "@unsubscribe:ok:";
+    reply.concat(serviceName);
+  } else if (op.equals("@subscribeLog") || op.equals("@unsubscribeLog")) {
+    BroadcastClient &bc = broadcastClients[client->id()];
+    if (op.equals("@subscribeLog")) {
+      bc.channels |= BROADCAST_LOG;
+    } else {
+      bc.channels &= ~BROADCAST_LOG;
+    }
+    if (bc.channels == 0) {
+      broadcastClients.erase(client->id());
+    }
+    reply = op;
+    reply.concat(":ok");
+  } else if (op.equals("@pushInterval")) {
+    long interval = serviceName.toInt();
+    auto i = clientSubscriptions.find(client->id());
+    if (interval < 20 || interval > 3600000) {
+      reply = "@pushInterval:error:Expecting an interval between 20 and 3600000 millis";
+    } else if (i == clientSubscriptions.end()) {
+      reply = "@pushInterval:error:No subscriptions";
+    } else {
+      i->second.intervalMillis = interval;
+      reply = "@pushInterval:ok:";
+      reply.concat(interval);
+    }
+  } else {
+    reply = "@error:Unknown subscription command ";
+    reply.concat(op);
+  }
+  subsMon.leave();
+
+  sendText(client, reply.c_str());
+}
+
+void WebSocketsServer::onValueChange(ServiceCommands *service, ServiceCommands::ParamData *data)
+{
+  subsMon.enter();
+  for (auto cs = clientSubscriptions.begin(); cs != clientSubscriptions.end(); ++cs) {
+    for (auto sub = cs->second.subscriptions.begin(); sub != cs->second.subscriptions.end(); ++sub) {
+      if (sub->service != service || sub->isEvents) {
+        continue;
+      }
+      for (size_t i = 0; i < sub->fields.size(); i++) {
+        if (data == nullptr || sub->fields[i] == data) {
+          sub->isDirty[i] = true;
+        }
+      }
+    }
+  }
+  subsMon.leave();
+}
+
+void WebSocketsServer::onServiceCommand(ServiceCommands *service, uint32_t eventType, bool isProcessed, String *result)
+{
+  String event;
+  subsMon.enter();
+  for (auto cs = clientSubscriptions.begin(); cs != clientSubscriptions.end(); ++cs) {
+    for (auto sub = cs->second.subscriptions.begin(); sub != cs->second.subscriptions.end(); ++sub) {
+      if (sub->service != service || !sub->isEvents) {
+        continue;
+      }
+      if (cs->second.needsSnapshot) {
+        break; // events are dropped until the client gets its snapshot
+      }
+      if (cs->second.pendingEvents.size() >= (size_t)pushMaxPendingEvents) {
+        // fell behind, will get a snapshot instead
+        cs->second.droppedCount += cs->second.pendingEvents.size() + 1;
+        cs->second.pendingEvents.clear();
+        cs->second.needsSnapshot = true;
+        break;
+      }
+      if (event.isEmpty()) {
+        DynamicJsonBuffer buf;
+        JsonObject &e = buf.createObject();
+        e["service"] = service->getServiceName();
+        e["event"] = commandMgr->getEventLoop()->getEventName(eventType);
+        e["processed"] = isProcessed;
+        e["result"] = result->c_str();
+        e.printTo(event);
+      }
+      cs->second.pendingEvents.push_back(event);
+      break;
+    }
+  }
+  subsMon.leave();
+}
+
+void WebSocketsServer::pushUpdates()
+{
+  // The fields are read without subsMon: their getFns may enter it (e.g. the "ws" status). The
+  // fields to read are taken under it, then read, then compared and pushed under it again, for
+  // the subscriptions that are still there.
+  struct FieldRead {
+    size_t subIndex;
+    size_t fieldIndex;
+    ServiceCommands::ParamData *field;
+    String value;
+    bool isRead;
+  };
+  struct ClientPush {
+    uint32_t clientId;
+    bool isSnapshot;
+    size_t firstRead;
+    size_t readCount;
+  };
+  std::vector<FieldRead> reads;
+  std::vector<ClientPush> pushes;
+
+  uint32_t now = millis();
+  subsMon.enter();
+  for (auto cs = clientSubscriptions.begin(); cs != clientSubscriptions.end(); ) {
+    uint32_t clientId = cs->first;
+    ClientSubscriptions &subs = cs->second;
+    AsyncWebSocketClient *client = ws.client(clientId);
+    if (client == nullptr) {
+      cs = clientSubscriptions.erase(cs);
+      continue;
+    }
+    ++cs;
+    if (now - subs.lastPushMillis < subs.intervalMillis) {
+      continue;
+    }
+    if (client->queueIsFull()) {
+      // fell behind, changes keep being marked dirty, events are dropped
+      if (!subs.needsSnapshot) {
+        subs.droppedCount += subs.pendingEvents.size();
+        subs.pendingEvents.clear();
+        subs.needsSnapshot = true;
+      }
+      continue;
+    }
+
+    // taken now: a snapshot needed again while the fields are read is for the next push
+    ClientPush push = { clientId, subs.needsSnapshot, reads.size(), 0 };
+    subs.needsSnapshot = false;
+    // getFn values and values changed by their service aren't notified, they are read and compared
+    bool isPoll = (now - subs.lastPollMillis >= (uint32_t)pushPollMillis);
+    if (isPoll) {
+      subs.lastPollMillis = now;
+    }
+    for (size_t s = 0; s < subs.subscriptions.size(); s++) {
+      Subscription &sub = subs.subscriptions[s];
+      if (sub.isEvents) {
+        continue;
+      }
+      for (size_t i = 0; i < sub.fields.size(); i++) {
+        if (!push.isSnapshot && !isPoll && !sub.isDirty[i]) {
+          continue;
+        }
+        sub.isDirty[i] = false;
+        reads.push_back({ s, i, sub.fields[i], String(), false });
+      }
+    }
+    push.readCount = reads.size() - push.firstRead;
+    pushes.push_back(push);
+  }
+  subsMon.leave();
+
+  for (auto r = reads.begin(); r != reads.end(); ++r) {
+    r->isRead = r->field->addValue(&r->value);
+  }
+
+  subsMon.enter();
+  for (auto push = pushes.begin(); push != pushes.end(); ++push) {
+    auto cs = clientSubscriptions.find(push->clientId);
+    if (cs == clientSubscriptions.end()) {
+      continue;
+    }
+    ClientSubscriptions &subs = cs->second;
+    DynamicJsonBuffer buf;
+    JsonObject &root = buf.createObject();
+    JsonObject *status = nullptr;
+    Subscription *lastSub = nullptr;
+    JsonObject *serviceStatus = nullptr;
+    for (size_t n = push->firstRead; n < push->firstRead + push->readCount; n++) {
+      FieldRead &r = reads[n];
+      // skipped if the client changed its subscriptions meanwhile
+      if (r.subIndex >= subs.subscriptions.size()) {
+        continue;
+      }
+      Subscription &sub = subs.subscriptions[r.subIndex];
+      if (sub.isEvents || r.fieldIndex >= sub.fields.size() || sub.fields[r.fieldIndex] != r.field) {
+        continue;
+      }
+      if (!r.isRead || (!push->isSnapshot && r.value.equals(sub.lastValues[r.fieldIndex]))) {
+        continue;
+      }
+      sub.lastValues[r.fieldIndex] = r.value;
+      if (status == nullptr) {
+        status = &root.createNestedObject("status");
+      }
+      if (&sub != lastSub) {
+        lastSub = &sub;
+        serviceStatus = &status->createNestedObject(sub.service->getServiceName());
+      }
+      (*serviceStatus)[r.field->name.get()] = r.value;
+    }
+    if (subs.pendingEvents.size() > 0) {
+      JsonArray &events = root.createNestedArray("events");
+      for (auto e = subs.pendingEvents.begin(); e != subs.pendingEvents.end(); ++e) {
+        events.add(RawJson(e->c_str()));
+      }
+    }
+    if (push->isSnapshot) {
+      root["snapshot"] = true;
+      root["dropped"] = subs.droppedCount;
+    }
+    if (root.size() > 0) {
+      String msg("@push:");
+      root.printTo(msg);
+      sendMessage(push->clientId, false, (const uint8_t *)msg.c_str(), msg.length());
+      subs.lastPushMillis = now;
+    }
+    subs.pendingEvents.clear();
   }
+  subsMon.leave();
 }
@@ -2,6 +2,8 @@
 #define COMMAND_WEBSOCKETS_H
 
 #include <ESPAsyncWebServer.h>
+#include <map>
+#include <vector>
 #include "UEvent.h"
 #include "Monitor.h"
 #include "CommandMgr.h"
@@ -9,6 +11,38 @@
 #include "RebootDetectorService.h"
 #include "LogMgr.h"
 
+/**
+ * Text messages are command lines, answered with text messages in the order they are received.
+ *
+ * Binary messages use a multiplexed command protocol, integers are little-endian:
+ *   Request:  0xC1, uint32 request ID, command value, argument values...
+ *   Response: 0xC2, uint32 request ID, uint8 status (WsStatus), result value
+ * The command value is a string "<service> <command>", argument values are appended to it as
+ * text. Values are tagged with their type:
+ *   's': varint length, followed by the bytes of the string
+ *   'i': zigzag varint
+ *   'f': 32-bit float
+ *   'b': one byte, 0 or 1
+ * Responses are sent as each command completes, not necessarily in request order.
+ *
+ * Text messages starting with "@" manage server-push subscriptions:
+ *   @subscribe <service> [field...]   status fields of the service, all if none specified
+ *   @subscribeEvents <service>        commands processed by the service
+ *   @unsubscribe [service]            all subscriptions if no service specified
+ *   @pushInterval <millis>            minimum interval between pushes to this client
+ *   @subscribeLog / @unsubscribeLog   log records, as text messages "@log:..."
+ * Pushes are text messages "@push:" followed by JSON, with the fields whose values changed
+ * since the last push, and the events since the last push. A field set by a command is pushed
+ * at the next interval; values that change without a command (read by a getFn, or updated by
+ * the service itself) are polled every pushPollMillis and pushed if they differ. Changes are coalesced per client
+ * to at most one push per interval. A client that falls behind (its send queue is full or
+ * too many events are pending) gets a full snapshot once it catches up.
+ *
+ * Broadcasts (e.g., log records) are serialized once into a reference-counted buffer that
+ * is queued to every subscribed client. A client whose send queue is full misses the
+ * message, which is counted; it is told how many messages it missed once it catches up,
+ * and cleanupClients() closes it if it stays behind for longer than broadcastStallMillis.
+ */
 class WebSocketsServer {
 public:
   WebSocketsServer();
@@ -16,8 +50,74 @@ public:
   void init(AsyncWebServer *server, CommandMgr *commandMgr, SystemService *system, RebootDetectorService *rebootDetector, LogMgr *logMgr);
   void cleanupClients();
 
+  enum WsStatus {
+    WS_STATUS_OK = 0,
+    WS_STATUS_NOT_PROCESSED = 1,
+    WS_STATUS_BAD_REQUEST = 2,
+    WS_STATUS_QUEUE_ERROR = 3
+  };
+  static const uint8_t WS_REQUEST_TAG = 0xC1;
+  static const uint8_t WS_RESPONSE_TAG = 0xC2;
+  static const size_t WS_MAX_MESSAGE_SIZE = 4096;
+
+  enum BroadcastChannel {
+    BROADCAST_LOG = 0x01
+  };
+  /** Sends the message to all clients subscribed to the channel, sharing a single buffer */
+  void broadcast(BroadcastChannel channel, const char *msg, size_t len);
+
 private:
   AsyncWebSocket ws;
+  // messages received in several frames are assembled here, by client ID
+  struct RxBuffer {
+    std::vector<uint8_t> data;
+    AwsFrameType opcode;
+    bool isOverflow;
+  };
+  std::map<uint32_t, RxBuffer> rxBuffers;
+
+  // Server-push subscriptions, accessed from the event loop's task (notifications, pushes)
+  // and from the AsyncTCP task (subscription messages), protected by subsMon
+  struct Subscription {
+    ServiceCommands *service;
+    bool isEvents; // the service's command events, else status fields
+    std::vector<ServiceCommands::ParamData *> fields;
+    std::vector<String> lastValues; // last values pushed, parallel to fields
+    std::vector<bool> isDirty;
+  };
+  struct ClientSubscriptions {
+    std::vector<Subscription> subscriptions;
+    std::vector<String> pendingEvents; // JSON objects
+    uint32_t intervalMillis;
+    uint32_t lastPushMillis;
+    uint32_t lastPollMillis;
+    bool needsSnapshot;
+    uint32_t droppedCount;
+  };
+  std::map<uint32_t, ClientSubscriptions> clientSubscriptions;
+  Monitor subsMon;
+  UEventLoopTimer pushTimer;
+  int pushIntervalMillis; // default interval for new subscribers
+  int pushPollMillis; // interval for reading all the subscribed fields
+  int pushMaxPendingEvents;
+
+  // broadcast subscribers, protected by subsMon
+  struct BroadcastClient {
+    uint32_t channels; // BroadcastChannel bits
+    uint32_t sentCount;
+    uint32_t droppedCount;
+    uint32_t unreportedDropCount; // drops that the client wasn't told about yet
+    uint32_t stallStartMillis; // when the client started dropping messages, 0 if not dropping
+  };
+  std::map<uint32_t, BroadcastClient> broadcastClients;
+  int broadcastStallMillis;
+  uint32_t broadcastCount;
+
+  // Messages are queued to clients from the AsyncTCP task (replies), from the event loop's task
+  // (command responses, pushes) and from the log flusher. The client's queue isn't protected by
+  // ws, so every send of ours is done under sendMon, entered after subsMon if both are needed.
+  Monitor sendMon;
+
   // AsyncEventSource events;
   CommandMgr *commandMgr;
   SystemService *system;
@@ -25,6 +125,19 @@ private:
   Logger *logger;
 
   void processCommand(String cmdm, AsyncWebSocketClient *client);
+  void processMessage(AsyncWebSocketClient *client, AwsFrameType opcode, uint8_t *data, size_t len);
+  void processBinaryCommand(AsyncWebSocketClient *client, const uint8_t *data, size_t len);
+  void sendBinaryResponse(uint32_t clientId, uint32_t requestId, WsStatus status, const char *result);
+  bool sendMessage(uint32_t clientId, bool isBinary, const uint8_t *data, size_t len);
+  void releaseBuffers();
+  void sendText(AsyncWebSocketClient *client, const char *msg);
+
+  void initCommands(ServiceCommands *cmd);
+  void processSubscriptionCommand(AsyncWebSocketClient *client, String &msg);
+  void onValueChange(ServiceCommands *service, ServiceCommands::ParamData *data);
+  void onServiceCommand(ServiceCommands *service, uint32_t eventType, bool isProcessed, String *result);
+  void pushUpdates();
+  void initLogBroadcast(LogMgr *logMgr);
 
   void onWsEvent(AsyncWebSocket * server, AsyncWebSocketClient * client, AwsEventType type, void * arg, uint8_t *data, size_t len);
 
@@ -20,9 +20,12 @@
  *
  *************************/
 
-// Define only one of the following
+// Define only one of the following, here or with -D in the build flags
 
+#if !defined(CONFIG_ALL) && !defined(CONFIG_MINIMUM) && !defined(CONFIG_SUPERVISOR) && !defined(CONFIG_LED_SPHERE) \
+    && !defined(CONFIG_STEPPER) && !defined(CONFIG_GPSDO) && !defined(CONFIG_HEATER)
 #define CONFIG_MINIMUM
+#endif
 //#define CONFIG_SUPERVISOR
 //#define CONFIG_LED_SPHERE
 //#define CONFIG_STEPPER
@@ -105,6 +108,7 @@
 #define USE_BEEPER
 #define USE_LED
 #define USE_LED_SPHERE
+#define USE_JS
 #endif
 
 // Stepper
@@ -0,0 +1,19 @@
+#include "CompilationOpts.h"
+
+#ifdef USE_JS
+
+// duktape, built with the overrides of DuktapeOpts.h; duk_config.h being included first, the
+// include in duktape.c is a no-op, so it must see the same DUK_COMPILING_DUKTAPE as duktape.c
+#define DUK_COMPILING_DUKTAPE
+#include "DuktapeOpts.h"
+#include <duktape.c>
+
+#include <esp_timer.h>
+
+duk_bool_t duk_exec_timeout_check(void *udata)
+{
+    const uint64_t *deadline = (const uint64_t *)udata;
+    return deadline != NULL && *deadline != 0 && (uint64_t)esp_timer_get_time() > *deadline;
+}
+
+#endif
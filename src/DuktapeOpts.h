@@ -0,0 +1,32 @@
+#ifndef INCL_DUKTAPE_OPTS_H
+#define INCL_DUKTAPE_OPTS_H
+
+/**
+ * Duktape configuration of the firmware: the vendored duk_config.h, with our overrides.
+ * Include this instead of duktape.h. The vendored library is not built by itself
+ * (lib_ignore in platformio.ini), DuktapeBuild.c builds it with these overrides.
+ */
+
+#include <duk_config.h>
+
+// Execution timeout: duktape calls duk_exec_timeout_check() every few thousand bytecode
+// instructions with the heap udata, which aborts the call when it returns true. Used to
+// enforce the CPU budget of scripts, see LedScriptEffect.cpp.
+#define DUK_USE_INTERRUPT_COUNTER
+#define DUK_USE_EXEC_TIMEOUT_CHECK duk_exec_timeout_check
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+/**
+ * udata is the heap udata: a pointer to the deadline of the current call, in esp_timer micros,
+ * 0 when no call is running; null for heaps created without one.
+ */
+duk_bool_t duk_exec_timeout_check(void *udata);
+#ifdef __cplusplus
+}
+#endif
+
+#include <duktape.h>
+
+#endif
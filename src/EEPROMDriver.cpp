@@ -3,15 +3,45 @@
 #include <Wire.h>
 #include <HardwareSerial.h>
 
+// for how long to retry transfers not acknowledged by the device, because it's still in a write cycle
+#define EE_BUSY_TIMEOUT_MICROS 100000
+
+void eeFlushTaskFn(void *arg)
+{
+    ((EEPROMMasterDriver *)arg)->flushTaskRun();
+}
+
+void eeFlushTimerFn(void *arg)
+{
+    xTaskNotifyGive(((EEPROMMasterDriver *)arg)->flushTask);
+}
 
 EEPROMMasterDriver::EEPROMMasterDriver()
 {
     lastErr = ESP_OK;
     deviceAddress = 0;
     eeWritePageSize = 64;
+    writeCycleMicros = 5000;
+    writeCycleEnd = 0;
     initDone = false;
     isSynced = true;
     isDriverInstalled = false;
+
+    cachePageCount = 0;
+    cache = nullptr;
+    cacheUseCounter = 0;
+    writeBackDelayMicros = 0;
+    mutex = nullptr;
+    flushTimer = nullptr;
+    flushTask = nullptr;
+    bus = nullptr;
+    busTx.priority = I2cBus::BULK;
+    resetStats();
+}
+
+EEPROMMasterDriver::~EEPROMMasterDriver()
+{
+    terminate();
 }
 
 esp_err_t EEPROMMasterDriver::lastError()
@@ -48,6 +78,9 @@ bool EEPROMMasterDriver::init(int sdaPin, int sclPin, int freqHz, int port, uint
         isDriverInstalled = (lastErr == ESP_OK);
     }
     initDone = (lastErr == ESP_OK);
+    if (initDone && mutex == nullptr) {
+        mutex = xSemaphoreCreateMutex();
+    }
     return initDone;
 }
 
@@ -58,14 +91,24 @@ bool EEPROMMasterDriver::init(int port, uint8_t deviceAddress) {
     isSynced = true;
     lastErr = ESP_OK;
     initDone = true;
+    if (mutex == nullptr) {
+        mutex = xSemaphoreCreateMutex();
+    }
     return initDone;
 }
 
+bool EEPROMMasterDriver::init(I2cBus *bus, uint8_t deviceAddress) {
+    bool rc = init((int)bus->getPort(), deviceAddress);
+    this->bus = bus;
+    return rc;
+}
+
 void EEPROMMasterDriver::terminate()
 {
     if (!initDone) {
         return;
     }
+    setCache(0);
     if (isDriverInstalled) {
         i2c_driver_delete(port);
     }
@@ -82,93 +125,380 @@ void EEPROMMasterDriver::setWritePageSize(uint16_t pageSize)
     eeWritePageSize = pageSize;
 }
 
-bool EEPROMMasterDriver::writeByteDev(uint8_t deviceAddress, uint16_t eeAddress, uint8_t byte) {
+bool EEPROMMasterDriver::setCache(int pageCount, int writeBackDelayMillis)
+{
     if (!initDone) {
         return false;
     }
-    int32_t maxWaitTicks = 100 / portTICK_PERIOD_MS; // 100 ms + 1 tick
-    int32_t tm = xTaskGetTickCount();
-    do {
-        i2c_cmd_handle_t cmd = i2c_cmd_link_create();
-        i2c_master_start(cmd);
-        i2c_master_write_byte(cmd, (deviceAddress << 1) | 0x0 /* write */, true);
+    lock();
+    bool rc = flushAll();
+    if (cache != nullptr) {
+        for (int i = 0; i < cachePageCount; i++) {
+            delete[] cache[i].data;
+        }
+        delete[] cache;
+        cache = nullptr;
+        cachePageCount = 0;
+    }
+    if (pageCount <= 0 && flushTask != nullptr) {
+        esp_timer_stop(flushTimer);
+        esp_timer_delete(flushTimer);
+        flushTimer = nullptr;
+        vTaskDelete(flushTask);
+        flushTask = nullptr;
+    }
+    if (pageCount > 0) {
+        cache = new CachePage[pageCount];
+        for (int i = 0; i < pageCount; i++) {
+            cache[i].address = -1;
+            cache[i].dirtyStart = cache[i].dirtyEnd = 0;
+            cache[i].lastUse = 0;
+            cache[i].data = new uint8_t[eeWritePageSize];
+        }
+        cachePageCount = pageCount;
+        writeBackDelayMicros = writeBackDelayMillis * 1000;
+
+        if (flushTask == nullptr) {
+            xTaskCreate(eeFlushTaskFn, "EEPROMFlush", 2048, this, uxTaskPriorityGet(nullptr) + 1, &flushTask);
+            esp_timer_create_args_t args = { };
+            args.callback = eeFlushTimerFn;
+            args.arg = this;
+            args.name = "EEPROMFlush";
+            esp_timer_create(&args, &flushTimer);
+        }
+    }
+    unlock();
+    return rc;
+}
+
+/**
+ * Waits for the end of the write cycle of the last page write, without polling the device.
+ */
+void EEPROMMasterDriver::waitWriteCycle()
+{
+    int64_t remaining = writeCycleEnd - esp_timer_get_time();
+    if (remaining <= 0) {
+        return;
+    }
+    TickType_t ticks = remaining / 1000 / portTICK_PERIOD_MS;
+    if (ticks > 0) {
+        vTaskDelay(ticks);
+    }
+    remaining = writeCycleEnd - esp_timer_get_time();
+    if (remaining > 0) {
+        ets_delay_us(remaining);
+    }
+}
+
+/**
+ * One transfer: start, the memory address (unless eeAddress is -1, to probe the device),
+ * then data written, or a repeated start and data read.
+ */
+esp_err_t EEPROMMasterDriver::transfer(uint8_t deviceAddress, int32_t eeAddress,
+    const uint8_t *writeData, size_t writeSize, uint8_t *readData, size_t readSize, int timeoutMillis)
+{
+    if (bus != nullptr) {
+        busTx.address = deviceAddress;
+        if (eeAddress >= 0) {
+            busTx.setHeader(eeAddress >> 8, eeAddress & 0xFF);
+        } else {
+            busTx.headerLen = 0;
+        }
+        busTx.writeData = writeData;
+        busTx.writeLen = writeSize;
+        busTx.readData = readData;
+        busTx.readLen = readSize;
+        busTx.timeoutMillis = timeoutMillis;
+        return bus->execute(&busTx);
+    }
+    i2c_cmd_handle_t cmd = i2c_cmd_link_create();
+    i2c_master_start(cmd);
+    i2c_master_write_byte(cmd, (deviceAddress << 1) | 0x0 /* write */, true);
+    if (eeAddress >= 0) {
         i2c_master_write_byte(cmd, eeAddress >> 8, true);
         i2c_master_write_byte(cmd, eeAddress & 0xFF, true);
-        i2c_master_write_byte(cmd, byte, true);
-        i2c_master_stop(cmd);
-        lastErr = i2c_master_cmd_begin(port, cmd, 1000 / portTICK_PERIOD_MS);
-        i2c_cmd_link_delete(cmd);
-    } while (lastErr == ESP_FAIL && xTaskGetTickCount() - tm < maxWaitTicks);
-    // repeat above as long as slave doesn't send ACK (it's still in a previous write cycle),
-    // but for no longer than 100 ms
-    isSynced = false;
-    return (lastErr == ESP_OK);
+    }
+    if (writeSize > 0) {
+        i2c_master_write(cmd, (uint8_t *)writeData, writeSize, true);
+    }
+    if (readSize > 0) {
+        i2c_master_start(cmd);
+        i2c_master_write_byte(cmd, (deviceAddress << 1) | 0x1 /* read */, true);
+        i2c_master_read(cmd, readData, readSize, i2c_ack_type_t::I2C_MASTER_LAST_NACK);
+    }
+    i2c_master_stop(cmd);
+    esp_err_t err = i2c_master_cmd_begin(port, cmd, timeoutMillis / portTICK_PERIOD_MS);
+    i2c_cmd_link_delete(cmd);
+    return err;
 }
 
-bool EEPROMMasterDriver::syncDev(uint8_t deviceAddress) {
-    if (!initDone) {
+/**
+ * Writes within a single write page.
+ */
+bool EEPROMMasterDriver::writePage(uint8_t deviceAddress, uint16_t eeAddress, const uint8_t *data, size_t size)
+{
+    waitWriteCycle();
+    int64_t tm = esp_timer_get_time();
+    while (true) {
+        lastErr = transfer(deviceAddress, eeAddress, data, size, nullptr, 0, 100);
+        // not acknowledged: the device is still in a write cycle, longer than writeCycleMicros
+        if (lastErr != ESP_FAIL || esp_timer_get_time() - tm >= EE_BUSY_TIMEOUT_MICROS) {
+            break;
+        }
+        ++statBusyRetries;
+    }
+    if (lastErr != ESP_OK) {
         return false;
     }
-    if (isSynced) {
+    writeCycleEnd = esp_timer_get_time() + writeCycleMicros;
+    isSynced = false;
+    ++statPageWrites;
+    return true;
+}
+
+/**
+ * With a bus, reads are split in transfers of a write page, so that transfers of
+ * higher priority don't wait for a long read.
+ */
+bool EEPROMMasterDriver::readRaw(uint8_t deviceAddress, uint16_t eeAddress, uint8_t *bytePtr, size_t size)
+{
+    waitWriteCycle();
+    size_t chunk = (bus != nullptr ? eeWritePageSize : size);
+    for (size_t done = 0; done < size; done += chunk) {
+        size_t len = (size - done < chunk ? size - done : chunk);
+        int64_t tm = esp_timer_get_time();
+        while (true) {
+            lastErr = transfer(deviceAddress, eeAddress + done, nullptr, 0, bytePtr + done, len, 1000);
+            if (lastErr != ESP_FAIL || esp_timer_get_time() - tm >= EE_BUSY_TIMEOUT_MICROS) {
+                break;
+            }
+            ++statBusyRetries;
+        }
+        if (lastErr != ESP_OK) {
+            return false;
+        }
+    }
+    return true;
+}
+
+EEPROMMasterDriver::CachePage *EEPROMMasterDriver::findPage(uint8_t deviceAddress, uint16_t pageAddress)
+{
+    for (int i = 0; i < cachePageCount; i++) {
+        if (cache[i].address == pageAddress && cache[i].deviceAddress == deviceAddress) {
+            return &cache[i];
+        }
+    }
+    return nullptr;
+}
+
+/**
+ * Takes a free entry, else the least recently used one, writing it back if dirty.
+ * Returns null if the write back failed.
+ */
+EEPROMMasterDriver::CachePage *EEPROMMasterDriver::allocPage(uint8_t deviceAddress, uint16_t pageAddress)
+{
+    CachePage *page = nullptr;
+    for (int i = 0; i < cachePageCount; i++) {
+        if (cache[i].address == -1) {
+            page = &cache[i];
+            break;
+        }
+        if (page == nullptr || (int32_t)(cache[i].lastUse - page->lastUse) < 0) {
+            page = &cache[i];
+        }
+    }
+    if (page->dirtyStart != page->dirtyEnd && !flushPage(page)) {
+        return nullptr;
+    }
+    page->address = pageAddress;
+    page->deviceAddress = deviceAddress;
+    page->dirtyStart = page->dirtyEnd = 0;
+    return page;
+}
+
+/**
+ * Writes within a single write page into the cache.
+ */
+bool EEPROMMasterDriver::cachePut(uint8_t deviceAddress, uint16_t eeAddress, const uint8_t *data, size_t size)
+{
+    uint16_t pageAddress = eeAddress & ~(eeWritePageSize - 1);
+    uint16_t start = eeAddress - pageAddress;
+    uint16_t end = start + size;
+    CachePage *page = findPage(deviceAddress, pageAddress);
+    if (page != nullptr && page->dirtyStart != page->dirtyEnd) {
+        if (start > page->dirtyEnd || end < page->dirtyStart) {
+            // not contiguous with the pending bytes, which would leave a gap of unknown bytes
+            if (!flushPage(page)) {
+                return false;
+            }
+        } else {
+            ++statMergedWrites;
+        }
+    }
+    if (page == nullptr) {
+        page = allocPage(deviceAddress, pageAddress);
+        if (page == nullptr) {
+            return false;
+        }
+    }
+    memcpy(page->data + start, data, size);
+    if (page->dirtyStart == page->dirtyEnd) {
+        page->dirtyStart = start;
+        page->dirtyEnd = end;
+        page->dirtySince = esp_timer_get_time();
+    } else {
+        page->dirtyStart = (start < page->dirtyStart ? start : page->dirtyStart);
+        page->dirtyEnd = (end > page->dirtyEnd ? end : page->dirtyEnd);
+    }
+    page->lastUse = ++cacheUseCounter;
+    return true;
+}
+
+bool EEPROMMasterDriver::flushPage(CachePage *page)
+{
+    if (page->dirtyStart == page->dirtyEnd) {
         return true;
     }
-    int32_t maxWaitTicks = 100 / portTICK_PERIOD_MS; // 100 ms + 1 tick
-    int32_t tm = xTaskGetTickCount();
-    do {
-        i2c_cmd_handle_t cmd = i2c_cmd_link_create();
-        i2c_master_start(cmd);
-        i2c_master_write_byte(cmd, (deviceAddress << 1) | 0x0 /* write */, true);
-        i2c_master_stop(cmd);
-        lastErr = i2c_master_cmd_begin(port, cmd, 100 / portTICK_PERIOD_MS);
-        i2c_cmd_link_delete(cmd);
-    } while (lastErr == ESP_FAIL && xTaskGetTickCount() - tm < maxWaitTicks);
-    // repeat above as long as slave doesn't send ACK (it's still in a previous write cycle),
-    // but for no longer than 100 ms
-    if (lastErr == ESP_OK) {
-        isSynced = true;
+    bool rc = writePage(page->deviceAddress, page->address + page->dirtyStart,
+        page->data + page->dirtyStart, page->dirtyEnd - page->dirtyStart);
+    if (rc) {
+        page->dirtyStart = page->dirtyEnd = 0;
+    }
+    return rc;
+}
+
+// writes back dirty pages in address order
+bool EEPROMMasterDriver::flushAll()
+{
+    while (true) {
+        CachePage *next = nullptr;
+        for (int i = 0; i < cachePageCount; i++) {
+            if (cache[i].dirtyStart != cache[i].dirtyEnd && (next == nullptr || cache[i].address < next->address)) {
+                next = &cache[i];
+            }
+        }
+        if (next == nullptr) {
+            return true;
+        }
+        if (!flushPage(next)) {
+            return false;
+        }
+    }
+}
+
+/**
+ * Arms the timer for the next write back: when the oldest dirty page is due,
+ * but not before the end of the current write cycle.
+ */
+void EEPROMMasterDriver::scheduleFlush()
+{
+    if (flushTimer == nullptr) {
+        return;
+    }
+    int64_t due = INT64_MAX;
+    for (int i = 0; i < cachePageCount; i++) {
+        if (cache[i].dirtyStart != cache[i].dirtyEnd && cache[i].dirtySince + writeBackDelayMicros < due) {
+            due = cache[i].dirtySince + writeBackDelayMicros;
+        }
+    }
+    esp_timer_stop(flushTimer);
+    if (due == INT64_MAX) {
+        return;
+    }
+    if (due < writeCycleEnd) {
+        due = writeCycleEnd;
+    }
+    int64_t timeout = due - esp_timer_get_time();
+    esp_timer_start_once(flushTimer, timeout > 0 ? timeout : 1);
+}
+
+void EEPROMMasterDriver::flushTaskRun()
+{
+    while (true) {
+        ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+        lock();
+        int64_t now = esp_timer_get_time();
+        if (now >= writeCycleEnd) {
+            // write back one due page, the timer brings us back for the next one
+            CachePage *page = nullptr;
+            for (int i = 0; i < cachePageCount; i++) {
+                if (cache[i].dirtyStart != cache[i].dirtyEnd && cache[i].dirtySince + writeBackDelayMicros <= now
+                        && (page == nullptr || cache[i].dirtySince < page->dirtySince)) {
+                    page = &cache[i];
+                }
+            }
+            if (page != nullptr && !flushPage(page)) {
+                // retried on the next sync() or eviction, lastErr tells why
+                page->dirtySince = now;
+            }
+        }
+        scheduleFlush();
+        unlock();
     }
-    return (lastErr == ESP_OK);
 }
 
 bool EEPROMMasterDriver::writeDev(uint8_t deviceAddress, uint16_t eeAddress, uint8_t *data, size_t size) {
     if (!initDone) {
         return false;
     }
-    const int32_t maxWaitTicks = 100 / portTICK_PERIOD_MS; // 100 ms + 1 tick
-
+    lock();
     uint16_t currentAddress = eeAddress;
     size_t remaining = size;
     uint8_t *ptr = data;
-    size_t toWrite;
+    bool rc = true;
 
-    do {
+    while (rc && remaining > 0) {
         uint16_t nextPageAddress = (currentAddress | (eeWritePageSize - 1)) + 1;
-        toWrite = nextPageAddress - currentAddress;
+        size_t toWrite = nextPageAddress - currentAddress;
         if (toWrite > remaining) {
             toWrite = remaining;
         }
-        int32_t tm = xTaskGetTickCount();
-        do {
-            i2c_cmd_handle_t cmd = i2c_cmd_link_create();
-            i2c_master_start(cmd);
-            i2c_master_write_byte(cmd, (deviceAddress << 1) | 0x0 /* write */, true);
-            i2c_master_write_byte(cmd, currentAddress >> 8, true);
-            i2c_master_write_byte(cmd, currentAddress & 0xFF, true);
-            i2c_master_write(cmd, ptr, toWrite, true);
-            i2c_master_stop(cmd);
-            lastErr = i2c_master_cmd_begin(port, cmd, 100 / portTICK_PERIOD_MS);
-            i2c_cmd_link_delete(cmd);
-        } while (lastErr == ESP_FAIL && xTaskGetTickCount() - tm < maxWaitTicks);
-        // repeat above as long as slave doesn't send ACK (it's still in a previous write cycle),
-        // but for no longer than 100 ms
-        if (lastErr == ESP_OK) {
-            remaining -= toWrite;
-            ptr += toWrite;
-            currentAddress += toWrite;
-        }
-    } while (lastErr == ESP_OK && remaining > 0);
-    isSynced = false;
+        if (cachePageCount > 0) {
+            rc = cachePut(deviceAddress, currentAddress, ptr, toWrite);
+        } else {
+            rc = writePage(deviceAddress, currentAddress, ptr, toWrite);
+        }
+        remaining -= toWrite;
+        ptr += toWrite;
+        currentAddress += toWrite;
+    }
+    if (cachePageCount > 0) {
+        isSynced = false;
+        scheduleFlush();
+    }
+    unlock();
 
+    return rc;
+}
+
+bool EEPROMMasterDriver::syncDev(uint8_t deviceAddress) {
+    if (!initDone) {
+        return false;
+    }
+    lock();
+    if (!flushAll()) {
+        unlock();
+        return false;
+    }
+    scheduleFlush();
+    if (isSynced) {
+        unlock();
+        return true;
+    }
+    waitWriteCycle();
+    // the write cycle may take longer than writeCycleMicros, check that the device acknowledges
+    int64_t tm = esp_timer_get_time();
+    while (true) {
+        lastErr = transfer(deviceAddress, -1, nullptr, 0, nullptr, 0, 100);
+        if (lastErr != ESP_FAIL || esp_timer_get_time() - tm >= EE_BUSY_TIMEOUT_MICROS) {
+            break;
+        }
+        ++statBusyRetries;
+    }
+    if (lastErr == ESP_OK) {
+        isSynced = true;
+    }
+    unlock();
     return (lastErr == ESP_OK);
 }
 
@@ -176,24 +506,64 @@ bool EEPROMMasterDriver::readDev(uint8_t deviceAddress, uint16_t eeAddress, uint
     if (!initDone) {
         return false;
     }
-    const int32_t maxWaitTicks = 100 / portTICK_PERIOD_MS; // 100 ms + 1 tick
-    int32_t tm = xTaskGetTickCount();
-    do {
-        i2c_cmd_handle_t cmd = i2c_cmd_link_create();
-        i2c_master_start(cmd);
-        i2c_master_write_byte(cmd, (deviceAddress << 1) | 0x0 /* write */, true);
-        i2c_master_write_byte(cmd, eeAddress >> 8, true);
-        i2c_master_write_byte(cmd, eeAddress & 0xFF, true);
-        i2c_master_start(cmd);
-        i2c_master_write_byte(cmd, (deviceAddress << 1) | 0x1 /* read */, true);
-        i2c_master_read(cmd, bytePtr, size, i2c_ack_type_t::I2C_MASTER_LAST_NACK);
-        i2c_master_stop(cmd);
-        lastErr = i2c_master_cmd_begin(port, cmd, 1000 / portTICK_PERIOD_MS);
-        i2c_cmd_link_delete(cmd);
-    } while (lastErr == ESP_FAIL && xTaskGetTickCount() - tm < maxWaitTicks);
-    // repeat above as long as slave doesn't send ACK (it's still in a previous write cycle),
-    // but for no longer than 100 ms
-    isSynced = true;
-    return (lastErr == ESP_OK);
+    lock();
+    ++statReads;
+
+    // served from the cache if all bytes are pending writes
+    bool isHit = (cachePageCount > 0);
+    for (uint32_t a = eeAddress; isHit && a < (uint32_t)eeAddress + size; ) {
+        uint16_t pageAddress = a & ~(eeWritePageSize - 1);
+        uint32_t end = pageAddress + eeWritePageSize;
+        if (end > (uint32_t)eeAddress + size) {
+            end = eeAddress + size;
+        }
+        CachePage *page = findPage(deviceAddress, pageAddress);
+        isHit = (page != nullptr && a - pageAddress >= page->dirtyStart && end - pageAddress <= page->dirtyEnd);
+        a = end;
+    }
+
+    bool rc = true;
+    if (!isHit) {
+        rc = readRaw(deviceAddress, eeAddress, bytePtr, size);
+        if (rc && cachePageCount == 0) {
+            isSynced = true; // the device acknowledged, it's not in a write cycle
+        }
+    } else {
+        ++statReadHits;
+    }
+    // pending writes override what the device has
+    for (int i = 0; rc && i < cachePageCount; i++) {
+        CachePage *page = &cache[i];
+        if (page->address == -1 || page->deviceAddress != deviceAddress || page->dirtyStart == page->dirtyEnd) {
+            continue;
+        }
+        int32_t from = page->address + page->dirtyStart;
+        int32_t to = page->address + page->dirtyEnd;
+        from = (from < eeAddress ? eeAddress : from);
+        to = (to > (int32_t)(eeAddress + size) ? (int32_t)(eeAddress + size) : to);
+        if (from < to) {
+            memcpy(bytePtr + (from - eeAddress), page->data + (from - page->address), to - from);
+        }
+    }
+    unlock();
+    return rc;
 }
 
+void EEPROMMasterDriver::getStats(String *msg)
+{
+    *msg += "Page writes: "; *msg += statPageWrites;
+    *msg += ", merged writes: "; *msg += statMergedWrites;
+    *msg += ", reads: "; *msg += statReads;
+    *msg += " ("; *msg += statReadHits; *msg += " from cache)";
+    *msg += ", busy retries: "; *msg += statBusyRetries;
+    *msg += ", cache pages: "; *msg += cachePageCount;
+}
+
+void EEPROMMasterDriver::resetStats()
+{
+    statPageWrites = 0;
+    statMergedWrites = 0;
+    statReads = 0;
+    statReadHits = 0;
+    statBusyRetries = 0;
+}
@@ -1,8 +1,27 @@
 #ifndef INCL_EEPROM_DRIVER
 #define INCL_EEPROM_DRIVER
 
+#include <Arduino.h>
 #include <driver/i2c.h>
+#include <esp_timer.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/semphr.h>
+#include <freertos/task.h>
+#include "I2cBus.h"
 
+/**
+ * Driver for I2C EEPROMs (24LCxxx and compatible).
+ *
+ * After a page write, the chip doesn't acknowledge anything for its write cycle (t_WR).
+ * Instead of polling it, the driver notes when the cycle ends, and the next transfer waits
+ * for that instant.
+ *
+ * With setCache(), writes go to a write-back cache of whole write pages: small writes
+ * to the same page are merged, reads see cached data, and dirty pages are written back
+ * by a background task, woken by a timer, writeBackDelay after they were first written
+ * or when the previous write cycle ends. sync() writes back all dirty pages and waits
+ * for the end of the last write cycle.
+ */
 class EEPROMMasterDriver {
     i2c_port_t port;
     uint8_t deviceAddress; // 0 for undefined, in which case it must be specified in each call
@@ -12,17 +31,73 @@ class EEPROMMasterDriver {
     esp_err_t lastErr;
     uint16_t eeSize; // EEPROM size in bytes, power of 2
     uint16_t eeWritePageSize; // page size for page writes, defaults to 64
+    uint32_t writeCycleMicros; // t_WR of the chip
+    int64_t writeCycleEnd; // esp_timer time when the last write cycle ends
+
+    struct CachePage {
+        int32_t address; // of the first byte of the page, -1 if the entry is free
+        uint8_t deviceAddress;
+        uint16_t dirtyStart; // dirty bytes, offsets in the page; dirtyStart == dirtyEnd if clean
+        uint16_t dirtyEnd;
+        int64_t dirtySince; // esp_timer time of the first write since last written back
+        uint32_t lastUse; // for LRU replacement
+        uint8_t *data; // eeWritePageSize bytes, only the dirty range is meaningful
+    };
+    int cachePageCount;
+    CachePage *cache;
+    uint32_t cacheUseCounter;
+    uint32_t writeBackDelayMicros;
+    SemaphoreHandle_t mutex;
+    esp_timer_handle_t flushTimer;
+    TaskHandle_t flushTask;
+    I2cBus *bus;
+    I2cBus::Transaction busTx; // used under the mutex
+
+    // statistics
+    uint32_t statPageWrites;
+    uint32_t statMergedWrites; // writes merged in a page that was already dirty
+    uint32_t statReads;
+    uint32_t statReadHits; // reads served entirely from the cache
+    uint32_t statBusyRetries; // transfers retried because the chip was still busy
+
+    void lock() { if (mutex != nullptr) { xSemaphoreTake(mutex, portMAX_DELAY); } }
+    void unlock() { if (mutex != nullptr) { xSemaphoreGive(mutex); } }
+    void waitWriteCycle();
+    esp_err_t transfer(uint8_t deviceAddress, int32_t eeAddress, const uint8_t *writeData, size_t writeSize,
+        uint8_t *readData, size_t readSize, int timeoutMillis);
+    bool writePage(uint8_t deviceAddress, uint16_t eeAddress, const uint8_t *data, size_t size);
+    bool readRaw(uint8_t deviceAddress, uint16_t eeAddress, uint8_t *data, size_t size);
+    CachePage *findPage(uint8_t deviceAddress, uint16_t pageAddress);
+    CachePage *allocPage(uint8_t deviceAddress, uint16_t pageAddress);
+    bool cachePut(uint8_t deviceAddress, uint16_t eeAddress, const uint8_t *data, size_t size);
+    bool flushPage(CachePage *page);
+    bool flushAll();
+    void scheduleFlush();
+    void flushTaskRun();
+    friend void eeFlushTaskFn(void *arg);
+    friend void eeFlushTimerFn(void *arg);
+
 public:
     EEPROMMasterDriver();
+    ~EEPROMMasterDriver();
 
     esp_err_t lastError();
     const char *lastErrorStr();
     bool init(int sdaPin, int sclPin, int freqHz, int port, uint8_t deviceAddress = 0x50);
     bool init(int port, uint8_t deviceAddress = 0x50);
+    // transfers go through the bus, at bulk priority, reads split in write pages
+    bool init(I2cBus *bus, uint8_t deviceAddress = 0x50);
     void terminate();
     void setDeviceAddress(uint8_t deviceaddress);
-    // write page size must be a power of 2, default is 64 (page size for 24LC256 EEPROM)
+    // write page size must be a power of 2, default is 64 (page size for 24LC256 EEPROM);
+    // must be set before enabling the cache
     void setWritePageSize(uint16_t pageSize);
+    uint16_t getWritePageSize() { return eeWritePageSize; }
+    // write cycle time of the chip, default 5 ms
+    void setWriteCycleMicros(uint32_t micros) { writeCycleMicros = micros; }
+    // Enables a write-back cache of pageCount write pages, 0 disables it (after writing back
+    // dirty pages). Dirty pages are written back writeBackDelayMillis after their first write.
+    bool setCache(int pageCount, int writeBackDelayMillis = 20);
     bool writeByte(uint16_t eeaddress, uint8_t byte);
     bool writeByteDev(uint8_t deviceaddress, uint16_t eeaddress, uint8_t byte);
     bool write(uint16_t eeAddress, uint8_t *data, size_t size);
@@ -34,11 +109,16 @@ public:
     bool read(uint16_t eeAddress, uint8_t *data, size_t size);
     bool readDev(uint8_t deviceAddress, uint16_t eeAddress, uint8_t *data, size_t size);
 
+    void getStats(String *msg);
+    void resetStats();
 };
 
 inline bool EEPROMMasterDriver::writeByte(uint16_t eeAddress, uint8_t byte) {
     return writeByteDev(deviceAddress, eeAddress, byte);
 }
+inline bool EEPROMMasterDriver::writeByteDev(uint8_t deviceAddress, uint16_t eeAddress, uint8_t byte) {
+    return writeDev(deviceAddress, eeAddress, &byte, 1);
+}
 inline bool EEPROMMasterDriver::write(uint16_t eeAddress, uint8_t *data, size_t size)
 {
     return writeDev(deviceAddress, eeAddress, data, size);
@@ -58,4 +138,3 @@ inline bool EEPROMMasterDriver::readByteDev(uint8_t deviceAddress, uint16_t eeAd
 }
 
 #endif
-
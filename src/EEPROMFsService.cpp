@@ -40,14 +40,15 @@ void EEPROMFsService::init(UEventLoop *eventLoop, CommandMgr *commandMgr, LogMgr
     EEPROMLittleFs::LFSConfig lfsCfg;
     eeCfg.size = 32768;
     eeCfg.writePageSize = 64;
+    eeCfg.kvSize = 2048; // a header page, then 31 pages of 5 records
 
     if (isEnabled) {
-        rc = systemService->getIdf(i2cPort);
-        if (!rc) {
+        I2cBus *bus = systemService->getI2cBus(i2cPort);
+        if (bus == nullptr) {
             logger->error("Error getting get the i2c driver, the service will not work");
             isFsInitialized = false;
         } else {
-            isFsInitialized = eepromLfs.init(i2cPort, eeCfg, lfsCfg, true);
+            isFsInitialized = eepromLfs.init(i2cPort, eeCfg, lfsCfg, true, bus);
         }
     } else {
         isFsInitialized = false;
@@ -56,6 +57,10 @@ void EEPROMFsService::init(UEventLoop *eventLoop, CommandMgr *commandMgr, LogMgr
         logger->error("Error initializing EEPROM LFS, the service will not work");
     } else {
         logger->info("Initialized EEPROM LittleFs at i2c port {}", i2cPort);
+        if (eepromLfs.getMigratedFileCount() >= 0) {
+            logger->warn("EEPROM LittleFs resized for the key/value store: {} files carried over, {} did not fit",
+                eepromLfs.getMigratedFileCount(), eepromLfs.getLostFileCount());
+        }
     }
 }
 
@@ -120,6 +125,64 @@ void EEPROMFsService::initCmd()
         })
     );
 
+    cmd->registerStringData(
+        ServiceCommands::StringDataBuilder("driverStats", true)
+        .cmd("driverStats")
+        .help("--> Transfers of the eeprom driver: page writes, merged writes, reads served from its cache")
+        .isPersistent(false)
+        .getFn([this](String *val) {
+            this->eepromLfs.getDriverStats(val);
+        })
+    );
+
+    cmd->registerStringData(
+        ServiceCommands::StringDataBuilder("ioStats", true)
+        .cmd("ioStats")
+        .help("ioStats [reset] --> Filesystem geometry, and device reads and writes for each kind of file operation")
+        .isPersistent(false)
+        .includeInStatus(false)
+        .setFn([this](const String &val, bool isLoading, String *msg) -> bool {
+            if (val == "reset") {
+                this->eepromLfs.resetIoStats();
+                *msg = "I/O statistics reset";
+            } else {
+                this->eepromLfs.getIoStats(msg);
+            }
+            return true;
+        })
+        .getFn([this](String *val) {
+            this->eepromLfs.getIoStats(val);
+        })
+    );
+
+    cmd->registerStringData(
+        ServiceCommands::StringDataBuilder("kvStats", true)
+        .cmd("kvStats")
+        .help("kvStats [reset] --> Key/value store: wear, writes, and the value of each key")
+        .isPersistent(false)
+        .includeInStatus(false)
+        .setFn([this](const String &val, bool isLoading, String *msg) -> bool {
+            EEPROMKvStore *kv = this->eepromLfs.getKvStore();
+            if (kv == nullptr) {
+                *msg = "Key/value store not available";
+            } else if (val == "reset") {
+                kv->resetStats();
+                *msg = "Key/value store statistics reset";
+            } else {
+                kv->getStats(msg);
+            }
+            return true;
+        })
+        .getFn([this](String *val) {
+            EEPROMKvStore *kv = this->eepromLfs.getKvStore();
+            if (kv == nullptr) {
+                *val += "Key/value store not available";
+            } else {
+                kv->getStats(val);
+            }
+        })
+    );
+
 #ifdef EEPROM_LFS_ENABLE_TESTS
 
     cmd->registerBoolData(
@@ -12,6 +12,7 @@
 #include "LogMgr.h"
 #include "EEPROMDriver.h"
 #include "EEPROMLittleFs.h"
+#include "EEPROMKvStore.h"
 #include "SystemService.h"
 
 class EEPROMFsService {
@@ -33,6 +34,8 @@ private:
     void initCmd();
 public:
     EEPROMLittleFs *getFs() { return isFsInitialized ? &eepromLfs : nullptr; }
+    // persistent counters and flags, nullptr if the service is not initialized
+    EEPROMKvStore *getKvStore() { return isFsInitialized ? eepromLfs.getKvStore() : nullptr; }
 };
 
 #endif
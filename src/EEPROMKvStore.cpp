@@ -0,0 +1,368 @@
+#include <CompilationOpts.h>
+
+#ifdef USE_EEPROM_LFS
+#include "EEPROMKvStore.h"
+
+// value of the bytes of an EEPROM that was never written
+static const uint32_t ERASED_SEQ = 0xFFFFFFFF;
+static const uint32_t HEADER_MAGIC = 0x5356654B; // "KeVS"
+static const uint16_t HEADER_VERSION = 1;
+
+EEPROMKvStore::EEPROMKvStore()
+{
+    driver = nullptr;
+    deviceAddress = 0;
+    baseAddress = 0;
+    pageSize = 0;
+    slotsPerPage = 0;
+    slotCount = 0;
+    size = 0;
+    head = 0;
+    nextSeq = 1;
+    isInitialized = false;
+    isFormatNeeded = false;
+    isReadError = false;
+    mutex = nullptr;
+    resetStats();
+}
+
+EEPROMKvStore::~EEPROMKvStore()
+{
+    if (mutex != nullptr) {
+        vSemaphoreDelete(mutex);
+    }
+}
+
+// FNV-1a, folded to 16 bits; 0xFFFF is left for erased records
+uint16_t EEPROMKvStore::hashKey(const char *name)
+{
+    uint32_t h = 2166136261u;
+    for (const char *p = name; *p != '\0'; p++) {
+        h = (h ^ (uint8_t)*p) * 16777619u;
+    }
+    uint16_t key = (h >> 16) ^ (h & 0xFFFF);
+    return key == 0xFFFF ? 0xFFFE : key;
+}
+
+// CRC-16/CCITT-FALSE
+uint16_t EEPROMKvStore::crc16(const uint8_t *data, size_t size)
+{
+    uint16_t crc = 0xFFFF;
+    for (size_t i = 0; i < size; i++) {
+        crc ^= (uint16_t)data[i] << 8;
+        for (int b = 0; b < 8; b++) {
+            crc = (crc & 0x8000) ? (crc << 1) ^ 0x1021 : crc << 1;
+        }
+    }
+    return crc;
+}
+
+// the header takes the first page
+uint32_t EEPROMKvStore::slotAddress(int slot)
+{
+    return baseAddress + (1 + slot / slotsPerPage) * pageSize + (slot % slotsPerPage) * sizeof(Record);
+}
+
+void EEPROMKvStore::makeHeader(Header *h)
+{
+    h->magic = HEADER_MAGIC;
+    h->version = HEADER_VERSION;
+    h->pageSize = pageSize;
+    h->recordSize = sizeof(Record);
+    h->size = size;
+    h->crc = crc16((const uint8_t *)h, offsetof(Header, crc));
+}
+
+EEPROMKvStore::Entry *EEPROMKvStore::find(uint16_t key)
+{
+    for (Entry &e : entries) {
+        if (e.key == key) {
+            return &e;
+        }
+    }
+    return nullptr;
+}
+
+EEPROMKvStore::Entry *EEPROMKvStore::findSlot(int slot)
+{
+    for (Entry &e : entries) {
+        if (e.slot == slot) {
+            return &e;
+        }
+    }
+    return nullptr;
+}
+
+// nullptr if the hash of name is already used by another name
+EEPROMKvStore::Entry *EEPROMKvStore::entryFor(const char *name)
+{
+    uint16_t key = hashKey(name);
+    Entry *e = find(key);
+    if (e == nullptr) {
+        entries.push_back(Entry());
+        e = &entries.back();
+        e->key = key;
+        e->value = 0;
+        e->seq = 0;
+        e->slot = -1;
+    }
+    if (e->name.isEmpty()) {
+        e->name = name;
+    } else if (e->name != name) {
+        ++statErrors;
+        return nullptr;
+    }
+    return e;
+}
+
+bool EEPROMKvStore::init(EEPROMMasterDriver *driver, uint8_t deviceAddress, uint32_t baseAddress, size_t size)
+{
+    this->driver = driver;
+    this->deviceAddress = deviceAddress;
+    this->baseAddress = baseAddress;
+    this->size = size;
+    pageSize = driver->getWritePageSize();
+    slotsPerPage = pageSize / sizeof(Record);
+    slotCount = (size / pageSize - 1) * slotsPerPage;
+    entries.clear();
+    if (mutex == nullptr) {
+        mutex = xSemaphoreCreateMutex();
+    }
+    isInitialized = false;
+    isFormatNeeded = false;
+    isReadError = false;
+    if (slotCount < 2) {
+        return false;
+    }
+    Header h;
+    Header expected;
+    makeHeader(&expected);
+    if (!driver->readDev(deviceAddress, baseAddress, (uint8_t *)&h, sizeof(h))) {
+        ++statErrors;
+        isReadError = true;
+        return false;
+    }
+    if (memcmp(&h, &expected, sizeof(h)) != 0) {
+        isFormatNeeded = true;
+        return false;
+    }
+    isInitialized = load();
+    isReadError = !isInitialized;
+    return isInitialized;
+}
+
+/**
+ * The header is written last: if the erase is interrupted, the region still needs a format.
+ */
+bool EEPROMKvStore::format()
+{
+    if (slotCount < 2) {
+        return false;
+    }
+    lock();
+    isInitialized = false;
+    uint8_t page[pageSize];
+    memset(page, 0xFF, pageSize);
+    bool rc = true;
+    for (int p = 0; p < slotCount / slotsPerPage + 1 && rc; p++) {
+        rc = driver->writeDev(deviceAddress, baseAddress + p * pageSize, page, pageSize);
+    }
+    Header h;
+    makeHeader(&h);
+    rc = rc && driver->syncDev(deviceAddress)
+        && driver->writeDev(deviceAddress, baseAddress, (uint8_t *)&h, sizeof(h))
+        && driver->syncDev(deviceAddress);
+    if (rc) {
+        entries.clear();
+        head = 0;
+        nextSeq = 1;
+        isInitialized = true;
+        isFormatNeeded = false;
+    } else {
+        ++statErrors;
+    }
+    unlock();
+    return rc;
+}
+
+bool EEPROMKvStore::load()
+{
+    uint8_t page[pageSize];
+    uint32_t maxSeq = 0;
+    int maxSlot = -1;
+    for (int p = 0; p < slotCount / slotsPerPage; p++) {
+        if (!driver->readDev(deviceAddress, slotAddress(p * slotsPerPage), page, pageSize)) {
+            ++statErrors;
+            return false;
+        }
+        for (int i = 0; i < slotsPerPage; i++) {
+            Record r;
+            memcpy(&r, page + i * sizeof(Record), sizeof(Record));
+            if (r.seq == ERASED_SEQ || r.crc != crc16((const uint8_t *)&r, offsetof(Record, crc))) {
+                continue;
+            }
+            int slot = p * slotsPerPage + i;
+            Entry *e = find(r.key);
+            if (e == nullptr) {
+                entries.push_back(Entry());
+                e = &entries.back();
+                e->key = r.key;
+                e->seq = 0;
+            }
+            if (r.seq > e->seq) {
+                e->value = r.value;
+                e->seq = r.seq;
+                e->slot = slot;
+            }
+            if (r.seq > maxSeq) {
+                maxSeq = r.seq;
+                maxSlot = slot;
+            }
+        }
+    }
+    head = (maxSlot + 1) % slotCount;
+    nextSeq = maxSeq + 1;
+    return true;
+}
+
+bool EEPROMKvStore::writeRecord(int slot, uint16_t key, int32_t value)
+{
+    Record r;
+    r.seq = nextSeq++;
+    r.key = key;
+    r.value = value;
+    r.crc = crc16((const uint8_t *)&r, offsetof(Record, crc));
+    if (!driver->writeDev(deviceAddress, slotAddress(slot), (uint8_t *)&r, sizeof(r))
+            || !driver->syncDev(deviceAddress)) {
+        ++statErrors;
+        return false;
+    }
+    ++statWrites;
+    Entry *e = find(key);
+    e->value = value;
+    e->seq = r.seq;
+    e->slot = slot;
+    return true;
+}
+
+bool EEPROMKvStore::append(uint16_t key, int32_t value)
+{
+    for (int n = 0; n < slotCount; n++) {
+        int slot = head;
+        head = (head + 1) % slotCount;
+        Entry *live = findSlot(slot);
+        if (live == nullptr) {
+            return writeRecord(slot, key, value);
+        }
+        if (live->key != key && nextSeq - live->seq > (uint32_t)(2 * slotCount)) {
+            // the copy lands after slot, and slot is only overwritten once it is written
+            if (!append(live->key, live->value)) {
+                return false;
+            }
+            ++statRelocations;
+            return writeRecord(slot, key, value);
+        }
+        ++statSkips;
+    }
+    // more keys than slots
+    ++statErrors;
+    return false;
+}
+
+bool EEPROMKvStore::contains(const char *key)
+{
+    if (!isInitialized) {
+        return false;
+    }
+    lock();
+    Entry *e = find(hashKey(key));
+    bool rc = (e != nullptr && e->seq != 0);
+    unlock();
+    return rc;
+}
+
+int32_t EEPROMKvStore::get(const char *key, int32_t defaultValue)
+{
+    if (!isInitialized) {
+        return defaultValue;
+    }
+    lock();
+    Entry *e = find(hashKey(key));
+    int32_t value = (e != nullptr && e->seq != 0 ? e->value : defaultValue);
+    unlock();
+    return value;
+}
+
+bool EEPROMKvStore::set(const char *key, int32_t value)
+{
+    if (!isInitialized) {
+        return false;
+    }
+    lock();
+    bool rc;
+    Entry *e = entryFor(key);
+    if (e == nullptr) {
+        rc = false;
+    } else if (e->seq != 0 && e->value == value) {
+        ++statUnchanged;
+        rc = true;
+    } else {
+        rc = append(e->key, value);
+    }
+    unlock();
+    return rc;
+}
+
+int32_t EEPROMKvStore::increment(const char *key, int32_t delta)
+{
+    if (!isInitialized) {
+        return 0;
+    }
+    lock();
+    int32_t value = 0;
+    Entry *e = entryFor(key);
+    if (e != nullptr) {
+        value = (e->seq != 0 ? e->value : 0) + delta;
+        append(e->key, value);
+    }
+    unlock();
+    return value;
+}
+
+void EEPROMKvStore::getStats(String *msg)
+{
+    if (!isInitialized) {
+        *msg += "Not initialized";
+        return;
+    }
+    lock();
+    *msg += "Slots: "; *msg += slotCount; *msg += " at "; *msg += baseAddress;
+    *msg += ", head: "; *msg += head; *msg += ", seq: "; *msg += nextSeq;
+    *msg += " (about "; *msg += (nextSeq - 1) / slotCount; *msg += " writes per slot)\n";
+    *msg += "Writes: "; *msg += statWrites; *msg += ", unchanged: "; *msg += statUnchanged;
+    *msg += ", relocations: "; *msg += statRelocations; *msg += ", skipped slots: "; *msg += statSkips;
+    *msg += ", errors: "; *msg += statErrors; *msg += "\n";
+    for (const Entry &e : entries) {
+        if (e.seq == 0) {
+            continue;
+        }
+        if (e.name.isEmpty()) {
+            *msg += "#"; *msg += e.key;
+        } else {
+            *msg += e.name;
+        }
+        *msg += ": "; *msg += e.value; *msg += " (slot "; *msg += e.slot; *msg += ")\n";
+    }
+    unlock();
+}
+
+void EEPROMKvStore::resetStats()
+{
+    statWrites = 0;
+    statUnchanged = 0;
+    statRelocations = 0;
+    statSkips = 0;
+    statErrors = 0;
+}
+
+#endif
@@ -0,0 +1,121 @@
+#include "CompilationOpts.h"
+
+#ifdef USE_EEPROM_LFS
+#ifndef INCL_EEPROM_KV_STORE_H
+#define INCL_EEPROM_KV_STORE_H
+
+#include <Arduino.h>
+#include <vector>
+#include <freertos/FreeRTOS.h>
+#include <freertos/semphr.h>
+#include "EEPROMDriver.h"
+
+/**
+ * Small key/value store of int32 values (counters, flags) in a region of the EEPROM
+ * outside the filesystem, for state that changes often and must survive resets.
+ *
+ * The region is a circular log of fixed size records (seq, key, value, crc), written one
+ * at a time, never across a write page. The latest value of each key is cached in RAM,
+ * so reads don't access the EEPROM, and setting a key to its current value writes
+ * nothing. On init, the whole region is read once: for each key the valid record with
+ * the highest seq wins, and writing resumes after the record with the highest seq.
+ *
+ * A record that holds the latest value of a key is never overwritten: the log skips it,
+ * so that a torn write loses at most the value being written. When the log comes back
+ * to a record that did not change for two laps, the record is first copied to the head,
+ * so that rarely changing keys don't keep slots out of the rotation and all pages wear
+ * evenly.
+ *
+ * Keys are names, stored as a 16 bit hash: two names with the same hash are detected
+ * when both are used in the same run, and the second one is refused.
+ *
+ * The first page of the region is a header (magic, version, page size, record size and
+ * region size). Records are only read from a region whose header matches: anything else
+ * may be stale bytes with valid-looking records (e.g. blocks of a former filesystem), and
+ * the store stays inactive until format() erases the region and writes the header.
+ */
+class EEPROMKvStore {
+    struct __attribute__((packed)) Header {
+        uint32_t magic;
+        uint16_t version;
+        uint16_t pageSize;
+        uint16_t recordSize;
+        uint32_t size;
+        uint16_t crc; // of the fields above
+    };
+    struct __attribute__((packed)) Record {
+        uint32_t seq;
+        uint16_t key;
+        int32_t value;
+        uint16_t crc; // of the fields above
+    };
+    struct Entry {
+        uint16_t key;
+        int32_t value;
+        uint32_t seq;
+        int slot;
+        String name; // empty until used in this run
+    };
+
+    EEPROMMasterDriver *driver;
+    uint8_t deviceAddress;
+    uint32_t baseAddress;
+    int pageSize;
+    int slotsPerPage;
+    int slotCount;
+    uint32_t size;
+    int head; // next slot to write
+    uint32_t nextSeq;
+    bool isInitialized;
+    bool isFormatNeeded;
+    bool isReadError;
+    std::vector<Entry> entries;
+    SemaphoreHandle_t mutex;
+
+    // stats
+    uint32_t statWrites;
+    uint32_t statUnchanged; // sets that didn't need a write
+    uint32_t statRelocations;
+    uint32_t statSkips; // slots skipped because they hold a latest value
+    uint32_t statErrors;
+
+    void lock() { if (mutex != nullptr) { xSemaphoreTake(mutex, portMAX_DELAY); } }
+    void unlock() { if (mutex != nullptr) { xSemaphoreGive(mutex); } }
+    static uint16_t hashKey(const char *name);
+    static uint16_t crc16(const uint8_t *data, size_t size);
+    uint32_t slotAddress(int slot);
+    void makeHeader(Header *h);
+    Entry *find(uint16_t key);
+    Entry *findSlot(int slot);
+    Entry *entryFor(const char *name);
+    bool load();
+    bool append(uint16_t key, int32_t value);
+    bool writeRecord(int slot, uint16_t key, int32_t value);
+
+public:
+    EEPROMKvStore();
+    ~EEPROMKvStore();
+    // size bytes from baseAddress, a multiple of the write page size of the driver; false
+    // if the region can't be read, or if it has no header for this geometry
+    bool init(EEPROMMasterDriver *driver, uint8_t deviceAddress, uint32_t baseAddress, size_t size);
+    bool isActive() { return isInitialized; }
+    // the region was read, and has no header for this geometry
+    bool needsFormat() { return isFormatNeeded; }
+    // the last init() could not read the region, so whether it has a header is unknown
+    bool hasReadError() { return isReadError; }
+    // erases the region, then writes the header: all keys are lost
+    bool format();
+
+    bool contains(const char *key);
+    int32_t get(const char *key, int32_t defaultValue = 0);
+    // the value is in the EEPROM when this returns true
+    bool set(const char *key, int32_t value);
+    // returns the new value
+    int32_t increment(const char *key, int32_t delta = 1);
+
+    void getStats(String *msg);
+    void resetStats();
+};
+
+#endif
+#endif
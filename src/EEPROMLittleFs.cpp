@@ -10,21 +10,15 @@
 //#define DEBUG_PRINT(s) s;
 #define DEBUG_PRINT(s)
 
+// reads of the key/value region header before giving up the mount, see mountWithKvStore()
+#define KV_INIT_ATTEMPTS 3
+
 // Read a region in a block. Negative error codes are propogated
 // to the user.
 int eepromLfsRead(const struct lfs_config *c, lfs_block_t block, lfs_off_t off, void *buffer, lfs_size_t size)
 {
     EEPROMLittleFsImpl *elfs = (EEPROMLittleFsImpl *)c->context;
-#ifdef EEPROM_LFS_IN_MEMORY
-    memcpy(buffer, elfs->diskSpace + block * c->block_size + off, size);
-    return 0;
-#else
-    bool rc = elfs->eeDriver.read(block * c->block_size + off, (uint8_t *)buffer, size);
-if (elfs->eeDriver.lastError() != 0) {
-    DEBUG_PRINT(Serial.printf("   EEPROM Driver error: %s\n", elfs->eeDriver.lastErrorStr()))
-}
-    return (rc ? 0 : LFS_ERR_IO);
-#endif
+    return elfs->readWithReadAhead(block * c->block_size + off, (uint8_t *)buffer, size);
 }
 
 // Program a region in a block. The block must have previously
@@ -33,16 +27,7 @@ if (elfs->eeDriver.lastError() != 0) {
 int eepromLfsProg(const struct lfs_config *c, lfs_block_t block, lfs_off_t off, const void *buffer, lfs_size_t size)
 {
     EEPROMLittleFsImpl *elfs = (EEPROMLittleFsImpl *)c->context;
-#ifdef EEPROM_LFS_IN_MEMORY
-    memcpy(elfs->diskSpace + block * c->block_size + off, buffer, size);
-    return 0;
-#else
-    bool rc = elfs->eeDriver.write(block * c->block_size + off, (uint8_t *)buffer, size);
-if (elfs->eeDriver.lastError() != 0) {
-    DEBUG_PRINT(Serial.printf("   EEPROM Driver error: %s\n", elfs->eeDriver.lastErrorStr()))
-}
-    return (rc ? 0 : LFS_ERR_IO);
-#endif
+    return elfs->deviceProg(block * c->block_size + off, (const uint8_t *)buffer, size);
 }
 
 // Erase a block. A block must be erased before being programmed.
@@ -67,24 +52,110 @@ int eepromLfsSync(const struct lfs_config *c)
 #endif
 }
 
+int EEPROMLittleFsImpl::deviceRead(uint32_t address, uint8_t *buffer, size_t size)
+{
+    ++io.reads;
+    io.readBytes += size;
+#ifdef EEPROM_LFS_IN_MEMORY
+    memcpy(buffer, diskSpace + address, size);
+    return 0;
+#else
+    bool rc = eeDriver.read(address, buffer, size);
+if (eeDriver.lastError() != 0) {
+    DEBUG_PRINT(Serial.printf("   EEPROM Driver error: %s\n", eeDriver.lastErrorStr()))
+}
+    return (rc ? 0 : LFS_ERR_IO);
+#endif
+}
+
+int EEPROMLittleFsImpl::deviceProg(uint32_t address, const uint8_t *buffer, size_t size)
+{
+    ++io.progs;
+    io.progBytes += size;
+    // keep the read-ahead buffer up to date
+    if (readAheadLen > 0 && address < readAheadAddress + readAheadLen && address + size > readAheadAddress) {
+        uint32_t from = (address > readAheadAddress ? address : readAheadAddress);
+        uint32_t to = (address + size < readAheadAddress + readAheadLen ? address + size : readAheadAddress + readAheadLen);
+        memcpy(readAheadBuf + (from - readAheadAddress), buffer + (from - address), to - from);
+    }
+#ifdef EEPROM_LFS_IN_MEMORY
+    memcpy(diskSpace + address, buffer, size);
+    return 0;
+#else
+    bool rc = eeDriver.write(address, (uint8_t *)buffer, size);
+if (eeDriver.lastError() != 0) {
+    DEBUG_PRINT(Serial.printf("   EEPROM Driver error: %s\n", eeDriver.lastErrorStr()))
+}
+    return (rc ? 0 : LFS_ERR_IO);
+#endif
+}
 
+/**
+ * A read continuing the previous one fetches readAheadSize bytes at once, usually spanning
+ * the next blocks: littlefs allocates blocks sequentially, so the following reads of a file
+ * or of a metadata log are served from memory.
+ */
+int EEPROMLittleFsImpl::readWithReadAhead(uint32_t address, uint8_t *buffer, size_t size)
+{
+    if (readAheadLen > 0 && address >= readAheadAddress && address + size <= readAheadAddress + readAheadLen) {
+        memcpy(buffer, readAheadBuf + (address - readAheadAddress), size);
+        ++io.readAheadHits;
+        lastReadEnd = address + size;
+        return 0;
+    }
+    bool isSequential = (address == lastReadEnd);
+    lastReadEnd = address + size;
+    if (!isSequential || readAheadBuf == nullptr || size >= (size_t)readAheadSize) {
+        return deviceRead(address, buffer, size);
+    }
+    uint32_t len = readAheadSize;
+    if (address + len > deviceSize) {
+        len = deviceSize - address;
+    }
+    int rc = deviceRead(address, readAheadBuf, len);
+    if (rc < 0) {
+        readAheadLen = 0;
+        return rc;
+    }
+    readAheadAddress = address;
+    readAheadLen = len;
+    memcpy(buffer, readAheadBuf, size);
+    return 0;
+}
 
 EEPROMLittleFsImpl::EEPROMLittleFsImpl()
 {
     lastError = 0;
     isInitialized = false;
+    deviceSize = 0;
+    readAheadBuf = nullptr;
+    readAheadSize = 0;
+    readAheadAddress = 0;
+    readAheadLen = 0;
+    lastReadEnd = UINT32_MAX;
+    migratedFileCount = -1;
+    lostFileCount = -1;
+    resetIoStats();
 }
 
 EEPROMLittleFsImpl::~EEPROMLittleFsImpl()
 {
     terminate();
+    delete[] readAheadBuf;
 }
 
-bool EEPROMLittleFsImpl::init(int i2cPort, const EEPROMLittleFs::EEPROMConfig &eeCfg,
-    const EEPROMLittleFs::LFSConfig &lfsCfg, bool allowFormatting)
+/**
+ * With autoTune, the geometry follows the EEPROM:
+ * - blocks are whole write pages, at least 128 bytes, and there are at most 256 of them:
+ *   fewer blocks shorten allocation scans, smaller ones waste less space per file
+ * - reads and programs are in units of 16 bytes (or the page, if smaller), so that
+ *   tags and commits need fewer transfers, without padding commits to whole pages
+ * - caches are one page, so that flushing the program cache is one or two page writes
+ * - the lookahead bitmap covers all blocks, so allocation scans the filesystem once
+ * - read-ahead is two blocks
+ */
+void EEPROMLittleFsImpl::configureGeometry(const EEPROMLittleFs::EEPROMConfig &eeCfg, const EEPROMLittleFs::LFSConfig &lfsCfg)
 {
-    isInitialized = false;
-
     cfg = { };
     cfg.context = this;
 
@@ -95,13 +166,80 @@ bool EEPROMLittleFsImpl::init(int i2cPort, const EEPROMLittleFs::EEPROMConfig &e
     cfg.sync  = eepromLfsSync;
 
     // block device configuration
-    cfg.read_size = 1;
-    cfg.prog_size = 1;
-    cfg.block_size = lfsCfg.block_size;
-    cfg.block_count = eeCfg.size / cfg.block_size;
     cfg.block_cycles = lfsCfg.block_cycles;
-    cfg.cache_size = lfsCfg.cache_size;
-    cfg.lookahead_size = lfsCfg.lookahead_size;
+    size_t fsSize = eeCfg.size - eeCfg.kvSize;
+    if (lfsCfg.autoTune && eeCfg.writePageSize != (size_t)-1 && eeCfg.size != (size_t)-1) {
+        size_t page = eeCfg.writePageSize;
+        size_t blockSize = (page < 128 ? 128 : page);
+        while (fsSize / blockSize > 256) {
+            blockSize *= 2;
+        }
+        cfg.read_size = (page < 16 ? page : 16);
+        cfg.prog_size = cfg.read_size;
+        cfg.block_size = blockSize;
+        cfg.block_count = fsSize / blockSize;
+        cfg.cache_size = page;
+        cfg.lookahead_size = (cfg.block_count + 63) / 64 * 8;
+        readAheadSize = 2 * blockSize;
+    } else {
+        cfg.read_size = lfsCfg.read_size;
+        cfg.prog_size = lfsCfg.prog_size;
+        cfg.block_size = lfsCfg.block_size;
+        cfg.block_count = fsSize / cfg.block_size;
+        cfg.cache_size = lfsCfg.cache_size;
+        cfg.lookahead_size = lfsCfg.lookahead_size;
+        readAheadSize = lfsCfg.readAheadSize;
+    }
+    deviceSize = cfg.block_size * cfg.block_count;
+
+    delete[] readAheadBuf;
+    readAheadBuf = (readAheadSize > 0 ? new uint8_t[readAheadSize] : nullptr);
+    readAheadLen = 0;
+    lastReadEnd = UINT32_MAX;
+}
+
+void EEPROMLittleFsImpl::addIoStats(IoOp op, const IoCounts &start)
+{
+    ++opStats[op].calls;
+    opStats[op].io.reads += io.reads - start.reads;
+    opStats[op].io.readBytes += io.readBytes - start.readBytes;
+    opStats[op].io.progs += io.progs - start.progs;
+    opStats[op].io.progBytes += io.progBytes - start.progBytes;
+    opStats[op].io.readAheadHits += io.readAheadHits - start.readAheadHits;
+}
+
+void EEPROMLittleFsImpl::resetIoStats()
+{
+    memset(&io, 0, sizeof(io));
+    memset(opStats, 0, sizeof(opStats));
+}
+
+void EEPROMLittleFsImpl::getIoStats(String *msg)
+{
+    static const char *opNames[IO_OP_COUNT] = {
+        "mount", "open", "read", "write", "flush", "seek", "close", "dir", "stat", "modify"
+    };
+    *msg += "Blocks: "; *msg += cfg.block_count; *msg += " x "; *msg += cfg.block_size;
+    *msg += ", read/prog size: "; *msg += cfg.read_size; *msg += "/"; *msg += cfg.prog_size;
+    *msg += ", cache: "; *msg += cfg.cache_size; *msg += ", lookahead: "; *msg += cfg.lookahead_size;
+    *msg += ", read-ahead: "; *msg += readAheadSize; *msg += "\n";
+    for (int i = 0; i < IO_OP_COUNT; i++) {
+        if (opStats[i].calls == 0) {
+            continue;
+        }
+        *msg += opNames[i]; *msg += ": "; *msg += opStats[i].calls; *msg += " calls, ";
+        *msg += opStats[i].io.reads; *msg += " reads ("; *msg += opStats[i].io.readBytes; *msg += " bytes, ";
+        *msg += opStats[i].io.readAheadHits; *msg += " read-ahead hits), ";
+        *msg += opStats[i].io.progs; *msg += " progs ("; *msg += opStats[i].io.progBytes; *msg += " bytes)\n";
+    }
+}
+
+bool EEPROMLittleFsImpl::init(int i2cPort, const EEPROMLittleFs::EEPROMConfig &eeCfg,
+    const EEPROMLittleFs::LFSConfig &lfsCfg, bool allowFormatting, I2cBus *bus)
+{
+    isInitialized = false;
+
+    configureGeometry(eeCfg, lfsCfg);
 
 #ifdef EEPROM_LFS_IN_MEMORY
     diskSpace = (uint8_t*)malloc(cfg.block_size * cfg.block_count);
@@ -112,15 +250,24 @@ bool EEPROMLittleFsImpl::init(int i2cPort, const EEPROMLittleFs::EEPROMConfig &e
     }
     memset(diskSpace, 0, cfg.block_size * cfg.block_count);
 #else
-    bool rc = eeDriver.init(i2cPort, eeCfg.deviceAddress);
+    bool rc = (bus != nullptr ? eeDriver.init(bus, eeCfg.deviceAddress) : eeDriver.init(i2cPort, eeCfg.deviceAddress));
     if (!rc) {
         DEBUG_PRINT(Serial.printf("EEPROM Driver initialization failure: %s", eeDriver.lastErrorStr()))
         lastError = LFS_ERR_IO;
         return false;
     }
+    if (eeCfg.writePageSize != (size_t)-1) {
+        eeDriver.setWritePageSize(eeCfg.writePageSize);
+    }
+    eeDriver.setCache(eeCfg.cachePages, eeCfg.writeBackDelayMillis);
 #endif
 
+    IoScope scope(this, IO_MOUNT);
+#ifdef EEPROM_LFS_IN_MEMORY
     lastError = mount(allowFormatting);
+#else
+    lastError = mountWithKvStore(eeCfg, allowFormatting);
+#endif
     isInitialized = (lastError == 0);
     return isInitialized;
 }
@@ -130,23 +277,7 @@ bool EEPROMLittleFsImpl::init(const EEPROMLittleFs::I2CConfig &i2cCfg, const EEP
 {
     isInitialized = false;
 
-    cfg = { };
-    cfg.context = this;
-
-    // block device operations
-    cfg.read  = eepromLfsRead;
-    cfg.prog  = eepromLfsProg;
-    cfg.erase = eepromLfsErase;
-    cfg.sync  = eepromLfsSync;
-
-    // block device configuration
-    cfg.read_size = 1;
-    cfg.prog_size = 1;
-    cfg.block_size = lfsCfg.block_size;
-    cfg.block_count = eeCfg.size / cfg.block_size;
-    cfg.block_cycles = lfsCfg.block_cycles;
-    cfg.cache_size = lfsCfg.cache_size;
-    cfg.lookahead_size = lfsCfg.lookahead_size;
+    configureGeometry(eeCfg, lfsCfg);
 
 #ifdef EEPROM_LFS_IN_MEMORY
     diskSpace = (uint8_t*)malloc(cfg.block_size * cfg.block_count);
@@ -163,9 +294,18 @@ bool EEPROMLittleFsImpl::init(const EEPROMLittleFs::I2CConfig &i2cCfg, const EEP
         lastError = LFS_ERR_IO;
         return false;
     }
+    if (eeCfg.writePageSize != (size_t)-1) {
+        eeDriver.setWritePageSize(eeCfg.writePageSize);
+    }
+    eeDriver.setCache(eeCfg.cachePages, eeCfg.writeBackDelayMillis);
 #endif
 
+    IoScope scope(this, IO_MOUNT);
+#ifdef EEPROM_LFS_IN_MEMORY
     lastError = mount(allowFormatting);
+#else
+    lastError = mountWithKvStore(eeCfg, allowFormatting);
+#endif
     isInitialized = (lastError == 0);
     return isInitialized;
 }
@@ -186,6 +326,151 @@ int EEPROMLittleFsImpl::mount(bool allowFormatting)
     return err;
 }
 
+#ifndef EEPROM_LFS_IN_MEMORY
+
+/**
+ * The header of the key/value region (see EEPROMKvStore) is written when the filesystem is
+ * formatted to end where the region starts. Without it, the filesystem may be the former one,
+ * spanning the whole EEPROM: mounted with the new geometry, littlefs would either refuse it or
+ * lose the files in its last blocks, and the store would read these blocks as records. The
+ * files are read with the former geometry, then written back once the region is erased and
+ * the filesystem formatted without it.
+ *
+ * A header that can't be read is not a missing one: the filesystem may still be the former
+ * one, and mounting it with formatting allowed would erase it. The read is retried, then the
+ * mount fails and the EEPROM is left as is.
+ */
+int EEPROMLittleFsImpl::mountWithKvStore(const EEPROMLittleFs::EEPROMConfig &eeCfg, bool allowFormatting)
+{
+    migratedFileCount = -1;
+    lostFileCount = -1;
+    if (eeCfg.kvSize == 0) {
+        return mount(allowFormatting);
+    }
+    kvStore.init(&eeDriver, eeCfg.deviceAddress, eeCfg.size - eeCfg.kvSize, eeCfg.kvSize);
+    for (int i = 1; i < KV_INIT_ATTEMPTS && kvStore.hasReadError(); i++) {
+        vTaskDelay(pdMS_TO_TICKS(10));
+        kvStore.init(&eeDriver, eeCfg.deviceAddress, eeCfg.size - eeCfg.kvSize, eeCfg.kvSize);
+    }
+    if (kvStore.hasReadError()) {
+        DEBUG_PRINT(Serial.printf("Reading the key/value region failed: %s\n", eeDriver.lastErrorStr()))
+        return LFS_ERR_IO;
+    }
+    if (!kvStore.needsFormat()) {
+        // resized already; without an active store (a region too small for its header), the
+        // geometry is uncertain and the filesystem is never formatted
+        return mount(allowFormatting && kvStore.isActive());
+    }
+    if (!allowFormatting) {
+        return LFS_ERR_INVAL;
+    }
+
+    std::vector<MigratedFile> files;
+    lfs_size_t blockCount = cfg.block_count;
+    cfg.block_count = eeCfg.size / cfg.block_size;
+    deviceSize = cfg.block_size * cfg.block_count;
+    bool isFormer = (lfs_mount(&lfs, &cfg) == 0);
+    if (isFormer) {
+        int err = readTree("/", &files);
+        lfs_unmount(&lfs);
+        if (err < 0) {
+            // the files read so far are still written back
+            DEBUG_PRINT(Serial.printf("Reading the former filesystem failed, error %d\n", err))
+        }
+    }
+    cfg.block_count = blockCount;
+    deviceSize = cfg.block_size * cfg.block_count;
+    readAheadLen = 0;
+    lastReadEnd = UINT32_MAX;
+
+    if (!kvStore.format()) {
+        return LFS_ERR_IO;
+    }
+    if (!isFormer) {
+        return mount(true);
+    }
+    int err = lfs_format(&lfs, &cfg);
+    if (err == 0) {
+        err = lfs_mount(&lfs, &cfg);
+    }
+    if (err == 0) {
+        writeTree(files);
+    }
+    return err;
+}
+
+// files and directories under dir, each directory before its content
+int EEPROMLittleFsImpl::readTree(const String &dir, std::vector<MigratedFile> *files)
+{
+    lfs_dir_t d;
+    int err = lfs_dir_open(&lfs, &d, dir.c_str());
+    if (err < 0) {
+        return err;
+    }
+    lfs_info info;
+    while ((err = lfs_dir_read(&lfs, &d, &info)) > 0) {
+        if (strcmp(info.name, ".") == 0 || strcmp(info.name, "..") == 0) {
+            continue;
+        }
+        MigratedFile f;
+        f.path = dir + (dir.endsWith("/") ? "" : "/") + info.name;
+        f.isDir = (info.type == LFS_TYPE_DIR);
+        if (!f.isDir) {
+            lfs_file_t file;
+            err = lfs_file_open(&lfs, &file, f.path.c_str(), LFS_O_RDONLY);
+            if (err < 0) {
+                break;
+            }
+            f.data.resize(info.size);
+            lfs_ssize_t n = lfs_file_read(&lfs, &file, f.data.data(), info.size);
+            lfs_file_close(&lfs, &file);
+            if (n != (lfs_ssize_t)info.size) {
+                err = (n < 0 ? n : LFS_ERR_CORRUPT);
+                break;
+            }
+        }
+        files->push_back(f);
+        if (f.isDir && (err = readTree(f.path, files)) < 0) {
+            break;
+        }
+    }
+    lfs_dir_close(&lfs, &d);
+    return err;
+}
+
+void EEPROMLittleFsImpl::writeTree(const std::vector<MigratedFile> &files)
+{
+    migratedFileCount = 0;
+    lostFileCount = 0;
+    for (const MigratedFile &f : files) {
+        bool rc;
+        if (f.isDir) {
+            int err = lfs_mkdir(&lfs, f.path.c_str());
+            rc = (err == 0 || err == LFS_ERR_EXIST);
+        } else {
+            lfs_file_t file;
+            rc = (lfs_file_open(&lfs, &file, f.path.c_str(), LFS_O_WRONLY | LFS_O_CREAT | LFS_O_TRUNC) == 0);
+            if (rc) {
+                rc = (lfs_file_write(&lfs, &file, f.data.data(), f.data.size()) == (lfs_ssize_t)f.data.size());
+                rc = (lfs_file_close(&lfs, &file) == 0) && rc;
+                if (!rc) {
+                    lfs_remove(&lfs, f.path.c_str());
+                }
+            }
+        }
+        if (f.isDir) {
+            continue;
+        }
+        if (rc) {
+            ++migratedFileCount;
+        } else {
+            ++lostFileCount;
+        }
+    }
+}
+
+#endif
+
 void EEPROMLittleFsImpl::terminate()
 {
     if (isInitialized) {
@@ -196,6 +481,7 @@ void EEPROMLittleFsImpl::terminate()
 
 bool EEPROMLittleFsImpl::format()
 {
+    IoScope scope(this, IO_MOUNT);
     bool mustRemount = false;
     if (isInitialized) {
         lfs_unmount(&lfs);
@@ -236,6 +522,7 @@ const char *EEPROMLittleFsImpl::errorStr(int err)
 
 fs::FileImplPtr EEPROMLittleFsImpl::open(const char* path, const char* mode)
 {
+    IoScope scope(this, IO_OPEN);
     if (!isInitialized) {
         return nullptr;
     }
@@ -252,6 +539,7 @@ fs::FileImplPtr EEPROMLittleFsImpl::open(const char* path, const char* mode)
 
 bool EEPROMLittleFsImpl::exists(const char* path)
 {
+    IoScope scope(this, IO_STAT);
     if (!isInitialized) {
         return false;
     }
@@ -263,6 +551,7 @@ bool EEPROMLittleFsImpl::exists(const char* path)
 
 bool EEPROMLittleFsImpl::rename(const char* pathFrom, const char* pathTo)
 {
+    IoScope scope(this, IO_MODIFY);
     if (!isInitialized) {
         return false;
     }
@@ -273,6 +562,7 @@ bool EEPROMLittleFsImpl::rename(const char* pathFrom, const char* pathTo)
 
 bool EEPROMLittleFsImpl::remove(const char* path)
 {
+    IoScope scope(this, IO_MODIFY);
     if (!isInitialized) {
         return false;
     }
@@ -283,6 +573,7 @@ bool EEPROMLittleFsImpl::remove(const char* path)
 
 bool EEPROMLittleFsImpl::mkdir(const char *path)
 {
+    IoScope scope(this, IO_MODIFY);
     if (!isInitialized) {
         return false;
     }
@@ -293,6 +584,7 @@ bool EEPROMLittleFsImpl::mkdir(const char *path)
 
 bool EEPROMLittleFsImpl::rmdir(const char *path)
 {
+    IoScope scope(this, IO_MODIFY);
     if (!isInitialized) {
         return false;
     }
@@ -308,7 +600,29 @@ void EEPROMLittleFsImpl::getLastError(String *msg)
 
 void EEPROMLittleFsImpl::getDriverLastError(String *msg)
 {
+#ifdef EEPROM_LFS_IN_MEMORY
+    msg->concat("In memory, no driver");
+#else
     msg->concat(eeDriver.lastErrorStr());
+#endif
+}
+
+void EEPROMLittleFsImpl::getDriverStats(String *msg)
+{
+#ifdef EEPROM_LFS_IN_MEMORY
+    msg->concat("In memory, no driver");
+#else
+    eeDriver.getStats(msg);
+#endif
+}
+
+EEPROMKvStore *EEPROMLittleFsImpl::getKvStore()
+{
+#ifdef EEPROM_LFS_IN_MEMORY
+    return nullptr;
+#else
+    return kvStore.isActive() ? &kvStore : nullptr;
+#endif
 }
 
 
@@ -323,9 +637,9 @@ bool EEPROMLittleFs::init(const I2CConfig &i2cCfg, const EEPROMConfig &eeCfg, co
     return fsImplPtr->init(i2cCfg, eeCfg, lfsCfg, allowFormatting);
 }
 
-bool EEPROMLittleFs::init(int i2cPort, const EEPROMConfig &eeCfg, const LFSConfig &lfsCfg, bool allowFormatting)
+bool EEPROMLittleFs::init(int i2cPort, const EEPROMConfig &eeCfg, const LFSConfig &lfsCfg, bool allowFormatting, I2cBus *bus)
 {
-    return fsImplPtr->init(i2cPort, eeCfg, lfsCfg, allowFormatting);
+    return fsImplPtr->init(i2cPort, eeCfg, lfsCfg, allowFormatting, bus);
 }
 
 void EEPROMLittleFs::terminate()
@@ -348,6 +662,36 @@ void EEPROMLittleFs::getDriverLastError(String *msg)
     fsImplPtr->getDriverLastError(msg);
 }
 
+void EEPROMLittleFs::getDriverStats(String *msg)
+{
+    fsImplPtr->getDriverStats(msg);
+}
+
+void EEPROMLittleFs::getIoStats(String *msg)
+{
+    fsImplPtr->getIoStats(msg);
+}
+
+void EEPROMLittleFs::resetIoStats()
+{
+    fsImplPtr->resetIoStats();
+}
+
+EEPROMKvStore *EEPROMLittleFs::getKvStore()
+{
+    return fsImplPtr->getKvStore();
+}
+
+int EEPROMLittleFs::getMigratedFileCount()
+{
+    return fsImplPtr->getMigratedFileCount();
+}
+
+int EEPROMLittleFs::getLostFileCount()
+{
+    return fsImplPtr->getLostFileCount();
+}
+
 
 
 EEPROMFileImpl::EEPROMFileImpl(EEPROMLittleFsImpl *fs)
@@ -425,6 +769,7 @@ int EEPROMFileImpl::openFile(lfs_t *lfs, const char *path, const char *mode)
 
 size_t EEPROMFileImpl::write(const uint8_t *buf, size_t size)
 {
+    EEPROMLittleFsImpl::IoScope scope(fs, EEPROMLittleFsImpl::IO_WRITE);
     DEBUG_PRINT(Serial.printf("In write(<>, %d) %s\n", size, fileName.c_str()))
     if (isDir) {
         lastError = LFS_ERR_ISDIR;
@@ -443,6 +788,7 @@ size_t EEPROMFileImpl::write(const uint8_t *buf, size_t size)
 
 size_t EEPROMFileImpl::read(uint8_t* buf, size_t size)
 {
+    EEPROMLittleFsImpl::IoScope scope(fs, EEPROMLittleFsImpl::IO_READ);
     DEBUG_PRINT(Serial.printf("In read(<>, %d) %s\n", size, fileName.c_str()))
     if (isDir) {
         lastError = LFS_ERR_ISDIR;
@@ -460,6 +806,7 @@ size_t EEPROMFileImpl::read(uint8_t* buf, size_t size)
 
 void EEPROMFileImpl::flush()
 {
+    EEPROMLittleFsImpl::IoScope scope(fs, EEPROMLittleFsImpl::IO_FLUSH);
     DEBUG_PRINT(Serial.printf("In flush() %s\n", fileName.c_str()))
     if (isDir) {
         lastError = LFS_ERR_ISDIR;
@@ -475,6 +822,7 @@ void EEPROMFileImpl::flush()
 
 bool EEPROMFileImpl::seek(uint32_t pos, SeekMode mode)
 {
+    EEPROMLittleFsImpl::IoScope scope(fs, EEPROMLittleFsImpl::IO_SEEK);
     DEBUG_PRINT(Serial.printf("In seek(%d, %d) %s\n", pos, mode, fileName.c_str()))
     if (isDir) {
         lastError = LFS_ERR_ISDIR;
@@ -525,6 +873,7 @@ size_t EEPROMFileImpl::size() const
 
 void EEPROMFileImpl::close()
 {
+    EEPROMLittleFsImpl::IoScope scope(fs, EEPROMLittleFsImpl::IO_CLOSE);
     DEBUG_PRINT(Serial.printf("In close() %s\n", fileName.c_str()))
     if (!isOpen) {
         DEBUG_PRINT(Serial.printf("In close() returning because not open %s\n", fileName.c_str()))
@@ -559,6 +908,7 @@ boolean EEPROMFileImpl::isDirectory(void)
 
 fs::FileImplPtr EEPROMFileImpl::openNextFile(const char* mode)
 {
+    EEPROMLittleFsImpl::IoScope scope(fs, EEPROMLittleFsImpl::IO_DIR);
     DEBUG_PRINT(Serial.printf("In openNextFile(%s) %s\n", mode, fileName.c_str()))
     if (!isDir) {
         lastError = LFS_ERR_NOTDIR;
@@ -569,16 +919,24 @@ fs::FileImplPtr EEPROMFileImpl::openNextFile(const char* mode)
         return std::make_shared<EEPROMFileImpl>(fs); // not initialized
     }
     lfs_info info;
-    lastError = lfs_dir_read(lfs, &dir, &info);
+    do {
+        lastError = lfs_dir_read(lfs, &dir, &info);
+    } while (lastError > 0 && (strcmp(info.name, ".") == 0 || strcmp(info.name, "..") == 0));
     if (lastError < 0 || lastError == 0) { // 0: end of directory
         DEBUG_PRINT(Serial.printf("In openNextFile() (after lfs_dir_read()) lastError=%d %s\n", lastError, fileName.c_str()))
         return std::make_shared<EEPROMFileImpl>(fs); // not initialized
     }
+    // littlefs resolves paths from the root
+    String path = fileName;
+    if (!path.endsWith("/")) {
+        path += "/";
+    }
+    path += info.name;
     std::shared_ptr<EEPROMFileImpl> newFile = std::make_shared<EEPROMFileImpl>(fs);
     if (info.type == LFS_TYPE_DIR) {
-        lastError = newFile->openDir(lfs, info.name);
+        lastError = newFile->openDir(lfs, path.c_str());
     } else {
-        lastError = newFile->openFile(lfs, info.name, mode);
+        lastError = newFile->openFile(lfs, path.c_str(), mode);
     }
     DEBUG_PRINT(Serial.printf("In openNextFile() lastError=%d %s\n", lastError, fileName.c_str()))
 
@@ -590,6 +948,7 @@ fs::FileImplPtr EEPROMFileImpl::openNextFile(const char* mode)
 
 void EEPROMFileImpl::rewindDirectory(void)
 {
+    EEPROMLittleFsImpl::IoScope scope(fs, EEPROMLittleFsImpl::IO_DIR);
     if (!isDir) {
         lastError = LFS_ERR_NOTDIR;
         return;
@@ -7,11 +7,13 @@
 
 #include <limits>
 #include <stddef.h>
+#include <vector>
 #include <FS.h>
 #include <FSImpl.h>
 #include <debug.h>
 #include <lfs.h>
 #include "EEPROMDriver.h"
+#include "EEPROMKvStore.h"
 
 // #define EEPROM_LFS_IN_MEMORY
 
@@ -29,17 +31,31 @@ public:
         uint8_t deviceAddress = 0x50;
         size_t size = -1;
         size_t writePageSize = -1;
+        int cachePages = 4; // write-back cache in the driver, in write pages, 0 for none
+        int writeBackDelayMillis = 20;
+        // bytes at the end of the EEPROM left out of the filesystem, for the key/value
+        // store (see EEPROMKvStore), a multiple of writePageSize; changing it reformats,
+        // except from 0: the files are then carried over, see EEPROMLittleFsImpl::mountWithKvStore()
+        size_t kvSize = 0;
     };
     struct LFSConfig {
+        // If set, and EEPROMConfig has size and writePageSize, the geometry below is derived
+        // from the EEPROM (see EEPROMLittleFsImpl::configureGeometry()), block_cycles excepted
+        bool autoTune = true;
         size_t block_size = 128;
+        int read_size = 1;
+        int prog_size = 1;
         int block_cycles = 500;
         int cache_size = 128;
         int lookahead_size = 64;
+        // bytes read ahead of sequential reads, spanning blocks; 0 for none
+        int readAheadSize = 0;
     };
 
     EEPROMLittleFs();
     bool init(const I2CConfig &i2cCfg, const EEPROMConfig &eeCfg, const LFSConfig &lfsCfg, bool allowFormatting);
-    bool init(int i2cPort, const EEPROMConfig &eeCfg, const LFSConfig &lfsCfg, bool allowFormatting);
+    // with a bus, the EEPROM transfers go through it, see EEPROMMasterDriver
+    bool init(int i2cPort, const EEPROMConfig &eeCfg, const LFSConfig &lfsCfg, bool allowFormatting, I2cBus *bus = nullptr);
     void terminate();
 
     // If the file system was already mounted, it is mounted again after formatting
@@ -48,6 +64,17 @@ public:
     void getLastError(String *msg);
     // Last driver error
     void getDriverLastError(String *msg);
+    // Driver transfer statistics
+    void getDriverStats(String *msg);
+    // Geometry, and device I/O of each kind of filesystem operation
+    void getIoStats(String *msg);
+    void resetIoStats();
+    // nullptr if EEPROMConfig::kvSize is 0 or the store could not be read
+    EEPROMKvStore *getKvStore();
+    // files carried over by init() into the filesystem resized for the key/value store, and
+    // files that didn't fit; both -1 if init() found the filesystem already resized
+    int getMigratedFileCount();
+    int getLostFileCount();
 
 private:
     EEPROMLittleFsImpl *fsImplPtr;
@@ -64,6 +91,7 @@ private:
     uint8_t *diskSpace;
 #else
     EEPROMMasterDriver eeDriver;
+    EEPROMKvStore kvStore;
 #endif
 
     friend int eepromLfsRead(const struct lfs_config *c, lfs_block_t block,
@@ -75,18 +103,79 @@ private:
 
     const char *errorStr(int rc);
 
+    void configureGeometry(const EEPROMLittleFs::EEPROMConfig &eeCfg, const EEPROMLittleFs::LFSConfig &lfsCfg);
     int mount(bool allowFormatting);
+    int migratedFileCount;
+    int lostFileCount;
+#ifndef EEPROM_LFS_IN_MEMORY
+    struct MigratedFile {
+        String path;
+        bool isDir;
+        std::vector<uint8_t> data;
+    };
+    int mountWithKvStore(const EEPROMLittleFs::EEPROMConfig &eeCfg, bool allowFormatting);
+    int readTree(const String &dir, std::vector<MigratedFile> *files);
+    void writeTree(const std::vector<MigratedFile> &files);
+#endif
+
+public:
+    enum IoOp {
+        IO_MOUNT, IO_OPEN, IO_READ, IO_WRITE, IO_FLUSH, IO_SEEK, IO_CLOSE, IO_DIR, IO_STAT, IO_MODIFY,
+        IO_OP_COUNT
+    };
+    struct IoCounts {
+        uint32_t reads;
+        uint32_t readBytes;
+        uint32_t progs;
+        uint32_t progBytes;
+        uint32_t readAheadHits; // reads served by the read-ahead buffer
+    };
+    // Adds the device I/O done during its lifetime to the statistics of the operation
+    class IoScope {
+        EEPROMLittleFsImpl *fs;
+        IoOp op;
+        IoCounts start;
+    public:
+        IoScope(EEPROMLittleFsImpl *fs, IoOp op) : fs(fs), op(op), start(fs->io) { }
+        ~IoScope() { fs->addIoStats(op, start); }
+    };
+
+private:
+    IoCounts io; // since startup
+    struct {
+        uint32_t calls;
+        IoCounts io;
+    } opStats[IO_OP_COUNT];
+    void addIoStats(IoOp op, const IoCounts &start);
+
+    uint32_t deviceSize;
+    uint8_t *readAheadBuf;
+    int readAheadSize;
+    uint32_t readAheadAddress;
+    uint32_t readAheadLen; // 0 if the buffer is empty
+    uint32_t lastReadEnd; // to detect sequential reads
+
+    int deviceRead(uint32_t address, uint8_t *buffer, size_t size);
+    int deviceProg(uint32_t address, const uint8_t *buffer, size_t size);
+    int readWithReadAhead(uint32_t address, uint8_t *buffer, size_t size);
 
 public:
     bool init(const EEPROMLittleFs::I2CConfig &i2cCfg, const EEPROMLittleFs::EEPROMConfig &eeCfg,
         const EEPROMLittleFs::LFSConfig &lfsCfg, bool allowFormatting);
-    bool init(int i2cPort, const EEPROMLittleFs::EEPROMConfig &eeCfg, const EEPROMLittleFs::LFSConfig &lfsCfg, bool allowFormatting);
+    bool init(int i2cPort, const EEPROMLittleFs::EEPROMConfig &eeCfg, const EEPROMLittleFs::LFSConfig &lfsCfg, bool allowFormatting,
+        I2cBus *bus);
     void terminate();
     bool format();
     // Last filesystem error
     void getLastError(String *msg);
     // Last driver error
     void getDriverLastError(String *msg);
+    void getDriverStats(String *msg);
+    void getIoStats(String *msg);
+    void resetIoStats();
+    EEPROMKvStore *getKvStore();
+    int getMigratedFileCount() { return migratedFileCount; }
+    int getLostFileCount() { return lostFileCount; }
 
     lfs_t *getLfs() { return &lfs; }
 
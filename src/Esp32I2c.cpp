@@ -33,7 +33,13 @@ void Esp32I2cService::init(UEventLoop *eventLoop, CommandMgr *commandMgr, System
     nextMeasurementTime = 0; // will be set once we get a measurement
 
     isI2cRetrieved = false;
+    bus = nullptr;
+    tx.priority = I2cBus::NORMAL;
     clearMeasures();
+    tempSeries = nullptr;
+    humiditySeries = nullptr;
+    batterySeries = nullptr;
+    rssiSeries = nullptr;
 
     // load config
     String msg;
@@ -44,6 +50,14 @@ void Esp32I2cService::init(UEventLoop *eventLoop, CommandMgr *commandMgr, System
         cmd->getCurrentKeyName(&keyName);
         Serial.printf("Loaded config for %s/%s\n", cmd->getServiceName(), keyName.c_str());
     }
+
+    if (isEnabled) {
+        TimeSeries *timeSeries = system->getTimeSeries();
+        tempSeries = timeSeries->addMetric("esp32i2c.temp", "m°C", 36, 0, 48);
+        humiditySeries = timeSeries->addMetric("esp32i2c.humidity", "0.01%", 36, 0, 48);
+        batterySeries = timeSeries->addMetric("esp32i2c.battery", "0.01%", 36, 0, 48);
+        rssiSeries = timeSeries->addMetric("esp32i2c.rssi", "dBm", 36, 0, 48);
+    }
 }
 
 void Esp32I2cService::clearMeasures()
@@ -70,13 +84,7 @@ bool Esp32I2cService::writeParams(int32_t scanDurationMillis, int32_t sleepDurat
     memcpy(&data[5], &sleepDurationSecs, 4);
     data[9] = doNewScan ? 0x01 : 0x00;
 
-    i2c_cmd_handle_t cmd = i2c_cmd_link_create();
-    i2c_master_start(cmd);
-    i2c_master_write_byte(cmd, (i2cAddress << 1) | 0x0 /* write */, true);
-    i2c_master_write(cmd, data, 10, true);
-    i2c_master_stop(cmd);
-    esp_err_t err = i2c_master_cmd_begin(i2cPort, cmd, 20 / portTICK_PERIOD_MS);
-    i2c_cmd_link_delete(cmd);
+    esp_err_t err = transfer(data, 10, nullptr, 0, 20);
     if (err != ESP_OK) {
         logger->error("Error {} writing in writeParams(): {}", err, esp_err_to_name(err));
         return false;
@@ -85,6 +93,18 @@ bool Esp32I2cService::writeParams(int32_t scanDurationMillis, int32_t sleepDurat
     return true;
 }
 
+esp_err_t Esp32I2cService::transfer(const uint8_t *writeData, size_t writeLen, uint8_t *readData, size_t readLen, int timeoutMillis)
+{
+    tx.address = i2cAddress;
+    tx.headerLen = 0;
+    tx.writeData = writeData;
+    tx.writeLen = writeLen;
+    tx.readData = readData;
+    tx.readLen = readLen;
+    tx.timeoutMillis = timeoutMillis;
+    return bus->execute(&tx);
+}
+
 bool Esp32I2cService::readVersion()
 {
     // * Followed by a read:
@@ -94,13 +114,7 @@ bool Esp32I2cService::readVersion()
     // * Byte 0: Version of esp32 remote
 
     uint8_t data[9];
-    i2c_cmd_handle_t cmd = i2c_cmd_link_create();
-    i2c_master_start(cmd);
-    i2c_master_write_byte(cmd, (i2cAddress << 1) | 0x1 /* read */, true);
-    i2c_master_read(cmd, data, 9, i2c_ack_type_t::I2C_MASTER_LAST_NACK);
-    i2c_master_stop(cmd);
-    esp_err_t err = i2c_master_cmd_begin(i2cPort, cmd, 1000 / portTICK_PERIOD_MS);
-    i2c_cmd_link_delete(cmd);
+    esp_err_t err = transfer(nullptr, 0, data, 9, 1000);
     if (err != ESP_OK) {
         logger->error("Error {} reading in readData(): {}", err, esp_err_to_name(err));
         return false;
@@ -131,13 +145,7 @@ bool Esp32I2cService::writeRequest()
     data[1] = BLE_DEVICE_NOT_SPECIFIED; // for the time being we're supposing that matching can happen from BLE scan data
     memcpy(&data[2], bleAddress.getNative(), 6);
 
-    i2c_cmd_handle_t cmd = i2c_cmd_link_create();
-    i2c_master_start(cmd);
-    i2c_master_write_byte(cmd, (i2cAddress << 1) | 0x0 /* write */, true);
-    i2c_master_write(cmd, data, 8, true);
-    i2c_master_stop(cmd);
-    esp_err_t err = i2c_master_cmd_begin(i2cPort, cmd, 20 / portTICK_PERIOD_MS);
-    i2c_cmd_link_delete(cmd);
+    esp_err_t err = transfer(data, 8, nullptr, 0, 20);
     if (err != ESP_OK) {
         logger->error("Error {} writing in writeConfigData(): {}", err, esp_err_to_name(err));
         return false;
@@ -156,13 +164,7 @@ bool Esp32I2cService::readMeasures()
 
     uint8_t count = 0;
     do { // reading returns 0xFF if no data is available at the remote side
-        i2c_cmd_handle_t cmd = i2c_cmd_link_create();
-        i2c_master_start(cmd);
-        i2c_master_write_byte(cmd, (i2cAddress << 1) | 0x1 /* read */, true);
-        i2c_master_read(cmd, &count, 1, i2c_ack_type_t::I2C_MASTER_LAST_NACK);
-        i2c_master_stop(cmd);
-        esp_err_t err = i2c_master_cmd_begin(i2cPort, cmd, 1000 / portTICK_PERIOD_MS);
-        i2c_cmd_link_delete(cmd);
+        esp_err_t err = transfer(nullptr, 0, &count, 1, 1000);
         if (err != ESP_OK) {
             logger->error("Error {} reading number of measurements in readData(): {}", err, esp_err_to_name(err));
             return false;
@@ -176,13 +178,7 @@ bool Esp32I2cService::readMeasures()
     }
 
     uint8_t data[count * 5];
-    i2c_cmd_handle_t cmd = i2c_cmd_link_create();
-    i2c_master_start(cmd);
-    i2c_master_write_byte(cmd, (i2cAddress << 1) | 0x1 /* read */, true);
-    i2c_master_read(cmd, data, count * 5, i2c_ack_type_t::I2C_MASTER_LAST_NACK);
-    i2c_master_stop(cmd);
-    esp_err_t err = i2c_master_cmd_begin(i2cPort, cmd, 1000 / portTICK_PERIOD_MS);
-    i2c_cmd_link_delete(cmd);
+    esp_err_t err = transfer(nullptr, 0, data, count * 5, 1000);
     if (err != ESP_OK) {
         logger->error("Error {} reading {} measurements in readData(): {}", err, count, esp_err_to_name(err));
         return false;
@@ -207,6 +203,20 @@ bool Esp32I2cService::readMeasures()
         }
     }
     isMeasured = !isPartial; // if we got partial data, just throw away the whole and retry getting
+    if (isMeasured) {
+        if (temp != 99999) {
+            TimeSeries::add(tempSeries, temp);
+        }
+        if (humidity != 99999) {
+            TimeSeries::add(humiditySeries, humidity);
+        }
+        if (batteryPct != 99999) {
+            TimeSeries::add(batterySeries, batteryPct);
+        }
+        if (rssi != 99999) {
+            TimeSeries::add(rssiSeries, rssi);
+        }
+    }
     return true;
 }
 
@@ -240,8 +250,8 @@ void Esp32I2cService::initDfa()
 
             if (input.is(Dfa::Input::ENTER_STATE, Dfa::Input::TIMEOUT)) {
                 if (!isI2cRetrieved) {
-                    bool rc = system->getIdf(i2cPort);
-                    if (!rc) {
+                    bus = system->getI2cBus(i2cPort);
+                    if (bus == nullptr) {
                         logger->error("Cannot retrieve i2c port {} in IDF form from System service", (int)(i2cPort));
                         return dfa->transitionTo(COMM_DISABLED);
                     }
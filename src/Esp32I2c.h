@@ -13,6 +13,7 @@
 #include "Dfa.h"
 #include "SystemService.h"
 #include <driver/i2c.h>
+#include "I2cBus.h"
 #include <NimBLEAddress.h>
 
 /***********************
@@ -113,6 +114,8 @@ private:
     bool isEnabled;
     i2c_port_t i2cPort;
     int i2cAddress;
+    I2cBus *bus;
+    I2cBus::Transaction tx;
     NimBLEAddress bleAddress;
     int measurementPeriodSecs;
     int32_t remoteBleScanDuration;
@@ -125,10 +128,16 @@ private:
     int batteryVoltage;
     int rssi;
     bool isMeasured;
+    // one measure per measurement period, so no minute tier
+    TimeSeries::Metric *tempSeries;
+    TimeSeries::Metric *humiditySeries;
+    TimeSeries::Metric *batterySeries;
+    TimeSeries::Metric *rssiSeries;
     // don't change this while we're IDLE and waiting for nextMeasurementTime, because this depends on the deep sleep time of remote esp32
     long nextMeasurementTime;
 
     void clearMeasures();
+    esp_err_t transfer(const uint8_t *writeData, size_t writeLen, uint8_t *readData, size_t readLen, int timeoutMillis);
     bool writeParams(int32_t scanDurationMillis, int32_t sleepDurationSecs, bool doNewScan);
     bool readVersion();
     bool writeInitData();
@@ -0,0 +1,245 @@
+#include "I2cBus.h"
+
+void i2cBusTaskFn(void *arg)
+{
+    ((I2cBus *)arg)->taskRun();
+}
+
+I2cBus::Transaction::~Transaction()
+{
+    if (doneSem != nullptr) {
+        vSemaphoreDelete(doneSem);
+    }
+}
+
+I2cBus::I2cBus()
+{
+    port = (i2c_port_t)-1;
+    eventLoop = nullptr;
+    doneEventType = -1;
+    task = nullptr;
+    stoppedSem = nullptr;
+    isStopping = false;
+    queueMux = portMUX_INITIALIZER_UNLOCKED;
+    for (int i = 0; i < PRIORITY_COUNT; i++) {
+        queueHead[i] = nullptr;
+        queueTail[i] = nullptr;
+    }
+    resetStats();
+}
+
+I2cBus::~I2cBus()
+{
+    stop();
+    if (stoppedSem != nullptr) {
+        vSemaphoreDelete(stoppedSem);
+    }
+}
+
+bool I2cBus::start(i2c_port_t port, UEventLoop *eventLoop)
+{
+    if (task != nullptr) {
+        return true;
+    }
+    this->port = port;
+    this->eventLoop = eventLoop;
+    doneEventType = eventLoop->getEventType("i2c", "done");
+    if (stoppedSem == nullptr) {
+        stoppedSem = xSemaphoreCreateBinary();
+    }
+    isStopping = false;
+    // above the event loops, so that a transaction runs as soon as it is submitted
+    BaseType_t rc = xTaskCreate(i2cBusTaskFn, port == I2C_NUM_0 ? "I2cBus0" : "I2cBus1", 3072, this,
+        uxTaskPriorityGet(nullptr) + 2, &task);
+    if (rc != pdPASS) {
+        task = nullptr;
+        return false;
+    }
+    return true;
+}
+
+void I2cBus::stop()
+{
+    if (task == nullptr) {
+        return;
+    }
+    isStopping = true;
+    xTaskNotifyGive(task);
+    xSemaphoreTake(stoppedSem, portMAX_DELAY);
+    task = nullptr;
+}
+
+bool I2cBus::submit(Transaction *t)
+{
+    return enqueue(t, false);
+}
+
+bool I2cBus::enqueue(Transaction *t, bool isSync)
+{
+    if (task == nullptr || isStopping || t->isPending) {
+        return false;
+    }
+    t->isPending = true;
+    t->isSync = isSync;
+    t->next = nullptr;
+    t->submitTime = esp_timer_get_time();
+    portENTER_CRITICAL(&queueMux);
+    if (queueTail[t->priority] == nullptr) {
+        queueHead[t->priority] = t;
+    } else {
+        queueTail[t->priority]->next = t;
+    }
+    queueTail[t->priority] = t;
+    portEXIT_CRITICAL(&queueMux);
+    xTaskNotifyGive(task);
+    return true;
+}
+
+esp_err_t I2cBus::execute(Transaction *t)
+{
+    if (t->doneSem == nullptr) {
+        t->doneSem = xSemaphoreCreateBinary();
+        if (t->doneSem == nullptr) {
+            return ESP_ERR_NO_MEM;
+        }
+    }
+    if (!enqueue(t, true)) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    xSemaphoreTake(t->doneSem, portMAX_DELAY);
+    return t->result;
+}
+
+I2cBus::Transaction *I2cBus::dequeue()
+{
+    Transaction *t = nullptr;
+    portENTER_CRITICAL(&queueMux);
+    for (int i = 0; i < PRIORITY_COUNT && t == nullptr; i++) {
+        t = queueHead[i];
+        if (t != nullptr) {
+            queueHead[i] = t->next;
+            if (queueHead[i] == nullptr) {
+                queueTail[i] = nullptr;
+            }
+        }
+    }
+    portEXIT_CRITICAL(&queueMux);
+    return t;
+}
+
+esp_err_t I2cBus::run(Transaction *t)
+{
+#ifdef I2C_BUS_STATIC_LINK
+    i2c_cmd_handle_t cmd = i2c_cmd_link_create_static(linkBuf, sizeof(linkBuf));
+#else
+    i2c_cmd_handle_t cmd = i2c_cmd_link_create();
+#endif
+    if (cmd == nullptr) {
+        return ESP_ERR_NO_MEM;
+    }
+    bool isWrite = (t->headerLen > 0 || t->writeLen > 0 || t->readLen == 0);
+    i2c_master_start(cmd);
+    if (isWrite) {
+        i2c_master_write_byte(cmd, (t->address << 1) | I2C_MASTER_WRITE, true);
+        if (t->headerLen > 0) {
+            i2c_master_write(cmd, t->header, t->headerLen, true);
+        }
+        if (t->writeLen > 0) {
+            i2c_master_write(cmd, (uint8_t *)t->writeData, t->writeLen, true);
+        }
+    }
+    if (t->readLen > 0) {
+        if (isWrite) {
+            i2c_master_start(cmd);
+        }
+        i2c_master_write_byte(cmd, (t->address << 1) | I2C_MASTER_READ, true);
+        i2c_master_read(cmd, t->readData, t->readLen, I2C_MASTER_LAST_NACK);
+    }
+    i2c_master_stop(cmd);
+    esp_err_t err = i2c_master_cmd_begin(port, cmd, t->timeoutMillis / portTICK_PERIOD_MS);
+#ifdef I2C_BUS_STATIC_LINK
+    i2c_cmd_link_delete_static(cmd);
+#else
+    i2c_cmd_link_delete(cmd);
+#endif
+    return err;
+}
+
+/**
+ * The transaction stays pending until onDone returned, so that isDone() also means that the
+ * results were handled.
+ */
+void I2cBus::complete(Transaction *t)
+{
+    if (t->isSync) {
+        t->isPending = false;
+        xSemaphoreGive(t->doneSem);
+    } else if (t->onDone && t->eventLoop != nullptr) {
+        // without waiting: the other transactions would wait behind a full event queue; if
+        // the event can't be queued, the finalizer calls onDone at once, in this task
+        t->eventLoop->queueEvent(UEvent(doneEventType, (void *)t), [](UEvent *event) {
+            Transaction *t = (Transaction *)event->dataPtr;
+            t->onDone(t);
+            t->isPending = false;
+        }, nullptr, nullptr, 0);
+    } else {
+        if (t->onDone) {
+            t->onDone(t);
+        }
+        t->isPending = false;
+    }
+}
+
+void I2cBus::taskRun()
+{
+    while (true) {
+        ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+        Transaction *t;
+        while ((t = dequeue()) != nullptr) {
+            if (isStopping) {
+                t->result = ESP_ERR_INVALID_STATE;
+                complete(t);
+                continue;
+            }
+            int64_t start = esp_timer_get_time();
+            t->result = run(t);
+            int64_t end = esp_timer_get_time();
+            auto &s = stats[t->priority];
+            uint32_t wait = start - t->submitTime;
+            uint32_t runTime = end - start;
+            ++s.count;
+            if (t->result != ESP_OK) {
+                ++s.errors;
+            }
+            s.avgWaitMicros = (s.avgWaitMicros * 63 + (wait << 4)) / 64;
+            if (wait > s.maxWaitMicros) {
+                s.maxWaitMicros = wait;
+            }
+            if (runTime > s.maxRunMicros) {
+                s.maxRunMicros = runTime;
+            }
+            complete(t);
+        }
+        if (isStopping) {
+            xSemaphoreGive(stoppedSem);
+            vTaskDelete(nullptr);
+        }
+    }
+}
+
+void I2cBus::getStats(String *msg)
+{
+    static const char *names[PRIORITY_COUNT] = { "critical", "normal", "bulk" };
+    *msg += "Port "; *msg += (int)port; *msg += "\n";
+    for (int i = 0; i < PRIORITY_COUNT; i++) {
+        *msg += names[i]; *msg += ": "; *msg += stats[i].count; *msg += " transactions, ";
+        *msg += stats[i].errors; *msg += " errors, wait avg "; *msg += stats[i].avgWaitMicros >> 4;
+        *msg += " us, max "; *msg += stats[i].maxWaitMicros;
+        *msg += " us, longest run "; *msg += stats[i].maxRunMicros; *msg += " us\n";
+    }
+}
+
+void I2cBus::resetStats()
+{
+    memset(stats, 0, sizeof(stats));
+}
@@ -0,0 +1,121 @@
+#ifndef INCL_I2C_BUS_H
+#define INCL_I2C_BUS_H
+
+#include <Arduino.h>
+#include <driver/i2c.h>
+#include <esp_system.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/semphr.h>
+#include <freertos/task.h>
+#include <functional>
+#include "UEvent.h"
+
+#if defined(ESP_IDF_VERSION_MAJOR) && (ESP_IDF_VERSION_MAJOR > 4 || (ESP_IDF_VERSION_MAJOR == 4 && ESP_IDF_VERSION_MINOR >= 4))
+#define I2C_BUS_STATIC_LINK
+#endif
+
+/**
+ * Transactions on an I2C port, run one at a time by a task of the bus, highest priority
+ * first, in order within a priority.
+ *
+ * A transaction is: start, the device address, header then data written, and, if
+ * something is to be read, a repeated start and the read. With nothing to write, it
+ * is a plain read; with nothing at all, an address probe.
+ *
+ * Transactions are owned by their callers, usually as members, and are not copied: queuing
+ * and completing them allocates nothing. Bulk transfers (EEPROM) should be split in
+ * small transactions, so that a CRITICAL one (protection measures) waits at most for
+ * the end of one of them.
+ *
+ * execute() submits and waits. With submit(), onDone is called when the transaction
+ * completed, in the eventLoop of the transaction, or in the task of the bus if it has none
+ * or if the event queue is full. The transaction is pending until onDone returns: onDone
+ * may submit other transactions, not its own.
+ */
+class I2cBus {
+public:
+    enum Priority {
+        CRITICAL,
+        NORMAL,
+        BULK,
+        PRIORITY_COUNT
+    };
+
+    class Transaction {
+        friend class I2cBus;
+        Transaction *next;
+        int64_t submitTime;
+        SemaphoreHandle_t doneSem; // created by the first execute()
+        volatile bool isPending;
+        bool isSync; // submitted by execute()
+    public:
+        uint8_t address = 0;
+        uint8_t header[4]; // register or memory address
+        uint8_t headerLen = 0;
+        const uint8_t *writeData = nullptr;
+        size_t writeLen = 0;
+        uint8_t *readData = nullptr;
+        size_t readLen = 0;
+        Priority priority = NORMAL;
+        int timeoutMillis = 200;
+        UEventLoop *eventLoop = nullptr;
+        std::function<void(Transaction *t)> onDone;
+        esp_err_t result = ESP_OK;
+
+        Transaction() : next(nullptr), submitTime(0), doneSem(nullptr), isPending(false), isSync(false) { }
+        ~Transaction();
+        bool isDone() { return !isPending; }
+        void setHeader(uint8_t b) { header[0] = b; headerLen = 1; }
+        void setHeader(uint8_t b0, uint8_t b1) { header[0] = b0; header[1] = b1; headerLen = 2; }
+    };
+
+private:
+    i2c_port_t port;
+    UEventLoop *eventLoop;
+    uint32_t doneEventType;
+    TaskHandle_t task;
+    SemaphoreHandle_t stoppedSem;
+    volatile bool isStopping;
+    portMUX_TYPE queueMux;
+    Transaction *queueHead[PRIORITY_COUNT];
+    Transaction *queueTail[PRIORITY_COUNT];
+#ifdef I2C_BUS_STATIC_LINK
+    uint8_t linkBuf[I2C_LINK_RECOMMENDED_SIZE(4)];
+#endif
+
+    // stats, per priority
+    struct {
+        uint32_t count;
+        uint32_t errors;
+        uint32_t avgWaitMicros; // << 4
+        uint32_t maxWaitMicros;
+        uint32_t maxRunMicros;
+    } stats[PRIORITY_COUNT];
+
+    bool enqueue(Transaction *t, bool isSync);
+    Transaction *dequeue();
+    esp_err_t run(Transaction *t);
+    void complete(Transaction *t);
+    void taskRun();
+    friend void i2cBusTaskFn(void *arg);
+
+public:
+    I2cBus();
+    ~I2cBus();
+    // the i2c driver of the port must be installed
+    bool start(i2c_port_t port, UEventLoop *eventLoop);
+    // fails the transactions still queued with ESP_ERR_INVALID_STATE
+    void stop();
+    bool isStarted() { return task != nullptr; }
+    i2c_port_t getPort() { return port; }
+
+    // false if the transaction is still pending or the bus is not started
+    bool submit(Transaction *t);
+    // must not be called from onDone of a transaction without eventLoop
+    esp_err_t execute(Transaction *t);
+
+    void getStats(String *msg);
+    void resetStats();
+};
+
+#endif
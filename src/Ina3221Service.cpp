@@ -11,6 +11,11 @@
 #include "LogMgr.h"
 #include "Ina3221Service.h"
 
+void ina3221CaptureTimerFn(void *arg)
+{
+    ((Ina3221Service *)arg)->captureTick();
+}
+
 void Ina3221Service::init(UEventLoop *eventLoop, CommandMgr *commandMgr, LogMgr *logMgr, SystemService *systemService)
 {
     this->eventLoop = eventLoop;
@@ -29,6 +34,12 @@ void Ina3221Service::init(UEventLoop *eventLoop, CommandMgr *commandMgr, LogMgr
     currentReg = 128; // a non-existent reg, uint_8
     lastError.clear();
     loggingIntervalMillis = 1000;
+    for (int i = 0; i < 3; i++) {
+        voltageSeries[i] = nullptr;
+        currentSeries[i] = nullptr;
+    }
+    alertPin = -1;
+    captureIntervalMicros = 1000;
     timer.init(eventLoop, [this](UEventLoopTimer *t) {
         if (!isEnabled) {
             return;
@@ -60,14 +71,44 @@ void Ina3221Service::init(UEventLoop *eventLoop, CommandMgr *commandMgr, LogMgr
     }
 
     // init data structures
-    this->cmd = nullptr;
+    bus = nullptr;
+    tx.address = i2cAddress;
+    tx.priority = I2cBus::CRITICAL;
+
+    captureChannel = 0;
+    captureBusy = false;
+    captureProtectPin = -1;
+    captureMux = portMUX_INITIALIZER_UNLOCKED;
+    captureHead = 0;
+    captureTail = 0;
+    captureAlerts = 0;
+    captureSamples = 0;
+    captureOverruns = 0;
+    captureMissed = 0;
+    captureErrors = 0;
+    for (int i = 0; i < 2; i++) {
+        captureTx[i].address = i2cAddress;
+        captureTx[i].priority = I2cBus::CRITICAL;
+        captureTx[i].readData = captureData[i];
+        captureTx[i].readLen = 2;
+        captureTx[i].timeoutMillis = 20;
+        captureTx[i].onDone = [this](I2cBus::Transaction *t) { captureRead(t); };
+    }
+    esp_timer_create_args_t timerArgs = { };
+    timerArgs.callback = ina3221CaptureTimerFn;
+    timerArgs.arg = this;
+    timerArgs.name = "Ina3221Capture";
+    esp_timer_create(&timerArgs, &captureTimer);
+    if (alertPin >= 0) {
+        pinMode(alertPin, INPUT_PULLUP); // open drain, active low
+    }
 
     if (!isEnabled) {
         i2cPort = (i2c_port_t)-1;
         lastError = "Not enabled";
     } else {
-        rc = systemService->getIdf(i2cPort);
-        if (!rc) {
+        bus = systemService->getI2cBus(i2cPort);
+        if (bus == nullptr) {
             logger->error("Error getting get the i2c driver, the service will not work");
             i2cPort = (i2c_port_t)-1;
             lastError = "Couldn't get driver";
@@ -88,6 +129,16 @@ void Ina3221Service::init(UEventLoop *eventLoop, CommandMgr *commandMgr, LogMgr
                 hwOk = false;
             }
         }
+        if (hwOk) {
+            TimeSeries *timeSeries = systemService->getTimeSeries();
+            for (int i = 0; i < 3; i++) {
+                if (channelEnabled[i]) {
+                    String name = String("ina3221.ch") + (i + 1);
+                    voltageSeries[i] = timeSeries->addMetric((name + ".voltage").c_str(), "mV", 32, 60, 24);
+                    currentSeries[i] = timeSeries->addMetric((name + ".current").c_str(), "mA", 32, 60, 24);
+                }
+            }
+        }
         if (hwOk && loggingIntervalMillis >= 10) {
             timer.setInterval(loggingIntervalMillis);
         }
@@ -117,59 +168,50 @@ bool Ina3221Service::setupDeviceNormal()
     return ok;
 }
 
-bool Ina3221Service::setupDeviceCheckOvercurrent(int channel)
+bool Ina3221Service::setupDeviceCapture(int channel, int criticalMilliamps)
 {
     if (!isEnabled) {
         return false;
     }
     int chEn =
-        (channel == 1 ? 0b100 : 0)
-        | (channel == 2 ? 0b010 : 0)
-        | (channel == 3 ? 0b001 : 0);
+        (channelEnabled[0] ? 0b100 : 0)
+        | (channelEnabled[1] ? 0b010 : 0)
+        | (channelEnabled[2] ? 0b001 : 0);
 
-    bool ok = writeRegister(0x00,
+    // limit in shunt voltage, 40 uV units in bits 15..3, compared with each conversion
+    int limit = 0xFFF;
+    if (criticalMilliamps > 0 && criticalMilliamps * shuntResistance[channel - 1] / 40 < limit) {
+        limit = criticalMilliamps * shuntResistance[channel - 1] / 40;
+    }
+    bool ok =
+        writeRegister(0x07 + (channel - 1) * 2, limit << 3)
+        && writeRegister(0x00,
             (0 << 15) // not reset
             | (chEn << 12) // enable chosen channels
             | (0b000 << 9) // averaging 1
-            | (0b000 << 6) // bus voltage time 140us (but won't be used, as we'll set mode shunt only)
-            | (0b010 << 3) // shunt voltage time 333us
-            | (0b101 << 0) // mode shunt continuous
+            | (0b000 << 6) // bus voltage time 140us
+            | (0b000 << 3) // shunt voltage time 140us
+            | (0b111 << 0) // mode shunt and bus continuous
         );
     return ok;
 }
 
-bool Ina3221Service::setModeOvercurrent(int channel)
-{
-    return setupDeviceCheckOvercurrent(channel);
-}
-
-bool Ina3221Service::setModeNormal()
-{
-    return setupDeviceNormal();
-}
-
 bool Ina3221Service::readRegister(uint8_t reg, uint16_t *value)
 {
-    if (cmd != nullptr) {
-        i2c_cmd_link_delete(cmd);
-        cmd = nullptr;
-    }
-    cmd = i2c_cmd_link_create();
-    i2c_master_start(cmd);
-    if (currentReg != reg) { // set register pointer
-        i2c_master_write_byte(cmd, (i2cAddress << 1) | 0x0 /* write */, true);
-        i2c_master_write_byte(cmd, reg, true);
-        i2c_master_start(cmd);
-    }
-    i2c_master_write_byte(cmd, (i2cAddress << 1) | 0x1 /* read */, true);
-    uint8_t data[2];
-    i2c_master_read(cmd, data, 2, i2c_ack_type_t::I2C_MASTER_LAST_NACK);
-    i2c_master_stop(cmd);
-    esp_err_t err = i2c_master_cmd_begin(i2cPort, cmd, 200 / portTICK_PERIOD_MS);
-    // delete cmd lazily, above
+    if (bus == nullptr) {
+        return false;
+    }
+    tx.headerLen = 0;
+    if (currentReg != reg || captureChannel != 0) { // set register pointer, captures move it
+        tx.setHeader(reg);
+    }
+    tx.writeLen = 0;
+    tx.readData = rxData;
+    tx.readLen = 2;
+    esp_err_t err = bus->execute(&tx);
 
     if (err == ESP_OK) {
-        *value = data[1] + (data[0] << 8);
+        *value = rxData[1] + (rxData[0] << 8);
         lastError.clear();
         currentReg = reg;
         return true;
@@ -182,19 +224,16 @@ bool Ina3221Service::readRegister(uint8_t reg, uint16_t *value)
 
 bool Ina3221Service::writeRegister(uint8_t reg, uint16_t value)
 {
-    i2c_cmd_handle_t cmd = i2c_cmd_link_create();
-    i2c_master_start(cmd);
-    if (currentReg != reg) { // set register pointer
-        i2c_master_write_byte(cmd, (i2cAddress << 1) | 0x0 /* write */, true);
-        i2c_master_write_byte(cmd, reg, true);
-        i2c_master_start(cmd);
-    }
-    i2c_master_write_byte(cmd, (i2cAddress << 1) | 0x0 /* write */, true);
-    i2c_master_write_byte(cmd, (uint8_t)(value & 0xFF), true);
-    i2c_master_write_byte(cmd, (uint8_t)(value >> 8), true);
-    i2c_master_stop(cmd);
-    esp_err_t err = i2c_master_cmd_begin(i2cPort, cmd, 200 / portTICK_PERIOD_MS);
-    i2c_cmd_link_delete(cmd);
+    if (bus == nullptr) {
+        return false;
+    }
+    tx.setHeader(reg);
+    txData[0] = value >> 8;
+    txData[1] = value & 0xFF;
+    tx.writeData = txData;
+    tx.writeLen = 2;
+    tx.readLen = 0;
+    esp_err_t err = bus->execute(&tx);
 
     if (err == ESP_OK) {
         lastError.clear();
@@ -272,6 +311,46 @@ void Ina3221Service::initCommands(ServiceCommands *cmd)
         })
     );
 
+    cmd->registerIntData(
+        ServiceCommands::IntDataBuilder("alertPin", true)
+        .cmd("alertPin")
+        .help("--> Pin connected to the critical alert output, -1 if none - requires reboot")
+        .vMin(-1)
+        .vMax(39)
+        .ptr(&alertPin)
+    );
+
+    cmd->registerIntData(
+        ServiceCommands::IntDataBuilder("captureInterval", true)
+        .cmd("captureInterval")
+        .help("--> Interval in microseconds between samples in capture mode, minimum 300")
+        .vMin(300)
+        .ptr(&captureIntervalMicros)
+    );
+
+    cmd->registerStringData(
+        ServiceCommands::StringDataBuilder("captureStats", true)
+        .cmd("captureStats")
+        .help("captureStats [reset] --> Samples of the capture mode: captured, lost, missed, errors")
+        .isPersistent(false)
+        .includeInStatus(false)
+        .setFn([this](const String &val, bool isLoading, String *msg) -> bool {
+            if (val == "reset") {
+                captureSamples = 0;
+                captureOverruns = 0;
+                captureMissed = 0;
+                captureErrors = 0;
+                *msg = "Capture statistics reset";
+            } else {
+                getCaptureStats(msg);
+            }
+            return true;
+        })
+        .getFn([this](String *val) {
+            getCaptureStats(val);
+        })
+    );
+
     cmd->registerStringData(
         ServiceCommands::StringDataBuilder("reg", true)
         .cmd("reg")
@@ -419,11 +498,153 @@ bool Ina3221Service::readChannelData(int channel, int *voltage, int *current)
     if (rc) {
         *voltage = v;
         *current = i;
+        TimeSeries::add(voltageSeries[channel - 1], v);
+        TimeSeries::add(currentSeries[channel - 1], i);
         return true;
     } else {
         return false;
     }
 }
 
+bool Ina3221Service::startCapture(int channel, int criticalMilliamps, int protectPin)
+{
+    if (!isEnabled || bus == nullptr || channel < 1 || channel > 3 || !channelEnabled[channel - 1]
+            || captureChannel != 0) {
+        return false;
+    }
+    if (!setupDeviceCapture(channel, criticalMilliamps)) {
+        return false;
+    }
+    captureTx[0].setHeader((channel - 1) * 2 + 1);
+    captureTx[1].setHeader((channel - 1) * 2 + 2);
+    captureHead = 0;
+    captureTail = 0;
+    captureAlerts = 0;
+    captureProtectPin = protectPin;
+    if (alertPin >= 0) {
+        attachInterruptArg(digitalPinToInterrupt(alertPin), alertIsr, this, FALLING);
+    }
+    captureChannel = channel;
+    esp_timer_start_periodic(captureTimer, captureIntervalMicros);
+    logger->debug("Capture of channel {} every {} us, critical alert at {} mA", channel, captureIntervalMicros,
+        criticalMilliamps);
+    return true;
+}
+
+void Ina3221Service::stopCapture()
+{
+    if (captureChannel == 0) {
+        return;
+    }
+    int channel = captureChannel;
+    portENTER_CRITICAL(&captureMux);
+    captureChannel = 0;
+    portEXIT_CRITICAL(&captureMux);
+    esp_timer_stop(captureTimer);
+    while (captureBusy) {
+        vTaskDelay(1);
+    }
+    if (alertPin >= 0) {
+        detachInterrupt(alertPin);
+    }
+    writeRegister(0x07 + (channel - 1) * 2, 0x7FF8); // critical alert limit at its reset value
+    setupDeviceNormal();
+}
+
+// in the esp_timer task
+void Ina3221Service::captureTick()
+{
+    portENTER_CRITICAL(&captureMux);
+    bool isStarting = (captureChannel != 0 && !captureBusy);
+    bool isMissed = (captureChannel != 0 && captureBusy);
+    if (isStarting) {
+        captureBusy = true;
+    }
+    portEXIT_CRITICAL(&captureMux);
+    if (isMissed) {
+        ++captureMissed;
+    }
+    if (isStarting && !bus->submit(&captureTx[0])) {
+        ++captureErrors;
+        captureBusy = false;
+    }
+}
+
+// in the task of the bus
+void Ina3221Service::captureRead(I2cBus::Transaction *t)
+{
+    if (t->result != ESP_OK) {
+        ++captureErrors;
+        captureBusy = false;
+        return;
+    }
+    if (t == &captureTx[0]) {
+        if (!bus->submit(&captureTx[1])) {
+            ++captureErrors;
+            captureBusy = false;
+        }
+        return;
+    }
+    int channel = captureChannel;
+    if (channel != 0) {
+        CaptureSample sample;
+        sample.tsMicros = esp_timer_get_time();
+        int16_t shunt = (captureData[0][0] << 8) | captureData[0][1];
+        int16_t busVoltage = (captureData[1][0] << 8) | captureData[1][1];
+        sample.current = (shunt / 8) * 40 / shuntResistance[channel - 1];
+        sample.voltage = (busVoltage / 8) * 8;
+        uint32_t head = captureHead.load(std::memory_order_relaxed);
+        if (head - captureTail.load(std::memory_order_acquire) >= CAPTURE_RING_SIZE) {
+            ++captureOverruns;
+        } else {
+            captureRing[head % CAPTURE_RING_SIZE] = sample;
+            captureHead.store(head + 1, std::memory_order_release);
+            ++captureSamples;
+        }
+    }
+    captureBusy = false;
+}
+
+int Ina3221Service::readCapture(CaptureSample *samples, int maxCount)
+{
+    uint32_t tail = captureTail.load(std::memory_order_relaxed);
+    uint32_t head = captureHead.load(std::memory_order_acquire);
+    int n = 0;
+    while (tail != head && n < maxCount) {
+        samples[n++] = captureRing[tail % CAPTURE_RING_SIZE];
+        ++tail;
+    }
+    captureTail.store(tail, std::memory_order_release);
+    int ch = captureChannel - 1;
+    if (ch >= 0) {
+        for (int i = 0; i < n; i++) {
+            TimeSeries::add(voltageSeries[ch], samples[i].tsMicros / 1000, samples[i].voltage);
+            TimeSeries::add(currentSeries[ch], samples[i].tsMicros / 1000, samples[i].current);
+        }
+    }
+    return n;
+}
+
+void IRAM_ATTR Ina3221Service::alertIsr(void *arg)
+{
+    Ina3221Service *ina = (Ina3221Service *)arg;
+    if (ina->captureProtectPin >= 0) {
+        digitalWrite(ina->captureProtectPin, LOW);
+    }
+    ++ina->captureAlerts;
+}
+
+void Ina3221Service::getCaptureStats(String *msg)
+{
+    *msg += "Capture: "; *msg += (captureChannel != 0 ? "channel " : "stopped");
+    if (captureChannel != 0) {
+        *msg += captureChannel;
+    }
+    *msg += ", interval "; *msg += captureIntervalMicros; *msg += " us\n";
+    *msg += "Samples: "; *msg += captureSamples; *msg += ", lost (ring full): "; *msg += captureOverruns;
+    *msg += ", missed intervals: "; *msg += captureMissed; *msg += ", errors: "; *msg += captureErrors;
+    *msg += ", critical alerts: "; *msg += captureAlerts; *msg += "\n";
+}
+
 #endif
 
@@ -7,16 +7,27 @@
 #include <HardwareSerial.h>
 #include <SPIFFS.h>
 #include <ArduinoJson.h>
+#include <atomic>
+#include <esp_timer.h>
 #include "UEvent.h"
 #include "CommandMgr.h"
 #include "LogMgr.h"
 #include "Dfa.h"
 #include "SystemService.h"
+#include "I2cBus.h"
 
 class Ina3221Service {
 public:
+    struct CaptureSample {
+        int64_t tsMicros; // esp_timer_get_time() when read
+        int voltage; // mV
+        int current; // mA
+    };
+
     void init(UEventLoop *eventLoop, CommandMgr *commandMgr, LogMgr *logMgr, SystemService *systemService);
 private:
+    static const int CAPTURE_RING_SIZE = 128; // power of 2
+
     UEventLoop *eventLoop;
     CommandMgr *commandMgr;
     Logger *logger;
@@ -30,21 +41,69 @@ private:
     String lastError;
     int loggingIntervalMillis;
     UEventLoopTimer timer;
+    // time series of the enabled channels, fed by all reads, including the capture
+    TimeSeries::Metric *voltageSeries[3];
+    TimeSeries::Metric *currentSeries[3];
 
-    i2c_cmd_handle_t cmd; // used for i2c communication, deleted lazily to save some time
+    I2cBus *bus;
+    I2cBus::Transaction tx; // critical: measures are used for protection
+    uint8_t txData[2];
+    uint8_t rxData[2];
+
+    // capture: a timer submits the read of the shunt register of the channel, the read of the
+    // bus register follows, and the bus task puts the sample in the ring, read by one consumer
+    int alertPin; // critical alert output of the INA3221, -1 if not connected
+    int captureIntervalMicros;
+    volatile int captureChannel; // 1..3, 0 if not capturing
+    volatile bool captureBusy; // reads of a sample in progress
+    volatile int captureProtectPin;
+    portMUX_TYPE captureMux;
+    esp_timer_handle_t captureTimer;
+    I2cBus::Transaction captureTx[2]; // shunt voltage, bus voltage
+    uint8_t captureData[2][2];
+    CaptureSample captureRing[CAPTURE_RING_SIZE];
+    std::atomic<uint32_t> captureHead; // written by the bus task
+    std::atomic<uint32_t> captureTail; // written by the consumer
+    volatile uint32_t captureAlerts;
+    // stats
+    uint32_t captureSamples;
+    uint32_t captureOverruns; // ring full, sample lost
+    uint32_t captureMissed; // timer ticks while the previous sample was still being read
+    uint32_t captureErrors;
 
     void initCommands(ServiceCommands *cmd);
     bool setupDeviceNormal();
-    // channel: 1..3; sets up for checking current on channel as quickly as possible
-    bool setupDeviceCheckOvercurrent(int channel);
+    // channel: 1..3; all enabled channels converted continuously at the shortest conversion time,
+    // critical alert of channel at criticalMilliamps (none if 0)
+    bool setupDeviceCapture(int channel, int criticalMilliamps);
+    void captureTick();
+    void captureRead(I2cBus::Transaction *t);
+    static void IRAM_ATTR alertIsr(void *arg);
+    friend void ina3221CaptureTimerFn(void *arg);
+    void getCaptureStats(String *msg);
     bool identify();
     bool readRegister(uint8_t register, uint16_t *value);
     bool writeRegister(uint8_t register, uint16_t value);
 public:
     // millivolts and milliamps
     bool readChannelData(int channel, int *voltage, int *current);
-    bool setModeOvercurrent(int channel);
-    bool setModeNormal();
+
+    /**
+     * Samples channel every captureInterval microseconds into a ring buffer, without blocking
+     * the caller, until stopCapture(). The other enabled channels stay readable with
+     * readChannelData().
+     *
+     * With an alert pin, the INA3221 compares each conversion of channel with criticalMilliamps,
+     * and the interrupt of the pin sets protectPin LOW right away (if not -1), without
+     * waiting for the consumer of the samples.
+     */
+    bool startCapture(int channel, int criticalMilliamps, int protectPin);
+    void stopCapture();
+    bool isCapturing() { return captureChannel != 0; }
+    // the samples captured since the last call, oldest first; to be called by one consumer only
+    int readCapture(CaptureSample *samples, int maxCount);
+    // critical alerts since startCapture()
+    uint32_t getCaptureAlerts() { return captureAlerts; }
 };
 
 #endif
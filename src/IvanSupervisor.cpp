@@ -115,6 +115,8 @@ void IvanSupervisorService::init(UEventLoop *eventLoop, CommandMgr *commandMgr,
 #endif
 
     eepromFs = eepromFsService->getFs(); // eepromFs can be null, if eeprom fs not initialized
+    kvStore = eepromFsService->getKvStore(); // same
+    importPersistentData();
 
     ServiceCommands *cmd = commandMgr->getServiceCommands("supervisor");
     initDfa();
@@ -145,6 +147,9 @@ void IvanSupervisorService::init(UEventLoop *eventLoop, CommandMgr *commandMgr,
     telemetryUploadSize = 1200;
     telemetryClearSize = 3600;
     telemetryMinPeriodSecs = 24 * 3600;
+    telemetryFormat = "json";
+    telemetryCommitRecords = 16;
+    telemetryCommitSecs = 60;
     isTelemetryInProcess = false;
 
     isLoadLaunched = false;
@@ -162,6 +167,13 @@ void IvanSupervisorService::init(UEventLoop *eventLoop, CommandMgr *commandMgr,
     smsCmd.commandsExecutedCount = 0;
 
     persistentFile.openForWrite("/persistent.txt", eepromFs, 1000);
+    telemetryLog.init(eventLoop, logger, eepromFs, "/telemetry.log");
+    telemetryLog.setCommitPolicy(telemetryCommitRecords, telemetryCommitSecs);
+    telemetryLog.setSizeLimit(telemetryClearSize);
+    telemetryLog.onDrop([this](const TelemetryLog::DropInfo &info) {
+        logger->warn("Telemetry log full, dropped {} records ({} to {})", info.records, info.firstTs, info.lastTs);
+    });
+    importTelemetryText();
 
     // init data structures
 
@@ -290,6 +302,34 @@ void IvanSupervisorService::telemetry(const char *recordType,
         dataType4, data4, dataType5, data5, dataType6, data6, dataType7, data7, dataType8, data8, dataType9, data9, dataType10, data10);
 }
 
+/**
+ * Protection events and shutdown records are written at once, as power may go away
+ * right after them. Other records are written in groups.
+ */
+static bool isImmediateTelemetry(const char *recordType)
+{
+    return recordType[0] == 'P'
+        || strcmp(recordType, TELEMETRY_SHUTDOWN) == 0
+        || strcmp(recordType, TELEMETRY_SHUTDOWN_MANUALLY) == 0
+        || strcmp(recordType, TELEMETRY_SHUTDOWN_NOT_PERFORMED) == 0;
+}
+
+void IvanSupervisorService::telemetryToJson(const char *recordType, uint32_t ts,
+        const char * const *dataTypes, const char * const *data, int count, String *json)
+{
+    DynamicJsonBuffer buf;
+    JsonObject &o = buf.createObject();
+    o["type"] = recordType;
+    o["ts"] = ts;
+    // we can use data to construct the object, even though data won't be copied
+    // into the JsonBuffer, because we'll print out the constructed object and discard
+    // the JsonBuffer before data goes out of scope.
+    for (int i = 0; i < count && dataTypes[i] != nullptr; i++) {
+        o[dataTypes[i]] = data[i];
+    }
+    o.printTo(*json);
+}
+
 void IvanSupervisorService::doTelemetry(bool isPersistent, const char *recordType,
         const char *dataType1, const char *data1, const char *dataType2, const char *data2,
         const char *dataType3, const char *data3, const char *dataType4, const char *data4,
@@ -299,66 +339,66 @@ void IvanSupervisorService::doTelemetry(bool isPersistent, const char *recordTyp
 {
     time_t ts = time(nullptr);
 
-    DynamicJsonBuffer buf;
-    JsonObject &o = buf.createObject();
-    o["type"] = recordType;
-    o["ts"] = ts;
-    // we can use data<n> to construct the object, even though data won't be copied
-    // into the JsonBuffer, because we'll print out the constructed object and discard
-    // the JsonBuffer before data<n> go out of scope.
-    if (dataType1 != nullptr) {
-        o[dataType1] = data1;
-    }
-    if (dataType2 != nullptr) {
-        o[dataType2] = data2;
-    }
-    if (dataType3 != nullptr) {
-        o[dataType3] = data3;
-    }
-    if (dataType4 != nullptr) {
-        o[dataType4] = data4;
-    }
-    if (dataType5 != nullptr) {
-        o[dataType5] = data5;
-    }
-    if (dataType6 != nullptr) {
-        o[dataType6] = data6;
-    }
-    if (dataType7 != nullptr) {
-        o[dataType7] = data7;
-    }
-    if (dataType8 != nullptr) {
-        o[dataType8] = data8;
-    }
-    if (dataType9 != nullptr) {
-        o[dataType9] = data9;
-    }
-    if (dataType10 != nullptr) {
-        o[dataType10] = data10;
-    }
-    size_t len = o.measureLength();
-    char msgBuf[len + 1];
-    o.printTo(msgBuf, sizeof(msgBuf));
+    const char *dataTypes[] = { dataType1, dataType2, dataType3, dataType4, dataType5,
+        dataType6, dataType7, dataType8, dataType9, dataType10 };
+    const char *data[] = { data1, data2, data3, data4, data5,
+        data6, data7, data8, data9, data10 };
+    static_assert(sizeof(dataTypes) / sizeof(dataTypes[0]) == TelemetryLog::MAX_FIELDS, "one field per dataType");
 
     if (eepromFs == nullptr) {
         return;
     }
+    String msg;
+    telemetryToJson(recordType, ts, dataTypes, data, TelemetryLog::MAX_FIELDS, &msg);
     logger->info("Telemetry {} {} {}", recordType,
-        (uint32_t)ts, msgBuf);
+        (uint32_t)ts, msg.c_str());
 
-    File logFile = eepromFs->open("/telemetry.txt", "a+");
-    if (logFile) {
-        logFile.println(msgBuf);
-        logFile.flush();
-        logFile.close();
-    }
+    telemetryLog.append(recordType, ts, dataTypes, data, isPersistent || isImmediateTelemetry(recordType));
 
     if (isPersistent) {
-        persistentFile.println(msgBuf);
+        persistentFile.println(msg);
         persistentFile.terminateRecord();
     }
 }
 
+/**
+ * Moves the records of the JSON lines file used before the telemetry log into the log.
+ */
+void IvanSupervisorService::importTelemetryText()
+{
+    if (eepromFs == nullptr || !eepromFs->exists("/telemetry.txt")) {
+        return;
+    }
+    File f = eepromFs->open("/telemetry.txt", "r");
+    int count = 0;
+    while (f && f.available()) {
+        String line = f.readStringUntil('\n');
+        DynamicJsonBuffer buf;
+        JsonObject &o = buf.parseObject(line);
+        if (!o.success() || !o["type"].is<const char *>()) {
+            continue;
+        }
+        const char *dataTypes[TelemetryLog::MAX_FIELDS + 1] = { nullptr };
+        const char *data[TelemetryLog::MAX_FIELDS + 1] = { nullptr };
+        int n = 0;
+        for (auto kv : o) {
+            if (n < TelemetryLog::MAX_FIELDS && strcmp(kv.key, "type") != 0 && strcmp(kv.key, "ts") != 0) {
+                dataTypes[n] = kv.key;
+                data[n] = kv.value.as<const char *>();
+                ++n;
+            }
+        }
+        telemetryLog.append(o["type"].as<const char *>(), o["ts"].as<uint32_t>(), dataTypes, data, false);
+        ++count;
+    }
+    if (f) {
+        f.close();
+    }
+    telemetryLog.commit();
+    eepromFs->remove("/telemetry.txt");
+    logger->info("Imported {} records from /telemetry.txt into the telemetry log", count);
+}
+
 void IvanSupervisorService::telemetryAndPersistent(const char *recordType, const char *dataType, int32_t data)
 {
     doTelemetry(true, recordType, dataType, String(data).c_str());
@@ -386,120 +426,111 @@ bool IvanSupervisorService::initiateTelemetryUpload()
     if (eepromFs == nullptr) {
         return false;
     }
-    File logFile = eepromFs->open("/telemetry.txt", "a+");
-    if (!logFile) {
-        return false;
-    }
-    size_t size = logFile.size();
-    logFile.close();
-    if (size == 0) {
+    if (isTelemetryInProcess) {
         return false;
     }
-    if (isTelemetryInProcess) {
+    telemetryLog.commit();
+    // records committed while uploading are numbered from uploadEndSeq, and are kept; not an
+    // offset: the file is rewritten if the size limit drops records meanwhile
+    size_t uploadSize = telemetryLog.getCommittedSize();
+    uint32_t uploadEndSeq = telemetryLog.getEndSeq();
+    if (uploadSize == 0) {
         return false;
     }
     isTelemetryInProcess = true;
 
-    bool rc;
-    eepromFs->remove("/telemetry.sending.txt");
-    eepromFs->rename("/telemetry.txt", "/telemetry.sending.txt");
-    if (this->isTelemetryEnabled) {
-        // upload telemetry file
-        logger->info("Telemetry uploading {} bytes", size);
-        char *buf = new char[size + 1];
-        File f = eepromFs->open("/telemetry.sending.txt", "a+");
-        f.readBytes(buf, size);
-        f.close();
-        buf[size] = '\0';
-        // if we end up clearing the data without sending it, we'd like to know
-        // the number of lines, first and last timestamps, and number of
-        // lines indicating wakeup (TELEMETRY_START).
-        struct ClearedInfo {
-            int bufLines = 0;
-            int bufTelemetryStartCount = 0;
-            int bufFirstTs = 0; // timestamp
-            int bufLastTs = 0; // timestamp
-        } clearedInfo;
-        char *ptr = buf;
-        DynamicJsonBuffer jsonBuf;
-        String record;
-        do {
-            char *next = strstr("\n", ptr);
-            if (next == nullptr) { // we're done (records are always terminated by '\n')
-                break;
-            }
-            ++clearedInfo.bufLines;
-            record.clear();
-            // terminate current record with '\0', copy it to a string, then restore it
-            char c = *next;
-            *next = '\0';
-            record.concat(ptr);
-            *next = c;
-            JsonObject &jsonRecord = jsonBuf.parseObject(record);
-            if (jsonRecord.success()) {
-                const char *type = jsonRecord["type"].as<char *>();
-                if (type != nullptr && strcmp(type, TELEMETRY_START)) {
-                    ++clearedInfo.bufTelemetryStartCount;
-                }
-                if (jsonRecord.containsKey("ts")) {
-                    int ts = jsonRecord["ts"].as<int>();
-                    if (clearedInfo.bufFirstTs == 0 || ts < clearedInfo.bufFirstTs) {
-                        clearedInfo.bufFirstTs = ts;
-                    }
-                    if (clearedInfo.bufLastTs == 0 || ts < clearedInfo.bufLastTs) {
-                        clearedInfo.bufLastTs = ts;
-                    }
+    // if we end up clearing the data without sending it, we'd like to know
+    // the number of lines, first and last timestamps, and number of
+    // lines indicating wakeup (TELEMETRY_START).
+    struct ClearedInfo {
+        int bufLines = 0;
+        int bufTelemetryStartCount = 0;
+        uint32_t bufFirstTs = 0; // timestamp
+        uint32_t bufLastTs = 0; // timestamp
+    } clearedInfo;
+
+    // uploaded as JSON lines, or in compact form, see TelemetryCodec.h
+    bool isCompact = telemetryFormat == "compact";
+    String *text = new String();
+    std::vector<uint8_t> encoded;
+    TelemetryEncoder encoder(encoded);
+    if (isCompact) {
+        encoded.reserve(uploadSize);
+    } else {
+        text->reserve(uploadSize * 2);
+    }
+    telemetryLog.forEach(0, uploadSize, [text, isCompact, &encoder, &clearedInfo](const TelemetryLog::Record &rec, size_t offset) {
+        if (isCompact) {
+            encoder.beginRecord(rec.type, rec.ts, rec.fieldCount);
+            for (int i = 0; i < rec.fieldCount; i++) {
+                const TelemetryLog::Field &field = rec.fields[i];
+                if (field.isInt) {
+                    encoder.addInt(field.key, field.intValue);
+                } else {
+                    encoder.addString(field.key, field.strValue, strlen(field.strValue));
                 }
             }
-        } while (true);
+        } else {
+            const char *dataTypes[TelemetryLog::MAX_FIELDS];
+            const char *data[TelemetryLog::MAX_FIELDS];
+            for (int i = 0; i < rec.fieldCount; i++) {
+                dataTypes[i] = rec.fields[i].key;
+                data[i] = rec.fields[i].strValue;
+            }
+            telemetryToJson(rec.type, rec.ts, dataTypes, data, rec.fieldCount, text);
+            text->concat('\n');
+        }
 
-        logger->debug("Telemetry uploading {} bytes: {}", size, buf);
-        this->sim7000->initiateSendMessage(buf, buf, [this, size, &clearedInfo](void *arg, bool sent, bool confirmed) {
+        ++clearedInfo.bufLines;
+        if (strcmp(rec.type, TELEMETRY_START) == 0) {
+            ++clearedInfo.bufTelemetryStartCount;
+        }
+        if (clearedInfo.bufFirstTs == 0 || rec.ts < clearedInfo.bufFirstTs) {
+            clearedInfo.bufFirstTs = rec.ts;
+        }
+        if (rec.ts > clearedInfo.bufLastTs) {
+            clearedInfo.bufLastTs = rec.ts;
+        }
+        return true;
+    });
+    if (isCompact) {
+        *text = TELEMETRY_CODEC_TEXT_PREFIX;
+        Util::base64Encode(text, (char *)encoded.data(), encoded.size());
+        logger->info("Telemetry encoded {} records in {} bytes", clearedInfo.bufLines, encoded.size());
+        std::vector<uint8_t>().swap(encoded);
+    }
+
+    bool rc;
+    if (this->isTelemetryEnabled) {
+        // upload telemetry
+        logger->info("Telemetry uploading {} records, {} bytes", clearedInfo.bufLines, text->length());
+        logger->debug("Telemetry uploading {} bytes: {}", text->length(), text->c_str());
+        this->sim7000->initiateSendMessage(text->c_str(), text, [this, uploadEndSeq, clearedInfo](void *arg, bool sent, bool confirmed) {
             logger->info("Telemetry uploading sent: {}, confirmed: {}",
                 sent ? "true" : "false",
                 confirmed ? "true" : "false");
-            delete[] (char *)arg;
-
-            // if the size of telemetry data still allows, we'll keep the old non-confirmed (or not sent)
-            // data so that it is sent next time
-            if (!confirmed && size < this->telemetryClearSize) {
-                // we may already have a new telemetry.txt, as new telemetry has come in
-                // append new telementry to old file, then rename
-                bool oldFileDataCopied = false;
-                fs::File newFile = eepromFs->open("/telemetry.txt");
-                if (newFile && size + newFile.size() < this->telemetryClearSize ) { // we ask for the totality to fit in telemetryClearSize
-                    char *buf = new char[newFile.size()];
-                    int read = newFile.readBytes(buf, size);
-                    newFile.close();
-                    if (read > 0) {
-                        fs::File oldFile = eepromFs->open("/telemetry.sending.txt", "a");
-                        oldFile.write((uint8_t *)buf, read);
-                        oldFile.close();
-                        oldFileDataCopied = true;
-                    }
-                }
-                eepromFs->rename("/telemetry.sending.txt", "/telemetry.txt");
-                if (!oldFileDataCopied) {
-                    telemetry(sent ? TELEMETRY_UPLOAD_SENT_NOT_CONFIRMED : TELEMETRY_UPLOAD_NOT_SENT,
-                        TELEMETRY_UPLOAD_GSM_RSSI, String(sim7000->getRssi()).c_str(),
-                        TELEMETRY_UPLOAD_SIM7000_ERROR, sim7000->getError());
-                }
+            delete (String *)arg;
+
+            if (confirmed) {
+                telemetryLog.discardBefore(uploadEndSeq);
+                telemetry(TELEMETRY_UPLOAD_SENT_CONFIRMED);
+            } else if (telemetryLog.getSize() < (size_t)this->telemetryClearSize) {
+                // the size of telemetry data still allows, we keep the non-confirmed (or not sent)
+                // data so that it is sent next time
+                telemetry(sent ? TELEMETRY_UPLOAD_SENT_NOT_CONFIRMED : TELEMETRY_UPLOAD_NOT_SENT,
+                    TELEMETRY_UPLOAD_GSM_RSSI, String(sim7000->getRssi()).c_str(),
+                    TELEMETRY_UPLOAD_SIM7000_ERROR, sim7000->getError());
             } else {
-                eepromFs->remove("/telemetry.sending.txt");
-                if (confirmed) {
-                    telemetry(TELEMETRY_UPLOAD_SENT_CONFIRMED);
-                } else {
-                    // we're about to clear old collected data
-
-                    telemetryAndPersistent(sent ? TELEMETRY_UPLOAD_SENT_NOT_CONFIRMED_CLEARED : TELEMETRY_UPLOAD_NOT_SENT_CLEARED,
-                        TELEMETRY_UPLOAD_GSM_RSSI, String(sim7000->getRssi()).c_str(),
-                        TELEMETRY_UPLOAD_SIM7000_ERROR, sim7000->getError(),
-                        TELEMETRY_CLEARED_LINES, String(clearedInfo.bufLines).c_str(),
-                        TELEMETRY_CLEARED_START_COUNT, String(clearedInfo.bufTelemetryStartCount).c_str(),
-                        TELEMETRY_CLEARED_FIRST_TS, String(clearedInfo.bufFirstTs).c_str(),
-                        TELEMETRY_CLEARED_LAST_TS, String(clearedInfo.bufLastTs).c_str()
-                    );
-                }
+                // we're about to clear old collected data
+                telemetryLog.discardBefore(uploadEndSeq);
+                telemetryAndPersistent(sent ? TELEMETRY_UPLOAD_SENT_NOT_CONFIRMED_CLEARED : TELEMETRY_UPLOAD_NOT_SENT_CLEARED,
+                    TELEMETRY_UPLOAD_GSM_RSSI, String(sim7000->getRssi()).c_str(),
+                    TELEMETRY_UPLOAD_SIM7000_ERROR, sim7000->getError(),
+                    TELEMETRY_CLEARED_LINES, String(clearedInfo.bufLines).c_str(),
+                    TELEMETRY_CLEARED_START_COUNT, String(clearedInfo.bufTelemetryStartCount).c_str(),
+                    TELEMETRY_CLEARED_FIRST_TS, String(clearedInfo.bufFirstTs).c_str(),
+                    TELEMETRY_CLEARED_LAST_TS, String(clearedInfo.bufLastTs).c_str()
+                );
             }
 
             isTelemetryInProcess = false;
@@ -509,10 +540,15 @@ bool IvanSupervisorService::initiateTelemetryUpload()
         smsCmd.commandsExecutedCount = 0; // resetting count of executed commands
         rc = true;
 
-    } else { // else we're not removing .sending, as we're testing. It will be removed just before next upload.
-        File f = eepromFs->open("/telemetry.sending.txt", "a");
-        f.println("{\"type\":\"COMMENT\",\"comment\":\"Telemetry was disabled, no transmission.\"}");
-        f.close();
+    } else { // we're testing: what would have been sent is kept in .sending until next upload
+        File f = eepromFs->open("/telemetry.sending.txt", "w");
+        if (f) {
+            f.print(*text);
+            f.println("{\"type\":\"COMMENT\",\"comment\":\"Telemetry was disabled, no transmission.\"}");
+            f.close();
+        }
+        delete text;
+        telemetryLog.discardBefore(uploadEndSeq);
         rc = false;
         isTelemetryInProcess = false;
     }
@@ -547,7 +583,7 @@ void IvanSupervisorService::loadSmsCommands()
         String text(sms->text);
         if (text.startsWith("CMD ")) {
             text.replace("CMD ", "");
-            smsCmd.commands.push_back(text);
+            addSmsCommand(text);
         } else if (text.startsWith("STOP ")) {
             text.replace("STOP ", "");
             char *endPtr;
@@ -609,16 +645,41 @@ void IvanSupervisorService::loadSmsCommands()
 
     // add commands for pumpCron and isStopRequested
     if (!smsCmd.pumpCron.isEmpty()) {
-        smsCmd.commands.push_back(smsCmd.pumpCron);
+        addSmsCommand(smsCmd.pumpCron);
         smsCmd.pumpCron.clear();
         smsCmd.needsConfigSave = true;
     }
     if (smsCmd.isStopRequested) {
-        smsCmd.commands.push_back(String("supervisor shutdown nowakeup"));
+        addSmsCommand(String("supervisor shutdown nowakeup"));
         smsCmd.isStopRequested = false;
     }
 }
 
+void IvanSupervisorService::addSmsCommand(const String &text)
+{
+    smsCmd.commands.emplace_back();
+    SmsCommand &cmd = smsCmd.commands.back();
+    cmd.text = text;
+    if (text.startsWith("DELAY ")) { // if it's DELAY, we'll wait for the specified duration
+        String delayStr = text;
+        delayStr.replace("DELAY ", "");
+        delayStr.trim();
+        char *endPtr;
+        unsigned delay = strtoul(delayStr.c_str(), &endPtr, 10);
+        if (*endPtr != '\0') { // something is wrong with the syntax
+            delay = 1;
+        }
+        if (delay < 1 || delay > 60 * 1000) { // delay no more than 60 seconds
+            delay = 10000;
+        }
+        cmd.delay = delay;
+    } else {
+        cmd.delay = -1;
+        // an unrecognized command is reported when processed
+        commandMgr->addToBatch(&cmd.batch, text.c_str());
+    }
+}
+
 // 8888888b.  8888888888     d8888 
 // 888  "Y88b 888           d88888 
 // 888    888 888          d88P888 
@@ -783,47 +844,38 @@ void IvanSupervisorService::initDfa()
 
             if (input.is(Dfa::Input::ENTER_STATE)) {
                 if (smsCmd.commands.size() > 0) { // have a little timeout before processing a command, so that command processing is not synchronous
-                    String *cmd = &smsCmd.commands[0];
-                    if (cmd->startsWith("DELAY ")) { // if it's DELAY, we wait for the specified duration
-                        String delayStr = *cmd;
-                        delayStr.replace("DELAY ", "");
-                        delayStr.trim();
-                        char *endPtr;
-                        unsigned delay = strtoul(delayStr.c_str(), &endPtr, 10);
-                        if (*endPtr != '\0') { // something is wrong with the syntax
-                            delay = 1;
-                        }
-                        if (delay < 1 || delay > 60 * 1000) { // delay no more than 60 seconds
-                            delay = 10000;
-                        }
-                        logger->debug("Processing command {} with delay = {}", cmd->c_str(), delay);
-                        dfa->setStateTimeout(delay);
-                    } else {
-                        int delay = 1;
-                        logger->debug("Processing command {} with delay = {}", cmd->c_str(), delay);
-                        dfa->setStateTimeout(delay);
-                    }
+                    SmsCommand *cmd = &smsCmd.commands[0];
+                    int delay = cmd->delay >= 0 ? cmd->delay : 1; // if it's DELAY, we wait for the specified duration
+                    logger->debug("Processing command {} with delay = {}", cmd->text.c_str(), delay);
+                    dfa->setStateTimeout(delay);
                     return dfa->noTransition();
                 } else {
                     return dfa->transitionTo(IDLE);
                 }
             } else if (input.is(Dfa::Input::TIMEOUT)) {
-                String *cmd = &smsCmd.commands[0];
-                if (!cmd->startsWith("DELAY ")) { // DELAY has already been processed, using timeout
-                    logger->debug("Processing command \"{}\"", cmd->c_str());
-                    String cmdRet(*cmd);
-                    bool isProcessed = commandMgr->processCommandLine("SMS", &cmdRet);
+                SmsCommand *cmd = &smsCmd.commands[0];
+                if (cmd->delay < 0) { // DELAY has already been processed, using timeout
+                    logger->debug("Processing command \"{}\"", cmd->text.c_str());
+                    // a command line too long to be tokenized is not added to the batch
+                    bool isProcessed = false;
+                    const char *resultMsg = "Command too long";
+                    if (cmd->batch.size() > 0) {
+                        commandMgr->processBatch("SMS", &cmd->batch);
+                        CommandBatch::Result *result = cmd->batch.getResult(0);
+                        isProcessed = result->isProcessed;
+                        resultMsg = result->msg.c_str();
+                    }
                     if (isProcessed) {
                         this->telemetry(TELEMETRY_CMD_PROCESSED_SUCCESSFULLY,
-                            TELEMETRY_DATA_CMD_TEXT, cmd->c_str(),
-                            TELEMETRY_DATA_CMD_RESULT, cmdRet.c_str());
+                            TELEMETRY_DATA_CMD_TEXT, cmd->text.c_str(),
+                            TELEMETRY_DATA_CMD_RESULT, resultMsg);
                     } else {
-                        this->telemetry(TELEMETRY_CMD_PROCESSED_FAILURE, TELEMETRY_DATA_CMD_TEXT, cmd->c_str());
+                        this->telemetry(TELEMETRY_CMD_PROCESSED_FAILURE, TELEMETRY_DATA_CMD_TEXT, cmd->text.c_str());
                     }
                     logger->debug("Processed command \"{}\", processed: {}, result: \"{}\"",
-                        cmd->c_str(),
+                        cmd->text.c_str(),
                         isProcessed ? "true" : "false",
-                        cmdRet.c_str()
+                        resultMsg
                     );
                 }
                 smsCmd.commands.pop_front();
@@ -1274,12 +1326,7 @@ void IvanSupervisorService::initLoadFlow()
                 // check to see if we need telemetry upload
                 // do an upload if we ran the load, or if the file size is big enough
                 if (eepromFs != nullptr) {
-                    File f = eepromFs->open("/telemetry.txt");
-                    size_t size = 0;
-                    if (f) {
-                        size = f.size();
-                        f.close();
-                    }
+                    size_t size = telemetryLog.getSize();
                     time_t lastUpload = 0;
                     File lastTelemetryFile = eepromFs->open("/telemetryLast.txt");
                     if (lastTelemetryFile) {
@@ -1366,37 +1413,46 @@ void IvanSupervisorService::protDoShutdownNoWakeup()
     dfa.queueInputForState(REQUEST_SHUTDOWN, IDLE); // what if we're in the shutdown process, waiting for timeout? TODO
 }
 
-void IvanSupervisorService::setPersistentState(int state, int value)
+void IvanSupervisorService::setPersistentState(const char *state, int value)
 {
-    fs::File f = eepromFs->open("persistent.data", "w+");
-    bool rc = false;
-    if (f) {
-        rc = f.seek(state);
-    }
-    if (rc) {
-        int32_t val = value;
-        f.write((uint8_t *)&val, 4);
-    }
-    if (f) {
-        f.close();
+    if (kvStore == nullptr || !kvStore->set(state, value)) {
+        logger->error("Could not persist state {}", state);
     }
 }
 
-int IvanSupervisorService::getPersistentState(int state)
+int IvanSupervisorService::getPersistentState(const char *state)
 {
-    fs::File f = eepromFs->open("persistent.data", "r");
-    bool rc = false;
-    int32_t val = 0;
-    if (f) {
-        rc = f.seek(state);
+    return kvStore == nullptr ? 0 : kvStore->get(state, 0);
+}
+
+// the file is removed only once every value is in the store, else it's imported again on the next start
+void IvanSupervisorService::importPersistentData()
+{
+    if (eepromFs == nullptr || kvStore == nullptr || !eepromFs->exists("/persistent.data")) {
+        return;
     }
-    if (rc) {
-        f.readBytes((char *)&val, 4);
+    const char *states[] = { PERSISTENT_STATE_OVERCURRENT, PERSISTENT_STATE_CROWBAR };
+    File f = eepromFs->open("/persistent.data", "r");
+    bool isImported = (bool)f;
+    for (int i = 0; i < 2 && isImported; i++) {
+        int32_t val;
+        if (kvStore->contains(states[i])) {
+            // imported by a previous start that could not remove the file, or set since
+            continue;
+        }
+        isImported = f.seek(i * 4) && f.read((uint8_t *)&val, 4) == 4 && kvStore->set(states[i], val);
+        if (isImported) {
+            logger->info("Imported persistent state {}: {}", states[i], (int)val);
+        }
     }
     if (f) {
         f.close();
     }
-    return val;
+    if (!isImported) {
+        logger->error("Could not import /persistent.data, kept for the next start");
+        return;
+    }
+    eepromFs->remove("/persistent.data");
 }
 
 
@@ -1823,7 +1879,7 @@ void IvanSupervisorService::initCommands(ServiceCommands *cmd)
     cmd->registerIntData(
         ServiceCommands::IntDataBuilder("telemetryUploadSize", true)
         .cmd("telemetryUploadSize")
-        .help("--> Once the telemetry file reaches this size, it will be uploaded")
+        .help("--> Once the telemetry log reaches this size, it will be uploaded")
         .ptr(&telemetryUploadSize)
         .vMin(1)
         .vMax(10000)
@@ -1832,10 +1888,126 @@ void IvanSupervisorService::initCommands(ServiceCommands *cmd)
     cmd->registerIntData(
         ServiceCommands::IntDataBuilder("telemetryClearSize", true)
         .cmd("telemetryClearSize")
-        .help("--> If the telemetry file reaches this size and it's not uploaded yet, it will be cleared")
-        .ptr(&telemetryClearSize)
+        .help("--> If the telemetry log reaches this size and it's not uploaded yet, oldest records are cleared")
         .vMin(1)
         .vMax(20000)
+        .setFn([this](int val, bool isLoading, String *msg) {
+            telemetryClearSize = val;
+            telemetryLog.setSizeLimit(val);
+            return true;
+        })
+        .getFn([this]() {
+            return telemetryClearSize;
+        })
+    );
+
+    cmd->registerStringData(
+        ServiceCommands::StringDataBuilder("telemetryFormat", true)
+        .cmd("telemetryFormat")
+        .help("--> json|compact -- Upload telemetry as JSON lines, or delta and varint encoded in base64 (see TelemetryCodec.h)")
+        .setFn([this](const String &val, bool isLoading, String *msg) {
+            if (val != "json" && val != "compact") {
+                *msg = "Expecting json or compact";
+                return false;
+            }
+            telemetryFormat = val;
+            *msg = "Set telemetryFormat to "; msg->concat(val);
+            return true;
+        })
+        .getFn([this](String *val) {
+            *val = telemetryFormat;
+        })
+    );
+
+    cmd->registerIntData(
+        ServiceCommands::IntDataBuilder("telemetryCommitRecords", true)
+        .cmd("telemetryCommitRecords")
+        .help("--> Telemetry records kept in memory before writing them to the telemetry log (protection events are written at once)")
+        .vMin(1)
+        .vMax(100)
+        .setFn([this](int val, bool isLoading, String *msg) {
+            telemetryCommitRecords = val;
+            telemetryLog.setCommitPolicy(telemetryCommitRecords, telemetryCommitSecs);
+            return true;
+        })
+        .getFn([this]() {
+            return telemetryCommitRecords;
+        })
+    );
+
+    cmd->registerIntData(
+        ServiceCommands::IntDataBuilder("telemetryCommitSecs", true)
+        .cmd("telemetryCommitSecs")
+        .help("--> Max delay in seconds before telemetry records in memory are written to the telemetry log")
+        .vMin(1)
+        .vMax(3600)
+        .setFn([this](int val, bool isLoading, String *msg) {
+            telemetryCommitSecs = val;
+            telemetryLog.setCommitPolicy(telemetryCommitRecords, telemetryCommitSecs);
+            return true;
+        })
+        .getFn([this]() {
+            return telemetryCommitSecs;
+        })
+    );
+
+    cmd->registerStringData(
+        ServiceCommands::StringDataBuilder("persistentLog", true)
+        .cmd("persistentLog")
+        .help("persistentLog [<n>|since <ts>] --> Show the last n records (10 by default) of the persistent log,\n"
+            "    or the records since timestamp ts")
+        .isPersistent(false)
+        .includeInStatus(false)
+        .setFn([this](const String &val, bool isLoading, String *msg) -> bool {
+            RotatingFile::Reader reader;
+            if (!reader.open("/persistent.txt", eepromFs)) {
+                *msg = "Could not read the persistent log";
+                return true;
+            }
+            String record;
+            if (val.startsWith("since ")) {
+                time_t ts = strtol(val.c_str() + 6, nullptr, 10);
+                reader.seekToTime(ts, [](const String &record) {
+                    int i = record.indexOf("\"ts\":");
+                    return (time_t)(i < 0 ? 0 : strtol(record.c_str() + i + 5, nullptr, 10));
+                });
+            } else {
+                int count = val.length() == 0 ? 10 : val.toInt();
+                reader.seekToEnd();
+                for (int i = 0; i < count && reader.previous(&record); i++) {
+                }
+            }
+            msg->clear();
+            while (reader.next(&record)) {
+                record.trim();
+                msg->concat(record);
+                msg->concat('\n');
+            }
+            return true;
+        })
+    );
+
+    cmd->registerStringData(
+        ServiceCommands::StringDataBuilder("telemetryLog", true)
+        .cmd("telemetryLog")
+        .help("telemetryLog [reset|commit] --> Records in the telemetry log, and commits to it")
+        .isPersistent(false)
+        .includeInStatus(false)
+        .setFn([this](const String &val, bool isLoading, String *msg) -> bool {
+            if (val == "reset") {
+                telemetryLog.resetStats();
+                *msg = "Telemetry log statistics reset";
+            } else if (val == "commit") {
+                telemetryLog.commit();
+                *msg = "Telemetry log committed";
+            } else {
+                telemetryLog.getStats(msg);
+            }
+            return true;
+        })
+        .getFn([this](String *val) {
+            telemetryLog.getStats(val);
+        })
     );
 
     cmd->registerIntData(
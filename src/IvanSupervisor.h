@@ -28,6 +28,9 @@
 #include "Esp32I2c.h"
 #include "RebootDetectorService.h"
 #include "LedIndicatorService.h"
+#include "TelemetryLog.h"
+#include "TelemetryCodec.h"
+#include "LoadProfileCodec.h"
 
 // Telemetry tags
 
@@ -156,8 +159,8 @@ private:
 
     int highFrequencyMillis;
     int lowFrequencyMillis;
-    float hystCurrentPct;
-    float hystVoltagePct;
+    int profileCurrentMaxError; // mA
+    int profileVoltageMaxError; // mV
 
     bool protIsEnabled; // for all protections except crowbar
     bool protCrowbarIsEnabled; // for crowbar protection
@@ -191,20 +194,20 @@ private:
     int caseTemp; // milli°C
 
     bool isFirstProfile;
-    unsigned long lastProfileTs;
-    unsigned long lastMeasureTs;
-    int lastLoadCurrent;
-    int lastLoadVoltage;
     uint32_t measurementCounter;
+    uint32_t lastCaptureAlerts; // critical alerts of the ina3221 already handled
 
-    // Current during load, in compressed format -- see protobuf varint
+    // Current and voltage during load, see LoadProfileCodec.h
+    static const size_t PROFILE_MAX_SIZE = 1024;
     std::vector<uint8_t> currentProfile;
-    void varintAdd(std::vector<uint8_t> &vect, int32_t n, bool isSignedEncoding);
-    int32_t varintDecode(std::vector<uint8_t> &vect, std::vector<uint8_t>::iterator &ptr, bool isSignedEncoding);
+    LoadProfileEncoder profileEncoder;
 
     void initCommands(ServiceCommands *cmd);
 
     void doSensorMeasurements(bool isHighFreq);
+    // returns the number of samples read, sets peakCurrent if any
+    int consumeCapture(int *peakCurrent);
+    void profileAdd(unsigned long ts, int current, int voltage);
 };
 
 class IvanSupervisorLedIndicators {
@@ -320,6 +323,7 @@ private:
     int loadSmsRetryCount;
 
     void loadSmsCommands();
+    void addSmsCommand(const String &text);
 
     UEventLoopTimer sim7000CallbackTimer;
 
@@ -373,12 +377,17 @@ private:
     int telemetryUploadSize; // if telemetry reaches this size, upload it
     int telemetryClearSize; // if telemetry reaches this size, clear it (should be greater than telemetryUploadSizze)
     int telemetryMinPeriodSecs;
+    String telemetryFormat; // "json" or "compact"
+    int telemetryCommitRecords; // records buffered in RAM before being written to the telemetry log
+    int telemetryCommitSecs; // max delay before buffered records are written
     bool isTelemetryInProcess;
+    TelemetryLog telemetryLog;
 
     IvanSupervisorLedIndicators ledIndicators;
 
     String sim7000Msg;
     EEPROMLittleFs *eepromFs;
+    EEPROMKvStore *kvStore;
 
     Dfa loadFlow;
     defState(loadFlow, LOAD_INIT);
@@ -411,8 +420,16 @@ private:
     // see whether load need to run
     bool calcRunLoad();
 
+    struct SmsCommand {
+        String text;
+        /** For "DELAY <millis>", the delay parsed when loaded; -1 for other commands */
+        int delay;
+        /** The command compiled when loaded, empty for DELAY */
+        CommandBatch batch;
+    };
+
     struct {
-        std::deque<String> commands;
+        std::deque<SmsCommand> commands;
         String pumpCron;
         bool isStopRequested;
         bool needsConfigSave;
@@ -459,20 +476,25 @@ private:
         const char *dataType9 = nullptr, const char *data9 = nullptr,
         const char *dataType10 = nullptr, const char *data10 = nullptr
     );
+    void importTelemetryText();
+    // the JSON object uploaded for a record
+    static void telemetryToJson(const char *recordType, uint32_t ts,
+        const char * const *dataTypes, const char * const *data, int count, String *json);
     // return false if there's no telemetry to do; else send UPLOAD_TERMINATED after telemetry finished (OK or not)
     bool initiateTelemetryUpload();
     RotatingFile persistentFile;
 
     Sensors sensors;
 
-    // Persistent state: an offset where to write a value, in the
-    // file "persistent.data" in eeprom fs.
-    // Value is int32_t (or something else, to be taken in account in offsets)
+    // Persistent state: int32 values in the key/value store of the eeprom, 0 if never set.
+    // Setting is synchronous, the value survives a crowbar right after.
 
-    void setPersistentState(int state, int value);
-    int getPersistentState(int state);
-#define PERSISTENT_STATE_OVERCURRENT 0
-#define PERSISTENT_STATE_CROWBAR (PERSISTENT_STATE_OVERCURRENT + 4)
+    void setPersistentState(const char *state, int value);
+    int getPersistentState(const char *state);
+    // the state kept by former versions at fixed offsets of persistent.data
+    void importPersistentData();
+#define PERSISTENT_STATE_OVERCURRENT "sup.overcurrent"
+#define PERSISTENT_STATE_CROWBAR "sup.crowbar"
 
     void protDoCrowbar();
     void protDoLoadOff();
@@ -10,6 +10,7 @@
 
 
 Sensors::Sensors()
+    : profileEncoder(currentProfile)
 {
 
 }
@@ -22,8 +23,8 @@ void Sensors::init(IvanSupervisorService *sup, ServiceCommands *cmd)
 
     highFrequencyMillis = 10;
     lowFrequencyMillis = 1000;
-    hystCurrentPct = 2;
-    hystVoltagePct = 2;
+    profileCurrentMaxError = 50;
+    profileVoltageMaxError = 40;
 
     protIsEnabled = false;
     protCrowbarIsEnabled = false;
@@ -55,10 +56,8 @@ void Sensors::init(IvanSupervisorService *sup, ServiceCommands *cmd)
     caseTemp = 0; // milli°C
 
     isFirstProfile = true;
-    lastProfileTs = loadOffTs;
-    lastLoadCurrent = 0;
-    lastLoadVoltage = 0;
     measurementCounter = 0;
+    lastCaptureAlerts = 0;
 
     timer.init(sup->eventLoop, [this](UEventLoopTimer *timer) {
         unsigned long ts = millis();
@@ -112,44 +111,21 @@ void Sensors::setLoadState(bool isOn)
     }
 }
 
-void Sensors::varintAdd(std::vector<uint8_t> &vect, int32_t n, bool isSignedEncoding)
+void Sensors::loadOnOvercurrentSupervisionPrepare()
 {
-    if (isSignedEncoding) {
-        n = (n << 1) ^ ((int32_t)n >> 31);
-    }
-    while (n & ~0x7F) {
-        vect.push_back((n & 0xFF) | 0x80);
-        n = n >> 7;
+    // the critical alert turns the load off by itself only if protection is enabled; the
+    // supervision below aborts the load in any case. A capture left running (load turned on
+    // again before the end of the previous profile) is restarted, with the current limit
+    // and protection of this run.
+    if (sup->ina3221->isCapturing()) {
+        int peakCurrent;
+        consumeCapture(&peakCurrent); // the samples still in the ring go to the profile first
+        sup->ina3221->stopCapture();
     }
-    vect.push_back(n);
-}
-
-int32_t Sensors::varintDecode(std::vector<uint8_t> &vect, std::vector<uint8_t>::iterator &ptr, bool isSignedEncoding)
-{
-    uint32_t result = 0;
-    uint32_t v;
-    int b = 0;
-    do {
-        if (ptr == vect.end()) {
-            Serial.printf("At %d, found end of vector\n", (int)(ptr - vect.begin()));
-            return 0;
-        }
-        v = *ptr;
-        result += ((v & 0x7F) << b);
-        ptr++;
-        b += 7;
-    } while ((v & 0x80) != 0);
-    if (isSignedEncoding) {
-        int32_t signmask = (result & 1) ? -1 : 0;
-        result = (result >> 1) ^ signmask;
+    if (!sup->ina3221->startCapture(2, protOnMaxCurrent, protIsEnabled ? sup->loadOnPin : -1)) {
+        sup->logger->error("Could not start the capture of the load current, supervision will poll");
     }
-    return result;
-}
-
-
-void Sensors::loadOnOvercurrentSupervisionPrepare()
-{
-    sup->ina3221->setModeOvercurrent(2);
+    lastCaptureAlerts = sup->ina3221->getCaptureAlerts();
 }
 
 int Sensors::loadOnOvercurrentSupervision(int duration)
@@ -157,45 +133,88 @@ int Sensors::loadOnOvercurrentSupervision(int duration)
     int cnt = 0;
     int tm = millis();
     while (millis() - tm < duration) {
-        sup->ina3221->readChannelData(2, &loadVoltage, &loadCurrent);
-        if (loadCurrent > protOnMaxCurrent) {
+        int peakCurrent;
+        if (sup->ina3221->isCapturing()) {
+            delay(1); // the samples of the next millisecond are captured meanwhile
+            int n = consumeCapture(&peakCurrent);
+            cnt += n;
+            if (sup->ina3221->getCaptureAlerts() != lastCaptureAlerts) {
+                lastCaptureAlerts = sup->ina3221->getCaptureAlerts();
+                sup->logger->trace("Overcurrent supervision for {} millis, critical alert, {} samples", duration, cnt);
+                return (n > 0 && peakCurrent > protOnMaxCurrent ? peakCurrent : protOnMaxCurrent);
+            }
+            if (n == 0) {
+                continue;
+            }
+        } else {
+            sup->ina3221->readChannelData(2, &loadVoltage, &loadCurrent);
+            peakCurrent = loadCurrent;
+            delayMicroseconds(400); // give enough time for a cycle of measuring
+            ++cnt;
+        }
+        if (peakCurrent > protOnMaxCurrent) {
             sup->logger->trace("Overcurrent supervision for {} millis, overcurrent {} mA, performed {} samplings",
-                duration, loadCurrent, cnt);
-            return loadCurrent;
+                duration, peakCurrent, cnt);
+            return peakCurrent;
         }
-        delayMicroseconds(400); // give enough time for a cycle of measuring
-        ++cnt;
     }
-    sup->ina3221->setModeNormal();
     sup->logger->debug("Overcurrent supervision for {} millis, performed {} samplings", duration, cnt);
     return 0;
 }
 
+/**
+ * Reads the load samples captured since the last call, in batches: they all go to the load
+ * profile, and loadVoltage and loadCurrent are set to the last one.
+ */
+int Sensors::consumeCapture(int *peakCurrent)
+{
+    static const int BATCH_SIZE = 16;
+    Ina3221Service::CaptureSample batch[BATCH_SIZE];
+    int count = 0;
+    int n;
+    do {
+        n = sup->ina3221->readCapture(batch, BATCH_SIZE);
+        for (int i = 0; i < n; i++) {
+            if ((count == 0 && i == 0) || batch[i].current > *peakCurrent) {
+                *peakCurrent = batch[i].current;
+            }
+            unsigned long ts = batch[i].tsMicros / 1000;
+            // samples taken just before turning on are not part of the profile
+            if ((long)(ts - loadOnTs) >= 0 && (isLoadOn || ts - loadOffTs < 5000)) {
+                profileAdd(ts, batch[i].current, batch[i].voltage);
+            }
+        }
+        if (n > 0) {
+            loadVoltage = batch[n - 1].voltage;
+            loadCurrent = batch[n - 1].current;
+        }
+        count += n;
+    } while (n == BATCH_SIZE);
+    return count;
+}
+
 void Sensors::doSensorMeasurements(bool isHighFreq)
 {
     ++measurementCounter;
     // int ts1 = millis();
     sup->ina3221->readChannelData(3, &mainVoltage, &mainCurrent);
     mainCurrent = -mainCurrent; // main current is inverted, we want it positive
-    sup->ina3221->readChannelData(2, &loadVoltage, &loadCurrent);
-    caseTemp = sup->tempService->readTempMilliC();
-    int ts = millis();
-
-    int hystCurrentMin = 20;
-    int hystVoltageMin = 20;
-
-    int currentHyst = abs(lastLoadCurrent) * (int)(hystCurrentPct * 100) / 10000;
-    if (currentHyst < hystCurrentMin) {
-        currentHyst = hystCurrentMin;
+    // while capturing, the load samples since the last measurement are used, and are already in the profile
+    int loadPeakCurrent;
+    bool isCaptured = (sup->ina3221->isCapturing() && consumeCapture(&loadPeakCurrent) > 0);
+    if (!isCaptured) {
+        sup->ina3221->readChannelData(2, &loadVoltage, &loadCurrent);
+        loadPeakCurrent = loadCurrent;
     }
-    int voltageHyst = abs(lastLoadVoltage) * (int)(hystVoltagePct * 100) / 10000;
-    if (voltageHyst < hystVoltageMin) {
-        voltageHyst = hystVoltageMin;
+    if (sup->ina3221->getCaptureAlerts() != lastCaptureAlerts) {
+        // the load may already be off, turned off by the alert, and the samples don't show it
+        lastCaptureAlerts = sup->ina3221->getCaptureAlerts();
+        if (loadPeakCurrent <= protOnMaxCurrent) {
+            loadPeakCurrent = protOnMaxCurrent + 1;
+        }
     }
-
-    bool currentOrVoltageChanged = // changed more than 20 mA / 20 mV and more than a percentage of last value
-            (abs(loadCurrent - lastLoadCurrent) > currentHyst)
-            || (abs(loadVoltage - lastLoadVoltage) > voltageHyst);
+    caseTemp = sup->tempService->readTempMilliC();
+    int ts = millis();
 
     // Protection conditions
 
@@ -245,14 +264,14 @@ void Sensors::doSensorMeasurements(bool isHighFreq)
     }
 
     // If we're on and current is too high, turn off
-    if (isLoadOn && loadCurrent > protOnMaxCurrent) {
+    if (isLoadOn && loadPeakCurrent > protOnMaxCurrent) {
         if (!isTurnOffInitiated) {
             isTurnOffInitiated = true;
-            sup->logger->error("Protection: Overcurrent while load is on: {} mA, turning load off", loadCurrent);
+            sup->logger->error("Protection: Overcurrent while load is on: {} mA, turning load off", loadPeakCurrent);
             if (protIsEnabled) {
                 sup->protDoLoadOff();
             }
-            sup->telemetryAndPersistent(TELEMETRY_LOG_OVERCURRENT, TELEMETRY_PROT_VALUE, loadCurrent);
+            sup->telemetryAndPersistent(TELEMETRY_LOG_OVERCURRENT, TELEMETRY_PROT_VALUE, loadPeakCurrent);
             sup->setPersistentState(PERSISTENT_STATE_OVERCURRENT, sup->getPersistentState(PERSISTENT_STATE_OVERCURRENT) + 1);
             // forced telemetry upload
             sup->initiateTelemetryUpload();
@@ -428,75 +447,33 @@ void Sensors::doSensorMeasurements(bool isHighFreq)
 
     // If sensor measurements are in load mode, we keep track of the voltage and current profile
     if (isLoadOn || (!isLoadOn && ts - loadOffTs < 5000)) { // we'll gather profile until 5s second after turning off
-        if (isFirstProfile) {
-            lastProfileTs = loadOnTs;
-            lastMeasureTs = ts;
-            lastLoadCurrent = 0;
-            lastLoadVoltage = 0;
-            currentOrVoltageChanged = true;
-            currentProfile.clear();
-            varintAdd(currentProfile, 1, false); // version of the profile
-            varintAdd(currentProfile, currentHyst, false);
-            varintAdd(currentProfile, voltageHyst, false);
-        }
-
-        if (isFirstProfile || currentOrVoltageChanged) {
-            // The load profile is a suite of entries of the following form:
-            // - Timestamp difference with last entry (time since turn-on for the first entry)
-            // - Timestamp difference with last measure timestamp (normally equal to period between two measures)
-            // - Current difference with previous entry, in 10 mA units
-            // - Voltage difference with previous entry, in 20 mV units
-            // Data is encoded in varint, timestamps are positive, measures are signed (svarint)
-
-            // guard from entering too many values in the profile
-            int maxEntries = 100;
-            if (currentProfile.size() < maxEntries * 4) {
-                varintAdd(currentProfile, ts - lastProfileTs, false);
-                varintAdd(currentProfile, ts - lastMeasureTs, false);
-                varintAdd(currentProfile, (loadCurrent + 5) / 10 - (lastLoadCurrent + 5) / 10, true);
-                varintAdd(currentProfile, (loadVoltage + 10) / 20 - (lastLoadVoltage + 10) / 20, true);
-                lastProfileTs = ts;
-                lastLoadCurrent = loadCurrent;
-                lastLoadVoltage = loadVoltage;
-            } else if (currentProfile.size() == maxEntries * 4) {
-                // add one last entry with 999999
-                varintAdd(currentProfile, ts - lastProfileTs, false);
-                varintAdd(currentProfile, ts - lastMeasureTs, false);
-                varintAdd(currentProfile, 999999, true);
-                varintAdd(currentProfile, 999999, true);
-            }
-            // else we won't add another entry, the last added one is 999999
+        if (!isCaptured) {
+            profileAdd(ts, loadCurrent, loadVoltage);
         }
-        lastMeasureTs = ts;
-        isFirstProfile = false;
     } else {
+        sup->ina3221->stopCapture();
         if (isFirstProfile == false) { // first time we enter here after terminating the profile gathering
-            // add one more entry with current values, without thresholds
-            varintAdd(currentProfile, ts - lastProfileTs, false);
-            varintAdd(currentProfile, ts - lastMeasureTs, false);
-            varintAdd(currentProfile, (loadCurrent + 5) / 10 - (lastLoadCurrent + 5) / 10, true);
-            varintAdd(currentProfile, (loadVoltage + 10) / 20 - (lastLoadVoltage + 10) / 20, true);
+            // one more entry with current values, then the end of the last segment
+            profileEncoder.add(ts, loadCurrent, loadVoltage);
+            profileEncoder.finish();
 
             // log the whole profile
             String profile;
-            int32_t current = 0, voltage = 0;
-            auto ptr = currentProfile.begin();
-            uint32_t version = varintDecode(currentProfile, ptr, false);
-            uint16_t currentHyst = varintDecode(currentProfile, ptr, false);
-            uint16_t voltageHyst = varintDecode(currentProfile, ptr, false);
-            profile.concat("version "); profile.concat(version);
-            profile.concat(" currentHyst "); profile.concat(currentHyst);
-            profile.concat(" voltageHyst "); profile.concat(voltageHyst);
+            LoadProfileDecoder decoder(currentProfile.data(), currentProfile.size());
+            profile.concat("version "); profile.concat(LoadProfileEncoder::VERSION);
+            profile.concat(" currentMaxError "); profile.concat(decoder.getCurrentMaxError());
+            profile.concat(" voltageMaxError "); profile.concat(decoder.getVoltageMaxError());
+            profile.concat(" size "); profile.concat((int)currentProfile.size());
             profile.concat("\n");
-            while (ptr != currentProfile.end()) {
-                ts += varintDecode(currentProfile, ptr, false);
-                unsigned long lastTsDelta = varintDecode(currentProfile, ptr, false);
-                int c = varintDecode(currentProfile, ptr, true);
-                int v = varintDecode(currentProfile, ptr, true);
-                current += (c == 999999 ? 0 : c * 10);
-                voltage += (v == 999999 ? 0 : v * 20);
-                profile += "{\"ts\":" + String(ts) + ",\"tsd\":" + String(lastTsDelta)
-                        + ",\"i\":" + String(current) + ",\"v\":" + String(voltage) + "}\n";
+            LoadProfileDecoder::Point p;
+            while (decoder.next(&p)) {
+                profile += "{\"ts\":" + String(p.ts) + ",\"n\":" + String(p.sampleCount)
+                        + ",\"i\":" + String(p.current) + ",\"v\":" + String(p.voltage)
+                        + ",\"iMin\":" + String(p.currentMin) + ",\"iMax\":" + String(p.currentMax)
+                        + ",\"vMin\":" + String(p.voltageMin) + ",\"vMax\":" + String(p.voltageMax) + "}\n";
+            }
+            if (decoder.isTruncated()) {
+                profile += "truncated\n";
             }
             sup->logger->debug("Load profile: {}", profile.c_str());
             isFirstProfile = true;
@@ -515,6 +492,15 @@ void Sensors::doSensorMeasurements(bool isHighFreq)
 
 }
 
+void Sensors::profileAdd(unsigned long ts, int current, int voltage)
+{
+    if (isFirstProfile) {
+        profileEncoder.begin(loadOnTs, profileCurrentMaxError, profileVoltageMaxError, PROFILE_MAX_SIZE);
+        isFirstProfile = false;
+    }
+    profileEncoder.add(ts, current, voltage);
+}
+
 bool Sensors::protIsDoNotLoad()
 {
     return protIsOutputPowered || protIsUndervoltage || protIsOvertemp;
@@ -522,8 +508,11 @@ bool Sensors::protIsDoNotLoad()
 
 void Sensors::readLoadProfile(String *profileStr)
 {
-    // first convert the profile into a string
-    Util::base64Encode(profileStr, (char *)currentProfile.data(), currentProfile.size());
+    // read 1 s after turning off, while the profile still gathers the 5 s after: the last
+    // segment is included without being closed
+    std::vector<uint8_t> profile;
+    profileEncoder.snapshot(&profile);
+    Util::base64Encode(profileStr, (char *)profile.data(), profile.size());
 }
 
 void Sensors::spotMeasure()
@@ -629,21 +618,19 @@ void Sensors::initCommands(ServiceCommands *cmd)
         })
     );
 
-    cmd->registerFloatData(
-        ServiceCommands::FloatDataBuilder("prot.currentProfileHysteresisPct", true)
-        .cmd("prot.currentProfileHysteresisPct")
-        .help("--> Pct. of change in current needed to store a new value in the load profile.")
-        .vMin(0.1)
-        .vMax(100)
-        .ptr(&hystCurrentPct)
+    cmd->registerIntData(
+        ServiceCommands::IntDataBuilder("prot.profileCurrentMaxError", true)
+        .cmd("prot.profileCurrentMaxError")
+        .help("--> Max error of the current in the load profile, in milliamps. A lower value gives a longer profile.")
+        .vMin(1)
+        .ptr(&profileCurrentMaxError)
     );
-    cmd->registerFloatData(
-        ServiceCommands::FloatDataBuilder("prot.voltageProfileHysteresisPct", true)
-        .cmd("prot.voltageProfileHysteresisPct")
-        .help("--> Pct. of change in voltage needed to store a new value in the load profile.")
-        .vMin(0.1)
-        .vMax(100)
-        .ptr(&hystVoltagePct)
+    cmd->registerIntData(
+        ServiceCommands::IntDataBuilder("prot.profileVoltageMaxError", true)
+        .cmd("prot.profileVoltageMaxError")
+        .help("--> Max error of the voltage in the load profile, in millivolts. A lower value gives a longer profile.")
+        .vMin(1)
+        .ptr(&profileVoltageMaxError)
     );
 
     cmd->registerIntData(
@@ -9,10 +9,11 @@
 #include "CommandMgr.h"
 #include "LM75A_TempService.h"
 
-bool LM75A::init(int i2cAddress, i2c_port_t i2cPort)
+bool LM75A::init(int i2cAddress, I2cBus *bus)
 {
     this->i2cAddress = i2cAddress;
-    this->i2cPort = i2cPort;
+    this->bus = bus;
+    tx.address = i2cAddress;
     return checkConnect();
 }
 
@@ -214,17 +215,14 @@ bool LM75A::isConnected()
 
 bool LM75A::readRegister(uint8_t reg, uint8_t *values, int length)
 {
-    i2c_cmd_handle_t cmd = i2c_cmd_link_create();
-    i2c_master_start(cmd);
-    i2c_master_write_byte(cmd, (i2cAddress << 1) | 0x0 /* write */, true);
-    i2c_master_write_byte(cmd, reg, true);
-    i2c_master_start(cmd);
-    i2c_master_write_byte(cmd, (i2cAddress << 1) | 0x1 /* read */, true);
-    i2c_master_read(cmd, values, length, i2c_ack_type_t::I2C_MASTER_LAST_NACK);
-    i2c_master_stop(cmd);
-    esp_err_t err = i2c_master_cmd_begin(i2cPort, cmd, 200 / portTICK_PERIOD_MS);
-    i2c_cmd_link_delete(cmd);
-    return (err == ESP_OK);
+    if (bus == nullptr) {
+        return false;
+    }
+    tx.setHeader(reg);
+    tx.writeLen = 0;
+    tx.readData = values;
+    tx.readLen = length;
+    return bus->execute(&tx) == ESP_OK;
 }
 
 bool LM75A::readReg8(uint8_t reg, uint8_t *value)
@@ -244,15 +242,14 @@ bool LM75A::readReg16(uint8_t reg, uint16_t *value)
 
 bool LM75A::writeRegister(uint8_t reg, uint8_t *values, int length)
 {
-    i2c_cmd_handle_t cmd = i2c_cmd_link_create();
-    i2c_master_start(cmd);
-    i2c_master_write_byte(cmd, (i2cAddress << 1) | 0x0 /* write */, true);
-    i2c_master_write_byte(cmd, reg, true);
-    i2c_master_write(cmd, values, length, i2c_ack_type_t::I2C_MASTER_LAST_NACK);
-    i2c_master_stop(cmd);
-    esp_err_t err = i2c_master_cmd_begin(i2cPort, cmd, 200 / portTICK_PERIOD_MS);
-    i2c_cmd_link_delete(cmd);
-    return (err == ESP_OK);
+    if (bus == nullptr) {
+        return false;
+    }
+    tx.setHeader(reg);
+    tx.writeData = values;
+    tx.writeLen = length;
+    tx.readLen = 0;
+    return bus->execute(&tx) == ESP_OK;
 }
 
 bool LM75A::writeReg8(uint8_t reg, uint8_t value)
@@ -386,6 +383,7 @@ void LM75A_TempService::init(UEventLoop *eventLoop, CommandMgr *commandMgr, Syst
 
 
     // defaults
+    tempSeries = nullptr;
     this->i2cAddress = 0x48;
     tempOffsetMilliC = 0;
     isEnabled = false;
@@ -400,18 +398,22 @@ void LM75A_TempService::init(UEventLoop *eventLoop, CommandMgr *commandMgr, Syst
     }
 
     if (isEnabled) {
-        rc = systemService->getIdf(i2cPort);
+        I2cBus *bus = systemService->getI2cBus(i2cPort);
+        rc = (bus != nullptr);
         if (!rc) {
             logger->error("Cannot retrieve i2c port {} in IDF form from System service", (int)(i2cPort));
         }
         if (rc) {
-            rc = lm75a.init(i2cAddress, i2cPort);
+            rc = lm75a.init(i2cAddress, bus);
             if (!rc) {
             logger->error("Initialization failed for i2cPort {}, i2cAddress {}",
                 (int)i2cPort, i2cAddress);
             }
         }
     }
+    if (rc && isEnabled) {
+        tempSeries = systemService->getTimeSeries()->addMetric("lm75a.temp", "m°C", 32, 60, 24);
+    }
     if (rc) {
         loggingTimer.init(eventLoop, [this](UEventLoopTimer *timer) {
             if (isEnabled) {
@@ -429,7 +431,11 @@ int LM75A_TempService::readTempMilliC()
         return 999999;
     }
     int t = lm75a.getTempMilliC();
-    return t == 999999 ? 999999 : t + tempOffsetMilliC;
+    if (t == 999999) {
+        return 999999;
+    }
+    TimeSeries::add(tempSeries, t + tempOffsetMilliC);
+    return t + tempOffsetMilliC;
 }
 
 
@@ -14,7 +14,8 @@
 
 class LM75A {
     int i2cAddress;
-    i2c_port_t i2cPort;
+    I2cBus *bus = nullptr;
+    I2cBus::Transaction tx;
     uint8_t regConfig;
     bool isInitialized;
 
@@ -31,7 +32,7 @@ class LM75A {
     bool readRegister(uint8_t reg, uint8_t *values, int length);
     bool writeRegister(uint8_t reg, uint8_t *values, int length);
 public:
-    bool init(int i2cAddress, i2c_port_t i2cPort);
+    bool init(int i2cAddress, I2cBus *bus);
     void shutdown();
     void wakeup();
     bool isShutdown();
@@ -91,6 +92,7 @@ private:
     int tempOffsetMilliC;
 
     UEventLoopTimer loggingTimer;
+    TimeSeries::Metric *tempSeries;
 public:
     // Returns 999999 if impossible to read temp
     int readTempMilliC();
@@ -0,0 +1,212 @@
+#include "CompilationOpts.h"
+
+#ifdef USE_LED
+
+#include <HardwareSerial.h>
+#include <math.h>
+#include <FastLED.h>
+#include "UEvent.h"
+#include "CommandMgr.h"
+#include "LedService.h"
+#include "LedFieldEffect.h"
+
+LedFieldEffect::LedFieldEffect(int controllerId, LedMap1d *leds, int totalLedCount, LedGeometry *geometry, const char *description)
+    : Effect(controllerId, leds, totalLedCount, description)
+{
+    this->geometry = geometry;
+    isEnabled = false;
+    isPulse = false;
+    azimuth = 0;
+    elevation = 90;
+    periodMillis = 2000;
+    widthPct = 10;
+    hue = 0;
+    hueStep = 30;
+    saturation = 255;
+    valMax = 255;
+    millisPerFrame = 33;
+    statAvgLit = 0;
+}
+
+LedFieldEffect::~LedFieldEffect()
+{
+}
+
+void LedFieldEffect::setCmd(ServiceCommands *cmd, const char *command, const char *help, int *data, int min, int max)
+{
+  cmd->registerIntData(
+    ServiceCommands::IntDataBuilder(command, true)
+    .cmd(command, true)
+    .help(help)
+    .vMin(min)
+    .vMax(max)
+    .setFn([this, data, command](int val, bool isLoading, String *msg) {
+      *data = val;
+      if (!isLoading) {
+        calcFrameProperties();
+        *msg = "Set "; msg->concat(command);
+        msg->concat(" to "); msg->concat(*data);
+      }
+      return true;
+    })
+    .getFn([this, data]() {
+      return *data;
+    })
+  );
+};
+
+void LedFieldEffect::init(int millisPerFrame, CommandMgr *commandMgr, uint32_t frame)
+{
+    String controllerName = "led"; controllerName += controllerId;
+    cmd = commandMgr->getServiceCommands(controllerName.c_str());
+
+    cmd->onAfterLoad([this](String *msg) { this->onAfterLoad(); });
+
+    cmd->registerBoolData(
+        ServiceCommands::BoolDataBuilder("isEnabled", true)
+            .cmdOn("enable")
+            .cmdOff("disable")
+            .helpOn("--> Enable this controller")
+            .helpOff("--> Disable this controller")
+            .ptr(&isEnabled)
+    );
+
+    cmd->registerStringData(
+        ServiceCommands::StringDataBuilder("mode", true)
+        .cmd("mode")
+        .help("--> plane|pulse -- plane sweeping along the direction, or pulse growing from the direction")
+        .setFn([this](const String &val, bool isLoading, String *msg) {
+            if (val.equalsIgnoreCase("plane")) {
+                isPulse = false;
+            } else if (val.equalsIgnoreCase("pulse")) {
+                isPulse = true;
+            } else {
+                *msg = "Expecting plane or pulse";
+                return false;
+            }
+            if (!isLoading) {
+                calcFrameProperties();
+                *msg = "Set mode to "; msg->concat(val);
+            }
+            return true;
+        })
+        .getFn([this](String *val) {
+            *val = isPulse ? "pulse" : "plane";
+        })
+    );
+
+    setCmd(cmd, "azimuth", "--> Azimuth of the direction, in degrees", &azimuth, 0, 359);
+    setCmd(cmd, "elevation", "--> Elevation of the direction, in degrees (90 is the top of the sphere)", &elevation, -90, 90);
+    setCmd(cmd, "periodMillis", "--> Duration of a sweep, in millis", &periodMillis, 1, 3600000);
+    setCmd(cmd, "widthPct", "--> Width of the lit band, in percentage of the sweep", &widthPct, 1, 100);
+    setCmd(cmd, "hue", "--> Hue of the first sweep, 0..255", &hue, 0, 255);
+    setCmd(cmd, "hueStep", "--> Change in hue on each sweep, 0..255", &hueStep, 0, 255);
+    setCmd(cmd, "saturation", "--> Color saturation, 0..255", &saturation, 0, 255);
+    setCmd(cmd, "valMax", "--> Brightness at the center of the band, 0..255", &valMax, 0, 255);
+
+    registerLayerCommands(cmd);
+
+    String msg;
+    bool rc = cmd->load(nullptr, &msg);
+    if (!rc) {
+        Serial.printf("LedController %s: error loading defaults: %s\n", cmd->getServiceName(), msg.c_str());
+    } else {
+        String keyName;
+        cmd->getCurrentKeyName(&keyName);
+        Serial.printf("Loaded config for %s/%s\n", cmd->getServiceName(), keyName.c_str());
+    }
+
+    this->millisPerFrame = millisPerFrame;
+    calcFrameProperties();
+}
+
+void LedFieldEffect::onAfterLoad()
+{
+    calcFrameProperties();
+}
+
+void LedFieldEffect::getOneLineStatus(String *msg)
+{
+    *msg += "Type: field, "; *msg += (isPulse ? "pulse" : "plane");
+    *msg += " on "; *msg += geometry->getCount(); *msg += " leds ("; *msg += geometry->getType(); *msg += "). Controller is ";
+    *msg += (this->isEnabled ? "enabled." : "disabled.");
+}
+
+void LedFieldEffect::setFrameDuration(int millis)
+{
+    this->millisPerFrame = millis;
+}
+
+/**
+ * Samples the field at each led, mapped to 0..65535, and sorts the leds by it.
+ */
+void LedFieldEffect::calcFrameProperties()
+{
+    float el = elevation * M_PI / 180.0;
+    float az = azimuth * M_PI / 180.0;
+    float dx = cosf(el) * cosf(az);
+    float dy = cosf(el) * sinf(az);
+    float dz = sinf(el);
+
+    index.build(geometry->getCount(), [this, dx, dy, dz](int pos) {
+        float x = geometry->getX(pos) / 16384.0;
+        float y = geometry->getY(pos) / 16384.0;
+        float z = geometry->getZ(pos) / 16384.0;
+        float dot = x * dx + y * dy + z * dz;
+        float v;
+        if (isPulse) {
+            // angle between the led and the direction, 0..PI
+            float r = sqrtf(x * x + y * y + z * z);
+            float c = r == 0 ? 1 : dot / r;
+            v = acosf(c < -1 ? -1 : (c > 1 ? 1 : c)) / M_PI;
+        } else {
+            // position along the direction, the plane sweeps from the direction to the opposite side
+            v = (1 - dot) / 2;
+        }
+        return (uint16_t)(v < 0 ? 0 : (v > 1 ? 65535 : v * 65535));
+    });
+}
+
+void LedFieldEffect::calc(uint32_t frame)
+{
+    if (!isEnabled || index.getCount() == 0) {
+        return;
+    }
+
+    uint64_t tm = (uint64_t)frame * millisPerFrame;
+    uint32_t sweep = tm / periodMillis;
+    uint32_t t = tm % periodMillis;
+
+    // the center of the band travels from -width to 65535 + width during a sweep
+    int32_t width = widthPct * 65536 / 100;
+    int32_t center = -width + (int32_t)((int64_t)(65536 + 2 * width) * t / periodMillis);
+    uint8_t sweepHue = hue + sweep * hueStep;
+
+    int lit = 0;
+    int count = index.getCount();
+    for (int k = index.lowerBound(center - width < 0 ? 0 : center - width); k < count; k++) {
+        int32_t d = (int32_t)index.valueAt(k) - center;
+        if (d >= width) {
+            break;
+        }
+        uint8_t v = valMax * (width - abs(d)) / width;
+        if (v != 0) {
+            leds->at(index.ledAt(k))->setHSV(sweepHue, saturation, v);
+            ++lit;
+        }
+    }
+
+    statAvgLit = (statAvgLit == 0 ? (lit << 4) : statAvgLit * 63 / 64 + (lit << 4) / 64);
+}
+
+void LedFieldEffect::printStats()
+{
+    Serial.printf("  %s -- Avg lit: %d leds\n", cmd->getServiceName(), (statAvgLit >> 4));
+}
+
+void LedFieldEffect::printStats(String *msg)
+{
+    *msg += cmd->getServiceName(); *msg += " -- Avg lit: "; *msg += (statAvgLit >> 4); *msg += " leds";
+}
+
+#endif // USE_LED
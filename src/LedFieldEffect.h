@@ -0,0 +1,62 @@
+#ifndef INCL_LED_FIELD_EFFECT_H
+#define INCL_LED_FIELD_EFFECT_H
+
+#include "CompilationOpts.h"
+
+#ifdef USE_LED
+
+#include <FastLED.h>
+#include "UEvent.h"
+#include "CommandMgr.h"
+#include "LedService.h"
+#include "LedGeometry.h"
+
+/**
+ * Effect sampling a field in the coordinates of the leds (see LedGeometry):
+ *
+ * - plane: a plane orthogonal to the direction sweeps through the leds
+ * - pulse: a circle centered on the direction grows from it to the opposite side of the sphere
+ *
+ * The field value of each led is computed when parameters change, and kept sorted
+ * in a LedFieldIndex; each frame only visits the leds lit by the band around the
+ * current position of the plane or of the circle.
+ */
+class LedFieldEffect: public Effect {
+    friend class LedService;
+private:
+    bool isEnabled;
+    ServiceCommands *cmd;
+    LedGeometry *geometry;
+    LedFieldIndex index;
+
+    bool isPulse; // else plane
+    int azimuth; // direction, in degrees
+    int elevation;
+    int periodMillis; // duration of a sweep
+    int widthPct; // width of the band, in percentage of the field range
+    int hue;
+    int hueStep; // change of hue on each sweep
+    int saturation;
+    int valMax;
+
+    int millisPerFrame;
+    uint32_t statAvgLit; // leds lit per frame, << 4
+
+    void calcFrameProperties();
+
+    void setCmd(ServiceCommands *cmd, const char *commandStr, const char *help, int *data, int min, int max);
+
+public:
+    LedFieldEffect(int controllerId, LedMap1d *leds, int totalLedCount, LedGeometry *geometry, const char *description);
+    virtual ~LedFieldEffect();
+    virtual void init(int millisPerFrame, CommandMgr *commandMgr, uint32_t frame);
+    virtual void setFrameDuration(int millisPerFrame);
+    virtual void onAfterLoad();
+    virtual void getOneLineStatus(String *msg);
+    virtual void calc(uint32_t frame);
+    virtual void printStats();
+    virtual void printStats(String *msg);
+};
+
+#endif
+#endif
@@ -0,0 +1,188 @@
+#include "CompilationOpts.h"
+
+#ifdef USE_LED
+
+#include <algorithm>
+#include <math.h>
+#include "LedGeometry.h"
+
+LedGeometry::LedGeometry()
+{
+    count = 0;
+    xyz = nullptr;
+}
+
+LedGeometry::~LedGeometry()
+{
+    delete[] xyz;
+}
+
+void LedGeometry::setCount(int count)
+{
+    delete[] xyz;
+    this->count = count;
+    xyz = new int16_t[3 * count];
+}
+
+// coordinates are scaled to fixed point by normalize(); until then they're kept as 1/256 units
+void LedGeometry::setPoint(int i, float x, float y, float z)
+{
+    xyz[3 * i] = (int16_t)(x * 256.0);
+    xyz[3 * i + 1] = (int16_t)(y * 256.0);
+    xyz[3 * i + 2] = (int16_t)(z * 256.0);
+}
+
+void LedGeometry::normalize()
+{
+    float maxDistance = 0;
+    for (int i = 0; i < count; i++) {
+        float d = sqrtf((float)getX(i) * getX(i) + (float)getY(i) * getY(i) + (float)getZ(i) * getZ(i));
+        if (d > maxDistance) {
+            maxDistance = d;
+        }
+    }
+    if (maxDistance == 0) {
+        return;
+    }
+    float scale = 16384.0 / maxDistance;
+    for (int i = 0; i < 3 * count; i++) {
+        xyz[i] = (int16_t)lroundf(xyz[i] * scale);
+    }
+}
+
+void LedGeometry::generateRing(int count)
+{
+    type = "ring";
+    setCount(count);
+    for (int i = 0; i < count; i++) {
+        float a = 2 * M_PI * i / count;
+        setPoint(i, 100.0 * cosf(a), 100.0 * sinf(a), 0);
+    }
+    normalize();
+}
+
+void LedGeometry::generateSphere(const int *rings, int ringCount)
+{
+    type = "sphere";
+    int total = 0;
+    for (int r = 0; r < ringCount; r++) {
+        total += rings[r];
+    }
+    setCount(total);
+
+    int pos = 0;
+    for (int r = 0; r < ringCount; r++) {
+        // rings are evenly spaced in latitude, from the top (z = 1) to the bottom
+        float polar = M_PI * (r + 0.5) / ringCount;
+        for (int i = 0; i < rings[r]; i++) {
+            float azimuth = 2 * M_PI * i / rings[r];
+            setPoint(pos++, 100.0 * sinf(polar) * cosf(azimuth), 100.0 * sinf(polar) * sinf(azimuth), 100.0 * cosf(polar));
+        }
+    }
+    normalize();
+}
+
+bool LedGeometry::load(const JsonVariant &cfg, int totalLedCount, String *error)
+{
+    const char *t = cfg["type"] | "";
+    if (strcmp(t, "ring") == 0) {
+        int n = cfg["count"] | totalLedCount;
+        if (n <= 0 || n > totalLedCount) {
+            *error = String("Geometry: ring count ") + n + " out of range 1.." + totalLedCount;
+            return false;
+        }
+        generateRing(n);
+    } else if (strcmp(t, "sphere") == 0) {
+        const JsonVariant &r = cfg["rings"];
+        if (!r.is<JsonArray>() || r.size() == 0) {
+            *error = "Geometry: sphere expects a non-empty array \"rings\"";
+            return false;
+        }
+        int *rings = new int[r.size()];
+        int total = 0;
+        for (int i = 0; i < r.size(); i++) {
+            rings[i] = r[i] | 0;
+            total += rings[i];
+            if (rings[i] <= 0) {
+                total = -1;
+                break;
+            }
+        }
+        if (total <= 0 || total > totalLedCount) {
+            delete[] rings;
+            *error = String("Geometry: sphere rings must have leds, and at most ") + totalLedCount + " leds in total";
+            return false;
+        }
+        generateSphere(rings, r.size());
+        delete[] rings;
+    } else if (strcmp(t, "points") == 0) {
+        const JsonVariant &p = cfg["points"];
+        if (!p.is<JsonArray>() || p.size() == 0 || p.size() > totalLedCount) {
+            *error = String("Geometry: points expects an array of 1..") + totalLedCount + " [x, y, z] elements";
+            return false;
+        }
+        type = "points";
+        setCount(p.size());
+        // scale to 1/256 units relative to the largest coordinate, normalize() does the rest
+        float maxCoord = 0;
+        for (int i = 0; i < count; i++) {
+            for (int c = 0; c < 3; c++) {
+                float v = fabsf(p[i][c] | 0.0f);
+                if (v > maxCoord) {
+                    maxCoord = v;
+                }
+            }
+        }
+        float scale = maxCoord == 0 ? 1 : 100.0 / maxCoord;
+        for (int i = 0; i < count; i++) {
+            setPoint(i, (p[i][0] | 0.0f) * scale, (p[i][1] | 0.0f) * scale, (p[i][2] | 0.0f) * scale);
+        }
+        normalize();
+    } else {
+        *error = String("Geometry: unrecognized type \"") + t + "\", expecting ring, sphere or points";
+        return false;
+    }
+    return true;
+}
+
+LedFieldIndex::LedFieldIndex()
+{
+    count = 0;
+    leds = nullptr;
+    values = nullptr;
+}
+
+LedFieldIndex::~LedFieldIndex()
+{
+    delete[] leds;
+    delete[] values;
+}
+
+void LedFieldIndex::build(int count, std::function<uint16_t(int pos)> valueAt)
+{
+    if (count != this->count) {
+        delete[] leds;
+        delete[] values;
+        this->count = count;
+        leds = new uint16_t[count];
+        values = new uint16_t[count];
+    }
+    // sort (value, led) pairs packed in a single integer
+    uint32_t *pairs = new uint32_t[count];
+    for (int i = 0; i < count; i++) {
+        pairs[i] = ((uint32_t)valueAt(i) << 16) | i;
+    }
+    std::sort(pairs, pairs + count);
+    for (int i = 0; i < count; i++) {
+        values[i] = pairs[i] >> 16;
+        leds[i] = pairs[i] & 0xFFFF;
+    }
+    delete[] pairs;
+}
+
+int LedFieldIndex::lowerBound(uint16_t value)
+{
+    return std::lower_bound(values, values + count, value) - values;
+}
+
+#endif // USE_LED
@@ -0,0 +1,71 @@
+#ifndef INCL_LED_GEOMETRY_H
+#define INCL_LED_GEOMETRY_H
+
+#include "CompilationOpts.h"
+
+#ifdef USE_LED
+
+#include <functional>
+#include <ArduinoJson.h>
+
+/**
+ * Coordinates of the leds, in the order used by effects (positions of LedMap1d::at()).
+ *
+ * Coordinates are either given for each led, or generated for a ring or a sphere made of rings.
+ * They are stored in fixed point 2.14, normalized so that the led farthest from the origin
+ * is at distance 1 (16384).
+ */
+class LedGeometry {
+    String type;
+    int count;
+    int16_t *xyz; // x, y, z for each led
+
+    void setCount(int count);
+    void setPoint(int i, float x, float y, float z);
+    void normalize();
+public:
+    LedGeometry();
+    ~LedGeometry();
+
+    /**
+     * Loads the "geometry" element of the hardware configuration, one of
+     *   { "type": "ring", "count": <leds, default all> }
+     *   { "type": "sphere", "rings": [ <leds in each ring, from the top> ] }
+     *   { "type": "points", "points": [ [x, y, z], ... ] }
+     */
+    bool load(const JsonVariant &cfg, int totalLedCount, String *error);
+    void generateRing(int count);
+    void generateSphere(const int *rings, int ringCount);
+
+    int getCount() { return count; }
+    const String &getType() { return type; }
+    int16_t getX(int i) { return xyz[3 * i]; }
+    int16_t getY(int i) { return xyz[3 * i + 1]; }
+    int16_t getZ(int i) { return xyz[3 * i + 2]; }
+};
+
+/**
+ * Spatial index on a scalar field sampled at each led (e.g., a projection on an axis,
+ * or an angle from a point): leds are sorted by value, so that the leds within a band
+ * of values are found with a binary search, and only those are visited.
+ * Values are 0..65535.
+ */
+class LedFieldIndex {
+    int count;
+    uint16_t *leds; // led positions, sorted by value
+    uint16_t *values; // values of the leds above
+public:
+    LedFieldIndex();
+    ~LedFieldIndex();
+
+    void build(int count, std::function<uint16_t(int pos)> valueAt);
+    // index of the first led with a value >= value, getCount() if none
+    int lowerBound(uint16_t value);
+
+    int getCount() { return count; }
+    uint16_t ledAt(int idx) { return leds[idx]; }
+    uint16_t valueAt(int idx) { return values[idx]; }
+};
+
+#endif
+#endif
@@ -29,28 +29,34 @@
 
 
 
-bool LedPwm::init(int pin0, int pin1, int pin2, bool isInverted,
-    ledc_timer_t timer,
-    ledc_channel_t channel0,
-    ledc_channel_t channel1,
-    ledc_channel_t channel2)
+LedPwm::LedPwm()
 {
-    for (int j = 0; j < LED_PWM_LEDCOUNT; j++) {
+    channelCount = 0;
+    isInverted = false;
+    for (int j = 0; j < LED_PWM_MAX_CHANNELS; j++) {
+        ledcChannel[j].gpio_num = -1;
+        curDuty[j] = 0;
+        fade[j].isActive = false;
         animHead[j].animDef = nullptr;
         animHead[j].animHeadIdx = -1;
         animHead[j].state.lastStep = -1;
         animHead[j].state.nextStepTm = 0;
+        animHead[j].state.isDone = true;
     }
+}
 
-    this->isInverted = isInverted;
-    unsigned long tm = millis();
-    for (int j = 0; j < LED_PWM_LEDCOUNT; j++) {
-        lastFadeEndTm[j] = tm;
+bool LedPwm::init(const int *pins, int pinCount, bool isInverted,
+    ledc_timer_t timer,
+    ledc_channel_t firstChannel)
+{
+    if (pinCount < 0 || pinCount > LED_PWM_MAX_CHANNELS - firstChannel) {
+        return false;
     }
+    this->isInverted = isInverted;
 
     ledc_timer_config_t ledcTimer;
     ledcTimer.duty_resolution = LEDC_TIMER_13_BIT;
-    ledcTimer.freq_hz = 5000;
+    ledcTimer.freq_hz = LED_PWM_FREQ_HZ;
     ledcTimer.speed_mode = LEDC_HIGH_SPEED_MODE;
     ledcTimer.timer_num = timer;
 
@@ -59,56 +65,106 @@ bool LedPwm::init(int pin0, int pin1, int pin2, bool isInverted,
         return false;
     }
 
-    for (int j = 0; j < LED_PWM_LEDCOUNT; j++) {
-        ledcChannel[j].channel = (j == 0 ? channel0 : j == 1 ? channel1 : channel2);
-        ledcChannel[j].gpio_num = (gpio_num_t)(j == 0 ? pin0 : j == 1 ? pin1 : pin2);
+    for (int j = 0; j < pinCount; j++) {
+        ledcChannel[j].channel = (ledc_channel_t)(firstChannel + j);
+        ledcChannel[j].gpio_num = (gpio_num_t)pins[j];
         ledcChannel[j].speed_mode = LEDC_HIGH_SPEED_MODE;
         ledcChannel[j].timer_sel = timer;
         ledcChannel[j].intr_type = LEDC_INTR_DISABLE;
         ledcChannel[j].duty = (isInverted ? 8192 : 0);
-        if (ledcChannel[j].gpio_num > 0) {
+        if (ledcChannel[j].gpio_num >= 0) {
             rc = ledc_channel_config(&ledcChannel[j]);
             if (rc != ESP_OK) {
                 return false;
             }
         }
     }
-
-    // Initialize fade service.
-    ledc_fade_func_install(0);
+    channelCount = pinCount;
 
     return true;
 }
 
 void LedPwm::setDuty(int led, uint32_t duty, unsigned fadeMillis)
 {
-    if (ledcChannel[led].gpio_num == -1) {
+    setDuty(led, duty, fadeMillis, (long)millis());
+}
+
+// tm is when the fade starts, it ends at tm + fadeMillis
+void LedPwm::setDuty(int led, uint32_t duty, unsigned fadeMillis, long tm)
+{
+    if (led < 0 || led >= channelCount || ledcChannel[led].gpio_num < 0) {
         return;
     }
-    unsigned long tm = millis();
-    bool stopBeforeSetting = (tm - lastFadeEndTm[led] > 0);
+    uint32_t from = isInverted ? 8192 - curDuty[led] : curDuty[led];
+    uint32_t to = isInverted ? 8192 - duty : duty;
+    curDuty[led] = duty;
 
-    if (fadeMillis > 0) {
-        if (stopBeforeSetting) {
-            uint32_t oldDuty = ledc_get_duty(ledcChannel[led].speed_mode, ledcChannel[led].channel);
-            ledc_stop(ledcChannel[led].speed_mode, ledcChannel[led].channel, isInverted ? HIGH : LOW);
-            ledc_set_duty(ledcChannel[led].speed_mode, ledcChannel[led].channel, oldDuty);
-            ledc_update_duty(ledcChannel[led].speed_mode, ledcChannel[led].channel);
-        }
-        ledc_set_fade_with_time(ledcChannel[led].speed_mode, ledcChannel[led].channel,
-            isInverted ? 8192 - duty : duty, fadeMillis);
-        ledc_fade_start(ledcChannel[led].speed_mode, ledcChannel[led].channel, LEDC_FADE_NO_WAIT);
-        lastFadeEndTm[led] = tm + fadeMillis;
-// Serial.printf("c%d fade to %d\n", led, duty);
-    } else {
-        if (stopBeforeSetting) {
-            ledc_stop(ledcChannel[led].speed_mode, ledcChannel[led].channel, isInverted ? HIGH : LOW);
-        }
-        ledc_set_duty(ledcChannel[led].speed_mode, ledcChannel[led].channel, isInverted ? 8192 - duty : duty);
-        ledc_update_duty(ledcChannel[led].speed_mode, ledcChannel[led].channel);
-        lastFadeEndTm[led] = tm;
-// Serial.printf("c%d set to %d\n", led, duty);
+    if (fadeMillis == 0 || from == to) {
+        // also replaces a fade in progress
+        fade[led].isActive = false;
+        writeDuty(led, to);
+        return;
+    }
+    fade[led].isActive = true;
+    fade[led].to = to;
+    fade[led].endTm = tm + (long)fadeMillis;
+    startFadeSegment(led, from, tm);
+}
+
+void LedPwm::writeDuty(int led, uint32_t hwDuty)
+{
+    ledc_set_duty(ledcChannel[led].speed_mode, ledcChannel[led].channel, hwDuty);
+    ledc_update_duty(ledcChannel[led].speed_mode, ledcChannel[led].channel);
+}
+
+/**
+ * Runs the next segment of the channel's fade, from the given hardware duty, over an equal
+ * share of the remaining time. The fade unit adds dutyScale to the duty every cyclesPerStep
+ * PWM periods, for stepCount steps, starting from the duty given here: no need to wait for a
+ * previous setting to be latched. All three are 10 bits, so the fade is split when:
+ * - its steps would need more than 1023 cycles: segments of at most 1023 steps of a smaller
+ *   scale, down to 1;
+ * - even one duty unit per 1023 cycles is too fast: a segment per duty unit, each one
+ *   waiting for its share of the time after its step.
+ */
+void LedPwm::startFadeSegment(int led, uint32_t from, long tm)
+{
+    Fade *f = &fade[led];
+    long remaining = f->endTm - tm;
+    uint32_t delta = (f->to > from ? f->to - from : from - f->to);
+    if (remaining <= 0 || delta == 0) {
+        f->isActive = false;
+        writeDuty(led, f->to);
+        return;
     }
+
+    uint64_t cycles = (uint64_t)remaining * LED_PWM_FREQ_HZ / 1000;
+    uint32_t dutyScale = (delta + 1022) / 1023;
+    uint32_t stepCount = delta / dutyScale;
+    uint32_t segments;
+    if (cycles <= (uint64_t)stepCount * 1023) {
+        segments = 1;
+    } else if (cycles <= (uint64_t)delta * 1023) {
+        segments = (delta + 1022) / 1023;
+    } else {
+        segments = delta;
+    }
+
+    uint32_t segmentDelta = delta / segments;
+    long segmentMillis = remaining / segments;
+    dutyScale = (segmentDelta + 1022) / 1023;
+    stepCount = segmentDelta / dutyScale;
+    uint64_t cyclesPerStep = (uint64_t)segmentMillis * LED_PWM_FREQ_HZ / 1000 / stepCount;
+    cyclesPerStep = (cyclesPerStep < 1 ? 1 : (cyclesPerStep > 1023 ? 1023 : cyclesPerStep));
+
+    bool isIncreasing = f->to > from;
+    f->segmentTo = (isIncreasing ? from + stepCount * dutyScale : from - stepCount * dutyScale);
+    f->segmentEndTm = (segments == 1 ? f->endTm : tm + segmentMillis);
+    ledc_mode_t mode = ledcChannel[led].speed_mode;
+    ledc_channel_t channel = ledcChannel[led].channel;
+    ledc_set_fade(mode, channel, from, isIncreasing ? LEDC_DUTY_DIR_INCREASE : LEDC_DUTY_DIR_DECREASE,
+        stepCount, (uint32_t)cyclesPerStep, dutyScale);
+    ledc_update_duty(mode, channel);
 }
 
 int LedPwm::defineAnimation(const char *animation, String *error)
@@ -122,9 +178,9 @@ int LedPwm::defineAnimation(const char *animation, String *error)
     int duration;
 
     AnimationDef anim;
-    anim.channels[0] = nullptr;
-    anim.channels[1] = nullptr;
-    anim.channels[2] = nullptr;
+    for (int j = 0; j < LED_PWM_MAX_CHANNELS; j++) {
+        anim.channels[j] = nullptr;
+    }
     SingleChannelAnimationDef *curChannelAnimDef = nullptr;
     bool isOk = true;
     std::vector<AnimationDefEntry> curEntries;
@@ -153,9 +209,9 @@ int LedPwm::defineAnimation(const char *animation, String *error)
                     goto parseTerminated;
                 }
                 p += n;
-                if (channel < 0 || channel > 2) {
+                if (channel < 0 || channel >= LED_PWM_MAX_CHANNELS) {
                     isOk = false;
-                    *error = String("At char ") + (p - animation) + ": Channel must be 0, 1 or 2";
+                    *error = String("At char ") + (p - animation) + ": Channel must be 0.." + (LED_PWM_MAX_CHANNELS - 1);
                     goto parseTerminated;
                 }
                 if (anim.channels[channel] != nullptr) {
@@ -266,14 +322,14 @@ int LedPwm::defineAnimation(const char *animation, String *error)
     parseTerminated:
 
     if (!isOk) {
-        delete anim.channels[0]; anim.channels[0] = nullptr;
-        delete anim.channels[1]; anim.channels[1] = nullptr;
-        delete anim.channels[2]; anim.channels[2] = nullptr;
+        for (int j = 0; j < LED_PWM_MAX_CHANNELS; j++) {
+            delete anim.channels[j]; anim.channels[j] = nullptr;
+        }
         return -1;
     }
 
     int animId = animationDefs.add(anim);
-    for (int j = 0; j < LED_PWM_LEDCOUNT; j++) {
+    for (int j = 0; j < LED_PWM_MAX_CHANNELS; j++) {
         if (anim.channels[j] != nullptr) {
             anim.channels[j]->animId = animId;
         }
@@ -307,7 +363,7 @@ bool LedPwm::getAnimationDef(int id, String *str)
         }
     };
     int isFirst = true;
-    for (int i = 0; i < LED_PWM_LEDCOUNT; i++) {
+    for (int i = 0; i < LED_PWM_MAX_CHANNELS; i++) {
         if (anim->channels[i] != nullptr) {
             if (!isFirst) {
                 str->concat(";");
@@ -334,63 +390,92 @@ bool LedPwm::setAnimation(int level, int animId, uint32_t cycles)
         AnimationElement a;
         a.animId = -1;
         a.cycles = 0;
-        for (int j = 0; j < LED_PWM_LEDCOUNT; j++) {
+        for (int j = 0; j < LED_PWM_MAX_CHANNELS; j++) {
             a.channels[j] = nullptr;
             a.state[j].startTm = 0;
+            a.state[j].finishedCycles = 0;
         }
         animationStack.push_back(a);
     }
     animationStack[level].animId = animId;
     animationStack[level].cycles = cycles;
-    for (int j = 0; j < LED_PWM_LEDCOUNT; j++) {
+    for (int j = 0; j < LED_PWM_MAX_CHANNELS; j++) {
         animationStack[level].channels[j] = anim->channels[j];
         animationStack[level].state[j].finishedCycles = 0;
         animationStack[level].state[j].startTm = tm;
+        // the level restarts, even if it's the current head
+        if (animHead[j].animHeadIdx == level) {
+            animHead[j].animDef = nullptr;
+        }
     }
 
-    recalcHead();
+    recalcHead(tm);
 
     return true;
 }
 
-void LedPwm::recalcHead()
+/**
+ * Accounts for the cycles a hidden level went through since it was last visible.
+ */
+void LedPwm::catchUpCycles(AnimationElement *animEl, int channel, long tm)
 {
-    long tm = (long)millis();
+    uint32_t totalDuration = animEl->channels[channel]->totalDuration;
+    AnimationElement::State *st = &animEl->state[channel];
+    if (totalDuration == 0 || tm - st->startTm < (long)totalDuration) {
+        return;
+    }
+    unsigned int n = (unsigned long)(tm - st->startTm) / totalDuration;
+    st->finishedCycles += n;
+    st->startTm += (long)(n * totalDuration);
+}
 
+void LedPwm::recalcHead(long tm)
+{
     // calculate the current animations by going top-down in stack
-    AnimHead newHead[LED_PWM_LEDCOUNT];
-    for (int j = 0; j < LED_PWM_LEDCOUNT; j++) {
+    AnimHead newHead[LED_PWM_MAX_CHANNELS];
+    for (int j = 0; j < channelCount; j++) {
         newHead[j].animHeadIdx = -1;
         newHead[j].animDef = nullptr;
     }
-    int found = 0; // count channels that we've already found, quit when 3
-    for (int i = animationStack.size() - 1; found < LED_PWM_LEDCOUNT && i >= 0; i--) {
-        for (int j = 0; j < LED_PWM_LEDCOUNT; j++) {
-            if (animationStack[i].channels[j] != nullptr
-                    && newHead[j].animHeadIdx == -1
-                    && (animationStack[i].cycles == 0 || animationStack[i].state->finishedCycles < animationStack[i].cycles)) {
-                newHead[j].animDef = animationStack[i].channels[j];
+    int found = 0; // count channels that we've already found, quit when all are
+    for (int i = animationStack.size() - 1; found < channelCount && i >= 0; i--) {
+        AnimationElement *animEl = &animationStack[i];
+        for (int j = 0; j < channelCount; j++) {
+            if (animEl->channels[j] == nullptr || newHead[j].animHeadIdx != -1) {
+                continue;
+            }
+            if (animHead[j].animHeadIdx != i) {
+                catchUpCycles(animEl, j, tm);
+            }
+            if (animEl->cycles == 0 || animEl->state[j].finishedCycles < animEl->cycles) {
+                newHead[j].animDef = animEl->channels[j];
                 newHead[j].animHeadIdx = i;
                 newHead[j].state.lastStep = -1;
                 newHead[j].state.nextStepTm = tm;
+                newHead[j].state.isDone = false;
                 ++found;
             }
         }
     }
 
-    for (int j = 0; j < LED_PWM_LEDCOUNT; j++) {
+    for (int j = 0; j < channelCount; j++) {
         // if we're cleaning a channel, set its duty to 0
         if (newHead[j].animHeadIdx == -1 && animHead[j].animHeadIdx != -1) {
             setDuty(j, 0);
         }
     }
 
-    for (int j = 0; j < LED_PWM_LEDCOUNT; j++) {
+    for (int j = 0; j < channelCount; j++) {
         if (animHead[j].animDef != newHead[j].animDef || animHead[j].animHeadIdx != newHead[j].animHeadIdx) {
             animHead[j] = newHead[j];
+            if (newHead[j].animHeadIdx == -1) {
+                animHead[j].state.isDone = true;
+            } else {
+                // cycles of the new head are counted from its restart
+                animationStack[newHead[j].animHeadIdx].state[j].startTm = tm;
+            }
         }
     }
-
 }
 
 bool LedPwm::clearAnimation(int level, int animId)
@@ -404,108 +489,106 @@ bool LedPwm::clearAnimation(int level, int animId)
     // clear this level, recalculate curAnimations for the channel.
     animationStack[level].animId = -1;
     animationStack[level].cycles = 0;
-    for (int j = 0; j < LED_PWM_LEDCOUNT; j++) {
+    for (int j = 0; j < LED_PWM_MAX_CHANNELS; j++) {
         animationStack[level].channels[j] = nullptr;
         animationStack[level].state[j].finishedCycles = 0;
         animationStack[level].state[j].startTm = 0;
     }
-    recalcHead();
+    recalcHead((long)millis());
     return true;
 }
 
-uint32_t LedPwm::update()
+/**
+ * Applies the end of the current step of the channel's head (the starting duty for
+ * the very beginning, or the duty of a SET step), then starts the next step: a FADE
+ * step is handed to the LEDC fade unit for its whole duration.
+ */
+bool LedPwm::advanceStep(int j)
 {
-    long tm = (long)millis();
-    for (int i = 0; i < 3; i++) {
-        if ((unsigned long)tm - lastFadeEndTm[i] > 7200000) { // if older than 2h, move it at 1h, so we can always compare with current millis()
-            lastFadeEndTm[i] += 3600000;
+    AnimHead *head = &animHead[j];
+    AnimationElement *animEl = &animationStack[head->animHeadIdx];
+    SingleChannelAnimationDef *animDef = head->animDef;
+    AnimationElement::State *st = &animEl->state[j];
+
+    int curStep = head->state.lastStep;
+    if (curStep == -1) {
+        setDuty(j, animDef->startingDuty);
+    } else {
+        // for a FADE step, writes the exact target, in case the fade ended short of it
+        setDuty(j, animDef->entries[curStep].duty);
+    }
+    ++curStep;
+    if (curStep >= animDef->entriesCount) {
+        if (animDef->totalDuration == 0) {
+            // nothing changes over time, the last duty remains
+            head->state.isDone = true;
+            ++st->finishedCycles;
+            return animEl->cycles > 0;
+        }
+        curStep = 0;
+        ++st->finishedCycles;
+        st->startTm += animDef->totalDuration;
+        if (animEl->cycles > 0 && st->finishedCycles >= animEl->cycles) {
+            head->state.isDone = true;
+            return true;
         }
     }
+    if (animDef->entries[curStep].type == AnimationDefEntry::FADE) {
+        setDuty(j, animDef->entries[curStep].duty, animDef->entries[curStep].duration, head->state.nextStepTm);
+    }
+    head->state.lastStep = curStep;
+    head->state.nextStepTm += (long)animDef->entries[curStep].duration;
+    return false;
+}
 
 // E.g.: c0:255,d500,0,f500,255;c1:0,f1000,255
-    // see if we need to execute a change of pwm in current animation
-    bool needRecalcHead = false;
-    for (int j = 0; j < LED_PWM_LEDCOUNT; j++) {
-        if (animHead[j].animHeadIdx == -1) {
-            continue;
-        }
-        AnimationElement *animEl = &animationStack[animHead[j].animHeadIdx];
-        SingleChannelAnimationDef *animDef = animEl->channels[j];
-
-        bool didSet = false;
-        if (animHead[j].state.nextStepTm - tm <= 0) { // we must execute a step item for this channel
-            int curStep = animHead[j].state.lastStep;
-            if (curStep == -1) {
-                if (animEl->state->finishedCycles == 0) {
-                    setDuty(j, animDef->startingDuty);
-                    didSet = true;
-                }
-            } else {
-                if (animDef->entries[curStep].type == AnimationDefEntry::SET) {
-                    setDuty(j, animDef->entries[curStep].duty);
-                    didSet = true;
-                }
-            }
-            ++curStep;
-            if (curStep >= animDef->entriesCount) {
-                curStep = 0;
-                ++animEl->state->finishedCycles;
-            }
-            if (animEl->cycles > 0 && animEl->state->finishedCycles >= animEl->cycles) {
-                // this channel finished its cycles
-                needRecalcHead = true;
-            } else {
-                if (animDef->entries[curStep].type == AnimationDefEntry::FADE) {
-                    if (didSet) {
-                        delay(1); // otherwise the set duty cycle won't be taken in account by fade
-                    }
-                    setDuty(j, animDef->entries[curStep].duty, animDef->entries[curStep].duration);                    
-                }
-            }
+bool LedPwm::update(uint32_t *millisToNext)
+{
+    long tm = (long)millis();
 
-            animHead[j].state.lastStep = curStep;
-            animHead[j].state.nextStepTm += (long)animDef->entries[curStep].duration;
+    // fade segments that are done, before the steps that may replace the fades
+    for (int j = 0; j < channelCount; j++) {
+        if (fade[j].isActive && fade[j].segmentEndTm - tm <= 0) {
+            startFadeSegment(j, fade[j].segmentTo, tm);
         }
     }
-    if (needRecalcHead) {
-        recalcHead();
-    }
 
-    // update start times of the animation stack
-    for (int i = 0; i < animationStack.size(); i++) {
-        if (animationStack[i].animId != -1) {
-            for (int j = 0; j < LED_PWM_LEDCOUNT; j++) {
-                if (animHead[j].animHeadIdx == i) {
-                    continue; // we've processed this as animHead
-                }
-                if (animationStack[i].channels[j] == nullptr) {
-                    continue;
-                }
-                int totalDuration = animationStack[i].channels[j]->totalDuration;
-                while ((animationStack[i].state[j].startTm + totalDuration) - tm < 0) {
-                    animationStack[i].state[j].startTm += totalDuration;
-                    ++animationStack[i].state[j].finishedCycles;
+    bool needRecalcHead;
+    do {
+        needRecalcHead = false;
+        for (int j = 0; j < channelCount; j++) {
+            // after a late wakeup, all steps that are due run, the last ones prevail
+            while (animHead[j].animHeadIdx != -1 && !animHead[j].state.isDone
+                    && animHead[j].state.nextStepTm - tm <= 0) {
+                if (advanceStep(j)) {
+                    needRecalcHead = true;
                 }
             }
         }
-    }
+        // new heads start now, run their first steps
+        if (needRecalcHead) {
+            recalcHead(tm);
+        }
+    } while (needRecalcHead);
 
-    // calculate next update
-    long tillNextDuration = LONG_MAX; // will contain minimum duration to next step, all channels
-    for (int j = 0; j < LED_PWM_LEDCOUNT; j++) {
-        if (animHead[j].animHeadIdx == -1) {
-            continue;
+    // next deadline, over all channels
+    long tillNextDuration = LONG_MAX;
+    for (int j = 0; j < channelCount; j++) {
+        if (fade[j].isActive && fade[j].segmentEndTm - tm < tillNextDuration) {
+            tillNextDuration = fade[j].segmentEndTm - tm;
         }
-        AnimationElement *animEl = &animationStack[animHead[j].animHeadIdx];
-        if (animEl->cycles > 0 && animEl->state->finishedCycles >= animEl->cycles) {
+        if (animHead[j].animHeadIdx == -1 || animHead[j].state.isDone) {
             continue;
         }
         if (animHead[j].state.nextStepTm - tm < tillNextDuration) {
             tillNextDuration = animHead[j].state.nextStepTm - tm;
         }
     }
-
-    return tillNextDuration > 0 ? (uint32_t)tillNextDuration : 0;
+    if (tillNextDuration == LONG_MAX) {
+        return false;
+    }
+    *millisToNext = (tillNextDuration > 0 ? (uint32_t)tillNextDuration : 0);
+    return true;
 }
 
 /*******************************************************************
@@ -533,9 +616,9 @@ void LedIndicatorService::init(UEventLoop *eventLoop, CommandMgr *commandMgr, Lo
     initCommands(cmd);
 
     // defaults
-    pin0 = -1;
-    pin1 = -1;
-    pin2 = -1;
+    for (int j = 0; j < LED_PWM_MAX_CHANNELS; j++) {
+        pins[j] = -1;
+    }
     isInverted = false;
     animationLevel = 0;
 
@@ -551,23 +634,33 @@ void LedIndicatorService::init(UEventLoop *eventLoop, CommandMgr *commandMgr, Lo
 
     // init data structures
 
-    // init hardware
-    ledPwm.init(pin0, pin1, pin2, isInverted);
+    // init hardware, channels up to the last one with a pin
+    int pinCount = 0;
+    for (int j = 0; j < LED_PWM_MAX_CHANNELS; j++) {
+        if (pins[j] != -1) {
+            pinCount = j + 1;
+        }
+    }
+    if (!ledPwm.init(pins, pinCount, isInverted)) {
+        logger->error("Error initializing led pwm on {} channels", pinCount);
+    }
 
     // timer
-    isUpdating = false;
-
     timer.setCallback([this](UEventLoopTimer *timer) {
-        uint32_t duration = ledPwm.update();
-        if (duration == LONG_MAX) {
-            isUpdating = false;
-        } else {
-            long d = duration == 0 ? 1 : duration;
-            timer->setTimeout(d);
-        }
+        scheduleUpdate();
     });
 }
 
+void LedIndicatorService::scheduleUpdate()
+{
+    uint32_t millisToNext;
+    if (ledPwm.update(&millisToNext)) {
+        timer.setTimeout(millisToNext == 0 ? 1 : millisToNext);
+    } else {
+        timer.cancelTimeout();
+    }
+}
+
 int LedIndicatorService::defineAnimation(const char *animation, String *error)
 {
     return ledPwm.defineAnimation(animation, error);
@@ -584,14 +677,7 @@ bool LedIndicatorService::setAnimation(int level, int animId, uint32_t cycles)
     if (!rc) {
         return false;
     }
-    timer.cancelTimeout();
-    long duration = ledPwm.update();
-    if (duration == LONG_MAX) {
-        isUpdating = false;
-    } else {
-        isUpdating = true;
-        timer.setTimeout(duration);
-    }
+    scheduleUpdate();
     return true;
 }
 
@@ -602,59 +688,30 @@ bool LedIndicatorService::clearAnimation(int level, int animId)
         return false;
     }
 
-    timer.cancelTimeout();
-    long duration = ledPwm.update();
-    if (duration == LONG_MAX) {
-        isUpdating = false;
-    } else {
-        isUpdating = true;
-        timer.setTimeout(duration);
-    }
+    scheduleUpdate();
     return true;
 }
 
 
 void LedIndicatorService::initCommands(ServiceCommands *cmd)
 {
-    cmd->registerIntData(
-        ServiceCommands::IntDataBuilder("pin0", true)
-        .cmd("pin0")
-        .help("--> Set led pin 0, set to -1 for no led; requires reboot.")
-        .vMin(-1)
-        .vMax(99)
-        .ptr(&pin0)
-        .setFn([this](int val, bool isLoading, String *msg) -> bool {
-            pin0 = val;
-            *msg = "Led pin set to "; *msg += pin0; *msg += ", please reboot.";
-            return true;
-        })
-    );
-    cmd->registerIntData(
-        ServiceCommands::IntDataBuilder("pin1", true)
-        .cmd("pin1")
-        .help("--> Set led pin 1, set to -1 for no led; requires reboot.")
-        .vMin(-1)
-        .vMax(99)
-        .ptr(&pin1)
-        .setFn([this](int val, bool isLoading, String *msg) -> bool {
-            pin1 = val;
-            *msg = "Led pin set to "; *msg += pin1; *msg += ", please reboot.";
-            return true;
-        })
-    );
-    cmd->registerIntData(
-        ServiceCommands::IntDataBuilder("pin2", true)
-        .cmd("pin2")
-        .help("--> Set led pin 2, set to -1 for no led; requires reboot.")
-        .vMin(-1)
-        .vMax(99)
-        .ptr(&pin2)
-        .setFn([this](int val, bool isLoading, String *msg) -> bool {
-            pin2 = val;
-            *msg = "Led pin set to "; *msg += pin2; *msg += ", please reboot";
-            return true;
-        })
-    );
+    static const char *pinNames[LED_PWM_MAX_CHANNELS] = { "pin0", "pin1", "pin2", "pin3", "pin4", "pin5", "pin6", "pin7" };
+    for (int j = 0; j < LED_PWM_MAX_CHANNELS; j++) {
+        int *pin = &pins[j];
+        cmd->registerIntData(
+            ServiceCommands::IntDataBuilder(pinNames[j], true)
+            .cmd(pinNames[j], true)
+            .help("--> Set the pin of this led channel, set to -1 for no led; requires reboot.")
+            .vMin(-1)
+            .vMax(99)
+            .ptr(pin)
+            .setFn([pin](int val, bool isLoading, String *msg) -> bool {
+                *pin = val;
+                *msg = "Led pin set to "; *msg += *pin; *msg += ", please reboot.";
+                return true;
+            })
+        );
+    }
     cmd->registerBoolData(
         ServiceCommands::BoolDataBuilder("inverted", true)
         .cmd("inverted")
@@ -669,6 +726,7 @@ void LedIndicatorService::initCommands(ServiceCommands *cmd)
         .isPersistent(false)
         .setFn([this](int val, bool isLoading, String *msg) {
             ledPwm.setDuty(0, val, 5000);
+            scheduleUpdate();
             *msg = "Fading";
             return true;
         })
@@ -680,6 +738,7 @@ void LedIndicatorService::initCommands(ServiceCommands *cmd)
         .isPersistent(false)
         .setFn([this](int val, bool isLoading, String *msg) {
             ledPwm.setDuty(0, val, 0);
+            scheduleUpdate();
             *msg = "Setting";
             return true;
         })
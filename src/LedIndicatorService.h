@@ -14,13 +14,39 @@
 #include "Util.h"
 #include <driver/ledc.h>
 
-#define LED_PWM_LEDCOUNT 3
-
-
+#define LED_PWM_MAX_CHANNELS 8 // LEDC channels of one speed mode
+#define LED_PWM_FREQ_HZ 5000
+
+/**
+ * Animations on PWM channels, event-driven: update() runs the steps that are due and
+ * returns the time until the next one, over all channels, so that a single timer is armed
+ * for exactly that instant. Fades run in the LEDC fade unit, so nothing runs between
+ * the keyframes of an animation, apart from the segments of a fade too long or too slow
+ * for the fade unit.
+ *
+ * Only the head of each channel (the topmost level of the animation stack defining
+ * the channel) has deadlines. Levels that are hidden keep counting cycles while hidden,
+ * this is accounted for when they become visible again, so they need no wakeups.
+ */
 class LedPwm {
-    ledc_channel_config_t ledcChannel[LED_PWM_LEDCOUNT];
+    int channelCount; // channels 0..channelCount-1 are configured, those without a pin have gpio_num -1
+    ledc_channel_config_t ledcChannel[LED_PWM_MAX_CHANNELS];
     bool isInverted;
-    uint32_t lastFadeEndTm[LED_PWM_LEDCOUNT];
+    uint32_t curDuty[LED_PWM_MAX_CHANNELS]; // target of the last set or fade, not inverted
+
+    /**
+     * Fade in progress on a channel, in hardware duty. The fade unit's step count, cycles per
+     * step and duty scale are 10 bits: a fade that doesn't fit in one run of the fade unit goes
+     * in consecutive segments, each started when the previous one ends. The exact target is
+     * written at the end, the fade unit may stop short of it by less than the duty scale.
+     */
+    struct Fade {
+        bool isActive;
+        uint32_t to; // hardware duty at the end of the fade
+        uint32_t segmentTo; // hardware duty reached by the running segment
+        long endTm; // millis
+        long segmentEndTm;
+    } fade[LED_PWM_MAX_CHANNELS];
 
     /**
      * Format for led animation
@@ -29,7 +55,7 @@ class LedPwm {
      *
      * <channel annimation>:<value>(,<delay with or without fading>,<value>)*
      *
-     * <channel>: c<n 0..2>
+     * <channel>: c<n 0..7>
      * <value>: <n 0..255> ---> currently 8192
      * <delay without fading to next value>: d<n millis>
      * <delay with fading>: f<n millis>
@@ -65,7 +91,7 @@ class LedPwm {
     };
     // zero or one animation per channel
     struct AnimationDef {
-        SingleChannelAnimationDef *channels[LED_PWM_LEDCOUNT];
+        SingleChannelAnimationDef *channels[LED_PWM_MAX_CHANNELS];
     };
     // reference of all defined animations
     Register<AnimationDef> animationDefs;
@@ -73,13 +99,13 @@ class LedPwm {
 
     struct AnimationElement {
         int animId; // animation that is set for this level, -1 if none. Can't use a pointer because we're referencing into a vector
-        SingleChannelAnimationDef *channels[LED_PWM_LEDCOUNT]; // simply copied from AnimationDef
+        SingleChannelAnimationDef *channels[LED_PWM_MAX_CHANNELS]; // simply copied from AnimationDef
         uint32_t cycles; // 0 if until removed
         struct State { // state of each of the channels (only for defined channels, where channels[j] != nullptr)
             // start time for this iteration
             long startTm; // advances always modulo channel's totalDuration
             unsigned int finishedCycles;
-        } state[LED_PWM_LEDCOUNT];
+        } state[LED_PWM_MAX_CHANNELS];
     };
     std::vector<AnimationElement> animationStack;
 
@@ -92,19 +118,29 @@ class LedPwm {
         struct State { // in addition to animationStack[animHeadIdx].state[channel]
             int lastStep; // index in channels[]->entries, -1 for the very beginning
             long nextStepTm; // when is planned execution of next step
+            bool isDone; // no more steps: static animation, or cycles exhausted
         } state;
-    } animHead[LED_PWM_LEDCOUNT];
+    } animHead[LED_PWM_MAX_CHANNELS];
 
-    void recalcHead();
+    void setDuty(int led, uint32_t duty, unsigned fadeMillis, long tm);
+    void writeDuty(int led, uint32_t hwDuty);
+    void startFadeSegment(int led, uint32_t from, long tm);
+    void recalcHead(long tm);
+    void catchUpCycles(AnimationElement *animEl, int channel, long tm);
+    // returns true if the channel's animation exhausted its cycles
+    bool advanceStep(int channel);
 
 public:
-    bool init(int pin0, int pin1, int pin2, bool isInverted,
+    LedPwm();
+
+    // pins[j] is the pin of channel j, -1 for none; channels use consecutive LEDC channels from firstChannel
+    bool init(const int *pins, int pinCount, bool isInverted,
         ledc_timer_t timer = LEDC_TIMER_0,
-        ledc_channel_t channel0 = LEDC_CHANNEL_0,
-        ledc_channel_t channel1 = LEDC_CHANNEL_1,
-        ledc_channel_t channel2 = LEDC_CHANNEL_2);
+        ledc_channel_t firstChannel = LEDC_CHANNEL_0);
+
+    int getChannelCount() { return channelCount; }
 
-    // Duty goes from 0 to 8192.
+    // Duty goes from 0 to 8192. A fade needs update() to be called until it ends.
     void setDuty(int led, uint32_t duty, unsigned fadeMillis = 0);
 
     // returns -1 if incorrect syntax, in which case "error" is filled
@@ -121,11 +157,11 @@ public:
     // returns true if the level was cleared
     bool clearAnimation(int level, int animId = -1);
 
-    // perform any necessary transition, if any
-    // return the number of milliseconds until the next transition
-    // update() does not need to be called until the next transition, but it can be called (and will do nothing).
-    // update() must be called in time for processing next transition.
-    uint32_t update();
+    // Performs the transitions that are due, if any.
+    // Returns false if no transition is planned, else sets *millisToNext to the time until the next one,
+    // over all channels. update() must be called in time for the next transition, it may be called
+    // earlier (and will do nothing).
+    bool update(uint32_t *millisToNext);
 };
 
 
@@ -148,14 +184,13 @@ private:
     Logger *logger;
 
     UEventLoopTimer timer;
-    bool isUpdating;
 
     void initCommands(ServiceCommands *cmd);
     void initDfa();
+    // runs due transitions and arms the timer for the next one
+    void scheduleUpdate();
 
-    int pin0;
-    int pin1;
-    int pin2;
+    int pins[LED_PWM_MAX_CHANNELS];
     bool isInverted;
     int animationLevel;
 
@@ -72,6 +72,12 @@ void Shape::paramsCalc()
         leading.setValue(i, val);
     }
     leading.setValue(20, valMin);
+
+    for (int i = 0; i <= SHAPE_LUT_SIZE; i++) {
+        float v = shapeAt(lengthLeds * i / SHAPE_LUT_SIZE) * 256.0 + 0.5;
+        lut[i] = v < 0 ? 0 : (v > 65535 ? 65535 : (uint16_t)v);
+    }
+    lutIndexScale = (int64_t)((double)SHAPE_LUT_SIZE * 16777216.0 / lengthLeds + 0.5); // N * 2^24 / lengthLeds
 }
 
 float Shape::shapeAt(float x)
@@ -93,6 +99,7 @@ LedMeteorEffect::LedMeteorEffect(int controllerId, LedMap1d *leds, int totalLedC
     this->ledStart = defaultLedStart;
     this->ledCount = defaultLedCount;
     isMappingEnabled = true;
+    isFixedPoint = true;
 }
 
 LedMeteorEffect::~LedMeteorEffect()
@@ -278,6 +285,8 @@ void LedMeteorEffect::init(int millisPerFrame, CommandMgr *commandMgr, uint32_t
             .ptr(&isMappingEnabled)
     );
 
+    setCmd(cmd, "fixedPoint", "--> If true, render using fixed point lookup tables, else using float shape functions", &isFixedPoint);
+
     setCmd(cmd, "valMin", "--> Minimum brightness, 0..255", &shape.valMin, 0, 255);
     setCmd(cmd, "valMax", "--> Maximum brightness, 0..255", &shape.valMax, 0, 255);
 
@@ -322,6 +331,8 @@ void LedMeteorEffect::init(int millisPerFrame, CommandMgr *commandMgr, uint32_t
     );
 
 
+    registerLayerCommands(cmd);
+
     isEnabled = false;
 
     String msg;
@@ -377,6 +388,8 @@ void LedMeteorEffect::calcFrameProperties()
 
 void LedMeteorEffect::calc(uint32_t frame)
 {
+    // more than one frame elapsed if frames were skipped
+    uint32_t elapsedFrames = frame > lastFrame ? frame - lastFrame : 1;
     lastFrame = frame;
 
     if (!isEnabled) {
@@ -416,7 +429,7 @@ void LedMeteorEffect::calc(uint32_t frame)
 
     if (isRunning) {
         float ledsPerFrame = timing.speedLedsPerSec / 1000.0 * this->millisPerFrame;
-        curXStart += ledsPerFrame;
+        curXStart += ledsPerFrame * elapsedFrames;
         float fFirstLed = floor(curXStart);
         int firstLed = (int)fFirstLed;
         int lastLed = (int)ceil(curXStart + shape.lengthLeds);
@@ -451,6 +464,11 @@ void LedMeteorEffect::calc(uint32_t frame)
                 lastLedWeight = 1.0;
             }
 
+            if (isFixedPoint) {
+                renderFixed(frame, firstLed, lastLed, xFirstLed, firstLedWeight, lastLedWeight);
+                return;
+            }
+
             for (int i = firstLed; i < lastLed; i++) {
                 float x = xFirstLed + (i - firstLed);
                 float val = shape.shapeAt(timing.speedLedsPerSec > 0 ? x : shape.lengthLeds - x);
@@ -480,6 +498,45 @@ void LedMeteorEffect::calc(uint32_t frame)
     }
 }
 
+/**
+ * Same rendering as the float loop in calc(), with all per led work in integers:
+ * the position and the hue are stepped in fixed point 16.16, the shape comes from its lookup table.
+ */
+void LedMeteorEffect::renderFixed(uint32_t frame, int firstLed, int lastLed, float xFirstLed, float firstLedWeight, float lastLedWeight)
+{
+    bool isForward = timing.speedLedsPerSec > 0;
+    float xShape = isForward ? xFirstLed : shape.lengthLeds - xFirstLed;
+    int32_t x = (int32_t)(xShape * 65536.0f);
+    int32_t dx = isForward ? 65536 : -65536;
+    uint32_t firstWeight = (uint32_t)(firstLedWeight * 256.0f + 0.5f); // 0..256
+    uint32_t lastWeight = (uint32_t)(lastLedWeight * 256.0f + 0.5f);
+
+    // only the hue modulo 256 matters, so 16.16 arithmetic may wrap around
+    bool hasHueShift = color.hueShiftInShape != 0.0 || color.hueShiftInRun != 0.0;
+    uint32_t hue = (uint32_t)startingHue << 16;
+    int32_t dHue = 0;
+    if (hasHueShift) {
+        float h = fmodf(hueShiftInShapePerLed * xShape + hueShiftInRunPerFrame * (frame - startingFrame) + 0.5f, 256.0f);
+        hue += (uint32_t)(int32_t)(h * 65536.0f);
+        dHue = (int32_t)(fmodf(hueShiftInShapePerLed, 256.0f) * 65536.0f);
+        if (!isForward) {
+            dHue = -dHue;
+        }
+    }
+
+    for (int i = firstLed; i < lastLed; i++, x += dx, hue += dHue) {
+        uint32_t val = shape.shapeAtFixed(x);
+        if (i == firstLed) {
+            val = (val * firstWeight) >> 8;
+        }
+        if (i == lastLed - 1) {
+            val = (val * lastWeight) >> 8;
+        }
+        CRGB *led = isMappingEnabled ? leds->at(ledStart + i) : leds->atWithoutMapping(ledStart + i);
+        led->setHSV((uint8_t)(hue >> 16), startingSaturation, (uint8_t)((val + 128) >> 8));
+    }
+}
+
 /*
 
 stats
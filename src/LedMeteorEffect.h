@@ -36,6 +36,9 @@ inline InterpolatedFunction::~InterpolatedFunction()
     delete[] values;
 }
 
+// number of intervals in the fixed point lookup table of a shape
+#define SHAPE_LUT_SIZE 256
+
 struct Shape {
     // shape
     float lengthLeds;
@@ -60,14 +63,37 @@ struct Shape {
 
     void paramsCalc();
     float shapeAt(float x);
+    /**
+     * Same as shapeAt(), using the lookup table built by paramsCalc(): x is in leds,
+     * fixed point 16.16, the result is a value fixed point 8.8.
+     */
+    uint16_t shapeAtFixed(int32_t x);
 
 private:
     float xTrailing;
     float xLeading;
     InterpolatedFunction trailing;
     InterpolatedFunction leading;
+
+    uint16_t lut[SHAPE_LUT_SIZE + 1]; // shapeAt() sampled over [0, lengthLeds], fixed point 8.8
+    int64_t lutIndexScale; // x (16.16) * lutIndexScale >> 32 gives the lut index, fixed point 24.8
 };
 
+inline uint16_t Shape::shapeAtFixed(int32_t x)
+{
+    if (x < 0) {
+        return (uint16_t)(valMin << 8);
+    }
+    uint32_t idx = (uint32_t)(((int64_t)x * lutIndexScale) >> 32);
+    uint32_t slot = idx >> 8;
+    if (slot >= SHAPE_LUT_SIZE) {
+        return slot == SHAPE_LUT_SIZE && (idx & 0xFF) == 0 ? lut[SHAPE_LUT_SIZE] : (uint16_t)(valMin << 8);
+    }
+    int32_t v0 = lut[slot];
+    int32_t v1 = lut[slot + 1];
+    return (uint16_t)(v0 + (((v1 - v0) * (int32_t)(idx & 0xFF)) >> 8));
+}
+
 
 struct ColorParams {
 
@@ -159,6 +185,7 @@ private:
     int ledStart;
     int ledCount;
     bool isMappingEnabled;
+    bool isFixedPoint; // render with the fixed point lookup tables, else with the float shape functions
 
     Shape shape;
     ColorParams color;
@@ -182,6 +209,7 @@ private:
     void reinitLedState(uint32_t frame);
     void calcFrameProperties();
     int getRndExp();
+    void renderFixed(uint32_t frame, int firstLed, int lastLed, float xFirstLed, float firstLedWeight, float lastLedWeight);
 
     void setCmd(ServiceCommands *cmd, const char *commandStr, const char *help, uint8_t *data, int min, int max);
     void setCmd(ServiceCommands *cmd, const char *commandStr, const char *help, int *data, int min, int max);
@@ -0,0 +1,366 @@
+#include "CompilationOpts.h"
+
+#if defined(USE_LED) && defined(USE_JS)
+
+#include <HardwareSerial.h>
+#include <FS.h>
+#include <SPIFFS.h>
+#include <FastLED.h>
+#include "UEvent.h"
+#include "CommandMgr.h"
+#include "LedService.h"
+#include "LedScriptEffect.h"
+
+// budget for running the top level of the script, which defines render()
+#define SCRIPT_LOAD_BUDGET_MICROS 200000
+
+#define BYTECODE_MAGIC 0x43424B44 // "DKBC"
+
+struct BytecodeHeader {
+    uint32_t magic;
+    uint32_t version; // DUK_VERSION, bytecode is not portable across versions
+    uint32_t sourceHash;
+    uint32_t length; // of the bytecode following the header
+};
+
+static uint32_t fnv1a(const char *data, size_t len)
+{
+    uint32_t h = 2166136261u;
+    for (size_t i = 0; i < len; i++) {
+        h = (h ^ (uint8_t)data[i]) * 16777619u;
+    }
+    return h;
+}
+
+// duk_load_function() throws on malformed bytecode, run it protected
+static duk_ret_t safeLoadFunction(duk_context *ctx, void *udata)
+{
+    duk_load_function(ctx);
+    return 1;
+}
+
+ScriptEffect::ScriptEffect(int controllerId, LedMap1d *leds, int totalLedCount, int defaultLedStart, int defaultLedCount,
+    const char *scriptFile, const char *description)
+    : Effect(controllerId, leds, totalLedCount, description)
+{
+    isEnabled = false;
+    ledStart = constrain(defaultLedStart, 0, totalLedCount);
+    ledCount = constrain(defaultLedCount, 0, totalLedCount - ledStart);
+    this->scriptFile = scriptFile;
+    budgetMicros = 5000;
+    millisPerFrame = 33;
+
+    ctx = nullptr;
+    ledBytes = nullptr;
+    ledBytesCount = 0;
+    deadline = 0;
+
+    callCount = 0;
+    errorCount = 0;
+    timeoutCount = 0;
+    avgCallMicros = 0;
+    isFromBytecode = false;
+}
+
+ScriptEffect::~ScriptEffect()
+{
+    unloadScript();
+}
+
+void ScriptEffect::init(int millisPerFrame, CommandMgr *commandMgr, uint32_t frame)
+{
+    String controllerName = "led"; controllerName += controllerId;
+    cmd = commandMgr->getServiceCommands(controllerName.c_str());
+
+    cmd->onAfterLoad([this](String *msg) { this->onAfterLoad(); });
+
+    cmd->registerBoolData(
+        ServiceCommands::BoolDataBuilder("isEnabled", true)
+            .cmdOn("enable")
+            .cmdOff("disable")
+            .helpOn("--> Enable this controller")
+            .helpOff("--> Disable this controller")
+            .ptr(&isEnabled)
+    );
+
+    cmd->registerStringData(
+        ServiceCommands::StringDataBuilder("script", true)
+        .cmd("script")
+        .help("script <file> --> Javascript file defining render(leds, frame, millis), reloaded when set")
+        .setFn([this](const String &val, bool isLoading, String *msg) {
+            scriptFile = val;
+            if (!isLoading) {
+                if (!loadScript(msg)) {
+                    return false;
+                }
+                *msg = "Loaded "; msg->concat(scriptFile);
+                msg->concat(isFromBytecode ? " from bytecode cache" : ", bytecode cached");
+            }
+            return true;
+        })
+        .getFn([this](String *val) {
+            *val = scriptFile;
+        })
+    );
+
+    cmd->registerIntData(
+        ServiceCommands::IntDataBuilder("budgetMicros", true)
+        .cmd("budgetMicros")
+        .help("--> CPU budget of each call to render(), in micro-seconds; the frame is skipped when exceeded")
+        .vMin(100)
+        .vMax(100000)
+        .ptr(&budgetMicros)
+    );
+
+    cmd->registerBoolData(
+        ServiceCommands::BoolDataBuilder("reload", true)
+        .cmdOn("reload")
+        .helpOn("--> Reload the script, recompiling it if it changed")
+        .isPersistent(false)
+        .setFn([this](bool val, bool isLoading, String *msg) {
+            if (!loadScript(msg)) {
+                return false;
+            }
+            *msg = "Loaded "; msg->concat(scriptFile);
+            msg->concat(isFromBytecode ? " from bytecode cache" : ", bytecode cached");
+            return true;
+        })
+    );
+
+    registerLayerCommands(cmd);
+
+    String msg;
+    bool rc = cmd->load(nullptr, &msg);
+    if (!rc) {
+        Serial.printf("LedController %s: error loading defaults: %s\n", cmd->getServiceName(), msg.c_str());
+    } else {
+        String keyName;
+        cmd->getCurrentKeyName(&keyName);
+        Serial.printf("Loaded config for %s/%s\n", cmd->getServiceName(), keyName.c_str());
+    }
+
+    this->millisPerFrame = millisPerFrame;
+    onAfterLoad();
+}
+
+// setting "script" already loads it, this covers configurations without one
+void ScriptEffect::onAfterLoad()
+{
+    String msg;
+    if (ctx == nullptr && !loadScript(&msg)) {
+        Serial.printf("LedController %s: %s\n", cmd->getServiceName(), msg.c_str());
+    }
+}
+
+void ScriptEffect::setFrameDuration(int millis)
+{
+    this->millisPerFrame = millis;
+}
+
+void ScriptEffect::unloadScript()
+{
+    if (ctx != nullptr) {
+        duk_destroy_heap(ctx);
+        ctx = nullptr;
+    }
+    ledBytes = nullptr;
+    ledBytesCount = 0;
+}
+
+/**
+ * Leaves the compiled program on the stack, from the bytecode cache when its hash
+ * matches the source, else compiling the source and updating the cache.
+ */
+bool ScriptEffect::compileOrLoadCached(const String &source, String *msg)
+{
+    String cacheFile = scriptFile + "bc";
+    uint32_t hash = fnv1a(source.c_str(), source.length());
+
+    File f = SPIFFS.open(cacheFile, "r");
+    if (f) {
+        BytecodeHeader h;
+        bool isValid = f.read((uint8_t *)&h, sizeof(h)) == sizeof(h)
+            && h.magic == BYTECODE_MAGIC && h.version == DUK_VERSION && h.sourceHash == hash
+            && h.length > 0 && h.length == f.size() - sizeof(h);
+        if (isValid) {
+            uint8_t *p = (uint8_t *)duk_push_fixed_buffer(ctx, h.length);
+            isValid = f.read(p, h.length) == h.length
+                && duk_safe_call(ctx, safeLoadFunction, nullptr, 1, 1) == DUK_EXEC_SUCCESS;
+            if (!isValid) {
+                duk_pop(ctx);
+            }
+        }
+        f.close();
+        if (isValid) {
+            isFromBytecode = true;
+            return true;
+        }
+    }
+
+    duk_push_lstring(ctx, source.c_str(), source.length());
+    duk_push_string(ctx, scriptFile.c_str());
+    if (duk_pcompile(ctx, 0) != 0) {
+        *msg = "Error compiling "; *msg += scriptFile; *msg += ": "; *msg += duk_safe_to_string(ctx, -1);
+        duk_pop(ctx);
+        return false;
+    }
+    isFromBytecode = false;
+
+    duk_dump_function(ctx);
+    duk_size_t len;
+    uint8_t *p = (uint8_t *)duk_get_buffer_data(ctx, -1, &len);
+    f = SPIFFS.open(cacheFile, "w");
+    if (f) {
+        BytecodeHeader h = { BYTECODE_MAGIC, DUK_VERSION, hash, (uint32_t)len };
+        f.write((uint8_t *)&h, sizeof(h));
+        f.write(p, len);
+        f.close();
+    } else {
+        Serial.printf("LedController %s: cannot write bytecode cache %s\n", cmd->getServiceName(), cacheFile.c_str());
+    }
+    duk_load_function(ctx);
+    return true;
+}
+
+bool ScriptEffect::loadScript(String *msg)
+{
+    unloadScript();
+    loadError = "";
+    if (scriptFile.length() == 0) {
+        loadError = "No script";
+        *msg = loadError;
+        return false;
+    }
+
+    File f = SPIFFS.open(scriptFile, "r");
+    if (!f) {
+        loadError = String("Cannot open script ") + scriptFile;
+        *msg = loadError;
+        return false;
+    }
+    String source = f.readString();
+    f.close();
+
+    ctx = duk_create_heap(nullptr, nullptr, nullptr, &deadline, nullptr);
+    if (ctx == nullptr) {
+        loadError = "Cannot create javascript heap";
+        *msg = loadError;
+        return false;
+    }
+
+    if (!compileOrLoadCached(source, &loadError)) {
+        *msg = loadError;
+        unloadScript();
+        return false;
+    }
+
+    // run the top level of the script
+    deadline = Esp32Timer::currentTime() + SCRIPT_LOAD_BUDGET_MICROS;
+    int rc = duk_pcall(ctx, 0);
+    deadline = 0;
+    if (rc != DUK_EXEC_SUCCESS) {
+        loadError = String("Error running ") + scriptFile + ": " + duk_safe_to_string(ctx, -1);
+        *msg = loadError;
+        unloadScript();
+        return false;
+    }
+    duk_pop(ctx);
+
+    // keep render() and the led buffer in the stash, so that each frame only looks them up
+    duk_push_global_stash(ctx);
+    duk_get_global_string(ctx, "render");
+    if (!duk_is_function(ctx, -1)) {
+        loadError = scriptFile + " does not define a function render(leds, frame, millis)";
+        *msg = loadError;
+        unloadScript();
+        return false;
+    }
+    duk_put_prop_string(ctx, -2, "render");
+
+    ledBytesCount = 3 * ledCount;
+    ledBytes = (uint8_t *)duk_push_fixed_buffer(ctx, ledBytesCount);
+    duk_push_buffer_object(ctx, -1, 0, ledBytesCount, DUK_BUFOBJ_UINT8ARRAY);
+    duk_put_prop_string(ctx, -3, "leds");
+    duk_pop_2(ctx);
+
+    callCount = 0;
+    errorCount = 0;
+    timeoutCount = 0;
+    avgCallMicros = 0;
+    lastError = "";
+    return true;
+}
+
+void ScriptEffect::getOneLineStatus(String *msg)
+{
+    *msg += "Type: script "; *msg += scriptFile;
+    *msg += ", leds start at "; *msg += ledStart; *msg += ", for "; *msg += ledCount; *msg += " leds";
+    if (loadError.length() > 0) {
+        *msg += " ("; *msg += loadError; *msg += ")";
+    }
+    *msg += ". Controller is ";
+    *msg += (this->isEnabled ? "enabled." : "disabled.");
+}
+
+void ScriptEffect::calc(uint32_t frame)
+{
+    if (!isEnabled || ctx == nullptr) {
+        return;
+    }
+
+    memset(ledBytes, 0, ledBytesCount);
+    duk_push_global_stash(ctx);
+    duk_get_prop_string(ctx, -1, "render");
+    duk_get_prop_string(ctx, -2, "leds");
+    duk_push_uint(ctx, frame);
+    duk_push_number(ctx, (double)frame * millisPerFrame);
+
+    uint64_t start = Esp32Timer::currentTime();
+    deadline = start + budgetMicros;
+    int rc = duk_pcall(ctx, 3);
+    deadline = 0;
+    uint32_t duration = Esp32Timer::currentTime() - start;
+
+    ++callCount;
+    avgCallMicros = (avgCallMicros == 0 ? (duration << 4) : avgCallMicros * 63 / 64 + (duration << 4) / 64);
+    if (rc != DUK_EXEC_SUCCESS) {
+        if (duration >= (uint32_t)budgetMicros) {
+            ++timeoutCount;
+        } else {
+            ++errorCount;
+        }
+        lastError = duk_safe_to_string(ctx, -1);
+        duk_pop_2(ctx);
+        return;
+    }
+    duk_pop_2(ctx);
+
+    for (int i = 0; i < ledCount; i++) {
+        const uint8_t *p = ledBytes + 3 * i;
+        if (p[0] != 0 || p[1] != 0 || p[2] != 0) {
+            leds->at(ledStart + i)->setRGB(p[0], p[1], p[2]);
+        }
+    }
+}
+
+void ScriptEffect::printStats()
+{
+    String msg;
+    printStats(&msg);
+    Serial.printf("  %s\n", msg.c_str());
+}
+
+void ScriptEffect::printStats(String *msg)
+{
+    *msg += cmd->getServiceName();
+    *msg += " -- Calls: "; *msg += callCount;
+    *msg += ", avg "; *msg += (avgCallMicros >> 4); *msg += " us";
+    *msg += ", over budget: "; *msg += timeoutCount;
+    *msg += ", errors: "; *msg += errorCount;
+    *msg += (isFromBytecode ? ", from bytecode cache" : ", compiled");
+    if (lastError.length() > 0) {
+        *msg += ", last error: "; *msg += lastError;
+    }
+}
+
+#endif // USE_LED && USE_JS
@@ -0,0 +1,72 @@
+#ifndef INCL_LED_SCRIPT_EFFECT_H
+#define INCL_LED_SCRIPT_EFFECT_H
+
+#include "CompilationOpts.h"
+
+#if defined(USE_LED) && defined(USE_JS)
+
+#include <FastLED.h>
+#include "DuktapeOpts.h"
+#include "UEvent.h"
+#include "CommandMgr.h"
+#include "LedService.h"
+
+/**
+ * Effect running a javascript function on each frame.
+ *
+ * The script, a file on SPIFFS, must define a global function
+ *     render(leds, frame, millis)
+ * where leds is a Uint8Array of 3 * ledCount bytes (r, g, b for each led of the span),
+ * cleared before each call; black leds are left transparent.
+ *
+ * The compiled script is cached as bytecode next to the script (".jsbc"), tagged with a hash
+ * of the source, so that reloads skip parsing. Each call runs with a CPU budget: when it is
+ * exceeded, the execution timeout check of duktape aborts the call and the frame is skipped.
+ */
+class ScriptEffect: public Effect {
+    friend class LedService;
+private:
+    bool isEnabled;
+    ServiceCommands *cmd;
+    int ledStart;
+    int ledCount;
+
+    String scriptFile;
+    int budgetMicros;
+
+    duk_context *ctx;
+    uint8_t *ledBytes; // data of the Uint8Array passed to render()
+    int ledBytesCount;
+    uint64_t deadline; // end of the budget of the current call, 0 if no call is running
+    String loadError;
+
+    // stats
+    uint32_t callCount;
+    uint32_t errorCount;
+    uint32_t timeoutCount;
+    uint32_t avgCallMicros; // << 4
+    bool isFromBytecode; // whether the script was loaded from the bytecode cache
+    String lastError;
+
+    bool loadScript(String *msg);
+    void unloadScript();
+    bool compileOrLoadCached(const String &source, String *msg);
+
+public:
+    ScriptEffect(int controllerId, LedMap1d *leds, int totalLedCount, int defaultLedStart, int defaultLedCount,
+        const char *scriptFile, const char *description);
+    virtual ~ScriptEffect();
+    virtual void init(int millisPerFrame, CommandMgr *commandMgr, uint32_t frame);
+    virtual void setFrameDuration(int millisPerFrame);
+    virtual void onAfterLoad();
+    virtual void getOneLineStatus(String *msg);
+    virtual void calc(uint32_t frame);
+    virtual void printStats();
+    virtual void printStats(String *msg);
+
+private:
+    int millisPerFrame;
+};
+
+#endif
+#endif
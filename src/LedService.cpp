@@ -11,6 +11,8 @@
 #include "LedService.h"
 #include "LedSparkEffect.h"
 #include "LedMeteorEffect.h"
+#include "LedFieldEffect.h"
+#include "LedScriptEffect.h"
 
 Effect::Effect(int controllerId, LedMap1d *leds, int totalLedCount, const char *description)
 {
@@ -18,12 +20,73 @@ Effect::Effect(int controllerId, LedMap1d *leds, int totalLedCount, const char *
     this->totalLedCount = totalLedCount;
     this->controllerId = controllerId;
     this->description = description;
+    this->blendMode = LED_BLEND_ALPHA;
+    this->opacity = 255;
 }
 
 Effect::~Effect()
 {
 }
 
+void Effect::setLayerParams(LedBlendMode blendMode, int opacity)
+{
+    this->blendMode = blendMode;
+    this->opacity = opacity;
+}
+
+const char *Effect::blendModeName(LedBlendMode mode)
+{
+    switch (mode) {
+    case LED_BLEND_ALPHA: return "alpha";
+    case LED_BLEND_ADD: return "add";
+    case LED_BLEND_MAX: return "max";
+    case LED_BLEND_MULTIPLY: return "multiply";
+    }
+    return "?";
+}
+
+bool Effect::parseBlendMode(const char *name, LedBlendMode *mode)
+{
+    const LedBlendMode modes[] = { LED_BLEND_ALPHA, LED_BLEND_ADD, LED_BLEND_MAX, LED_BLEND_MULTIPLY };
+    for (int i = 0; i < sizeof(modes) / sizeof(modes[0]); i++) {
+        if (strcasecmp(name, blendModeName(modes[i])) == 0) {
+            *mode = modes[i];
+            return true;
+        }
+    }
+    return false;
+}
+
+void Effect::registerLayerCommands(ServiceCommands *cmd)
+{
+    cmd->registerStringData(
+        ServiceCommands::StringDataBuilder("blend", true)
+        .cmd("blend")
+        .help("--> alpha|add|max|multiply -- how this controller is merged over the controllers before it")
+        .setFn([this](const String &val, bool isLoading, String *msg) {
+            if (!parseBlendMode(val.c_str(), &blendMode)) {
+                *msg = "Expecting alpha, add, max or multiply";
+                return false;
+            }
+            if (!isLoading) {
+                *msg = "Set blend to "; msg->concat(blendModeName(blendMode));
+            }
+            return true;
+        })
+        .getFn([this](String *val) {
+            *val = blendModeName(blendMode);
+        })
+    );
+    cmd->registerIntData(
+        ServiceCommands::IntDataBuilder("opacity", true)
+        .cmd("opacity")
+        .help("--> Opacity of this controller when merged, 0..255")
+        .vMin(0)
+        .vMax(255)
+        .ptr(&opacity)
+    );
+}
+
 bool LedService::loadHardwareAndControllers(UEventLoop *eventLoop, CommandMgr *commandMgr)
 {
     // read configuration from file led-hardware.conf.json
@@ -51,9 +114,15 @@ bool LedService::loadHardwareAndControllers(UEventLoop *eventLoop, CommandMgr *c
         // { "start": 0, "count": 10, "mapTo": 0, "isReverse": true },
         // { "start": 10, "count": 9, "mapTo": 10 }
     ],
+    "geometry": { // optional coordinates of the leds, in mapped order, used by "field" controllers
+        // "type": "ring", "count": <n>
+        // or "type": "sphere", "rings": [ <leds in each ring from the top> ]
+        // or "type": "points", "points": [ [x, y, z], ... ]
+    },
     "controllers": [
         // must be a non-empty array of
-        // { id:<n, defaults to index in the array>, type: "spark" / "meteor", description, ledStart, ledCount }
+        // { id:<n, defaults to index in the array>, type: "spark" / "meteor" / "field" / "script", description, ledStart, ledCount,
+        //   script: <javascript file, for "script">, blend: "alpha" / "add" / "max" / "multiply", opacity: 0..255 }
     ]
 }
         )";
@@ -110,11 +179,16 @@ bool LedService::loadHardwareAndControllers(UEventLoop *eventLoop, CommandMgr *c
 
     // required here, because we create controllers below and "leds" is needed; same for map1d
     leds = new CRGB[totalLedCount];
+    showLeds = new CRGB[totalLedCount];
     map1d.map = new uint16_t[totalLedCount];
     for (int pos = 0; pos < totalLedCount; pos++) {
         map1d.map[pos] = pos;
     }
     map1d.leds = leds;
+    map1d.initDirty(totalLedCount);
+    ledsDirtyWords = LedMap1d::dirtyWordCount(totalLedCount);
+    ledsDirty = new uint32_t[ledsDirtyWords];
+    memset(ledsDirty, 0, ledsDirtyWords * sizeof(uint32_t));
 
     const JsonVariant &m = (*params)["mapping-1d"];
     if (m.is<JsonArray>()) {
@@ -142,6 +216,14 @@ bool LedService::loadHardwareAndControllers(UEventLoop *eventLoop, CommandMgr *c
         }
     }
 
+    const JsonVariant &g = (*params)["geometry"];
+    if (g.is<JsonObject>() && g.as<JsonObject>().containsKey("type")) {
+        if (!geometry.load(g, totalLedCount, &initializationError)) {
+            logger->error("{}", LogValue(initializationError.c_str(), LogValue::DO_COPY));
+            return false;
+        }
+    }
+
     const JsonVariant &ctrl = (*params)["controllers"];
     if (!ctrl) {
         initializationError = String("Expecting \"controllers\" config file ") + configFile;
@@ -150,12 +232,20 @@ bool LedService::loadHardwareAndControllers(UEventLoop *eventLoop, CommandMgr *c
     }
     if (ctrl.size() <= 0 || ctrl.size() > 100) {
         initializationError = String("The element \"controllers\" in config file ") + configFile
-            + " must be a non-empty array of { \"type\": <\"spark\"|\"meteor\"> }";
+            + " must be a non-empty array of { \"type\": <\"spark\"|\"meteor\"|\"field\"|\"script\"> }";
         logger->error("{}", LogValue(initializationError.c_str(), LogValue::DO_COPY));
         return false;
     }
     controllerCount = ctrl.size();
     controllers = new Effect*[controllerCount];
+    layers = new LedMap1d[controllerCount];
+    avgCalcDuration = new uint32_t[controllerCount];
+    for (int i = 0; i < controllerCount; i++) {
+        layers[i].leds = new CRGB[totalLedCount];
+        fill_solid(layers[i].leds, totalLedCount, CRGB(0,0,0));
+        layers[i].map = map1d.map; // shared, so that "map" changes apply to all layers
+        layers[i].initDirty(totalLedCount);
+    }
     for (int i = 0; i < controllerCount; i++) {
         const char *type = ctrl[i]["type"];
         if (type == nullptr || type[0] == '0') {
@@ -167,14 +257,33 @@ bool LedService::loadHardwareAndControllers(UEventLoop *eventLoop, CommandMgr *c
         int ledStart = ctrl[i]["ledStart"] | 0;
         int ledCount = ctrl[i]["ledCount"] | totalLedCount;
         if (strcmp(type, "spark") == 0) {
-            controllers[i] = new EffectSparks(id, &map1d, totalLedCount, ledStart, ledCount, ctrl[i]["description"] | "" );
+            controllers[i] = new EffectSparks(id, &layers[i], totalLedCount, ledStart, ledCount, ctrl[i]["description"] | "" );
         } else if (strcmp(type, "meteor") == 0) {
-            controllers[i] = new LedMeteorEffect(id, &map1d, totalLedCount, ledStart, ledCount, ctrl[i]["description"] | "" );
+            controllers[i] = new LedMeteorEffect(id, &layers[i], totalLedCount, ledStart, ledCount, ctrl[i]["description"] | "" );
+        } else if (strcmp(type, "field") == 0) {
+            if (geometry.getCount() == 0) {
+                initializationError = String("Controller type \"field\" requires \"geometry\" in config file ") + configFile;
+                logger->error("{}", LogValue(initializationError.c_str(), LogValue::DO_COPY));
+                return false;
+            }
+            controllers[i] = new LedFieldEffect(id, &layers[i], totalLedCount, &geometry, ctrl[i]["description"] | "" );
+#ifdef USE_JS
+        } else if (strcmp(type, "script") == 0) {
+            controllers[i] = new ScriptEffect(id, &layers[i], totalLedCount, ledStart, ledCount, ctrl[i]["script"] | "", ctrl[i]["description"] | "" );
+#endif
         } else {
             initializationError = String("Unrecognized controller type \"") + type + "\" in config file " + configFile;
             logger->error("{}", LogValue(initializationError.c_str(), LogValue::DO_COPY));
             return false;
         }
+        // defaults for compositing, the controller's persisted config overrides them
+        LedBlendMode blendMode = LED_BLEND_ALPHA;
+        const char *blend = ctrl[i]["blend"] | "alpha";
+        if (!Effect::parseBlendMode(blend, &blendMode)) {
+            logger->error("Unrecognized blend \"{}\" in controllers[{}], using alpha", LogValue(blend, LogValue::DO_COPY), i);
+        }
+        int opacity = ctrl[i]["opacity"] | 255;
+        controllers[i]->setLayerParams(blendMode, constrain(opacity, 0, 255));
     }
 
     return true;
@@ -195,6 +304,33 @@ void LedService::showMap(String *msg)
     }
 }
 
+/**
+ * Current frame, in hardware order, as a plain PPM image one led high.
+ */
+void LedService::dumpFrame(String *msg)
+{
+    msg->reserve(msg->length() + 16 + totalLedCount * 12);
+    *msg += "P3\n"; *msg += totalLedCount; *msg += " 1\n255\n";
+    for (int i = 0; i < totalLedCount; i++) {
+        *msg += leds[i].r; *msg += " ";
+        *msg += leds[i].g; *msg += " ";
+        *msg += leds[i].b; *msg += (i % 8 == 7 ? "\n" : "  ");
+    }
+    *msg += "\n";
+}
+
+void LedService::printTimings(String *msg)
+{
+    *msg += "Frame interval: "; *msg += intervalMillis; *msg += " ms, frames skipped: "; *msg += skippedFrames;
+    *msg += ", frames dropped while showing: "; *msg += lateShowCount; *msg += "\n";
+    *msg += "Jitter:\n";
+    jitterHistogram.print(msg, "    ");
+    *msg += "Calc:\n";
+    calcHistogram.print(msg, "    ");
+    *msg += "Show:\n";
+    showHistogram.print(msg, "    ");
+}
+
 void LedService::init(UEventLoop *eventLoop, CommandMgr *commandMgr, LogMgr *logMgr)
 {
     this->eventLoop = eventLoop;
@@ -203,7 +339,21 @@ void LedService::init(UEventLoop *eventLoop, CommandMgr *commandMgr, LogMgr *log
 
     isEnabled = false;
     leds = nullptr;
+    showLeds = nullptr;
+    showTask = nullptr;
+    showDoneSem = nullptr;
+    lateShowCount = 0;
+    ledsDirty = nullptr;
+    ledsDirtyWords = 0;
+    ledsSumR = ledsSumG = ledsSumB = 0;
+    frameBrightness = 0;
+    frameCurrent = 0;
+    avgCurrent = 0;
+    peakCurrent = 0;
+    powerLimitedFrames = 0;
     controllers = nullptr;
+    layers = nullptr;
+    avgCalcDuration = nullptr;
     controllerCount = 0;
     totalLedCount = 0;
 
@@ -264,15 +414,14 @@ void LedService::init(UEventLoop *eventLoop, CommandMgr *commandMgr, LogMgr *log
             .vMin(0)
             .vMax(255)
             .setFn([this](int val, bool isLoading, String *msg) {
-                brightness = val;
+                brightness = val; // applied from next frame
                 if (!isLoading) {
-                    FastLED.setBrightness(brightness);
                     *msg = "Global brightness set to "; *msg += val;
                 }
                 return true;
             })
             .getFn([this]() {
-                return FastLED.getBrightness();
+                return brightness;
             })
     );
 
@@ -284,9 +433,8 @@ void LedService::init(UEventLoop *eventLoop, CommandMgr *commandMgr, LogMgr *log
             .vMax(999999)
             .ptr(&powerLimit)
             .setFn([this](int val, bool isLoading, String *msg) {
-                powerLimit = val;
+                powerLimit = val; // applied from next frame
                 if (!isLoading) {
-                    FastLED.setMaxPowerInVoltsAndMilliamps(5, powerLimit);
                     *msg = "Power limit set to ";
                     *msg += powerLimit;
                     *msg += " milliamps at 5V";
@@ -294,6 +442,46 @@ void LedService::init(UEventLoop *eventLoop, CommandMgr *commandMgr, LogMgr *log
                 return true;
             }));
 
+    cmd->registerIntData(
+        ServiceCommands::IntDataBuilder("current", true)
+            .cmd("current")
+            .help("--> Estimated current of the last frame, in milliamps at 5V")
+            .isPersistent(false)
+            .getFn([this]() {
+                return (int)frameCurrent;
+            })
+    );
+
+    cmd->registerIntData(
+        ServiceCommands::IntDataBuilder("avgCurrent", true)
+            .cmd("avgCurrent")
+            .help("--> Average estimated current, in milliamps at 5V")
+            .isPersistent(false)
+            .getFn([this]() {
+                return (int)(avgCurrent >> 4);
+            })
+    );
+
+    cmd->registerIntData(
+        ServiceCommands::IntDataBuilder("peakCurrent", true)
+            .cmd("peakCurrent")
+            .help("--> Peak estimated current since the service was enabled, in milliamps at 5V")
+            .isPersistent(false)
+            .getFn([this]() {
+                return (int)peakCurrent;
+            })
+    );
+
+    cmd->registerIntData(
+        ServiceCommands::IntDataBuilder("powerLimitedFrames", true)
+            .cmd("powerLimitedFrames")
+            .help("--> Number of frames dimmed to stay within powerLimit since the service was enabled")
+            .isPersistent(false)
+            .getFn([this]() {
+                return (int)powerLimitedFrames;
+            })
+    );
+
     cmd->registerIntData(
         ServiceCommands::IntDataBuilder("freq", true)
             .cmd("freq")
@@ -307,7 +495,9 @@ void LedService::init(UEventLoop *eventLoop, CommandMgr *commandMgr, LogMgr *log
                         controllers[i]->setFrameDuration(intervalMillis);
                     }
                     if (isEnabled) {
-                        timer.setInterval(intervalMillis);
+                        // restart the deadlines from now with the new interval
+                        frameDeadline = Esp32Timer::currentTime();
+                        scheduleNextFrame();
                     }
                     *msg = "Frequency set to ";
                     *msg += 1000 / intervalMillis;
@@ -360,6 +550,44 @@ void LedService::init(UEventLoop *eventLoop, CommandMgr *commandMgr, LogMgr *log
         })
     );
 
+    cmd->registerStringData(
+        ServiceCommands::StringDataBuilder("frame", true)
+        .cmd("frame")
+        .help("--> Current frame as a plain PPM image, one row of leds in hardware order")
+        .isPersistent(false)
+        .includeInStatus(false)
+        .getFn([this](String *msg) {
+            if (leds == nullptr) {
+                *msg = "Led service is not initialized";
+            } else {
+                dumpFrame(msg);
+            }
+        })
+    );
+
+    cmd->registerStringData(
+        ServiceCommands::StringDataBuilder("timings", true)
+        .cmd("timings")
+        .help("timings [reset] --> Histograms of frame jitter, calc and show durations")
+        .isPersistent(false)
+        .includeInStatus(false)
+        .setFn([this](const String &val, bool isLoading, String *msg) {
+            if (val == "reset") {
+                jitterHistogram.clear();
+                calcHistogram.clear();
+                showHistogram.clear();
+                skippedFrames = 0;
+                *msg = "Timings reset";
+            } else {
+                printTimings(msg);
+            }
+            return true;
+        })
+        .getFn([this](String *msg) {
+            printTimings(msg);
+        })
+    );
+
     cmd->onBeforeLoad([this](String *msg) {
         if (isEnabled) {
             disable();
@@ -391,9 +619,14 @@ void LedService::init(UEventLoop *eventLoop, CommandMgr *commandMgr, LogMgr *log
             }
         }
 
+        if (geometry.getCount() > 0) {
+            *msg += "Geometry: "; *msg += geometry.getType(); *msg += ", "; *msg += geometry.getCount(); *msg += " leds\n";
+        }
         *msg += "Controllers: "; *msg += controllerCount; *msg += "\n";
         for (int i = 0; i < controllerCount; i++) {
-            *msg += "    led"; *msg += i; *msg += ": "; controllers[i]->getOneLineStatus(msg); *msg += "\n";
+            *msg += "    led"; *msg += i; *msg += ": "; controllers[i]->getOneLineStatus(msg);
+            *msg += " Blend: "; *msg += Effect::blendModeName(controllers[i]->getBlendMode());
+            *msg += ", opacity "; *msg += controllers[i]->getOpacity(); *msg += "\n";
         }
 
         if (isEnabled) {
@@ -403,8 +636,15 @@ void LedService::init(UEventLoop *eventLoop, CommandMgr *commandMgr, LogMgr *log
 
             *msg += "Avg duration micros: "; *msg += (avgTotalDuration >> 4); *msg += " total, "; *msg += ((avgTotalDuration / totalLedCount) >> 4);
             *msg += " per led, "; *msg += ((avgShowDuration / totalLedCount) >> 4); *msg += " for showing\n";
+            *msg += "Frames dropped while the previous frame was being shown: "; *msg += lateShowCount; *msg += "\n";
+            *msg += "Avg compositing micros: "; *msg += (avgComposeDuration >> 4); *msg += "\n";
+            *msg += "Estimated current: "; *msg += frameCurrent; *msg += " mA, avg "; *msg += (avgCurrent >> 4);
+            *msg += " mA, peak "; *msg += peakCurrent; *msg += " mA, limit "; *msg += powerLimit;
+            *msg += " mA, frames dimmed "; *msg += powerLimitedFrames; *msg += "\n";
             for (int i = 0; i < controllerCount; i++) {
                 controllers[i]->printStats(msg);
+                *msg += ", calc micros: "; *msg += (avgCalcDuration[i] >> 4);
+                *msg += " per frame, "; *msg += ((avgCalcDuration[i] / totalLedCount) >> 4); *msg += " per led";
                 *msg += "\n";
             }
         } else {
@@ -421,6 +661,8 @@ void LedService::init(UEventLoop *eventLoop, CommandMgr *commandMgr, LogMgr *log
     powerLimit = 1000;
     intervalMillis = 33;
     frame = 0;
+    frameDeadline = 0;
+    skippedFrames = 0;
     isEnabled = false;
     brightness = 128;
     avgShowDuration = 0;
@@ -459,16 +701,16 @@ void LedService::init(UEventLoop *eventLoop, CommandMgr *commandMgr, LogMgr *log
             int ledPin = hardware[i].ledPin;
 
     #define ADD_LEDS_PER_PIN(CHIP, RGBORDER) \
-                case LED_PIN_1: FastLED.addLeds<CHIP, LED_PIN_1, RGBORDER>(leds, curPos, hardware[i].count); break; \
-                case LED_PIN_2: FastLED.addLeds<CHIP, LED_PIN_2, RGBORDER>(leds, curPos, hardware[i].count); break; \
-                case LED_PIN_3: FastLED.addLeds<CHIP, LED_PIN_3, RGBORDER>(leds, curPos, hardware[i].count); break; \
-                case LED_PIN_4: FastLED.addLeds<CHIP, LED_PIN_4, RGBORDER>(leds, curPos, hardware[i].count); break; \
-                case LED_PIN_5: FastLED.addLeds<CHIP, LED_PIN_5, RGBORDER>(leds, curPos, hardware[i].count); break; \
-                case LED_PIN_6: FastLED.addLeds<CHIP, LED_PIN_6, RGBORDER>(leds, curPos, hardware[i].count); break; \
-                case LED_PIN_7: FastLED.addLeds<CHIP, LED_PIN_7, RGBORDER>(leds, curPos, hardware[i].count); break; \
-                case LED_PIN_8: FastLED.addLeds<CHIP, LED_PIN_8, RGBORDER>(leds, curPos, hardware[i].count); break; \
-                case LED_PIN_9: FastLED.addLeds<CHIP, LED_PIN_9, RGBORDER>(leds, curPos, hardware[i].count); break; \
-                case LED_PIN_10: FastLED.addLeds<CHIP, LED_PIN_10, RGBORDER>(leds, curPos, hardware[i].count); break;
+                case LED_PIN_1: FastLED.addLeds<CHIP, LED_PIN_1, RGBORDER>(showLeds, curPos, hardware[i].count); break; \
+                case LED_PIN_2: FastLED.addLeds<CHIP, LED_PIN_2, RGBORDER>(showLeds, curPos, hardware[i].count); break; \
+                case LED_PIN_3: FastLED.addLeds<CHIP, LED_PIN_3, RGBORDER>(showLeds, curPos, hardware[i].count); break; \
+                case LED_PIN_4: FastLED.addLeds<CHIP, LED_PIN_4, RGBORDER>(showLeds, curPos, hardware[i].count); break; \
+                case LED_PIN_5: FastLED.addLeds<CHIP, LED_PIN_5, RGBORDER>(showLeds, curPos, hardware[i].count); break; \
+                case LED_PIN_6: FastLED.addLeds<CHIP, LED_PIN_6, RGBORDER>(showLeds, curPos, hardware[i].count); break; \
+                case LED_PIN_7: FastLED.addLeds<CHIP, LED_PIN_7, RGBORDER>(showLeds, curPos, hardware[i].count); break; \
+                case LED_PIN_8: FastLED.addLeds<CHIP, LED_PIN_8, RGBORDER>(showLeds, curPos, hardware[i].count); break; \
+                case LED_PIN_9: FastLED.addLeds<CHIP, LED_PIN_9, RGBORDER>(showLeds, curPos, hardware[i].count); break; \
+                case LED_PIN_10: FastLED.addLeds<CHIP, LED_PIN_10, RGBORDER>(showLeds, curPos, hardware[i].count); break;
 
     #define ADD_LEDS_PIN_ERROR(i, ledPin) \
                         initializationError = String("In hardware slot ") + i + ": Led pin " + ledPin + " is not usable -- pins compiled in are " \
@@ -532,12 +774,18 @@ void LedService::init(UEventLoop *eventLoop, CommandMgr *commandMgr, LogMgr *log
             pinMode(hardware[i].ledPin, OUTPUT);
         }
 
+        // power is limited by the brightness of each frame, see limitPower()
         FastLED.setBrightness(brightness);
-        FastLED.setMaxPowerInVoltsAndMilliamps(5, powerLimit);
 
         FastLED.clear(false);
         FastLED.show();
 
+        void ledShowTaskFn(void *arg); // forward declaration
+        showDoneSem = xSemaphoreCreateBinary();
+        xSemaphoreGive(showDoneSem);
+        xTaskCreatePinnedToCore(ledShowTaskFn, "LedShow", 2048, this,
+            uxTaskPriorityGet(nullptr) + 1, &showTask, APP_CPU_NUM);
+
         eventLoop->registerTimer(&timer);
         timer.setCallback([this](UEventLoopTimer *timer) { runOnce(); });
         if (isEnabled) {
@@ -552,34 +800,110 @@ void LedService::enable() {
     avgShowDuration = 0;
     avgTotalDuration = 0;
     frame = 0;
+    lateShowCount = 0;
+    avgCurrent = 0;
+    peakCurrent = 0;
+    powerLimitedFrames = 0;
+    avgComposeDuration = 0;
+    for (int i = 0; i < controllerCount; i++) {
+        avgCalcDuration[i] = 0;
+    }
+    skippedFrames = 0;
+    jitterHistogram.clear();
+    calcHistogram.clear();
+    showHistogram.clear();
     lastRunTm = micros();
+    memset(ledsDirty, 0xff, ledsDirtyWords * sizeof(uint32_t)); // clear everything on the first frame
     isEnabled = true;
-    timer.setTimeout(intervalMillis);
+    frameDeadline = Esp32Timer::currentTime();
+    scheduleNextFrame();
+}
+
+void LedService::scheduleNextFrame()
+{
+    frameDeadline += intervalMillis * 1000;
+    uint64_t now = Esp32Timer::currentTime();
+    timer.setTimeoutMicros(frameDeadline > now ? (long)(frameDeadline - now) : 0);
 }
 
 void LedService::disable() {
     isEnabled = false;
     timer.cancelTimeout();
+    if (showDoneSem == nullptr) { // hardware was not initialized
+        return;
+    }
+    // wait for the frame being sent, the show task must be idle while we use FastLED
+    xSemaphoreTake(showDoneSem, portMAX_DELAY);
     FastLED.clear();
     FastLED.show();
+    xSemaphoreGive(showDoneSem);
 }
 
-void LedService::runOnce() {
-    timer.setTimeout(intervalMillis);
-    long tm1 = micros();
+void ledShowTaskFn(void *arg)
+{
+    LedService *ledService = (LedService *)arg;
+    ledService->showTaskRun();
+}
 
-    if (frame > 0) {
+void LedService::showTaskRun()
+{
+    while (true) {
+        ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+        long tm1 = micros();
         FastLED.show();
         long tmShow = micros();
         avgShowDuration = (avgShowDuration == 0 ? ((tmShow - tm1) << 4) : avgShowDuration * 63 / 64 + ((tmShow - tm1) << 4) / 64);
+        showHistogram.add(tmShow - tm1);
+        xSemaphoreGive(showDoneSem);
+    }
+}
+
+void LedService::runOnce() {
+    // this run is for the frame due at frameDeadline
+    uint64_t now = Esp32Timer::currentTime();
+    uint64_t intervalMicros = intervalMillis * 1000;
+    uint64_t lateness = now > frameDeadline ? now - frameDeadline : 0;
+    jitterHistogram.add(lateness);
+    if (lateness >= intervalMicros) {
+        // deadlines of the following frames have passed too: skip them
+        uint32_t skip = lateness / intervalMicros;
+        frame += skip;
+        skippedFrames += skip;
+        frameDeadline += skip * intervalMicros;
+    }
+    scheduleNextFrame();
+    long tm1 = micros();
+
+    if (frame > 0) {
+        // hand off the frame composited in the previous run; the show task sends it
+        // while we're rendering the next one
+        if (xSemaphoreTake(showDoneSem, 0) == pdTRUE) {
+            memcpy(showLeds, leds, totalLedCount * sizeof(CRGB));
+            FastLED.setBrightness(frameBrightness);
+            xTaskNotifyGive(showTask);
+        } else {
+            ++lateShowCount;
+        }
     }
-    fill_solid(leds, totalLedCount, CRGB(0,0,0));
 
     for (int i = 0; i < controllerCount; i++) {
+        LedMap1d &layer = layers[i];
+        LedMap1d::forEachSpan(layer.dirty, layer.dirtyWords, totalLedCount, [&layer](int start, int count) {
+            fill_solid(&layer.leds[start], count, CRGB(0,0,0));
+        });
+        layer.clearDirty();
+        long tmCalc = micros();
         controllers[i]->calc(frame);
+        uint32_t calcDuration = (uint32_t)(micros() - tmCalc) << 4;
+        avgCalcDuration[i] = (avgCalcDuration[i] == 0 ? calcDuration : avgCalcDuration[i] * 63 / 64 + calcDuration / 64);
     }
+    long tmCompose = micros();
+    compose();
+    uint32_t composeDuration = (uint32_t)(micros() - tmCompose) << 4;
+    avgComposeDuration = (avgComposeDuration == 0 ? composeDuration : avgComposeDuration * 63 / 64 + composeDuration / 64);
 
     long tmTotal = micros();
+    calcHistogram.add(tmTotal - tm1);
     avgTotalDuration = (avgTotalDuration == 0 ? ((tmTotal - tm1) << 4) : avgTotalDuration * 63 / 64 + ((tmTotal - tm1) << 4) / 64);
 
     uint32_t frameInterval = (uint32_t)(tm1 - lastRunTm);
@@ -591,15 +915,132 @@ void LedService::runOnce() {
     }
     if (frame % ((1000 / intervalMillis) * 30) == 0) {
         Serial.printf("Avg duration micros: %lu; total %lu per led, %lu for showing, at %d fps (%d micros/frame)\n",
-        (long)avgTotalDuration >> 4, (long)((avgTotalDuration / totalLedCount) >> 4), (long)((avgShowDuration / totalLedCount) >> 4),
+        (unsigned long)(avgTotalDuration >> 4), (unsigned long)((avgTotalDuration / totalLedCount) >> 4),
+        (unsigned long)((avgShowDuration / totalLedCount) >> 4),
         1000 / intervalMillis, intervalMillis * 1000);
         for (int i = 0; i < controllerCount; i++) {
             controllers[i]->printStats();
+            Serial.printf("    calc micros: %lu per frame\n", (unsigned long)(avgCalcDuration[i] >> 4));
         }
     }
 
     ++frame;
 }
 
+/**
+ * Merges the layers, in controller order, into the leds array.
+ * Only the segments written by each layer are visited.
+ */
+void LedService::compose()
+{
+    LedMap1d::forEachSpan(ledsDirty, ledsDirtyWords, totalLedCount, [this](int start, int count) {
+        fill_solid(&leds[start], count, CRGB(0,0,0));
+    });
+    memset(ledsDirty, 0, ledsDirtyWords * sizeof(uint32_t));
+    ledsSumR = ledsSumG = ledsSumB = 0;
+
+    for (int i = 0; i < controllerCount; i++) {
+        const LedMap1d &layer = layers[i];
+        int opacity = controllers[i]->getOpacity();
+        if (opacity == 0 || !layer.isDirty()) {
+            continue;
+        }
+        LedBlendMode mode = controllers[i]->getBlendMode();
+        LedMap1d::forEachSpan(layer.dirty, layer.dirtyWords, totalLedCount, [&](int start, int count) {
+            blendLayer(layer, mode, opacity, start, count);
+        });
+        for (int w = 0; w < ledsDirtyWords; w++) {
+            ledsDirty[w] |= layer.dirty[w];
+        }
+    }
+    limitPower();
+}
+
+/**
+ * Estimates the current of the composited frame from the channel sums, and lowers
+ * the brightness of the frame if it is over the power limit. The brightness is applied
+ * by FastLED while sending the frame, so limiting costs no pass over the leds.
+ */
+void LedService::limitPower()
+{
+    uint32_t dark = totalLedCount * LED_DARK_MA;
+    uint32_t full = (ledsSumR * LED_RED_MA + ledsSumG * LED_GREEN_MA + ledsSumB * LED_BLUE_MA) / 255; // at brightness 255
+
+    frameBrightness = brightness;
+    if (full > 0 && dark + full * brightness / 255 > (uint32_t)powerLimit) {
+        frameBrightness = (uint32_t)powerLimit <= dark ? 0 : (powerLimit - dark) * 255 / full;
+        ++powerLimitedFrames;
+    }
+
+    frameCurrent = dark + full * frameBrightness / 255;
+    avgCurrent = (avgCurrent == 0 ? (frameCurrent << 4) : avgCurrent * 63 / 64 + (frameCurrent << 4) / 64);
+    if (frameCurrent > peakCurrent) {
+        peakCurrent = frameCurrent;
+    }
+}
+
+void LedService::blendLayer(const LedMap1d &layer, LedBlendMode mode, uint8_t opacity, int start, int count)
+{
+    CRGB *dst = &leds[start];
+    const CRGB *src = &layer.leds[start];
+    const CRGB *end = &layer.leds[start + count];
+
+    // channel sums are updated with the difference made to each led, for power estimation
+    int32_t dr = 0;
+    int32_t dg = 0;
+    int32_t db = 0;
+    CRGB before;
+
+    switch (mode) {
+    case LED_BLEND_ALPHA:
+        for (; src < end; ++src, ++dst) {
+            if (*src) {
+                before = *dst;
+                *dst = (opacity == 255) ? *src : blend(*dst, *src, opacity);
+                dr += dst->r - before.r; dg += dst->g - before.g; db += dst->b - before.b;
+            }
+        }
+        break;
+    case LED_BLEND_ADD:
+        for (; src < end; ++src, ++dst) {
+            CRGB c = *src;
+            if (opacity != 255) {
+                c.nscale8_video(opacity);
+            }
+            before = *dst;
+            *dst += c; // saturates
+            dr += dst->r - before.r; dg += dst->g - before.g; db += dst->b - before.b;
+        }
+        break;
+    case LED_BLEND_MAX:
+        for (; src < end; ++src, ++dst) {
+            CRGB c = *src;
+            if (opacity != 255) {
+                c.nscale8_video(opacity);
+            }
+            before = *dst;
+            dst->r = max(dst->r, c.r);
+            dst->g = max(dst->g, c.g);
+            dst->b = max(dst->b, c.b);
+            dr += dst->r - before.r; dg += dst->g - before.g; db += dst->b - before.b;
+        }
+        break;
+    case LED_BLEND_MULTIPLY:
+        for (int pos = start; src < end; ++src, ++dst, ++pos) {
+            if (!layer.isWritten(pos)) {
+                continue; // as white: what's below is kept
+            }
+            CRGB c(scale8(dst->r, src->r), scale8(dst->g, src->g), scale8(dst->b, src->b));
+            before = *dst;
+            *dst = (opacity == 255) ? c : blend(*dst, c, opacity);
+            dr += dst->r - before.r; dg += dst->g - before.g; db += dst->b - before.b;
+        }
+        break;
+    }
+
+    ledsSumR += dr;
+    ledsSumG += dg;
+    ledsSumB += db;
+}
 
 #endif // USE_LED
@@ -10,16 +10,102 @@
 #include "Random.h"
 #include "CommandMgr.h"
 #include "LogMgr.h"
+#include "LedGeometry.h"
+#include "Util.h"
 
 #define LED_HARDWARE_COUNT 8
 
+/**
+ * How a controller's layer is merged over the layers below it.
+ *
+ * ALPHA: lit leds of the layer are blended over with the layer opacity, black leds are transparent
+ * ADD: saturated addition
+ * MAX: per channel maximum
+ * MULTIPLY: the leds the layer has written multiply what's below them, the others are left as is
+ */
+enum LedBlendMode {
+    LED_BLEND_ALPHA = 0,
+    LED_BLEND_ADD,
+    LED_BLEND_MAX,
+    LED_BLEND_MULTIPLY
+};
+
+/**
+ * A layer of leds, in hardware order, written by a single effect.
+ * Keeps track of the segments of LED_SEGMENT_SIZE leds written during the frame, a bit per
+ * segment, so that clearing and compositing only touch the segments that were lit, even when
+ * they are far apart; and of the leds written, a bit per led, for the blend modes where an
+ * unwritten black led is not the same as a written one.
+ */
+#define LED_SEGMENT_SHIFT 5
+#define LED_SEGMENT_SIZE (1 << LED_SEGMENT_SHIFT)
+static_assert(LED_SEGMENT_SIZE == 32, "LedMap1d::written has a 32-bit word per segment");
+
 class LedMap1d {
 friend class LedService;
     CRGB *leds;
     uint16_t *map;
+    uint32_t *dirty; // a bit per segment written in this frame, in hardware order
+    int dirtyWords;
+    uint32_t *written; // a bit per led written in this frame, a word per segment
+
+    void markDirty(int pos) {
+        int segment = pos >> LED_SEGMENT_SHIFT;
+        dirty[segment >> 5] |= 1u << (segment & 31);
+        written[segment] |= 1u << (pos & (LED_SEGMENT_SIZE - 1));
+    }
+    void initDirty(int ledCount) {
+        dirtyWords = dirtyWordCount(ledCount);
+        dirty = new uint32_t[dirtyWords];
+        memset(dirty, 0, dirtyWords * sizeof(uint32_t));
+        int segments = (ledCount + LED_SEGMENT_SIZE - 1) / LED_SEGMENT_SIZE;
+        written = new uint32_t[segments];
+        memset(written, 0, segments * sizeof(uint32_t));
+    }
+    // only the written words of the dirty segments are cleared
+    void clearDirty() {
+        for (int w = 0; w < dirtyWords; w++) {
+            for (uint32_t b = dirty[w]; b != 0; b &= b - 1) {
+                written[(w << 5) + __builtin_ctz(b)] = 0;
+            }
+            dirty[w] = 0;
+        }
+    }
+    bool isWritten(int pos) const {
+        return (written[pos >> LED_SEGMENT_SHIFT] >> (pos & (LED_SEGMENT_SIZE - 1))) & 1;
+    }
+    bool isDirty() const {
+        for (int w = 0; w < dirtyWords; w++) {
+            if (dirty[w] != 0) {
+                return true;
+            }
+        }
+        return false;
+    }
+    static int dirtyWordCount(int ledCount) {
+        return ((ledCount + LED_SEGMENT_SIZE - 1) / LED_SEGMENT_SIZE + 31) / 32;
+    }
+    /**
+     * Calls fn(start, count) for each run of consecutive segments set in bits, in led
+     * positions, the last one clipped to ledCount.
+     */
+    template<typename Fn> static void forEachSpan(const uint32_t *bits, int words, int ledCount, Fn fn) {
+        for (int w = 0; w < words; w++) {
+            uint32_t b = bits[w];
+            while (b != 0) {
+                int first = __builtin_ctz(b);
+                uint32_t rest = ~(b >> first);
+                int run = (rest == 0 ? 32 - first : __builtin_ctz(rest));
+                int start = ((w << 5) + first) << LED_SEGMENT_SHIFT;
+                int end = ((w << 5) + first + run) << LED_SEGMENT_SHIFT;
+                fn(start, (end < ledCount ? end : ledCount) - start);
+                b = (run == 32 ? 0 : b & ~(((1u << run) - 1) << first));
+            }
+        }
+    }
 public:
-    CRGB *at(int pos) { return &leds[map[pos]]; }
-    CRGB *atWithoutMapping(int pos) { return &leds[pos]; }
+    CRGB *at(int pos) { int p = map[pos]; markDirty(p); return &leds[p]; }
+    CRGB *atWithoutMapping(int pos) { markDirty(pos); return &leds[pos]; }
 };
 
 class Effect {
@@ -28,6 +114,12 @@ protected:
     LedMap1d *leds;
     int totalLedCount;
     String description;
+
+    // compositing of this effect's layer
+    LedBlendMode blendMode;
+    int opacity; // 0..255
+
+    void registerLayerCommands(ServiceCommands *cmd);
 public:
     Effect(int controllerId, LedMap1d *ledMap1d, int totalLedCount, const char *description);
     virtual ~Effect();
@@ -38,6 +130,12 @@ public:
     virtual void calc(uint32_t frame) = 0;
     virtual void printStats() = 0;
     virtual void printStats(String *msg) = 0;
+
+    void setLayerParams(LedBlendMode blendMode, int opacity);
+    LedBlendMode getBlendMode() { return blendMode; }
+    int getOpacity() { return opacity; }
+    static const char *blendModeName(LedBlendMode mode);
+    static bool parseBlendMode(const char *name, LedBlendMode *mode);
 };
 
 class LedService {
@@ -57,8 +155,34 @@ private:
     };
     Hardware hardware[LED_HARDWARE_COUNT];
     LedMap1d map1d;
+    LedGeometry geometry; // coordinates of the leds, in map1d positions; empty if not configured
 
+    // Frames are double buffered: controllers render and get composited into "leds" on the
+    // event loop, while the previous frame is sent out from "showLeds" by the show task.
+    // At each frame tick, if the show task is done, the new frame is copied to "showLeds".
     CRGB *leds; // array of leds, of size totalLedCount, mapped sequentially to hardware
+    CRGB *showLeds; // same size as leds, the array registered with FastLED
+    TaskHandle_t showTask;
+    SemaphoreHandle_t showDoneSem; // available when the show task is idle
+    uint32_t lateShowCount; // frames dropped because the previous frame was still being sent
+    uint32_t *ledsDirty; // segments of leds lit in the last composited frame, as in LedMap1d
+    int ledsDirtyWords;
+
+    // Power estimation: channel sums of the composited leds, kept up to date by the compositing,
+    // give the current of the frame; when over powerLimit, the brightness of that frame is lowered.
+    // Current per channel at full brightness and per dark led as used by FastLED, in mA at 5V.
+    static const int LED_RED_MA = 16;
+    static const int LED_GREEN_MA = 11;
+    static const int LED_BLUE_MA = 15;
+    static const int LED_DARK_MA = 1;
+    int32_t ledsSumR;
+    int32_t ledsSumG;
+    int32_t ledsSumB;
+    uint8_t frameBrightness; // brightness of the composited frame, after power limiting
+    uint32_t frameCurrent; // estimated current of the composited frame, in mA
+    uint32_t avgCurrent; // << 4
+    uint32_t peakCurrent;
+    uint32_t powerLimitedFrames;
 
     int powerLimit;
     int intervalMillis;
@@ -73,15 +197,35 @@ private:
     uint32_t avgTotalDuration = 0;
     uint32_t avgFrameInterval = 0;
 
+    // Frames are scheduled at absolute deadlines, startTime + frame * intervalMillis, on the
+    // Esp32Timer clock; when a deadline is missed by a whole frame or more, the frames that
+    // should have run meanwhile are skipped, so that frame numbers keep following real time.
+    uint64_t frameDeadline; // deadline of the next frame, in micros
+    uint32_t skippedFrames;
+    Histogram jitterHistogram; // lateness of each frame against its deadline
+    Histogram calcHistogram; // rendering and compositing of a frame
+    Histogram showHistogram; // sending a frame to the leds, measured by the show task
+    uint32_t *avgCalcDuration; // controllerCount elements, micros spent in each controller's calc(), << 4
+    uint32_t avgComposeDuration = 0;
+
     int controllerCount;
     Effect **controllers; // controllerCount elements
+    LedMap1d *layers; // controllerCount elements, the layer where each controller renders
 
     void enable();
     void disable();
     void runOnce();
+    void scheduleNextFrame();
+    void printTimings(String *msg);
+    void showTaskRun();
+    friend void ledShowTaskFn(void *arg);
+    void compose();
+    void limitPower();
+    void blendLayer(const LedMap1d &layer, LedBlendMode mode, uint8_t opacity, int start, int count);
 
     bool loadHardwareAndControllers(UEventLoop *eventLoop, CommandMgr *commandMgr);
     void showMap(String *msg);
+    void dumpFrame(String *msg);
 public:
     void init(UEventLoop *eventLoop, CommandMgr *commandMgr, LogMgr *logMgr);
 };
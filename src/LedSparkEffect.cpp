@@ -17,12 +17,16 @@ EffectSparks::EffectSparks(int controllerId, LedMap1d *leds, int totalLedCount,
 {
     attackValPerFrame = nullptr;
     decayValPerFrame = nullptr;
-    ledState = nullptr;
     isEnabled = false;
 
-    ledState = nullptr;
-    attackValPerFrame = nullptr;
-    decayValPerFrame = nullptr;
+    ledLastOn = nullptr;
+    ledBaseHue = nullptr;
+    ledHueKind = nullptr;
+    ledNext = nullptr;
+    activeLeds = nullptr;
+    activeCount = 0;
+    bucketHead = nullptr;
+    bucketMask = 0;
 
     this->ledStart = defaultLedStart;
     this->ledCount = defaultLedCount;
@@ -32,7 +36,96 @@ EffectSparks::~EffectSparks()
 {
     delete[] attackValPerFrame;
     delete[] decayValPerFrame;
-    delete[] ledState;
+    freeLedState();
+    delete[] bucketHead;
+}
+
+void EffectSparks::freeLedState()
+{
+    delete[] ledLastOn;
+    delete[] ledBaseHue;
+    delete[] ledHueKind;
+    delete[] ledNext;
+    delete[] activeLeds;
+    ledLastOn = nullptr;
+    ledBaseHue = nullptr;
+    ledHueKind = nullptr;
+    ledNext = nullptr;
+    activeLeds = nullptr;
+    activeCount = 0;
+}
+
+void EffectSparks::allocLedState()
+{
+    freeLedState();
+    ledLastOn = new uint32_t[ledCount];
+    ledBaseHue = new uint8_t[ledCount];
+    ledHueKind = new uint8_t[ledCount];
+    ledNext = new int32_t[ledCount];
+    activeLeds = new int32_t[ledCount];
+}
+
+/**
+ * Puts the leds that are sparking in activeLeds, the others in the calendar queue.
+ * The number of buckets covers the longest wait between sparks, up to 1024.
+ */
+void EffectSparks::rebuildSchedule(uint32_t frame)
+{
+    uint32_t horizon = sparkFrames + 10 * nonSparkFrames + 1;
+    uint32_t bucketCount = 16;
+    while (bucketCount < horizon && bucketCount < 1024) {
+        bucketCount <<= 1;
+    }
+    if (bucketHead == nullptr || bucketMask != bucketCount - 1) {
+        delete[] bucketHead;
+        bucketHead = new int32_t[bucketCount];
+        bucketMask = bucketCount - 1;
+    }
+    for (int b = 0; b < bucketCount; b++) {
+        bucketHead[b] = -1;
+    }
+
+    activeCount = 0;
+    for (int i = 0; i < ledCount; i++) {
+        if (ledLastOn[i] <= frame) {
+            activeLeds[activeCount++] = i;
+        } else {
+            int32_t &head = bucketHead[ledLastOn[i] & bucketMask];
+            ledNext[i] = head;
+            head = i;
+        }
+    }
+}
+
+/**
+ * Called at the last frame of sparking: calculates next time the led needs to enter sparking,
+ * and queues it for that time.
+ */
+void EffectSparks::endSpark(int i, uint32_t frame)
+{
+    ledLastOn[i] = frame + getRndExp();
+    // change hue
+    ledHueKind[i] = (rnd.nextUInt() % 100) <  hueParams.hue1Hue2Pct ? 0 : 1;
+    ledBaseHue[i] =
+        (ledHueKind[i] == 0 ? hueParams.hue1 : hueParams.hue2)
+        // hueTScale
+        + frame * hueTScale / 256
+        // hueXScale
+        + i * hueXScale / 256;
+    if (hueParams.hueJitter > 0) {
+        uint8_t jitter = (rnd.nextUInt() % hueParams.hueJitter) - (hueParams.hueJitter / 2);
+        ledBaseHue[i] += jitter;
+    }
+
+    int32_t &head = bucketHead[ledLastOn[i] & bucketMask];
+    ledNext[i] = head;
+    head = i;
+}
+
+void EffectSparks::setIdleColor(int i)
+{
+    CHSV color(ledBaseHue[i], ledHueKind[i] == 0 ? hueParams.sat1 : hueParams.sat2, valIdle);
+    *leds->at(ledStart + i) = color;
 }
 
 void EffectSparks::setCmd(ServiceCommands *cmd, const char *command, const char *help, uint8_t *data, int min, int max)
@@ -191,6 +284,8 @@ void EffectSparks::init(int millisPerFrame, CommandMgr *commandMgr, uint32_t fra
             })
     );
 
+    registerLayerCommands(cmd);
+
     isEnabled = true;
 
     ledStart = 0;
@@ -397,127 +492,121 @@ void EffectSparks::calc(uint32_t frame)
         return;
     }
 
-    bool isInitState = (lastFrame != frame - 1);
+    bool isInitState = (int32_t)(frame - lastFrame) <= 0;
+    bool isCatchingUp = !isInitState && frame != lastFrame + 1; // frames were skipped
     lastFrame = frame;
-    if (ledCount != lastLedCount || ledState == nullptr) {
-        if (ledState != nullptr) {
-            delete[] ledState;
-        }
-        ledState = new LedState[ledCount];
+    if (ledCount != lastLedCount || ledLastOn == nullptr) {
+        allocLedState();
         lastLedCount = ledCount;
         isInitState = true;
     }
     if (isInitState) {
         for (int i = 0; i < ledCount; i++) {
             int rndVal = (rnd.nextUInt() % sparkFrames) + getRndExp();
-            ledState[i].lastOn = frame + rndVal;
-            ledState[i].hueKind = rnd.bernoulli(hueParams.hue1Hue2Pct, 100) ? 0 : 1;
-            ledState[i].baseHue = (ledState[i].hueKind == 0) ? hueParams.hue1 : hueParams.hue2;
+            ledLastOn[i] = frame + rndVal;
+            ledHueKind[i] = rnd.bernoulli(hueParams.hue1Hue2Pct, 100) ? 0 : 1;
+            ledBaseHue[i] = (ledHueKind[i] == 0) ? hueParams.hue1 : hueParams.hue2;
+        }
+        rebuildSchedule(frame);
+    } else if (isCatchingUp) {
+        // sparks that ended during the skipped frames are rescheduled, the others go on
+        for (int i = 0; i < ledCount; i++) {
+            if (ledLastOn[i] + sparkFrames < frame) {
+                ledLastOn[i] = frame + getRndExp();
+            }
         }
+        rebuildSchedule(frame);
     }
 
     if (sparkFrames != lastSparkFrames || nonSparkFrames != lastNonSparkFrames) {
         // set new timings
         // reset timings for existing leds
+        int halfSparkFrames = sparkFrames / 2 > 0 ? sparkFrames / 2 : 1;
         for (int i = 0; i < ledCount; i++) {
-            if (ledState[i].lastOn > frame) {
+            if (ledLastOn[i] > frame) {
                 // leds that are not sparking
-                ledState[i].lastOn = frame + (rnd.nextUInt() % (sparkFrames / 2)) + getRndExp();
+                ledLastOn[i] = frame + (rnd.nextUInt() % halfSparkFrames) + getRndExp();
             } else {
                 // leds that are sparking, lastOn + sparkFrames must remain in the future
                 // if not, make them non-sparking (they'll shut down immediately, without easing)
-                if (ledState[i].lastOn + sparkFrames < frame) {
-                    ledState[i].lastOn = frame + (rnd.nextUInt() % (sparkFrames / 2)) + getRndExp();
+                if (ledLastOn[i] + sparkFrames < frame) {
+                    ledLastOn[i] = frame + (rnd.nextUInt() % halfSparkFrames) + getRndExp();
                 }
             }
         }
+        rebuildSchedule(frame);
         lastSparkFrames = sparkFrames;
         lastNonSparkFrames = nonSparkFrames;
     }
 
-    // if we're at the last frame of sparking,
-    // calculate next time we need to enter sparking
+    // leds starting to spark in this frame leave the calendar queue
+    int32_t *link = &bucketHead[frame & bucketMask];
+    while (*link != -1) {
+        int i = *link;
+        if (ledLastOn[i] == frame) {
+            *link = ledNext[i];
+            activeLeds[activeCount++] = i;
+        } else {
+            link = &ledNext[i];
+        }
+    }
+
+    // leds that are not sparking only need to be written when they're not black
+    if (valIdle != 0) {
+        for (int i = 0; i < ledCount; i++) {
+            setIdleColor(i);
+        }
+    }
+
+    // black leds are not written, so that they remain transparent when layers are composited
     int sparkingCount = 0; // for stats
-    for (int i = 0; i < ledCount; i++) {
-        if (frame == ledState[i].lastOn + sparkFrames) {
-            ledState[i].lastOn = frame + getRndExp();
-            // change hue
-            ledState[i].hueKind = (rnd.nextUInt() % 100) <  hueParams.hue1Hue2Pct ? 0 : 1;
-            ledState[i].baseHue =
-                (ledState[i].hueKind == 0 ? hueParams.hue1 : hueParams.hue2)
-                // hueTScale
-                + frame * hueTScale / 256
-                // hueXScale
-                + i * hueXScale / 256;
-            if (hueParams.hueJitter > 0) {
-                uint8_t jitter = (rnd.nextUInt() % hueParams.hueJitter) - (hueParams.hueJitter / 2);
-                ledState[i].baseHue += jitter;
+    for (int a = 0; a < activeCount; ) {
+        int i = activeLeds[a];
+        uint32_t lastOn = ledLastOn[i];
+        if (frame == lastOn + sparkFrames) {
+            endSpark(i, frame);
+            if (valIdle != 0) {
+                setIdleColor(i);
             }
+            activeLeds[a] = activeLeds[--activeCount];
+            continue;
         }
-        int lastOn = ledState[i].lastOn;
+        ++a;
+
         CHSV color;
-        if (frame < lastOn) {
-            if (valIdle == 0) {
-                color.v = 0;
-            } else {
-                color.setHSV(ledState[i].baseHue, ledState[i].hueKind == 0 ? hueParams.sat1 : hueParams.sat2, valIdle);
-            }
-        } else if (frame < lastOn + attackFrames) {
+        uint8_t sat = ledHueKind[i] == 0 ? hueParams.sat1 : hueParams.sat2;
+        int highDelta = ledHueKind[i] == 0 ? hueParams.hue1HighDelta : hueParams.hue2HighDelta;
+        if (frame < lastOn + attackFrames) {
             int f = frame - lastOn;
             int val = attackValPerFrame[f];
             int hue =
                 // starting hue
-                ledState[i].baseHue
+                ledBaseHue[i]
                 // delta
-                + (ledState[i].hueKind == 0 ? hueParams.hue1HighDelta : hueParams.hue2HighDelta) * f / attackFrames;
-            color.setHSV(hue, ledState[i].hueKind == 0 ? hueParams.sat1 : hueParams.sat2, val);
-            ++sparkingCount;
+                + highDelta * f / attackFrames;
+            color.setHSV(hue, sat, val);
         } else if (frame < lastOn + attackFrames + fullValFrames) {
             int hue =
                 // starting hue
-                ledState[i].baseHue
+                ledBaseHue[i]
                 // delta
-                + (ledState[i].hueKind == 0 ? hueParams.hue1HighDelta : hueParams.hue2HighDelta);
-            color.setHSV(hue, ledState[i].hueKind == 0 ? hueParams.sat1 : hueParams.sat2, valMax);
-            ++sparkingCount;
-        } else if (frame < lastOn + attackFrames + fullValFrames + decayFrames) {
+                + highDelta;
+            color.setHSV(hue, sat, valMax);
+        } else {
             int f = frame - lastOn - attackFrames - fullValFrames;
             int val = decayValPerFrame[f];
             int hue =
                 // starting hue
-                ledState[i].baseHue
+                ledBaseHue[i]
                 // delta
-                + (ledState[i].hueKind == 0 ? hueParams.hue1HighDelta : hueParams.hue2HighDelta) * (decayFrames - f) / decayFrames;
-            color.setHSV(hue, ledState[i].hueKind == 0 ? hueParams.sat1 : hueParams.sat2, val);
-            ++sparkingCount;
-        } else {
-            if (valIdle == 0) {
-                color.v = 0;
-            } else {
-                color.setHSV(ledState[i].baseHue, ledState[i].hueKind == 0 ? hueParams.sat1 : hueParams.sat2, valIdle);
-            }
+                + highDelta * (decayFrames - f) / decayFrames;
+            color.setHSV(hue, sat, val);
         }
+        ++sparkingCount;
 
-        // last effect wins unless it is 0
-        if (color != CRGB(0,0,0)) {
+        if (color.v != 0 || valIdle != 0) {
             *leds->at(ledStart + i) = color;
         }
-
-//         // stongest luma wins
-//         if (ledArray[ledStart + i] == CRGB(0,0,0)) {
-//             hsv2rgb_rainbow(color, ledArray[i]);
-//             // hsv2rgb_spectrum(color, ledArray[i]);
-// //            ledArray[i].g /= 2;
-//         } else { // strongest luma wins
-//             int newLuma = color.v; // getLuma() ?
-//             int currentLuma = ledArray[i].getLuma();
-//             if (newLuma > currentLuma) {
-//                 hsv2rgb_rainbow(color, ledArray[i]);
-//                 // hsv2rgb_spectrum(color, ledArray[i]);
-// //                ledArray[i].g /= 2;
-//             }
-//         }
-
     }
     if (statAvgSparkingPct == 0) {
         statAvgSparkingPct = ((uint64_t)sparkingCount * 100 / ledCount) << 16;
@@ -72,18 +72,33 @@ private:
     uint32_t statAvgSparkingPct;
 
     /**
-     * Led state: time when the led went on, or time in the future when it must
+     * Led state, one array per field, ledCount elements each.
+     * lastOn: time when the led went on, or time in the future when it must
      * switch on (in frames).
      */
-    struct LedState {
-        uint32_t lastOn;
-        uint8_t baseHue; // hue of the start of spark
-        int hueKind:1; // if 0 we're using hue1, if 1 we're using hue2
-    };
-    LedState *ledState;
+    uint32_t *ledLastOn;
+    uint8_t *ledBaseHue; // hue of the start of spark
+    uint8_t *ledHueKind; // if 0 we're using hue1, if 1 we're using hue2
+
+    /**
+     * Leds waiting for their next spark are in a calendar queue: bucket (lastOn & bucketMask)
+     * is a list linked through ledNext, -1 terminated. When a bucket contains leds from
+     * a later round (lastOn beyond the bucket count), they're left in place.
+     * Leds that are sparking are in activeLeds, so a frame only visits these.
+     */
+    int32_t *ledNext;
+    int32_t *bucketHead;
+    uint32_t bucketMask;
+    int32_t *activeLeds;
+    int activeCount;
     Random rnd;
 
     void reinitLedState(uint32_t frame);
+    void allocLedState();
+    void freeLedState();
+    void rebuildSchedule(uint32_t frame);
+    void endSpark(int i, uint32_t frame);
+    void setIdleColor(int i);
     void calcFrameProperties();
     int getRndExp();
 
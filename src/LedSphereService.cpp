@@ -61,93 +61,7 @@ void LedSphereService::init(UEventLoop *eventLoop, CommandMgr *commandMgr, LogMg
         Serial.printf("Loaded config for %s/%s\n", cmd->getServiceName(), keyName.c_str());
     }
 
-    // init data structures
-    startupEnterCommands = nullptr;
-    startupLeaveCommands = nullptr;
-    clickCommands = nullptr;
-    batteryLowEnterCommands = nullptr;
-    batteryLowLeaveCommands = nullptr;
-    usbPowerEnterCommands = nullptr;
-    usbPowerLeaveCommands = nullptr;
-
-    File f = SPIFFS.open("/ledSphereCommands.json", "r");
-    JsonObject &commands = clickCommandsBuffer.parseObject(f);
-    f.close();
-    if (!commands.success()) {
-        logger->error("Could not load json file ledSphereCommands.json");
-    } else {
-        Logger *logger = this->logger;
-        auto parseCommands = [logger](JsonObject &commands, const char *key1, const char *key2) {
-            if (commands.containsKey(key1)) {
-                JsonObject &o = commands[key1].as<JsonObject>();
-                if (o.success()) {
-                    JsonArray *p = &o[key2].as<JsonArray>();
-                    if (p->success()) {
-                        String str;
-                        p->printTo(str);
-                        logger->debug("{}.{}: {}", LogValue(key1, LogValue::STATIC),
-                            LogValue(key2, LogValue::STATIC), LogValue(str.c_str(), LogValue::DO_COPY));
-                        return p;
-                    } else {
-                        logger->error("Could not parse \"{}.{}\" in ledSphereCommands.json",
-                            LogValue(key1, LogValue::STATIC), LogValue(key2, LogValue::STATIC));
-                    }
-                } else {
-                    logger->error("Could not parse \"{}\" in ledSphereCommands.json", LogValue(key1, LogValue::STATIC));
-                }
-            }
-            return (JsonArray *)nullptr;
-        };
-
-        startupEnterCommands = parseCommands(commands, "startup", "enter");
-        startupLeaveCommands = parseCommands(commands, "startup", "leave");
-        batteryLowEnterCommands = parseCommands(commands, "batteryLow", "enter");
-        batteryLowLeaveCommands = parseCommands(commands, "batteryLow", "leave");
-        usbPowerEnterCommands = parseCommands(commands, "usbPower", "enter");
-        usbPowerLeaveCommands = parseCommands(commands, "usbPower", "leave");
-
-        JsonArray *p = &commands["click"].as<JsonArray>();
-        if (!p->success()) {
-            logger->error("Could not parse \"click\" in ledSphereCommands.json");
-        } else {
-            // all elements of p are arrays of strings
-            bool isOk = true;
-            for (int i = 0; i < p->size(); i++) {
-                if (!(*p)[i].is<JsonArray>()) {
-                    logger->error("Could not parse \"click[{}]\" as an array of strings in ledSphereCommands.json", i);
-                    isOk = false;
-                }
-            }
-            if (isOk) {
-                String str;
-                p->printTo(str);
-                logger->debug("click: {}", LogValue(str.c_str(), LogValue::DO_COPY));
-                clickCommands = p;
-            }
-        }
-    }
-
-    if (startupEnterCommands == nullptr) {
-        startupEnterCommands = &clickCommandsBuffer.createArray();
-    }
-    if (startupLeaveCommands == nullptr) {
-        startupLeaveCommands = &clickCommandsBuffer.createArray();
-    }
-    if (clickCommands == nullptr) {
-        clickCommands = &clickCommandsBuffer.createArray();
-    }
-    if (batteryLowEnterCommands == nullptr) {
-        batteryLowEnterCommands = &clickCommandsBuffer.createArray();
-    }
-    if (batteryLowLeaveCommands == nullptr) {
-        batteryLowLeaveCommands = &clickCommandsBuffer.createArray();
-    }
-    if (usbPowerEnterCommands == nullptr) {
-        usbPowerEnterCommands = &clickCommandsBuffer.createArray();
-    }
-    if (usbPowerLeaveCommands == nullptr) {
-        usbPowerLeaveCommands = &clickCommandsBuffer.createArray();
-    }
+    loadCommandBatches();
 
     clickIndex = 0;
 
@@ -200,6 +114,102 @@ void LedSphereService::init(UEventLoop *eventLoop, CommandMgr *commandMgr, LogMg
     dfa.handleInput(START);
 }
 
+void LedSphereService::loadCommandBatches()
+{
+    DynamicJsonBuffer buf;
+    File f = SPIFFS.open("/ledSphereCommands.json", "r");
+    JsonObject &commands = buf.parseObject(f);
+    f.close();
+    if (!commands.success()) {
+        logger->error("Could not load json file ledSphereCommands.json");
+        return;
+    }
+
+    auto parseCommands = [this](JsonObject &commands, const char *key1, const char *key2, CommandBatch *batch) {
+        if (commands.containsKey(key1)) {
+            JsonObject &o = commands[key1].as<JsonObject>();
+            if (o.success()) {
+                JsonArray &p = o[key2].as<JsonArray>();
+                if (p.success()) {
+                    String name(key1);
+                    name.concat('.');
+                    name.concat(key2);
+                    compileCommands(p, batch, name.c_str());
+                } else {
+                    logger->error("Could not parse \"{}.{}\" in ledSphereCommands.json",
+                        LogValue(key1, LogValue::STATIC), LogValue(key2, LogValue::STATIC));
+                }
+            } else {
+                logger->error("Could not parse \"{}\" in ledSphereCommands.json", LogValue(key1, LogValue::STATIC));
+            }
+        }
+    };
+
+    parseCommands(commands, "startup", "enter", &startupEnterCommands);
+    parseCommands(commands, "startup", "leave", &startupLeaveCommands);
+    parseCommands(commands, "batteryLow", "enter", &batteryLowEnterCommands);
+    parseCommands(commands, "batteryLow", "leave", &batteryLowLeaveCommands);
+    parseCommands(commands, "usbPower", "enter", &usbPowerEnterCommands);
+    parseCommands(commands, "usbPower", "leave", &usbPowerLeaveCommands);
+
+    JsonArray &p = commands["click"].as<JsonArray>();
+    if (!p.success()) {
+        logger->error("Could not parse \"click\" in ledSphereCommands.json");
+    } else {
+        // all elements of p are arrays of strings
+        bool isOk = true;
+        for (int i = 0; i < p.size(); i++) {
+            if (!p[i].is<JsonArray>()) {
+                logger->error("Could not parse \"click[{}]\" as an array of strings in ledSphereCommands.json", i);
+                isOk = false;
+            }
+        }
+        if (isOk) {
+            clickCommands.resize(p.size());
+            for (int i = 0; i < p.size(); i++) {
+                String name("click[");
+                name.concat(i);
+                name.concat(']');
+                compileCommands(p[i].as<JsonArray>(), &clickCommands[i], name.c_str());
+            }
+        }
+    }
+}
+
+void LedSphereService::compileCommands(JsonArray &commands, CommandBatch *batch, const char *name)
+{
+    String str;
+    commands.printTo(str);
+    logger->debug("{}: {}", name, str.c_str());
+
+    for (int i = 0; i < commands.size(); i++) {
+        const char *cmd = commands[i].as<const char *>();
+        if (cmd == nullptr) {
+            logger->error("Command {}[{}] in ledSphereCommands.json is not a string", name, i);
+            continue;
+        }
+        String msg;
+        if (!commandMgr->addToBatch(batch, cmd, &msg)) {
+            logger->error("Command \"{}\" in ledSphereCommands.json: {}",
+                cmd, msg.c_str());
+        }
+    }
+}
+
+void LedSphereService::runCommands(CommandBatch *batch)
+{
+    int processed = commandMgr->processBatch("ledSphere", batch);
+    if (processed < batch->size()) {
+        for (int i = 0; i < batch->size(); i++) {
+            CommandBatch::Result *r = batch->getResult(i);
+            if (!r->isProcessed) {
+                logger->error("Command \"{}\" failed: {}", batch->getCommandLine(i),
+                    r->msg.c_str());
+            }
+        }
+    }
+}
+
 void LedSphereService::initDfa()
 {
     dfa.init(eventLoop, nullptr /* or logger, to log */, LS_STARTUP);
@@ -222,10 +232,7 @@ void LedSphereService::initDfa()
 
             if (input.is(Dfa::Input::ENTER_STATE)) {
                 // load initial led config
-                for (int i = 0; i < startupEnterCommands->size(); i++) {
-                    String cmd = (*startupEnterCommands)[i].as<const char *>();
-                    this->commandMgr->processCommandLine("ledSphere", &cmd);
-                }
+                runCommands(&startupEnterCommands);
                 String cmd("led0 sparkDensityPct");
                 this->commandMgr->processCommandLine("ledSphere", &cmd);
                 dfaStartSparkDensityPct = cmd.toInt();
@@ -247,18 +254,12 @@ void LedSphereService::initDfa()
                     ++dfaStartSeq;
                     dfa->setStateTimeout(1000);
                 } else {
-                    for (int i = 0; i < startupLeaveCommands->size(); i++) {
-                        String cmd = (*startupLeaveCommands)[i].as<const char *>();
-                        this->commandMgr->processCommandLine("ledSphere", &cmd);
-                    }
+                    runCommands(&startupLeaveCommands);
                     clickIndex = 0;
                     return dfa->transitionTo(LS_ACTIVE); // not to LS_START_ACTIVE, as we don't want to re-apply clickCommands[0]
                 }
             } else if (input.is(BATTERY_LOW, USB_POWER)) {
-                for (int i = 0; i < startupLeaveCommands->size(); i++) {
-                    String cmd = (*startupLeaveCommands)[i].as<const char *>();
-                    this->commandMgr->processCommandLine("ledSphere", &cmd);
-                }
+                runCommands(&startupLeaveCommands);
                 return dfa->transitionTo(input.is(BATTERY_LOW) ? LS_BATTERY_LOW : LS_ON_USB_STANDBY);
             } else if (input.is(CLICK)) {
                 this->beeperService->beep(6, 9, 10);
@@ -268,9 +269,8 @@ void LedSphereService::initDfa()
         } else if (state.is(LS_START_ACTIVE)) {
 
             if (input.is(Dfa::Input::ENTER_STATE)) {
-                for (int i = 0; i < (*clickCommands)[clickIndex].size(); i++) {
-                    String cmd = (*clickCommands)[clickIndex][i].as<const char *>();
-                    this->commandMgr->processCommandLine("ledSphere", &cmd);
+                if (clickIndex < clickCommands.size()) {
+                    runCommands(&clickCommands[clickIndex]);
                 }
                 return dfa->transitionTo(LS_ACTIVE);
             }
@@ -282,13 +282,12 @@ void LedSphereService::initDfa()
                     return dfa->transitionTo(LS_ON_USB_STANDBY);
                 } else {
                     ++clickIndex;
-                    if (clickIndex > clickCommands->size()) {
+                    if (clickIndex > clickCommands.size()) {
                         clickIndex = 0;
                     }
-logger->debug("Click index: {}, commands: {}", clickIndex, (*clickCommands)[clickIndex].size());
-                    for (int i = 0; i < (*clickCommands)[clickIndex].size(); i++) {
-                        String cmd = (*clickCommands)[clickIndex][i].as<const char *>();
-                        this->commandMgr->processCommandLine("ledSphere", &cmd);
+logger->debug("Click index: {}, commands: {}", clickIndex, clickIndex < clickCommands.size() ? clickCommands[clickIndex].size() : 0);
+                    if (clickIndex < clickCommands.size()) {
+                        runCommands(&clickCommands[clickIndex]);
                     }
                     this->beeperService->beep(6, 2, 30, 0, 6, 9, 30);
                     return dfa->noTransition();
@@ -300,16 +299,10 @@ logger->debug("Click index: {}, commands: {}", clickIndex, (*clickCommands)[clic
         } else if (state.is(LS_BATTERY_LOW)) {
 
             if (input.is(Dfa::Input::ENTER_STATE)) {
-                for (int i = 0; i < batteryLowEnterCommands->size(); i++) {
-                    String cmd = (*batteryLowEnterCommands)[i].as<const char *>();
-                    this->commandMgr->processCommandLine("ledSphere", &cmd);
-                }
+                runCommands(&batteryLowEnterCommands);
                 return dfa->noTransition();
             } else if (input.is(BATTERY_LOW_TERMINATED, USB_POWER)) {
-                for (int i = 0; i < batteryLowLeaveCommands->size(); i++) {
-                    String cmd = (*batteryLowLeaveCommands)[i].as<const char *>();
-                    this->commandMgr->processCommandLine("ledSphere", &cmd);
-                }
+                runCommands(&batteryLowLeaveCommands);
                 return dfa->transitionTo(input.is(USB_POWER) ? LS_ON_USB_STANDBY : LS_START_ACTIVE);
             } else if (input.is(CLICK)) {
                 this->beeperService->beep(5, 2, 100);
@@ -319,19 +312,11 @@ logger->debug("Click index: {}, commands: {}", clickIndex, (*clickCommands)[clic
         } else if (state.is(LS_ON_USB_STANDBY)) {
 
             if (input.is(Dfa::Input::ENTER_STATE)) {
-                String cmd;
-                for (int i = 0; i < usbPowerEnterCommands->size(); i++) {
-                    cmd = (*usbPowerEnterCommands)[i].as<const char *>();
-                    this->commandMgr->processCommandLine("ledSphere", &cmd);
-                }
+                runCommands(&usbPowerEnterCommands);
                 this->beeperService->beep(6, 2, 20, 0, 6, 3, 20, 0, 6, 5, 20, 0, 6, 7, 20, 0, 6, 8, 20);
                 return dfa->noTransition();
             } else if (input.is(BATTERY_LOW, USB_POWER_TERMINATED, CLICK)) {
-                String cmd;
-                for (int i = 0; i < usbPowerLeaveCommands->size(); i++) {
-                    cmd = (*usbPowerLeaveCommands)[i].as<const char *>();
-                    this->commandMgr->processCommandLine("ledSphere", &cmd);
-                }
+                runCommands(&usbPowerLeaveCommands);
                 if (input.is(BATTERY_LOW)) {
                     return dfa->transitionTo(LS_BATTERY_LOW);
                 } else if (input.is(USB_POWER_TERMINATED)) {
@@ -339,7 +324,7 @@ logger->debug("Click index: {}, commands: {}", clickIndex, (*clickCommands)[clic
                     return dfa->transitionTo(LS_START_SEQUENCE);
                 } else { // CLICK
                     ++clickIndex;
-                    if (clickIndex > clickCommands->size()) {
+                    if (clickIndex > clickCommands.size()) {
                         clickIndex = 0;
                     }
                     this->beeperService->beep(6, 2, 30, 0, 6, 9, 30);
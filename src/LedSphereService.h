@@ -46,14 +46,14 @@ private:
     BeeperService *beeperService;
     LedService *ledService;
 
-    DynamicJsonBuffer clickCommandsBuffer;
-    JsonArray *startupEnterCommands; // array of strings
-    JsonArray *startupLeaveCommands; // array of strings
-    JsonArray *clickCommands; // array of arrays of strings
-    JsonArray *batteryLowEnterCommands; // array of strings
-    JsonArray *batteryLowLeaveCommands; // array of strings
-    JsonArray *usbPowerEnterCommands; // array of strings
-    JsonArray *usbPowerLeaveCommands; // array of strings
+    // command lists from ledSphereCommands.json, compiled once at load time
+    CommandBatch startupEnterCommands;
+    CommandBatch startupLeaveCommands;
+    std::vector<CommandBatch> clickCommands;
+    CommandBatch batteryLowEnterCommands;
+    CommandBatch batteryLowLeaveCommands;
+    CommandBatch usbPowerEnterCommands;
+    CommandBatch usbPowerLeaveCommands;
 
     SysPin voltageSensePin;
     SysPin chargingSensePin;
@@ -93,6 +93,9 @@ private:
 
     void initCommands(ServiceCommands *cmd);
     void initDfa();
+    void loadCommandBatches();
+    void compileCommands(JsonArray &commands, CommandBatch *batch, const char *name);
+    void runCommands(CommandBatch *batch);
 
     void voltageCheck();
     void chargingCheck();
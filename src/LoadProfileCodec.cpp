@@ -0,0 +1,226 @@
+#include <math.h>
+#include <algorithm>
+#include "Varint.h"
+#include "LoadProfileCodec.h"
+
+void LoadProfileEncoder::Channel::reset(int32_t value)
+{
+    anchor = value;
+    slopeLow = -INFINITY;
+    slopeHigh = INFINITY;
+    min = INT32_MAX;
+    max = INT32_MIN;
+    last = value;
+}
+
+bool LoadProfileEncoder::Channel::fits(uint32_t dt, int32_t value)
+{
+    if (dt == 0) {
+        // same milli as the anchor: only counted in min and max
+        return true;
+    }
+    float low = (value - maxError - anchor) / dt;
+    float high = (value + maxError - anchor) / dt;
+    return std::max(slopeLow, low) <= std::min(slopeHigh, high);
+}
+
+void LoadProfileEncoder::Channel::add(uint32_t dt, int32_t value)
+{
+    if (dt != 0) {
+        slopeLow = std::max(slopeLow, (value - maxError - anchor) / dt);
+        slopeHigh = std::min(slopeHigh, (value + maxError - anchor) / dt);
+    }
+    min = std::min(min, value);
+    max = std::max(max, value);
+    last = value;
+}
+
+int32_t LoadProfileEncoder::Channel::pointAt(uint32_t dt) const
+{
+    if (dt == 0) {
+        return last;
+    }
+    return lroundf(anchor + (slopeLow + slopeHigh) / 2 * dt);
+}
+
+LoadProfileEncoder::LoadProfileEncoder(std::vector<uint8_t> &out)
+    : out(out)
+{
+    maxSize = 0;
+    anchorTs = 0;
+    lastTs = 0;
+    sampleCount = 0;
+    pointCount = 0;
+    isStarted = false;
+    isFull = false;
+}
+
+void LoadProfileEncoder::begin(uint32_t startTs, int currentMaxError, int voltageMaxError, size_t maxSize)
+{
+    out.clear();
+    Varint::add(out, VERSION);
+    Varint::add(out, currentMaxError);
+    Varint::add(out, voltageMaxError);
+    // the points are rounded to integers, which adds up to 0.5 to the error of the lines
+    current.maxError = std::max(currentMaxError - 0.5f, 0.0f);
+    voltage.maxError = std::max(voltageMaxError - 0.5f, 0.0f);
+    this->maxSize = maxSize;
+    anchorTs = startTs;
+    lastTs = startTs;
+    sampleCount = 0;
+    pointCount = 0;
+    isStarted = false;
+    isFull = false;
+}
+
+bool LoadProfileEncoder::writePoint(std::vector<uint8_t> &data, uint32_t tsDelta, int count,
+    int32_t currentDelta, int32_t voltageDelta,
+    int32_t currentBelow, int32_t currentAbove, int32_t voltageBelow, int32_t voltageAbove) const
+{
+    if (data.size() >= maxSize) {
+        Varint::add(data, tsDelta);
+        Varint::add(data, 0);
+        return false;
+    }
+    bool hasExtremes = (currentBelow != 0 || currentAbove != 0 || voltageBelow != 0 || voltageAbove != 0);
+    Varint::add(data, tsDelta);
+    Varint::add(data, count << 1 | hasExtremes);
+    Varint::addSigned(data, currentDelta);
+    Varint::addSigned(data, voltageDelta);
+    if (hasExtremes) {
+        Varint::addSigned(data, currentBelow);
+        Varint::addSigned(data, currentAbove);
+        Varint::addSigned(data, voltageBelow);
+        Varint::addSigned(data, voltageAbove);
+    }
+    return true;
+}
+
+bool LoadProfileEncoder::writeSegmentEnd(std::vector<uint8_t> &data) const
+{
+    uint32_t dt = lastTs - anchorTs;
+    int32_t c = current.pointAt(dt);
+    int32_t v = voltage.pointAt(dt);
+    return writePoint(data, dt, sampleCount, c - current.anchor, v - voltage.anchor,
+        std::min(current.anchor, c) - current.min, current.max - std::max(current.anchor, c),
+        std::min(voltage.anchor, v) - voltage.min, voltage.max - std::max(voltage.anchor, v));
+}
+
+void LoadProfileEncoder::addPoint(uint32_t tsDelta, int count, int32_t currentDelta, int32_t voltageDelta,
+    int32_t currentBelow, int32_t currentAbove, int32_t voltageBelow, int32_t voltageAbove)
+{
+    if (writePoint(out, tsDelta, count, currentDelta, voltageDelta, currentBelow, currentAbove, voltageBelow, voltageAbove)) {
+        ++pointCount;
+    } else {
+        isFull = true;
+    }
+}
+
+void LoadProfileEncoder::closeSegment()
+{
+    if (writeSegmentEnd(out)) {
+        ++pointCount;
+    } else {
+        isFull = true;
+    }
+    uint32_t dt = lastTs - anchorTs;
+    current.reset(current.pointAt(dt));
+    voltage.reset(voltage.pointAt(dt));
+    anchorTs = lastTs;
+    sampleCount = 0;
+}
+
+void LoadProfileEncoder::add(uint32_t ts, int32_t currentValue, int32_t voltageValue)
+{
+    if (isFull) {
+        return;
+    }
+    if (!isStarted) {
+        addPoint(ts - anchorTs, 1, currentValue, voltageValue, 0, 0, 0, 0);
+        current.reset(currentValue);
+        voltage.reset(voltageValue);
+        anchorTs = ts;
+        lastTs = ts;
+        isStarted = true;
+        return;
+    }
+    uint32_t dt = ts - anchorTs;
+    if (!current.fits(dt, currentValue) || !voltage.fits(dt, voltageValue)) {
+        closeSegment();
+        if (isFull) {
+            return;
+        }
+        dt = ts - anchorTs;
+    }
+    current.add(dt, currentValue);
+    voltage.add(dt, voltageValue);
+    lastTs = ts;
+    ++sampleCount;
+}
+
+void LoadProfileEncoder::finish()
+{
+    if (isStarted && !isFull && sampleCount > 0) {
+        closeSegment();
+    }
+}
+
+void LoadProfileEncoder::snapshot(std::vector<uint8_t> *data) const
+{
+    *data = out;
+    if (isStarted && !isFull && sampleCount > 0) {
+        writeSegmentEnd(*data);
+    }
+}
+
+LoadProfileDecoder::LoadProfileDecoder(const uint8_t *data, size_t size)
+{
+    ptr = data;
+    end = data + size;
+    currentMaxError = 0;
+    voltageMaxError = 0;
+    last = Point();
+    isTruncatedData = false;
+    uint32_t version;
+    isError = !Varint::decode(ptr, end, &version) || version != LoadProfileEncoder::VERSION
+        || !Varint::decode(ptr, end, &currentMaxError) || !Varint::decode(ptr, end, &voltageMaxError);
+}
+
+bool LoadProfileDecoder::next(Point *point)
+{
+    if (isError || isTruncatedData || ptr == end) {
+        return false;
+    }
+    uint32_t tsDelta;
+    uint32_t count;
+    if (!Varint::decode(ptr, end, &tsDelta) || !Varint::decode(ptr, end, &count)) {
+        isError = true;
+        return false;
+    }
+    if (count == 0) {
+        isTruncatedData = true;
+        return false;
+    }
+    int32_t d[6] = { 0, 0, 0, 0, 0, 0 };
+    for (int i = 0; i < ((count & 1) ? 6 : 2); i++) {
+        if (!Varint::decodeSigned(ptr, end, &d[i])) {
+            isError = true;
+            return false;
+        }
+    }
+    bool isFirst = (last.sampleCount == 0);
+    Point p;
+    p.ts = last.ts + tsDelta;
+    p.sampleCount = count >> 1;
+    p.current = last.current + d[0];
+    p.voltage = last.voltage + d[1];
+    int32_t currentFrom = (isFirst ? p.current : last.current);
+    int32_t voltageFrom = (isFirst ? p.voltage : last.voltage);
+    p.currentMin = std::min(currentFrom, p.current) - d[2];
+    p.currentMax = std::max(currentFrom, p.current) + d[3];
+    p.voltageMin = std::min(voltageFrom, p.voltage) - d[4];
+    p.voltageMax = std::max(voltageFrom, p.voltage) + d[5];
+    last = p;
+    *point = p;
+    return true;
+}
@@ -0,0 +1,123 @@
+#ifndef INCL_LOAD_PROFILE_CODEC_H
+#define INCL_LOAD_PROFILE_CODEC_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <vector>
+
+/**
+ * Load profile: current and voltage of the load while it runs, as a piecewise linear
+ * curve, and its decoder. Only depends on the standard library, so that the same code
+ * builds on the server side.
+ *
+ * Samples are compressed with the swinging door algorithm, both channels sharing the
+ * points: a segment is extended while a line from its start stays within the max error of
+ * every sample of both channels; when a sample makes it impossible, a point is emitted at
+ * the previous sample, on the line in the middle of the door, and a new segment starts
+ * there. The values interpolated between two points are within the max error of the
+ * samples. The min and max of the samples of each segment are kept too, so that spikes
+ * shorter than a segment are not lost.
+ *
+ * The encoded data, all varints (see Varint.h):
+ *
+ *     version            2
+ *     currentMaxError    mA
+ *     voltageMaxError    mV
+ *     point*
+ *
+ *     point:             tsDelta  sampleCount << 1 | hasExtremes  current  voltage
+ *                        [currentBelow  currentAbove  voltageBelow  voltageAbove]
+ *
+ * tsDelta is the number of millis since the previous point (since turn on for the first
+ * one), sampleCount the number of samples in the segment ending at the point (1 for the
+ * first point). current and voltage are signed differences with the previous point (with
+ * 0 for the first one). currentBelow is the signed difference between the lowest end of
+ * the segment and the min of its samples, currentAbove between the max of its samples and
+ * the highest end; same for the voltage. They are only present with hasExtremes, else
+ * they are all 0. Both ends of the segment of the first point are the point itself.
+ *
+ * A point with a sampleCount of 0 and nothing after it marks a profile truncated because
+ * it reached its max size.
+ */
+class LoadProfileEncoder {
+    struct Channel {
+        float maxError; // error allowed for the line, before rounding the point to an integer
+        int32_t anchor; // value at the start of the segment
+        float slopeLow; // the door: slopes from the anchor that keep all samples within maxError
+        float slopeHigh;
+        int32_t min; // of the samples of the segment
+        int32_t max;
+        int32_t last;
+
+        void reset(int32_t value);
+        // false if the sample closes the door
+        bool fits(uint32_t dt, int32_t value);
+        void add(uint32_t dt, int32_t value);
+        int32_t pointAt(uint32_t dt) const;
+    };
+
+    std::vector<uint8_t> &out;
+    size_t maxSize;
+    Channel current;
+    Channel voltage;
+    uint32_t anchorTs;
+    uint32_t lastTs;
+    int sampleCount; // in the segment
+    uint32_t pointCount;
+    bool isStarted;
+    bool isFull;
+
+    // false, with the truncation marker written instead, if data reached maxSize
+    bool writePoint(std::vector<uint8_t> &data, uint32_t tsDelta, int count, int32_t currentDelta, int32_t voltageDelta,
+        int32_t currentBelow, int32_t currentAbove, int32_t voltageBelow, int32_t voltageAbove) const;
+    bool writeSegmentEnd(std::vector<uint8_t> &data) const;
+    void addPoint(uint32_t tsDelta, int count, int32_t currentDelta, int32_t voltageDelta,
+        int32_t currentBelow, int32_t currentAbove, int32_t voltageBelow, int32_t voltageAbove);
+    void closeSegment();
+public:
+    static const int VERSION = 2;
+
+    LoadProfileEncoder(std::vector<uint8_t> &out);
+    // clears out; startTs is the turn on time
+    void begin(uint32_t startTs, int currentMaxError, int voltageMaxError, size_t maxSize);
+    // ts in millis, not before the previous sample
+    void add(uint32_t ts, int32_t currentValue, int32_t voltageValue);
+    // emits the end of the last segment
+    void finish();
+    // the profile so far into data, as finish() would emit it, the last segment left open
+    void snapshot(std::vector<uint8_t> *data) const;
+    uint32_t getPointCount() { return pointCount; }
+    bool isTruncated() { return isFull; }
+};
+
+class LoadProfileDecoder {
+public:
+    struct Point {
+        uint32_t ts; // since turn on
+        uint32_t sampleCount;
+        int32_t current;
+        int32_t voltage;
+        int32_t currentMin; // of the samples of the segment ending here
+        int32_t currentMax;
+        int32_t voltageMin;
+        int32_t voltageMax;
+    };
+private:
+    const uint8_t *ptr;
+    const uint8_t *end;
+    uint32_t currentMaxError;
+    uint32_t voltageMaxError;
+    Point last;
+    bool isError;
+    bool isTruncatedData;
+public:
+    LoadProfileDecoder(const uint8_t *data, size_t size);
+    bool isValid() { return !isError; }
+    bool isTruncated() { return isTruncatedData; }
+    int getCurrentMaxError() { return currentMaxError; }
+    int getVoltageMaxError() { return voltageMaxError; }
+    // false at the end of the data, or if it is not valid
+    bool next(Point *point);
+};
+
+#endif
@@ -63,6 +63,9 @@ public:
     LogValue(uint64_t val, const char *format = nullptr);
     LogValue(double val, const char *format = nullptr);
     LogValue(const char *val, const char *format = nullptr);
+    // the string is always copied: the value may be logged after the caller's buffer is gone
+    enum StrMode { STATIC, DO_COPY };
+    LogValue(const char *val, StrMode mode, const char *format = nullptr);
     typedef std::function<void (String *)> ValueFunction;
     LogValue(ValueFunction val, const char *format = nullptr);
 
@@ -386,6 +389,11 @@ inline LogValue::LogValue(const char *val, const char *format)
     this->format = format;
 }
 
+inline LogValue::LogValue(const char *val, StrMode mode, const char *format)
+    : LogValue(val, format)
+{
+}
+
 inline LogValue::LogValue(std::function<void (String *)> val, const char *format)
 {
     this->val.fnVal = val;
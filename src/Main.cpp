@@ -14,9 +14,6 @@
 #include <ESPmDNS.h>
 #include <SPIFFSEditor.h>
 #include <esp_task.h>
-#ifdef USE_JS
-#include <duktape.h>
-#endif
 #include <ArduinoJson.h>
 #include <HardwareSerial.h>
 #include <soc/efuse_reg.h>
@@ -372,7 +369,9 @@ void setup() {
   sList->push_back(ServiceInit("RebootDetector", RebootDetectorService::MINIMUM, []() {
     fs::FS *fs;
     bool isEeprom;
+    EEPROMKvStore *kvStore = nullptr;
     #ifdef USE_EEPROM_LFS
+    kvStore = services.eepromLfs->getKvStore();
     fs = services.eepromLfs->getFs();
     if (fs == nullptr) {
       fs = &SPIFFS;
@@ -384,8 +383,8 @@ void setup() {
     fs = &SPIFFS;
     isEeprom = false;
     #endif
-    Serial.printf("Initializing RebootDetector using %s\n", isEeprom ? "EEPROM FS" : "SPIFFS");
-    services.rebootDetector->init(services.eventLoop, services.commandMgr, services.logMgr, services.systemService, fs);
+    Serial.printf("Initializing RebootDetector using %s\n", kvStore != nullptr ? "EEPROM key/value store" : isEeprom ? "EEPROM FS" : "SPIFFS");
+    services.rebootDetector->init(services.eventLoop, services.commandMgr, services.logMgr, services.systemService, fs, kvStore);
   }));
   #endif
   #ifdef USE_HEARTBEAT
@@ -437,7 +436,7 @@ void setup() {
   #endif
   #ifdef USE_SIM7000
   sList->push_back(ServiceInit("Sim7000", RebootDetectorService::APPLICATION, []() {
-    services.sim7000->init(services.eventLoop, services.commandMgr, services.uart, services.logMgr); }));
+    services.sim7000->init(services.eventLoop, services.commandMgr, services.systemService, services.uart, services.logMgr); }));
   #endif
   #ifdef USE_SERVO
   sList->push_back(ServiceInit("Servo", RebootDetectorService::APPLICATION, []() {
@@ -457,7 +456,7 @@ void setup() {
   #endif
   #ifdef USE_BLE
   sList->push_back(ServiceInit("Ble", RebootDetectorService::APPLICATION, []() {
-    services.ble->init(services.eventLoop, services.commandMgr, services.logMgr);
+    services.ble->init(services.eventLoop, services.commandMgr, services.systemService, services.logMgr);
   }));
   #endif
   #ifdef USE_ESP32I2C
@@ -642,13 +641,6 @@ void setup() {
 
 } // end of setup()
 
-#ifdef USE_JS
-  duk_context *ctx = duk_create_heap_default();
-  duk_eval_string(ctx, "1+2");
-  Serial.printf("Javascript: 1+2=%d\n", (int) duk_get_int(ctx, -1));
-  duk_destroy_heap(ctx);
-#endif
-
 
 void startWebServer()
 {
@@ -18,6 +18,10 @@
  * /<prefix>/tele/<topic>/<measure/> xxx -- telemetry at specified interval
  * /<prefix>/cmnd/<topic>/<command> xxx -- incoming command
  * /<prefix>/stat/<topic>/<command> xxx -- reply for command or status changes
+ *
+ * The only command is timeSeries/query, the payload being its arguments, e.g.
+ * "ina3221.ch2.current 1m": once enabled with "mqtt timeSeriesQueries.enable", the reply of
+ * "timeSeries query <payload>" is published in stat/<topic>/timeSeries/query.
  */
 
 void MqttService::init(UEventLoop *eventLoop, CommandMgr *commandMgr, WifiAsyncService *wifi, LogMgr *logMgr)
@@ -36,6 +40,7 @@ void MqttService::init(UEventLoop *eventLoop, CommandMgr *commandMgr, WifiAsyncS
     topic = wifi->getHostName();
     prefix = "";
     isRetain = false;
+    isQueriesEnabled = false;
 
     // load config
     String msg;
@@ -50,7 +55,7 @@ void MqttService::init(UEventLoop *eventLoop, CommandMgr *commandMgr, WifiAsyncS
     // init data structures
 
     // strings that must be available as long as mqtt is connected
-    lwtTopic = prefix + "tele/" + topic + "/LWT";
+    setTopics();
 
     mqtt.setClientId(topic.c_str())
         .setServer(ipAddress.c_str(), ipPort)
@@ -59,6 +64,17 @@ void MqttService::init(UEventLoop *eventLoop, CommandMgr *commandMgr, WifiAsyncS
     
     mqtt.onConnect([this](bool isSessionPresent) {
         mqtt.publish(lwtTopic.c_str(), 1, true, "online");
+        if (isQueriesEnabled) {
+            mqtt.subscribe(queryTopic.c_str(), 0);
+        }
+    });
+    mqtt.onMessage([this](char *topic, char *payload, AsyncMqttClientMessageProperties properties,
+            size_t len, size_t index, size_t total) {
+        if (index != 0 || len != total) {
+            logger->warn("Ignoring query in {}, {} bytes is too long", topic, total);
+            return;
+        }
+        onQuery(topic, payload, len);
     });
     mqtt.onDisconnect([this](AsyncMqttClientDisconnectReason reason) {
 Serial.println("MQTT onDisconnect()");
@@ -85,6 +101,33 @@ Serial.println("MQTT disconnecting on wifi stop");
 
 }
 
+void MqttService::setTopics()
+{
+    lwtTopic = prefix + "tele/" + topic + "/LWT";
+    queryTopic = prefix + "cmnd/" + topic + "/timeSeries/query";
+}
+
+// called from the mqtt client task, the query is run in the event loop
+void MqttService::onQuery(const char *topic, const char *payload, size_t len)
+{
+    if (!isQueriesEnabled || queryTopic != topic) {
+        return;
+    }
+    String cmdLine = "timeSeries query ";
+    // the payload is not null terminated
+    cmdLine.reserve(cmdLine.length() + len);
+    for (size_t j = 0; j < len; j++) {
+        cmdLine += payload[j];
+    }
+    logger->debug("Query from mqtt: {}", cmdLine.c_str());
+    bool isQueued = commandMgr->queueCommandLine("MQTT", cmdLine, [this](bool isProcessed, String *result) {
+        publishStat("timeSeries/query", 0, false, result->c_str());
+    });
+    if (!isQueued) {
+        publishStat("timeSeries/query", 0, false, "Error queueing the query");
+    }
+}
+
 bool MqttService::publish(const char *topic, uint8_t qos, bool retain, const char* payload, size_t length)
 {
     int rc = mqtt.publish(topic, qos, retain, payload, length);
@@ -158,11 +201,17 @@ void MqttService::initCommands(ServiceCommands *cmd)
             if (!isLoading && mqtt.connected()) {
                 mqtt.publish(lwtTopic.c_str(), 0, false, nullptr);
             }
-            lwtTopic = prefix + "tele/" + topic + "/LWT";
+            if (!isLoading && mqtt.connected() && isQueriesEnabled) {
+                mqtt.unsubscribe(queryTopic.c_str());
+            }
+            setTopics();
             if (!isLoading) {
                 mqtt.setWill(lwtTopic.c_str(), 1, true, "offline");
                 if (mqtt.connected()) {
                     mqtt.publish(lwtTopic.c_str(), 1, true, "online");
+                    if (isQueriesEnabled) {
+                        mqtt.subscribe(queryTopic.c_str(), 0);
+                    }
                 }
             }
             return true;
@@ -193,11 +242,17 @@ void MqttService::initCommands(ServiceCommands *cmd)
                 }
             }
 
-            lwtTopic = prefix + "tele/" + topic + "/LWT";
+            if (!isLoading && mqtt.connected() && isQueriesEnabled) {
+                mqtt.unsubscribe(queryTopic.c_str());
+            }
+            setTopics();
             if (!isLoading) {
                 mqtt.setWill(lwtTopic.c_str(), 1, true, "offline");
                 if (mqtt.connected()) {
                     mqtt.publish(lwtTopic.c_str(), 1, true, "online");
+                    if (isQueriesEnabled) {
+                        mqtt.subscribe(queryTopic.c_str(), 0);
+                    }
                 }
             }
             if (prefix.isEmpty()) {
@@ -209,6 +264,25 @@ void MqttService::initCommands(ServiceCommands *cmd)
         })
     );
 
+    cmd->registerBoolData(ServiceCommands::BoolDataBuilder("timeSeriesQueriesEnabled", true)
+        .cmdOn("timeSeriesQueries.enable")
+        .cmdOff("timeSeriesQueries.disable")
+        .helpOn("--> Accept time series queries published in cmnd/<topic>/timeSeries/query, with the arguments of \"timeSeries query\"; the reply is in stat/<topic>/timeSeries/query")
+        .helpOff("--> Stop accepting time series queries by mqtt")
+        .ptr(&isQueriesEnabled)
+        .setFn([this](bool val, bool isLoading, String *msg) {
+            if (!isLoading && val != isQueriesEnabled && mqtt.connected()) {
+                if (val) {
+                    mqtt.subscribe(queryTopic.c_str(), 0);
+                } else {
+                    mqtt.unsubscribe(queryTopic.c_str());
+                }
+            }
+            isQueriesEnabled = val;
+            return true;
+        })
+    );
+
     cmd->registerBoolData(ServiceCommands::BoolDataBuilder("setRetain", true)
         .cmd("setRetain")
         .help("--> Sets the retain flag used by \"publish\" command")
@@ -34,6 +34,11 @@ private:
     AsyncMqttClient mqtt;
     bool isRetain;
     String lwtTopic;
+    bool isQueriesEnabled;
+    String queryTopic; // cmnd/<topic>/timeSeries/query, the only command accepted by mqtt
+
+    void setTopics();
+    void onQuery(const char *topic, const char *payload, size_t len);
 
 public:
     bool publish(const char* topic, uint8_t qos, bool retain, const char* payload = nullptr, size_t length = 0);
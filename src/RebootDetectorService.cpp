@@ -9,20 +9,26 @@
 #include "CommandMgr.h"
 #include "RebootDetectorService.h"
 #include "LogMgr.h"
+#ifdef USE_EEPROM_LFS
+#include "EEPROMKvStore.h"
+#endif
 
 RebootDetectorService::RebootDetectorService()
 : fileName("/rebootDetector.txt")
 {
     quickRebootsCount = 0;
+    kvStore = nullptr;
 }
 
-void RebootDetectorService::init(UEventLoop *eventLoop, CommandMgr *commandMgr, LogMgr *logMgr,  SystemService *systemService, FS *fs)
+void RebootDetectorService::init(UEventLoop *eventLoop, CommandMgr *commandMgr, LogMgr *logMgr,  SystemService *systemService, FS *fs,
+    EEPROMKvStore *kvStore)
 {
     this->eventLoop = eventLoop;
     this->commandMgr = commandMgr;
     this->logger = logMgr->newLogger("rebootDetector");
     this->systemService = systemService;
     this->fs = fs;
+    this->kvStore = kvStore;
     quickRebootsCount = 0;
     involuntaryShutdown = false;
     isEnabled = false;
@@ -42,40 +48,26 @@ void RebootDetectorService::init(UEventLoop *eventLoop, CommandMgr *commandMgr,
 
     // init data structures
 
-    if (fs && isEnabled) {
-        fs::File fd = fs->open(fileName, "r+");
-        if (!fd) {
-            fd = fs->open(fileName, "w+");
-        }
-        String line = fd.readString();
-        if (line.isEmpty()) {
-            fd.seek(0);
-            fd.print("-1"); // to consider involuntary shutdown if not reset to 0 upon shutdown
-            fd.flush();
+    if ((fs || kvStore) && isEnabled) {
+        int count;
+        if (!readCount(&count)) {
+            writeCount(-1); // to consider involuntary shutdown if not reset to 0 upon shutdown
         } else {
-            quickRebootsCount = line.toInt();
+            quickRebootsCount = count;
             if (quickRebootsCount == -1) {
                 quickRebootsCount = 0;
                 involuntaryShutdown = true;
             }
         }
-        fd.close();
-
-        fd = fs->open(fileName, "w+"); // to truncate
-        fd.print(quickRebootsCount + 1);
-        fd.close();
+        writeCount(quickRebootsCount + 1);
 
         systemService->onShutdown([this]() {
-            fs::File fd = this->fs->open(fileName, "w+");
-            fd.print("0"); // this is a voluntary shutdown
-            fd.close();
+            writeCount(0); // this is a voluntary shutdown
         });
 
         // if we manage to survive for 10 seconds, we'll reset the stored quickRebootCounts, we consider booting is OK
         timer.init(eventLoop, [this](UEventLoopTimer *timer) {
-            fs::File fd = this->fs->open(fileName, "w+");
-            fd.print("-1"); // reset stored counter, but if not set to 0 upon shutdown, will be considered involontary shutdown
-            fd.close();
+            writeCount(-1); // reset stored counter, but if not set to 0 upon shutdown, will be considered involontary shutdown
 
             // if we had a reboot level > 0, and we managed to reset it here, we
             // must reboot after 15 minutes - unless we receive a reset
@@ -125,15 +117,53 @@ void RebootDetectorService::resetRebootLevel()
 {
     if (isEnabled && quickRebootsCount > 0) {
         quickRebootsCount = 0;
-        if (fs) {
-            fs::File fd = fs->open(fileName, "w+");
-            fd.print(0);
-            fd.close();
-        }
+        writeCount(0);
         timer.cancelTimeout();
     }
 }
 
+bool RebootDetectorService::readCount(int *count)
+{
+#ifdef USE_EEPROM_LFS
+    if (kvStore != nullptr && kvStore->contains("rebootDetector.count")) {
+        *count = kvStore->get("rebootDetector.count");
+        return true;
+    }
+#endif
+    // with the key/value store, the file of former versions: init() writes the count to the store
+    fs::File fd = fs->open(fileName, "r");
+    String line;
+    if (fd) {
+        line = fd.readString();
+        fd.close();
+#ifdef USE_EEPROM_LFS
+        if (kvStore != nullptr) {
+            fs->remove(fileName);
+        }
+#endif
+    }
+    if (line.isEmpty()) {
+        return false;
+    }
+    *count = line.toInt();
+    return true;
+}
+
+void RebootDetectorService::writeCount(int count)
+{
+#ifdef USE_EEPROM_LFS
+    if (kvStore != nullptr) {
+        kvStore->set("rebootDetector.count", count);
+        return;
+    }
+#endif
+    if (fs) {
+        fs::File fd = fs->open(fileName, "w+"); // to truncate
+        fd.print(count);
+        fd.close();
+    }
+}
+
 bool RebootDetectorService::isInvoluntaryShutdown()
 {
     return involuntaryShutdown;
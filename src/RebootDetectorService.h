@@ -12,15 +12,20 @@
 #include "LogMgr.h"
 #include "SystemService.h"
 
+class EEPROMKvStore;
+
 class RebootDetectorService {
 public:
     RebootDetectorService();
-    void init(UEventLoop *eventLoop, CommandMgr *commandMgr, LogMgr *logMgr, SystemService *systemService, FS *fs);
+    // The count is kept in kvStore if not null, in a file of fs otherwise
+    void init(UEventLoop *eventLoop, CommandMgr *commandMgr, LogMgr *logMgr, SystemService *systemService, FS *fs,
+        EEPROMKvStore *kvStore = nullptr);
 private:
     UEventLoop *eventLoop;
     CommandMgr *commandMgr;
     Logger *logger;
     FS *fs;
+    EEPROMKvStore *kvStore;
     SystemService *systemService;
 
     bool isEnabled;
@@ -30,6 +35,8 @@ private:
     bool involuntaryShutdown;
 
     void initCommands(ServiceCommands *cmd);
+    bool readCount(int *count); // false if nothing was stored yet
+    void writeCount(int count);
 
 public:
     enum Level {
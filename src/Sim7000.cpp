@@ -13,7 +13,7 @@
 #include <time.h>
 #include "pdu.h"
 
-void Sim7000Service::init(UEventLoop *eventLoop, CommandMgr *commandMgr, UartService *uart, LogMgr *logMgr)
+void Sim7000Service::init(UEventLoop *eventLoop, CommandMgr *commandMgr, SystemService *systemService, UartService *uart, LogMgr *logMgr)
 {
     this->eventLoop = eventLoop;
     this->commandMgr = commandMgr;
@@ -65,6 +65,9 @@ void Sim7000Service::init(UEventLoop *eventLoop, CommandMgr *commandMgr, UartSer
         Serial.printf("Loaded config for %s/%s\n", cmd->getServiceName(), keyName.c_str());
     }
 
+    // CSQ, 0..31
+    rssiSeries = (isEnabled ? systemService->getTimeSeries()->addMetric("sim7000.rssi", "csq", 32, 60, 24) : nullptr);
+
     if (pinSleep != -1) {
         pinMode(pinSleep, INPUT);
     }
@@ -317,6 +320,9 @@ void Sim7000Service::initDfa()
                     rssi = -1;
                 }
                 logger->info("RSSI = {}", rssi);
+                if (rssi >= 0 && rssi <= 31) { // 99 is unknown
+                    TimeSeries::add(rssiSeries, rssi);
+                }
                 return dfa->transitionTo(INIT_S60);
             } else if (input.is(Dfa::Input::TIMEOUT, RECEIVED_UNEXPECTED)) {
                 error = "BACKGROUND Timeout or received unexpected data at AT+CSQ?";
@@ -412,6 +418,9 @@ void Sim7000Service::initDfa()
                     rssi = -1;
                 }
                 logger->info("RSSI = {}", rssi);
+                if (rssi >= 0 && rssi <= 31) { // 99 is unknown
+                    TimeSeries::add(rssiSeries, rssi);
+                }
                 return dfa->transitionTo(IDLE);
             } else if (input.is(Dfa::Input::TIMEOUT, RECEIVED_UNEXPECTED)) {
                 error = "BACKGROUND Timeout or received unexpected data at AT+CSQ?";
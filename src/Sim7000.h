@@ -12,10 +12,11 @@
 #include "UartService.h"
 #include "LogMgr.h"
 #include "Dfa.h"
+#include "SystemService.h"
 
 class Sim7000Service {
 public:
-    void init(UEventLoop *eventLoop, CommandMgr *commandMgr, UartService *uart, LogMgr *logMgr);
+    void init(UEventLoop *eventLoop, CommandMgr *commandMgr, SystemService *systemService, UartService *uart, LogMgr *logMgr);
 
     struct Sms {
         int slot; // 0 to 9
@@ -47,6 +48,7 @@ private:
     bool isSimUnlocked;
     bool isFirstBackgroundRun;
     int rssi;
+    TimeSeries::Metric *rssiSeries;
 
     bool rcvExpectingData;
     bool rcvIsMultiLine;
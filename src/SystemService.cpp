@@ -48,6 +48,9 @@ void SystemService::init(UEventLoop *eventLoop, CommandMgr *commandMgr, LogMgr *
     });
     uptimeTimer.setInterval(24 * 3600 * 1000); // we just want millis() not to overflow
 
+    String msg;
+    bool rc;
+
 #ifdef USE_SYSTEM_I2C
     ServiceCommands *i2cCmd = commandMgr->getServiceCommands("i2c");
     initI2cCommands(i2cCmd);
@@ -56,8 +59,6 @@ void SystemService::init(UEventLoop *eventLoop, CommandMgr *commandMgr, LogMgr *
 
 
     // load config
-    String msg;
-    bool rc;
     rc = i2cCmd->load(nullptr, &msg);
     if (rc) {
         String keyName;
@@ -137,6 +138,18 @@ void SystemService::init(UEventLoop *eventLoop, CommandMgr *commandMgr, LogMgr *
         return true;
     });
 
+    // "timeSeries" command, loaded before the other services add their metrics
+    ServiceCommands *cmdTimeSeries = commandMgr->getServiceCommands("timeSeries");
+    initTimeSeriesCommands(cmdTimeSeries);
+    timeSeriesMaxMemory = 32768;
+    rc = cmdTimeSeries->load(nullptr, &msg);
+    if (rc) {
+        String keyName;
+        cmdTimeSeries->getCurrentKeyName(&keyName);
+        Serial.printf("Loaded config for %s/%s\n", cmdTimeSeries->getServiceName(), keyName.c_str());
+    }
+    timeSeries.setMaxMemory(timeSeriesMaxMemory);
+
     // init data structures
 
     // init hardware
@@ -174,6 +187,99 @@ void SystemService::getInfo(String *info)
         ;
 }
 
+void SystemService::initTimeSeriesCommands(ServiceCommands *cmd)
+{
+    cmd->registerIntData(
+        ServiceCommands::IntDataBuilder("maxMemory", true)
+        .cmd("maxMemory")
+        .help("--> Memory for the time series of the sensors, in bytes, 0 to disable - requires reboot")
+        .vMin(0)
+        .ptr(&timeSeriesMaxMemory)
+    );
+    cmd->registerStringData(
+        ServiceCommands::StringDataBuilder("metrics", true)
+        .cmd("metrics")
+        .help("--> Metrics: unit, entries of the raw, 1m and 1h tiers, memory, samples, last value")
+        .isPersistent(false)
+        .includeInStatus(false)
+        .getFn([this](String *val) {
+            getTimeSeriesMetrics(val);
+        })
+    );
+    cmd->registerStringData(
+        ServiceCommands::StringDataBuilder("query", true)
+        .cmd("query")
+        .help("query <metric> [raw|1m|1h] [count] --> Latest points of a metric as json, times in millis since boot;"
+            " raw points are [ts, value], 1m and 1h points [ts, min, max, avg, samples], the last one still open")
+        .isPersistent(false)
+        .includeInStatus(false)
+        .setFn([this](const String &val, bool isLoading, String *msg) -> bool {
+            return queryTimeSeries(val, msg);
+        })
+    );
+}
+
+void SystemService::getTimeSeriesMetrics(String *msg)
+{
+    *msg += "Memory: "; *msg += timeSeries.getUsedMemory(); *msg += " of "; *msg += timeSeries.getMaxMemory();
+    *msg += " bytes, "; *msg += timeSeries.getMetricCount(); *msg += " metrics\n";
+    for (int i = 0; i < timeSeries.getMetricCount(); i++) {
+        TimeSeries::Metric *m = timeSeries.getMetric(i);
+        *msg += m->getName(); *msg += " ("; *msg += m->getUnit(); *msg += "): ";
+        *msg += m->getSize(TimeSeries::RAW); *msg += "/"; *msg += m->getSize(TimeSeries::MINUTE);
+        *msg += "/"; *msg += m->getSize(TimeSeries::HOUR); *msg += " entries, ";
+        *msg += m->getMemorySize(); *msg += " bytes, "; *msg += m->getSampleCount(); *msg += " samples";
+        if (m->getSampleCount() > 0) {
+            *msg += ", last "; *msg += m->getLastValue();
+        }
+        *msg += "\n";
+    }
+}
+
+bool SystemService::queryTimeSeries(const String &args, String *msg)
+{
+    String argsCopy(args);
+    StringSplitter<128> splitter(&argsCopy);
+    const char *name = splitter.nextWord();
+    const char *tierStr = splitter.nextWord();
+    const char *countStr = splitter.nextWord();
+    TimeSeries::Metric *m = timeSeries.find(name);
+    if (m == nullptr) {
+        *msg = "Unknown metric \""; *msg += name; *msg += "\", see \"timeSeries metrics\"";
+        return false;
+    }
+    TimeSeries::Tier tier = TimeSeries::RAW;
+    if (*tierStr != '\0' && !TimeSeries::parseTier(tierStr, &tier)) {
+        *msg = "Tier must be raw, 1m or 1h";
+        return false;
+    }
+    // + 1 for the open bucket
+    int count = m->getSize(tier) + 1;
+    if (*countStr != '\0' && atoi(countStr) > 0 && atoi(countStr) < count) {
+        count = atoi(countStr);
+    }
+    std::vector<TimeSeries::Point> points(count);
+    count = TimeSeries::query(m, tier, 0, points.data(), count);
+
+    char buf[80];
+    snprintf(buf, sizeof(buf), "\",\"tier\":\"%s\",\"now\":%lld,\"points\":[",
+        TimeSeries::TIER_NAMES[tier], (long long)(esp_timer_get_time() / 1000));
+    *msg = "{\"metric\":\""; *msg += m->getName(); *msg += "\",\"unit\":\""; *msg += m->getUnit(); *msg += buf;
+    msg->reserve(msg->length() + count * (tier == TimeSeries::RAW ? 20 : 40) + 4);
+    for (int i = 0; i < count; i++) {
+        const TimeSeries::Point &p = points[i];
+        if (tier == TimeSeries::RAW) {
+            snprintf(buf, sizeof(buf), "%s[%lld,%d]", i > 0 ? "," : "", (long long)p.tsMillis, (int)p.avg);
+        } else {
+            snprintf(buf, sizeof(buf), "%s[%lld,%d,%d,%d,%u]", i > 0 ? "," : "", (long long)p.tsMillis,
+                (int)p.min, (int)p.max, (int)p.avg, (unsigned)p.count);
+        }
+        *msg += buf;
+    }
+    *msg += "]}";
+    return true;
+}
+
 void SystemService::getResetReason(String *info)
 {
     esp_reset_reason_t resetReason = esp_reset_reason();
@@ -329,6 +435,26 @@ void SystemService::initI2cCommands(ServiceCommands *cmd)
 
 
 
+    cmd->registerStringData(
+        ServiceCommands::StringDataBuilder("i2cBusStats", true)
+        .cmd("i2cBusStats")
+        .help("i2cBusStats [reset] --> Transactions of the i2c buses, by priority: count, errors, wait in queue, duration")
+        .isPersistent(false)
+        .includeInStatus(false)
+        .setFn([this](const String &val, bool isLoading, String *msg) -> bool {
+            if (val == "reset") {
+                i2cBus[0].resetStats();
+                i2cBus[1].resetStats();
+                *msg = "i2c bus statistics reset";
+            } else {
+                getI2cBusStats(msg);
+            }
+            return true;
+        })
+        .getFn([this](String *val) {
+            getI2cBusStats(val);
+        })
+    );
     cmd->registerBoolData(
         ServiceCommands::BoolDataBuilder("scan0", true)
         .cmdOn("scan0")
@@ -350,6 +476,18 @@ void SystemService::initI2cCommands(ServiceCommands *cmd)
 
 }
 
+void SystemService::getI2cBusStats(String *msg)
+{
+    for (int i = 0; i < 2; i++) {
+        if (i2cBus[i].isStarted()) {
+            i2cBus[i].getStats(msg);
+        }
+    }
+    if (!i2cBus[0].isStarted() && !i2cBus[1].isStarted()) {
+        *msg += "No i2c bus started";
+    }
+}
+
 void SystemService::scan(int port, String *msg)
 {
     *msg = "Scanning i2c port "; *msg += port; *msg += "\n";
@@ -482,6 +620,28 @@ bool SystemService::getIdf(i2c_port_t port)
     return true;
 }
 
+I2cBus *SystemService::getI2cBus(int port)
+{
+    if (port != 0 && port != 1) {
+        logger->error("i2c port must be 0 or 1, but {} was given", port);
+        return nullptr;
+    }
+    return getI2cBus(port == 0 ? I2C_NUM_0 : I2C_NUM_1);
+}
+
+I2cBus *SystemService::getI2cBus(i2c_port_t port)
+{
+    if (!getIdf(port)) {
+        return nullptr;
+    }
+    if (!i2cBus[port].isStarted() && !i2cBus[port].start(port, eventLoop)) {
+        logger->error("Error starting the i2c bus task of port {}", port);
+        releaseIdf(port);
+        return nullptr;
+    }
+    return &i2cBus[port];
+}
+
 void SystemService::releaseIdf(int port)
 {
     if (port != 0 && port != 1) {
@@ -499,6 +659,7 @@ void SystemService::releaseIdf(i2c_port_t port)
     }
     --i2c_useCount[port];
     if (i2c_useCount[port] == 0) {
+        i2cBus[port].stop();
         i2c_driver_delete(port);
         i2c_status[port] = I2cStatus::NOT_USED;
     }
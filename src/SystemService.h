@@ -14,6 +14,8 @@
 #include "Dfa.h"
 #include "Util.h"
 #include "System.h"
+#include "I2cBus.h"
+#include "TimeSeries.h"
 
 class SystemService {
 public:
@@ -43,13 +45,22 @@ private:
     };
     I2cStatus i2c_status[2];
     int i2c_useCount[2];
+    I2cBus i2cBus[2];
 
     void initI2cCommands(ServiceCommands *cmd);
     void scan(int port, String *msg);
+    void getI2cBusStats(String *msg);
 #endif
 
     std::vector<SysPinData*> sysPins;
 
+    TimeSeries timeSeries;
+    int timeSeriesMaxMemory;
+
+    void initTimeSeriesCommands(ServiceCommands *cmd);
+    void getTimeSeriesMetrics(String *msg);
+    bool queryTimeSeries(const String &args, String *msg);
+
 public:
     void getInfo(String *info);
     void getResetReason(String *info);
@@ -69,10 +80,16 @@ public:
     bool getIdf(int port);
     void releaseIdf(i2c_port_t port);
     void releaseIdf(int port);
+    /** like getIdf(), with the transaction scheduler of the port, started on first use; null on error */
+    I2cBus *getI2cBus(i2c_port_t port);
+    I2cBus *getI2cBus(int port);
 #endif
 
     SysPin registerSysPin(const char *service, const char *name);
 
+    /** history of the sensor readings, metrics are added by the services in their init */
+    TimeSeries *getTimeSeries() { return &timeSeries; }
+
 };
 
 #endif
@@ -0,0 +1,180 @@
+#include "Varint.h"
+#include "TelemetryCodec.h"
+
+static uint16_t packTag(const char *tag)
+{
+    return (uint8_t)tag[0] | (tag[0] == '\0' ? 0 : (uint8_t)tag[1] << 8);
+}
+
+static int findTag(const std::vector<uint16_t> &dict, uint16_t tag)
+{
+    for (size_t i = 0; i < dict.size(); i++) {
+        if (dict[i] == tag) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+TelemetryEncoder::TelemetryEncoder(std::vector<uint8_t> &out)
+    : out(out)
+{
+    lastTs = 0;
+    isStarted = false;
+    fieldsLeft = 0;
+}
+
+void TelemetryEncoder::beginRecord(const char *type, uint32_t ts, int fieldCount)
+{
+    if (!isStarted) {
+        Varint::add(out, VERSION);
+        Varint::add(out, ts);
+        lastTs = ts;
+        isStarted = true;
+    }
+    uint16_t tag = packTag(type);
+    int i = findTag(types, tag);
+    if (i >= 0) {
+        Varint::add(out, i + 1);
+    } else {
+        Varint::add(out, 0);
+        out.push_back(tag & 0xFF);
+        out.push_back(tag >> 8);
+        types.push_back(tag);
+    }
+    Varint::addSigned(out, (int32_t)(ts - lastTs));
+    lastTs = ts;
+    Varint::add(out, fieldCount);
+    fieldsLeft = fieldCount;
+}
+
+int TelemetryEncoder::keyRef(const char *key, bool isString)
+{
+    uint16_t tag = packTag(key);
+    int i = findTag(keys, tag);
+    if (i >= 0) {
+        Varint::add(out, ((i + 1) << 1) | isString);
+        return i;
+    }
+    Varint::add(out, isString);
+    out.push_back(tag & 0xFF);
+    out.push_back(tag >> 8);
+    keys.push_back(tag);
+    lastValues.push_back(0);
+    return keys.size() - 1;
+}
+
+void TelemetryEncoder::addInt(const char *key, int32_t value)
+{
+    int i = keyRef(key, false);
+    Varint::addSigned(out, (int32_t)((uint32_t)value - (uint32_t)lastValues[i]));
+    lastValues[i] = value;
+    --fieldsLeft;
+}
+
+void TelemetryEncoder::addString(const char *key, const char *value, size_t len)
+{
+    keyRef(key, true);
+    Varint::add(out, len);
+    out.insert(out.end(), (const uint8_t *)value, (const uint8_t *)value + len);
+    --fieldsLeft;
+}
+
+TelemetryDecoder::TelemetryDecoder(const uint8_t *data, size_t size)
+{
+    ptr = data;
+    end = data + size;
+    lastTs = 0;
+    fieldsLeft = 0;
+    uint32_t version;
+    isError = !Varint::decode(ptr, end, &version) || version != TelemetryEncoder::VERSION
+        || !Varint::decode(ptr, end, &lastTs);
+}
+
+bool TelemetryDecoder::readTag(uint32_t ref, std::vector<uint16_t> &dict, char tag[3])
+{
+    uint16_t t;
+    if (ref == 0) {
+        if (end - ptr < 2) {
+            return false;
+        }
+        t = ptr[0] | (ptr[1] << 8);
+        ptr += 2;
+        dict.push_back(t);
+    } else if (ref <= dict.size()) {
+        t = dict[ref - 1];
+    } else {
+        return false;
+    }
+    tag[0] = t & 0xFF;
+    tag[1] = t >> 8;
+    tag[2] = '\0';
+    return true;
+}
+
+bool TelemetryDecoder::nextRecord(char type[3], uint32_t *ts, int *fieldCount)
+{
+    if (isError || fieldsLeft != 0 || ptr == end) {
+        return false;
+    }
+    uint32_t ref;
+    int32_t delta;
+    uint32_t count;
+    if (!Varint::decode(ptr, end, &ref) || !readTag(ref, types, type)
+            || !Varint::decodeSigned(ptr, end, &delta) || !Varint::decode(ptr, end, &count)
+            || count > 255) {
+        isError = true;
+        return false;
+    }
+    lastTs += delta;
+    *ts = lastTs;
+    *fieldCount = count;
+    fieldsLeft = count;
+    return true;
+}
+
+bool TelemetryDecoder::nextField(char key[3], bool *isInt, int32_t *intValue, const char **str, size_t *len)
+{
+    if (isError || fieldsLeft == 0) {
+        return false;
+    }
+    uint32_t tag;
+    if (!Varint::decode(ptr, end, &tag)) {
+        isError = true;
+        return false;
+    }
+    uint32_t ref = tag >> 1;
+    if (!readTag(ref, keys, key)) {
+        isError = true;
+        return false;
+    }
+    if (ref == 0) {
+        lastValues.push_back(0);
+        ref = keys.size();
+    }
+    if ((tag & 1) == 0) {
+        int32_t delta;
+        if (!Varint::decodeSigned(ptr, end, &delta)) {
+            isError = true;
+            return false;
+        }
+        lastValues[ref - 1] = (int32_t)((uint32_t)lastValues[ref - 1] + (uint32_t)delta);
+        *isInt = true;
+        *intValue = lastValues[ref - 1];
+        *str = nullptr;
+        *len = 0;
+    } else {
+        uint32_t l;
+        if (!Varint::decode(ptr, end, &l) || l > (uint32_t)(end - ptr)) {
+            isError = true;
+            return false;
+        }
+        *isInt = false;
+        *intValue = 0;
+        *str = (const char *)ptr;
+        *len = l;
+        ptr += l;
+    }
+    --fieldsLeft;
+    return true;
+}
@@ -0,0 +1,77 @@
+#ifndef INCL_TELEMETRY_CODEC_H
+#define INCL_TELEMETRY_CODEC_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <vector>
+
+/**
+ * Compact encoding of telemetry records for upload, and its decoder. Only depends on the
+ * standard library, so that the same code builds on the server side.
+ *
+ * The encoded data, all varints (see Varint.h) except tags and strings:
+ *
+ *     version            1
+ *     baseTs             timestamp the first delta applies to
+ *     record*
+ *
+ *     record:            typeRef [type]  tsDelta  fieldCount  field*
+ *     field:             keyRef << 1 | isString  [key]  value
+ *
+ * typeRef and keyRef index dictionaries built along the data: 0 means that a new 2 char
+ * tag follows, and it gets the next index (1, 2...); other values refer to a tag seen
+ * before. tsDelta is the signed difference with the timestamp of the previous record.
+ * An int value is the signed difference with the previous int of the same key (0 at
+ * first); a string is its length then its bytes.
+ *
+ * When uploaded as text, the data is base64 encoded and prefixed with
+ * TELEMETRY_CODEC_TEXT_PREFIX.
+ */
+#define TELEMETRY_CODEC_TEXT_PREFIX "~1"
+
+class TelemetryEncoder {
+    std::vector<uint8_t> &out;
+    std::vector<uint16_t> types;
+    std::vector<uint16_t> keys;
+    std::vector<int32_t> lastValues; // per key
+    uint32_t lastTs;
+    bool isStarted;
+    int fieldsLeft;
+
+    int keyRef(const char *key, bool isString);
+public:
+    static const int VERSION = 1;
+
+    // appends to out
+    TelemetryEncoder(std::vector<uint8_t> &out);
+    void beginRecord(const char *type, uint32_t ts, int fieldCount);
+    void addInt(const char *key, int32_t value);
+    void addString(const char *key, const char *value, size_t len);
+    // dictionary sizes so far
+    size_t getTypeCount() { return types.size(); }
+    size_t getKeyCount() { return keys.size(); }
+};
+
+class TelemetryDecoder {
+    const uint8_t *ptr;
+    const uint8_t *end;
+    std::vector<uint16_t> types;
+    std::vector<uint16_t> keys;
+    std::vector<int32_t> lastValues;
+    uint32_t lastTs;
+    int fieldsLeft;
+    bool isError;
+
+    bool readTag(uint32_t ref, std::vector<uint16_t> &dict, char tag[3]);
+public:
+    TelemetryDecoder(const uint8_t *data, size_t size);
+    // false when the data is not valid
+    bool isValid() { return !isError; }
+    bool isAtEnd() { return !isError && fieldsLeft == 0 && ptr == end; }
+    // the fields of the previous record must have been read
+    bool nextRecord(char type[3], uint32_t *ts, int *fieldCount);
+    // str is not nul terminated, it points into the data
+    bool nextField(char key[3], bool *isInt, int32_t *intValue, const char **str, size_t *len);
+};
+
+#endif
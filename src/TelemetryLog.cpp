@@ -0,0 +1,494 @@
+#include <Arduino.h>
+#include <FS.h>
+#include "UEvent.h"
+#include "TelemetryLog.h"
+
+TelemetryLog::TelemetryLog()
+{
+    eventLoop = nullptr;
+    logger = nullptr;
+    fs = nullptr;
+    maxRecords = 16;
+    maxDelaySecs = 60;
+    sizeLimit = 0;
+    pendingCount = 0;
+    committedSize = 0;
+    committedCount = 0;
+    firstSeq = 0;
+    maxTs = 0;
+    resetStats();
+}
+
+TelemetryLog::~TelemetryLog()
+{
+    commit();
+}
+
+void TelemetryLog::init(UEventLoop *eventLoop, Logger *logger, FS *fs, const char *fileName)
+{
+    this->eventLoop = eventLoop;
+    this->logger = logger;
+    this->fs = fs;
+    this->fileName = fileName;
+
+    eventLoop->registerTimer(&commitTimer);
+    commitTimer.setCallback([this](UEventLoopTimer *timer) {
+        commit();
+    });
+
+    if (fs != nullptr) {
+        scan();
+    }
+}
+
+void TelemetryLog::setCommitPolicy(int maxRecords, int maxDelaySecs)
+{
+    this->maxRecords = maxRecords < 1 ? 1 : maxRecords;
+    this->maxDelaySecs = maxDelaySecs;
+}
+
+bool TelemetryLog::readHeader(File &f, size_t offset, RecordHeader *h)
+{
+    if (!f.seek(offset)) {
+        return false;
+    }
+    if (f.read((uint8_t *)h, sizeof(*h)) != sizeof(*h)) {
+        return false;
+    }
+    return h->magic == RECORD_MAGIC && h->fieldCount <= MAX_FIELDS;
+}
+
+void TelemetryLog::indexRecord(size_t offset, uint32_t ts)
+{
+    if (committedCount % INDEX_STRIDE == 0) {
+        index.push_back({ (uint32_t)offset, maxTs });
+    }
+    ++committedCount;
+    if (ts > maxTs) {
+        maxTs = ts;
+    }
+}
+
+/**
+ * Rebuilds the index from the record headers. A torn or corrupt tail is cut off.
+ */
+bool TelemetryLog::scan()
+{
+    committedSize = 0;
+    committedCount = 0;
+    maxTs = 0;
+    index.clear();
+
+    File f = fs->open(fileName.c_str(), "r");
+    if (!f) {
+        return true; // no log yet
+    }
+    size_t size = f.size();
+    size_t offset = 0;
+    RecordHeader h;
+    while (offset < size) {
+        if (!readHeader(f, offset, &h) || offset + sizeof(h) + h.payloadSize > size) {
+            break;
+        }
+        indexRecord(offset, h.ts);
+        offset += sizeof(h) + h.payloadSize;
+    }
+    f.close();
+    committedSize = offset;
+
+    if (offset < size) {
+        logger->warn("Telemetry log {}: dropping {} bytes of invalid data at {}",
+            fileName.c_str(), (unsigned)(size - offset), (unsigned)offset);
+        return rewrite(0, offset);
+    }
+    return true;
+}
+
+/**
+ * Replaces the file with its bytes [from, to), through a temporary file.
+ */
+bool TelemetryLog::rewrite(size_t from, size_t to)
+{
+    String tmpName = fileName + ".tmp";
+    File src = fs->open(fileName.c_str(), "r");
+    File dst = fs->open(tmpName.c_str(), "w");
+    if (!src || !dst) {
+        return false;
+    }
+    size_t left = to - from;
+    uint8_t buf[128];
+    if (src.seek(from)) {
+        while (left > 0) {
+            size_t n = src.read(buf, left < sizeof(buf) ? left : sizeof(buf));
+            if (n == 0 || dst.write(buf, n) != n) {
+                break;
+            }
+            left -= n;
+        }
+    }
+    src.close();
+    dst.close();
+    if (left != 0) {
+        fs->remove(tmpName.c_str());
+        return false;
+    }
+    if (!fs->rename(tmpName.c_str(), fileName.c_str())) {
+        fs->remove(fileName.c_str());
+        return fs->rename(tmpName.c_str(), fileName.c_str());
+    }
+    return true;
+}
+
+void TelemetryLog::append(const char *type, uint32_t ts, const char * const *keys, const char * const *values, bool isImmediate)
+{
+    RecordHeader h;
+    h.magic = RECORD_MAGIC;
+    h.type[0] = type[0];
+    h.type[1] = type[0] == '\0' ? '\0' : type[1];
+    h.ts = ts;
+
+    size_t start = pending.size();
+    pending.resize(start + sizeof(h));
+    int n;
+    for (n = 0; n < MAX_FIELDS && keys[n] != nullptr; n++) {
+        const char *v = values[n] == nullptr ? "" : values[n];
+        pending.push_back(keys[n][0]);
+        pending.push_back(keys[n][0] == '\0' ? '\0' : keys[n][1]);
+
+        // stored as an int only if it reads back the same
+        char *end;
+        long l = strtol(v, &end, 10);
+        char buf[12];
+        bool isInt = *v != '\0' && *end == '\0'
+            && snprintf(buf, sizeof(buf), "%ld", l) < (int)sizeof(buf) && strcmp(buf, v) == 0;
+        if (isInt) {
+            int32_t i = l;
+            pending.push_back(FIELD_INT);
+            pending.insert(pending.end(), (uint8_t *)&i, (uint8_t *)&i + sizeof(i));
+        } else {
+            size_t payloadSize = pending.size() - start - sizeof(h);
+            size_t maxLen = 0xFFFF - payloadSize - 3;
+            size_t len = strlen(v);
+            uint16_t len16 = len < maxLen ? len : maxLen;
+            pending.push_back(FIELD_STR);
+            pending.insert(pending.end(), (uint8_t *)&len16, (uint8_t *)&len16 + sizeof(len16));
+            pending.insert(pending.end(), (const uint8_t *)v, (const uint8_t *)v + len16);
+        }
+    }
+    h.fieldCount = n;
+    h.payloadSize = pending.size() - start - sizeof(h);
+    memcpy(&pending[start], &h, sizeof(h));
+
+    ++pendingCount;
+    ++statAppends;
+    if (isImmediate || pendingCount >= maxRecords) {
+        if (isImmediate) {
+            ++statImmediateCommits;
+        }
+        commit();
+    } else if (pendingCount == 1) {
+        commitTimer.setTimeout(maxDelaySecs * 1000L);
+    }
+}
+
+bool TelemetryLog::commit()
+{
+    commitTimer.cancelTimeout();
+    if (pending.empty()) {
+        return true;
+    }
+    if (fs == nullptr) {
+        pending.clear();
+        pendingCount = 0;
+        return false;
+    }
+
+    DropInfo dropInfo = { 0, 0, 0, 0 };
+    makeRoom(pending.size(), &dropInfo);
+
+    size_t written = 0;
+    File f = fs->open(fileName.c_str(), "a");
+    if (f) {
+        written = f.write(pending.data(), pending.size());
+        f.close();
+    }
+
+    bool rc = written == pending.size();
+    if (rc) {
+        size_t offset = 0;
+        while (offset < pending.size()) {
+            RecordHeader h;
+            memcpy(&h, &pending[offset], sizeof(h));
+            indexRecord(committedSize + offset, h.ts);
+            offset += sizeof(h) + h.payloadSize;
+        }
+        committedSize += pending.size();
+        ++statCommits;
+        avgRecordsPerCommit = (avgRecordsPerCommit == 0 ? (pendingCount << 4)
+            : (avgRecordsPerCommit * 63 + (pendingCount << 4)) / 64);
+    } else {
+        // what made it to the file is kept if complete, the rest is lost
+        ++statCommitErrors;
+        logger->error("Telemetry log {}: commit of {} records failed", fileName.c_str(), pendingCount);
+        scan();
+    }
+    pending.clear();
+    pendingCount = 0;
+
+    if (dropInfo.records > 0 && onDropCallback != nullptr) {
+        onDropCallback(dropInfo);
+    }
+    return rc;
+}
+
+/**
+ * Drops the oldest records if extra bytes don't fit within sizeLimit. Drops down to 3/4 of
+ * sizeLimit, so that the next commits don't need to rewrite the file.
+ */
+bool TelemetryLog::makeRoom(size_t extra, DropInfo *info)
+{
+    if (sizeLimit == 0 || committedSize + extra <= sizeLimit) {
+        return true;
+    }
+    size_t target = sizeLimit * 3 / 4;
+    size_t toDrop = (committedSize + extra > target ? committedSize + extra - target : 0);
+
+    size_t offset = 0;
+    if (toDrop >= committedSize) {
+        offset = committedSize;
+    } else {
+        File f = fs->open(fileName.c_str(), "r");
+        if (!f) {
+            return false;
+        }
+        RecordHeader h;
+        while (offset < toDrop && readHeader(f, offset, &h)) {
+            offset += sizeof(h) + h.payloadSize;
+        }
+        f.close();
+    }
+    bool rc = discard(offset, info);
+    statDroppedRecords += info->records;
+    return rc;
+}
+
+bool TelemetryLog::discard(size_t offset, DropInfo *info)
+{
+    if (offset > committedSize) {
+        offset = committedSize;
+    }
+    DropInfo dropped = { 0, (uint32_t)offset, 0, 0 };
+    if (offset > 0) {
+        File f = fs->open(fileName.c_str(), "r");
+        if (!f) {
+            return false;
+        }
+        size_t pos = 0;
+        RecordHeader h;
+        while (pos < offset && readHeader(f, pos, &h)) {
+            if (dropped.records == 0) {
+                dropped.firstTs = h.ts;
+            }
+            dropped.lastTs = h.ts;
+            ++dropped.records;
+            pos += sizeof(h) + h.payloadSize;
+        }
+        f.close();
+    }
+    if (info != nullptr) {
+        *info = dropped;
+    }
+    if (offset == 0) {
+        return true;
+    }
+
+    bool rc;
+    if (offset == committedSize) {
+        rc = fs->remove(fileName.c_str());
+    } else {
+        rc = rewrite(offset, committedSize);
+    }
+    // the records kept keep their numbers
+    uint32_t count = committedCount;
+    scan();
+    firstSeq += count - committedCount;
+    return rc;
+}
+
+/**
+ * Offset of the n-th committed record, from the index entry before it.
+ */
+size_t TelemetryLog::offsetOfRecord(uint32_t n)
+{
+    if (n >= committedCount) {
+        return committedSize;
+    }
+    size_t offset = index[n / INDEX_STRIDE].offset;
+    uint32_t left = n % INDEX_STRIDE;
+    if (left == 0) {
+        return offset;
+    }
+    File f = fs->open(fileName.c_str(), "r");
+    if (!f) {
+        return 0;
+    }
+    RecordHeader h;
+    while (left > 0 && readHeader(f, offset, &h)) {
+        offset += sizeof(h) + h.payloadSize;
+        --left;
+    }
+    f.close();
+    return left == 0 ? offset : 0;
+}
+
+bool TelemetryLog::discardBefore(uint32_t seq, DropInfo *info)
+{
+    // records before firstSeq are already gone
+    uint32_t n = (int32_t)(seq - firstSeq) > 0 ? seq - firstSeq : 0;
+    return discard(offsetOfRecord(n), info);
+}
+
+size_t TelemetryLog::seekToTime(uint32_t ts)
+{
+    if (index.empty()) {
+        return committedSize;
+    }
+    // last index entry before which all timestamps are < ts; index[0] has none before it
+    int lo = 0, hi = index.size() - 1;
+    while (lo < hi) {
+        int mid = (lo + hi + 1) / 2;
+        if (index[mid].maxTsBefore < ts) {
+            lo = mid;
+        } else {
+            hi = mid - 1;
+        }
+    }
+
+    File f = fs->open(fileName.c_str(), "r");
+    if (!f) {
+        return committedSize;
+    }
+    size_t offset = index[lo].offset;
+    RecordHeader h;
+    while (offset < committedSize && readHeader(f, offset, &h) && h.ts < ts) {
+        offset += sizeof(h) + h.payloadSize;
+    }
+    f.close();
+    return offset < committedSize ? offset : committedSize;
+}
+
+bool TelemetryLog::decode(const uint8_t *payload, const RecordHeader &h, char *strBuf, Record *rec)
+{
+    rec->type[0] = h.type[0];
+    rec->type[1] = h.type[1];
+    rec->type[2] = '\0';
+    rec->ts = h.ts;
+    rec->fieldCount = h.fieldCount;
+
+    size_t p = 0;
+    for (int i = 0; i < h.fieldCount; i++) {
+        Field &field = rec->fields[i];
+        if (p + 3 > h.payloadSize) {
+            return false;
+        }
+        field.key[0] = payload[p];
+        field.key[1] = payload[p + 1];
+        field.key[2] = '\0';
+        uint8_t kind = payload[p + 2];
+        p += 3;
+        if (kind == FIELD_INT) {
+            if (p + sizeof(int32_t) > h.payloadSize) {
+                return false;
+            }
+            memcpy(&field.intValue, payload + p, sizeof(int32_t));
+            p += sizeof(int32_t);
+            field.isInt = true;
+            field.strValue = strBuf;
+            strBuf += sprintf(strBuf, "%d", field.intValue) + 1;
+        } else if (kind == FIELD_STR) {
+            uint16_t len;
+            if (p + sizeof(len) > h.payloadSize) {
+                return false;
+            }
+            memcpy(&len, payload + p, sizeof(len));
+            p += sizeof(len);
+            if (p + len > h.payloadSize) {
+                return false;
+            }
+            field.isInt = false;
+            field.intValue = 0;
+            field.strValue = strBuf;
+            memcpy(strBuf, payload + p, len);
+            strBuf[len] = '\0';
+            strBuf += len + 1;
+            p += len;
+        } else {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool TelemetryLog::forEach(size_t fromOffset, size_t toOffset, std::function<bool(const Record &rec, size_t offset)> fn)
+{
+    if (toOffset > committedSize) {
+        toOffset = committedSize;
+    }
+    if (fromOffset >= toOffset) {
+        return true;
+    }
+    File f = fs->open(fileName.c_str(), "r");
+    if (!f) {
+        return false;
+    }
+    // an int takes 4 bytes in the payload and up to 12 as a string, other fields take more in the payload
+    std::vector<uint8_t> payload;
+    std::vector<char> strBuf;
+    Record rec;
+    RecordHeader h;
+    size_t offset = fromOffset;
+    bool rc = true;
+    while (offset < toOffset) {
+        if (!readHeader(f, offset, &h)) {
+            rc = false;
+            break;
+        }
+        payload.resize(h.payloadSize);
+        strBuf.resize(h.payloadSize * 3 + 1);
+        if (f.read(payload.data(), h.payloadSize) != h.payloadSize
+                || !decode(payload.data(), h, strBuf.data(), &rec)) {
+            rc = false;
+            break;
+        }
+        if (!fn(rec, offset)) {
+            break;
+        }
+        offset += sizeof(h) + h.payloadSize;
+    }
+    f.close();
+    return rc;
+}
+
+void TelemetryLog::getStats(String *msg)
+{
+    *msg += "Records: "; *msg += committedCount;
+    *msg += " ("; *msg += committedSize; *msg += " bytes)";
+    *msg += ", pending: "; *msg += pendingCount;
+    *msg += " ("; *msg += pending.size(); *msg += " bytes)";
+    *msg += ", appends: "; *msg += statAppends;
+    *msg += ", commits: "; *msg += statCommits;
+    *msg += " ("; *msg += statImmediateCommits; *msg += " immediate)";
+    *msg += ", avg records/commit: "; *msg += (avgRecordsPerCommit >> 4);
+    *msg += ", dropped: "; *msg += statDroppedRecords;
+    *msg += ", errors: "; *msg += statCommitErrors;
+}
+
+void TelemetryLog::resetStats()
+{
+    statAppends = 0;
+    statCommits = 0;
+    statImmediateCommits = 0;
+    statCommitErrors = 0;
+    statDroppedRecords = 0;
+    avgRecordsPerCommit = 0;
+}
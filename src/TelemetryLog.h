@@ -0,0 +1,145 @@
+#ifndef INCL_TELEMETRY_LOG_H
+#define INCL_TELEMETRY_LOG_H
+
+#include <Arduino.h>
+#include <FS.h>
+#include <functional>
+#include <vector>
+#include "UEvent.h"
+#include "LogMgr.h"
+
+/**
+ * Append-only log of telemetry records, in binary form, in a file.
+ *
+ * Each record is a fixed header (magic, 2 char type, field count, timestamp, payload size)
+ * followed by its fields: a 2 char key, a kind, and either an int32 or a string. Values
+ * given as strings are stored as ints when they are the canonical form of one, so that
+ * they are read back unchanged.
+ *
+ * Records are buffered in RAM and committed (one open/write/close of the file) when
+ * maxRecords are pending, maxDelaySecs after the first pending record, or at once when
+ * appended with isImmediate. The file is not rewritten on commit, except when it would
+ * exceed sizeLimit: the oldest records are then dropped, leaving some room so that the
+ * next commits don't drop again.
+ *
+ * An index of the offset of every few records, with the greatest timestamp before them,
+ * is kept in RAM, so that seekToTime() only reads a few records, even though timestamps
+ * may go back (e.g. when the clock is set).
+ *
+ * Committed records are numbered in RAM, from 0 for the first one found at init(). Dropping
+ * records (discardBefore() or the size limit) rewrites the file and moves the offsets of the
+ * records kept, but not their numbers: a reader that must discard what it has read while
+ * records may be dropped meanwhile (e.g. an upload waiting for its confirmation) keeps
+ * getEndSeq() rather than an offset.
+ */
+class TelemetryLog {
+public:
+    static const int MAX_FIELDS = 10;
+    struct Field {
+        char key[3];
+        bool isInt;
+        int32_t intValue;
+        const char *strValue; // valid for ints too
+    };
+    struct Record {
+        char type[3];
+        uint32_t ts;
+        int fieldCount;
+        Field fields[MAX_FIELDS];
+    };
+    struct DropInfo {
+        uint32_t records;
+        uint32_t bytes;
+        uint32_t firstTs;
+        uint32_t lastTs;
+    };
+
+private:
+    struct __attribute__((packed)) RecordHeader {
+        uint8_t magic;
+        char type[2];
+        uint8_t fieldCount;
+        uint32_t ts;
+        uint16_t payloadSize;
+    };
+    enum FieldKind : uint8_t {
+        FIELD_INT = 0,
+        FIELD_STR = 1
+    };
+    static const uint8_t RECORD_MAGIC = 0xA7;
+    static const int INDEX_STRIDE = 8; // records between index entries
+
+    struct IndexEntry {
+        uint32_t offset;
+        uint32_t maxTsBefore; // greatest timestamp of the records before offset
+    };
+
+    UEventLoop *eventLoop;
+    Logger *logger;
+    FS *fs;
+    String fileName;
+    UEventLoopTimer commitTimer;
+    int maxRecords;
+    int maxDelaySecs;
+    size_t sizeLimit;
+    std::function<void(const DropInfo &info)> onDropCallback;
+
+    std::vector<uint8_t> pending;
+    int pendingCount;
+    size_t committedSize;
+    uint32_t committedCount;
+    uint32_t firstSeq; // number of the first committed record
+    uint32_t maxTs; // greatest timestamp of the committed records
+    std::vector<IndexEntry> index;
+
+    // stats
+    uint32_t statAppends;
+    uint32_t statCommits;
+    uint32_t statImmediateCommits;
+    uint32_t statCommitErrors;
+    uint32_t statDroppedRecords;
+    uint32_t avgRecordsPerCommit; // << 4
+
+    bool readHeader(File &f, size_t offset, RecordHeader *h);
+    bool scan();
+    void indexRecord(size_t offset, uint32_t ts);
+    bool decode(const uint8_t *payload, const RecordHeader &h, char *strBuf, Record *rec);
+    bool rewrite(size_t from, size_t to);
+    bool makeRoom(size_t extra, DropInfo *info);
+    size_t offsetOfRecord(uint32_t n);
+    // drops the committed records before offset (a record boundary)
+    bool discard(size_t offset, DropInfo *info);
+
+public:
+    TelemetryLog();
+    ~TelemetryLog();
+    void init(UEventLoop *eventLoop, Logger *logger, FS *fs, const char *fileName);
+    void setCommitPolicy(int maxRecords, int maxDelaySecs);
+    void setSizeLimit(size_t sizeLimit) { this->sizeLimit = sizeLimit; }
+    // called after records were dropped to respect the size limit
+    void onDrop(std::function<void(const DropInfo &info)> callback) { onDropCallback = callback; }
+
+    // keys and values are nullptr terminated lists, at most MAX_FIELDS
+    void append(const char *type, uint32_t ts, const char * const *keys, const char * const *values, bool isImmediate);
+    bool commit();
+
+    // size of the committed records, offsets below are in [0, getCommittedSize()]
+    size_t getCommittedSize() { return committedSize; }
+    // committed and pending
+    size_t getSize() { return committedSize + pending.size(); }
+    uint32_t getRecordCount() { return committedCount + pendingCount; }
+    // offset of the first committed record with a timestamp >= ts, getCommittedSize() if none
+    size_t seekToTime(uint32_t ts);
+    // calls fn for each committed record in [fromOffset, toOffset), until fn returns false;
+    // the record is only valid during the call
+    bool forEach(size_t fromOffset, size_t toOffset, std::function<bool(const Record &rec, size_t offset)> fn);
+    // number of the record that the next commit will write first
+    uint32_t getEndSeq() { return firstSeq + committedCount; }
+    // drops the committed records numbered before seq, those already dropped are skipped
+    bool discardBefore(uint32_t seq, DropInfo *info = nullptr);
+
+    void getStats(String *msg);
+    void resetStats();
+};
+
+#endif
@@ -0,0 +1,226 @@
+#include <string.h>
+#include "TimeSeries.h"
+
+const int64_t TimeSeries::PERIOD_MILLIS[TIER_COUNT] = { 0, 60 * 1000, 3600 * 1000 };
+const char *TimeSeries::TIER_NAMES[TIER_COUNT] = { "raw", "1m", "1h" };
+
+TimeSeries::Metric::Metric(const char *name, const char *unit, int rawSize, int minuteSize, int hourSize)
+{
+    strncpy(this->name, name, sizeof(this->name) - 1);
+    this->name[sizeof(this->name) - 1] = '\0';
+    this->unit = unit;
+    mux = portMUX_INITIALIZER_UNLOCKED;
+    raw = (rawSize > 0 ? new RawEntry[rawSize] : nullptr);
+    this->rawSize = rawSize;
+    rawHead = 0;
+    rawUsed = 0;
+    int sizes[TIER_COUNT - 1] = { minuteSize, hourSize };
+    for (int i = 0; i < TIER_COUNT - 1; i++) {
+        Aggregate *a = &aggregates[i];
+        a->ring = (sizes[i] > 0 ? new Bucket[sizes[i]] : nullptr);
+        a->size = sizes[i];
+        a->head = 0;
+        a->used = 0;
+        a->endMillis = 0;
+        a->count = 0;
+    }
+    lastTsMillis = 0;
+    lastValue = 0;
+    sampleCount = 0;
+}
+
+TimeSeries::Metric::~Metric()
+{
+    delete[] raw;
+    for (int i = 0; i < TIER_COUNT - 1; i++) {
+        delete[] aggregates[i].ring;
+    }
+}
+
+size_t TimeSeries::Metric::getMemorySize()
+{
+    return sizeof(Metric) + rawSize * sizeof(RawEntry)
+        + (aggregates[0].size + aggregates[1].size) * sizeof(Bucket);
+}
+
+void TimeSeries::Metric::closeBucket(Aggregate *a)
+{
+    Bucket *b = &a->ring[a->head];
+    b->period = a->period;
+    b->min = a->min;
+    b->max = a->max;
+    b->avg = a->sum / (int64_t)a->count;
+    b->count = a->count;
+    a->head = (a->head + 1) % a->size;
+    if (a->used < a->size) {
+        ++a->used;
+    }
+    a->count = 0;
+}
+
+void TimeSeries::Metric::add(int64_t tsMillis, int32_t value)
+{
+    portENTER_CRITICAL(&mux);
+    if (tsMillis < lastTsMillis) {
+        tsMillis = lastTsMillis;
+    }
+    lastTsMillis = tsMillis;
+    lastValue = value;
+    ++sampleCount;
+    if (rawSize > 0) {
+        raw[rawHead].tsMillis = (uint32_t)tsMillis;
+        raw[rawHead].value = value;
+        rawHead = (rawHead + 1) % rawSize;
+        if (rawUsed < rawSize) {
+            ++rawUsed;
+        }
+    }
+    for (int i = 0; i < TIER_COUNT - 1; i++) {
+        Aggregate *a = &aggregates[i];
+        if (a->size == 0) {
+            continue;
+        }
+        if (a->count > 0 && tsMillis >= a->endMillis) {
+            closeBucket(a);
+        }
+        if (a->count == 0) {
+            // the only divisions, once per period
+            int64_t periodMillis = PERIOD_MILLIS[i + 1];
+            a->period = tsMillis / periodMillis;
+            a->endMillis = (a->period + 1) * periodMillis;
+            a->min = value;
+            a->max = value;
+            a->sum = value;
+            a->count = 1;
+        } else {
+            if (value < a->min) {
+                a->min = value;
+            }
+            if (value > a->max) {
+                a->max = value;
+            }
+            a->sum += value;
+            ++a->count;
+        }
+    }
+    portEXIT_CRITICAL(&mux);
+}
+
+int TimeSeries::Metric::query(Tier tier, int64_t sinceMillis, Point *points, int maxCount)
+{
+    if (maxCount <= 0) {
+        return 0;
+    }
+    int n = 0;
+    portENTER_CRITICAL(&mux);
+    if (tier == RAW) {
+        // the full time of an entry is found from the difference of its low bits with the last sample
+        uint32_t lastLow = (uint32_t)lastTsMillis;
+        int count = (rawUsed < maxCount ? rawUsed : maxCount);
+        int start = rawHead - count;
+        if (start < 0) {
+            start += rawSize;
+        }
+        for (int i = 0; i < count; i++) {
+            const RawEntry &e = raw[(start + i) % rawSize];
+            int64_t ts = lastTsMillis - (uint32_t)(lastLow - e.tsMillis);
+            if (ts < sinceMillis) {
+                continue;
+            }
+            Point &p = points[n++];
+            p.tsMillis = ts;
+            p.min = e.value;
+            p.max = e.value;
+            p.avg = e.value;
+            p.count = 1;
+        }
+    } else {
+        Aggregate *a = &aggregates[tier - 1];
+        int64_t periodMillis = PERIOD_MILLIS[tier];
+        int isOpen = (a->count > 0 ? 1 : 0);
+        int count = a->used + isOpen;
+        if (count > maxCount) {
+            count = maxCount;
+        }
+        int closedCount = count - isOpen;
+        int start = a->head - closedCount;
+        if (start < 0) {
+            start += a->size;
+        }
+        for (int i = 0; i < closedCount; i++) {
+            const Bucket &b = a->ring[(start + i) % a->size];
+            int64_t ts = (int64_t)b.period * periodMillis;
+            // a bucket is included if it ends after sinceMillis
+            if (ts + periodMillis <= sinceMillis) {
+                continue;
+            }
+            Point &p = points[n++];
+            p.tsMillis = ts;
+            p.min = b.min;
+            p.max = b.max;
+            p.avg = b.avg;
+            p.count = b.count;
+        }
+        if (isOpen && a->endMillis > sinceMillis) {
+            Point &p = points[n++];
+            p.tsMillis = (int64_t)a->period * periodMillis;
+            p.min = a->min;
+            p.max = a->max;
+            p.avg = a->sum / (int64_t)a->count;
+            p.count = a->count;
+        }
+    }
+    portEXIT_CRITICAL(&mux);
+    return n;
+}
+
+TimeSeries::TimeSeries()
+{
+    maxMemory = 0;
+    usedMemory = 0;
+}
+
+TimeSeries::~TimeSeries()
+{
+    for (Metric *m : metrics) {
+        delete m;
+    }
+}
+
+TimeSeries::Metric *TimeSeries::addMetric(const char *name, const char *unit, int rawSize, int minuteSize, int hourSize)
+{
+    Metric *m = find(name);
+    if (m != nullptr) {
+        return m;
+    }
+    size_t size = sizeof(Metric) + rawSize * sizeof(Metric::RawEntry)
+        + (minuteSize + hourSize) * sizeof(Metric::Bucket);
+    if (rawSize < 0 || minuteSize < 0 || hourSize < 0 || usedMemory + size > maxMemory) {
+        return nullptr;
+    }
+    m = new Metric(name, unit, rawSize, minuteSize, hourSize);
+    metrics.push_back(m);
+    usedMemory += size;
+    return m;
+}
+
+TimeSeries::Metric *TimeSeries::find(const char *name)
+{
+    for (Metric *m : metrics) {
+        if (strncmp(m->name, name, sizeof(m->name) - 1) == 0) {
+            return m;
+        }
+    }
+    return nullptr;
+}
+
+bool TimeSeries::parseTier(const char *str, Tier *tier)
+{
+    for (int i = 0; i < TIER_COUNT; i++) {
+        if (strcmp(str, TIER_NAMES[i]) == 0) {
+            *tier = (Tier)i;
+            return true;
+        }
+    }
+    return false;
+}
@@ -0,0 +1,147 @@
+#ifndef INCL_TIME_SERIES_H
+#define INCL_TIME_SERIES_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <vector>
+#include <freertos/FreeRTOS.h>
+#include <esp_timer.h>
+
+/**
+ * Recent history of sensor readings, in fixed memory.
+ *
+ * Each metric has three tiers, each a ring buffer whose size is given when the metric is
+ * added: the raw samples, and the min/max/avg of the samples of each minute and of each
+ * hour. All the memory of a metric is allocated when it is added, within the max memory
+ * of the store; adding a sample allocates nothing, and only updates the open minute and
+ * hour buckets, which are pushed to their ring when a sample falls in the next period.
+ * Periods without samples have no bucket.
+ *
+ * Times are millis since boot. The raw tier keeps the low 32 bits of the time, so it
+ * should not span more than 49 days.
+ *
+ * Metrics are added, and queried, from the event loop task; samples can be added from any
+ * task, but not from an ISR. A sample older than the previous one of its metric is taken
+ * as at the time of the previous one.
+ */
+class TimeSeries {
+public:
+    enum Tier {
+        RAW,
+        MINUTE,
+        HOUR,
+        TIER_COUNT
+    };
+
+    struct Point {
+        int64_t tsMillis; // of the sample, or start of the period
+        int32_t min;
+        int32_t max;
+        int32_t avg; // for a raw sample, min, max and avg are its value
+        uint32_t count; // of samples
+    };
+
+    class Metric {
+        friend class TimeSeries;
+        struct RawEntry {
+            uint32_t tsMillis;
+            int32_t value;
+        };
+        struct Bucket {
+            uint32_t period; // start of the period, in periods since boot
+            int32_t min;
+            int32_t max;
+            int32_t avg;
+            uint32_t count;
+        };
+        struct Aggregate {
+            Bucket *ring;
+            int size;
+            int head; // next entry to write
+            int used;
+            // the open bucket
+            int64_t endMillis;
+            uint32_t period;
+            int32_t min;
+            int32_t max;
+            int64_t sum;
+            uint32_t count;
+        };
+
+        char name[32];
+        const char *unit;
+        portMUX_TYPE mux;
+        RawEntry *raw;
+        int rawSize;
+        int rawHead;
+        int rawUsed;
+        Aggregate aggregates[TIER_COUNT - 1]; // MINUTE, HOUR
+        int64_t lastTsMillis;
+        int32_t lastValue;
+        uint32_t sampleCount;
+
+        Metric(const char *name, const char *unit, int rawSize, int minuteSize, int hourSize);
+        ~Metric();
+        void closeBucket(Aggregate *a);
+        void add(int64_t tsMillis, int32_t value);
+        int query(Tier tier, int64_t sinceMillis, Point *points, int maxCount);
+    public:
+        const char *getName() { return name; }
+        const char *getUnit() { return unit; }
+        int getSize(Tier tier) { return tier == RAW ? rawSize : aggregates[tier - 1].size; }
+        size_t getMemorySize();
+        uint32_t getSampleCount() { return sampleCount; }
+        int32_t getLastValue() { return lastValue; }
+        int64_t getLastTsMillis() { return lastTsMillis; }
+    };
+
+private:
+    std::vector<Metric *> metrics;
+    size_t maxMemory;
+    size_t usedMemory;
+
+public:
+    static const int64_t PERIOD_MILLIS[TIER_COUNT];
+    static const char *TIER_NAMES[TIER_COUNT];
+
+    TimeSeries();
+    ~TimeSeries();
+    // limits the memory of the metrics added after, 0 for no metrics at all
+    void setMaxMemory(size_t bytes) { maxMemory = bytes; }
+    size_t getMaxMemory() { return maxMemory; }
+    size_t getUsedMemory() { return usedMemory; }
+
+    /**
+     * Sizes are in entries of each tier, unit must be a literal. Returns the metric of
+     * that name if it was already added, null if it doesn't fit in the max memory.
+     */
+    Metric *addMetric(const char *name, const char *unit, int rawSize, int minuteSize, int hourSize);
+    Metric *find(const char *name);
+    int getMetricCount() { return metrics.size(); }
+    Metric *getMetric(int i) { return metrics[i]; }
+
+    // no-op if metric is null, so that a metric that could not be added needs no check
+    static void add(Metric *metric, int32_t value) {
+        if (metric != nullptr) {
+            metric->add(esp_timer_get_time() / 1000, value);
+        }
+    }
+    static void add(Metric *metric, int64_t tsMillis, int32_t value) {
+        if (metric != nullptr) {
+            metric->add(tsMillis, value);
+        }
+    }
+
+    /**
+     * Copies the latest points of the tier since sinceMillis, at most maxCount, oldest
+     * first, and returns their count. For MINUTE and HOUR, the last point is the bucket
+     * still open, if it has samples.
+     */
+    static int query(Metric *metric, Tier tier, int64_t sinceMillis, Point *points, int maxCount) {
+        return metric == nullptr ? 0 : metric->query(tier, sinceMillis, points, maxCount);
+    }
+    // "raw", "1m" or "1h"; returns false if not recognized
+    static bool parseTier(const char *str, Tier *tier);
+};
+
+#endif
@@ -317,7 +317,7 @@ bool UEventLoop::queueEvent(const UEvent &event, std::function<void(UEvent*)> fi
 }
 
 bool UEventLoop::queueEvent(const UEvent &event, std::function<void(UEvent*)> finalizer,
-        std::function<void(UEvent *event, bool isProcessed)> onProcess, SemaphoreHandle_t sem)
+        std::function<void(UEvent *event, bool isProcessed)> onProcess, SemaphoreHandle_t sem, int timeoutMillis)
 {
     if (queue == nullptr) {
         return false;
@@ -334,7 +334,7 @@ bool UEventLoop::queueEvent(const UEvent &event, std::function<void(UEvent*)> fi
     eventEntry.sem = sem;
     eventEntry.onProcess = onProcess;
     eventEntry.finalizer = finalizer;
-    BaseType_t didSent = xQueueSend(queue, &eventEntry, pdMS_TO_TICKS(50));
+    BaseType_t didSent = xQueueSend(queue, &eventEntry, pdMS_TO_TICKS(timeoutMillis));
     if (didSent != pdPASS) {
         if (eventEntry.onProcess != nullptr) {
             eventEntry.onProcess(&eventEntry.event, false);
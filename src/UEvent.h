@@ -181,10 +181,12 @@ public:
     /**
      * Queue an event, to be processed when its turn comes. If semaphore is
      * specified, a "give" will be performed on it after the event is consumed (processed or not).
+     * If the queue stays full for timeoutMillis, the event is consumed at once, not processed.
      */
     bool queueEvent(const UEvent &event, std::function<void(UEvent*)> finalizer, SemaphoreHandle_t = nullptr);
     bool queueEvent(const UEvent &event, std::function<void(UEvent*)> finalizer,
-            std::function<void(UEvent *event, bool isProcessed)> onProcess = nullptr, SemaphoreHandle_t = nullptr);
+            std::function<void(UEvent *event, bool isProcessed)> onProcess = nullptr, SemaphoreHandle_t = nullptr,
+            int timeoutMillis = 50);
 
     void registerTimer(UEventLoopTimer *timer);
     void registerTimer(UEventLoopTimer *timer, std::function<void(UEventLoopTimer *)> callback);
@@ -24,6 +24,51 @@ void Util::runAsThread(const char *taskName, Util::ThreadOptions &opt, std::func
     opt.priority == 0 ? uxTaskPriorityGet(nullptr) : opt.priority, &taskHandle);
 }
 
+void Histogram::clear()
+{
+    for (int i = 0; i < BUCKET_COUNT; i++) {
+        buckets[i] = 0;
+    }
+    count = 0;
+    maxValue = 0;
+    sum = 0;
+}
+
+void Histogram::add(uint32_t micros)
+{
+    int i = 0;
+    for (uint32_t v = micros >> 6; v != 0 && i < BUCKET_COUNT - 1; v >>= 1) {
+        ++i;
+    }
+    ++buckets[i];
+    ++count;
+    sum += micros;
+    if (micros > maxValue) {
+        maxValue = micros;
+    }
+}
+
+void Histogram::print(String *msg, const char *indent)
+{
+    *msg += indent; *msg += "count "; *msg += count; *msg += ", avg "; *msg += getAvg();
+    *msg += " us, max "; *msg += maxValue; *msg += " us\n";
+    for (int i = 0; i < BUCKET_COUNT; i++) {
+        if (buckets[i] == 0) {
+            continue;
+        }
+        *msg += indent;
+        if (i == 0) {
+            *msg += "< 64";
+        } else if (i == BUCKET_COUNT - 1) {
+            *msg += ">= "; *msg += (32UL << i);
+        } else {
+            *msg += (32UL << i); *msg += ".."; *msg += (64UL << i);
+        }
+        *msg += " us: "; *msg += buckets[i];
+        *msg += " ("; *msg += (uint32_t)((uint64_t)buckets[i] * 100 / count); *msg += "%)\n";
+    }
+}
+
 void Util::base64Encode(String *result, char *buf, size_t size)
 {
     static const char* base64Chars = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
@@ -206,8 +251,12 @@ const char *StringRing::get(uint32_t id)
 
 #endif
 
+#define ROTATING_FILE_MAGIC 0x31434652 // "RFC1"
+
 RotatingFile::RotatingFile()
 {
+    sizeLimit = 0;
+    memset(&checkpoint, 0, sizeof(checkpoint));
 }
 
 RotatingFile::~RotatingFile()
@@ -215,6 +264,91 @@ RotatingFile::~RotatingFile()
     pFile.close();
 }
 
+uint32_t RotatingFile::checkValue(const Checkpoint &cp)
+{
+    return (cp.magic ^ (cp.generation * 2654435761u) ^ (cp.writePos * 40503u) ^ cp.prevGenerationEnd) + 0x9E3779B9u;
+}
+
+bool RotatingFile::readCheckpoint(File &f, Checkpoint *cp)
+{
+    if (!f.seek(0) || f.read((uint8_t *)cp, sizeof(*cp)) != sizeof(*cp)) {
+        return false;
+    }
+    return cp->magic == ROTATING_FILE_MAGIC && cp->check == checkValue(*cp)
+        && cp->writePos >= sizeof(Checkpoint) && cp->writePos < f.size();
+}
+
+void RotatingFile::markersOf(uint32_t generation, uint8_t *markerA, uint8_t *markerB)
+{
+    *markerA = (generation & 1) == 0 ? MARKER_EVEN : MARKER_ODD;
+    *markerB = (generation & 1) == 0 ? MARKER_ODD : MARKER_EVEN;
+}
+
+int32_t RotatingFile::findForward(File &f, uint32_t start, uint32_t end, uint8_t marker)
+{
+    uint8_t buf[64];
+    uint32_t pos = start;
+    if (!f.seek(pos)) {
+        return -1;
+    }
+    while (pos < end) {
+        size_t read = f.read(buf, end - pos < sizeof(buf) ? end - pos : sizeof(buf));
+        if (read == 0) {
+            return -1;
+        }
+        for (size_t i = 0; i < read; i++) {
+            if (buf[i] == marker) {
+                return pos + i;
+            }
+        }
+        pos += read;
+    }
+    return -1;
+}
+
+int32_t RotatingFile::findBackward(File &f, uint32_t start, uint32_t end, uint8_t marker)
+{
+    uint8_t buf[64];
+    uint32_t pos = end;
+    while (pos > start) {
+        size_t len = pos - start < sizeof(buf) ? pos - start : sizeof(buf);
+        pos -= len;
+        if (!f.seek(pos) || f.read(buf, len) != len) {
+            return -1;
+        }
+        for (int i = len - 1; i >= 0; i--) {
+            if (buf[i] == marker) {
+                return pos + i;
+            }
+        }
+    }
+    return -1;
+}
+
+void RotatingFile::writeCheckpoint(uint32_t writePos)
+{
+    checkpoint.magic = ROTATING_FILE_MAGIC;
+    checkpoint.writePos = writePos;
+    checkpoint.check = checkValue(checkpoint);
+    pFile.seek(0);
+    pFile.write((uint8_t *)&checkpoint, sizeof(checkpoint));
+    pFile.seek(writePos);
+}
+
+/**
+ * Starts the current generation at the beginning of the file.
+ */
+void RotatingFile::startFile()
+{
+    markersOf(checkpoint.generation, &markerA, &markerB);
+    markerAB[0] = markerA;
+    markerAB[1] = markerB;
+    writeCheckpoint(sizeof(Checkpoint));
+    pFile.write(markerB);
+    pFile.seek(sizeof(Checkpoint));
+    pFile.flush();
+}
+
 void RotatingFile::openForWrite(const char *fileName, FS *fs, size_t sizeLimit)
 {
     if (pFile) {
@@ -232,57 +366,41 @@ void RotatingFile::openForWrite(const char *fileName, FS *fs, size_t sizeLimit)
         Serial.printf("Could not open rotating file %s for r+\n", fileName);
         return;
     }
-    // read until we find the first marker, that will be marker A
-    markerA = -1;
-    markerB = -1;
-    lastMarkerAPos = -1;
-    firstMarkerBPos = -1;
-    char buf[128];
-    size_t pos = 0, basePos = 0, read;
-    while (firstMarkerBPos == -1 && (read = pFile.readBytes(buf, sizeof(buf))) > 0) {
-        for (pos = 0; firstMarkerBPos == -1 && pos < read; pos++) {
-            if (markerA == -1) {
-                if ((uint8_t)buf[pos] == 0x1E || (uint8_t)buf[pos] == 0x1F) {
-                    markerA = buf[pos];
-                    lastMarkerAPos = basePos + pos;
-                    markerB = (markerA == 0x1E ? 0x1F : 0x1E);
-                }
-            }
-            if (markerA != -1 && firstMarkerBPos == -1) {
-                if (buf[pos] == markerA) {
-                    lastMarkerAPos = basePos + pos;
-                } else if (buf[pos] == markerB) {
-                    firstMarkerBPos = basePos + pos;
-                }
-            }
-        }
-        basePos += read;
-    }
-
-    markerAB[0] = markerA;
-    markerAB[1] = markerB;
 
-    // here we know the position of first marker A (or -1 if on EOF),
-    // last marker A if we had the first one, and first marker B (or -1 if on EOF)
-    if (lastMarkerAPos == -1) {
-        markerA = 0x1E;
-        markerB = 0x1F;
+    if (readCheckpoint(pFile, &checkpoint)) {
+        // records written since the checkpoint only contain marker A, the first marker B is where we left off
+        markersOf(checkpoint.generation, &markerA, &markerB);
         markerAB[0] = markerA;
         markerAB[1] = markerB;
-        pFile.seek(0);
-        pFile.write(markerAB, 2);
-        pFile.seek(pFile.position() - 1);
+        int32_t pos = findForward(pFile, checkpoint.writePos, pFile.size(), markerB);
+        if (pos == -1) {
+            pos = pFile.size();
+            pFile.seek(pos);
+            pFile.write(markerB);
+        }
+        if ((uint32_t)pos != checkpoint.writePos) {
+            writeCheckpoint(pos);
+        }
+        pFile.seek(pos);
         pFile.flush();
-    } else {
-        pFile.seek(lastMarkerAPos + 1);
+        return;
     }
 
-    // We start writing after last marker A in all cases.
-
-    // If we want to read instead of write:
-    // We must look from the current position for the first marker B. We read
-    // from there, until we find maker A or EOF. Then we continue from the beginning of the file
-    // until the first marker B.
+    if (pFile.size() > 0) {
+        pFile.close();
+        String oldName = String(fileName) + ".old";
+        fs->remove(oldName.c_str());
+        fs->rename(fileName, oldName.c_str());
+        Serial.printf("Rotating file %s has no checkpoint, moved to %s\n", fileName, oldName.c_str());
+        pFile = fs->open(fileName, "w+");
+        if (!pFile) {
+            Serial.printf("Could not open rotating file %s for w+\n", fileName);
+            return;
+        }
+    }
+    checkpoint.generation = 0;
+    checkpoint.prevGenerationEnd = 0;
+    startFile();
 }
 
 size_t RotatingFile::write(uint8_t v)
@@ -297,16 +415,169 @@ size_t RotatingFile::write(const uint8_t *buffer, size_t size)
 
 void RotatingFile::terminateRecord()
 {
+    if (!pFile) {
+        return;
+    }
     pFile.write(markerAB, 2);
-    pFile.seek(pFile.position() - 1);
+    uint32_t pos = pFile.position() - 1;
+    pFile.seek(pos);
+    if (pos > sizeLimit) {
+        checkpoint.prevGenerationEnd = pos;
+        ++checkpoint.generation;
+        startFile();
+        return;
+    }
+    if (pos - checkpoint.writePos >= CHECKPOINT_BYTES) {
+        writeCheckpoint(pos);
+    }
     pFile.flush();
-    if (pFile.position() > sizeLimit) {
-        char m = markerA; markerA = markerB; markerB = m;
-        markerAB[0] = markerA;
-        markerAB[1] = markerB;
-        pFile.seek(0);
-        pFile.write(markerAB, 2);
-        pFile.seek(pFile.position() - 1);
-        pFile.flush();
+}
+
+RotatingFile::Reader::Reader()
+{
+    segmentCount = 0;
+    seg = 0;
+    pos = 0;
+}
+
+RotatingFile::Reader::~Reader()
+{
+    close();
+}
+
+bool RotatingFile::Reader::open(const char *fileName, FS *fs)
+{
+    close();
+    if (fs == nullptr) {
+        return false;
+    }
+    pFile = fs->open(fileName, "r");
+    if (!pFile) {
+        return false;
+    }
+    Checkpoint cp;
+    if (!readCheckpoint(pFile, &cp)) {
+        close();
+        return false;
+    }
+    uint8_t markerA, markerB;
+    markersOf(cp.generation, &markerA, &markerB);
+    int32_t writePos = findForward(pFile, cp.writePos, pFile.size(), markerB);
+    if (writePos == -1) {
+        writePos = pFile.size();
+    }
+
+    // the previous generation, terminated by its marker A, that is our marker B
+    if (cp.prevGenerationEnd > (uint32_t)writePos + 1) {
+        // skip the record we may have partially overwritten
+        int32_t skipped = findForward(pFile, writePos + 1, cp.prevGenerationEnd, markerB);
+        if (skipped != -1 && (uint32_t)skipped + 1 < cp.prevGenerationEnd) {
+            segments[segmentCount++] = { (uint32_t)skipped + 1, cp.prevGenerationEnd, markerB };
+        }
+    }
+    segments[segmentCount++] = { sizeof(Checkpoint), (uint32_t)writePos, markerA };
+    rewind();
+    return true;
+}
+
+void RotatingFile::Reader::close()
+{
+    if (pFile) {
+        pFile.close();
+    }
+    segmentCount = 0;
+    seg = 0;
+    pos = 0;
+}
+
+void RotatingFile::Reader::rewind()
+{
+    seg = 0;
+    pos = segmentCount == 0 ? 0 : segments[0].start;
+}
+
+void RotatingFile::Reader::seekToEnd()
+{
+    seg = segmentCount == 0 ? 0 : segmentCount - 1;
+    pos = segmentCount == 0 ? 0 : segments[seg].end;
+}
+
+bool RotatingFile::Reader::readRecord(uint32_t start, uint32_t end, String *record)
+{
+    record->clear();
+    record->reserve(end - start);
+    char buf[65];
+    if (!pFile.seek(start)) {
+        return false;
+    }
+    while (start < end) {
+        size_t read = pFile.read((uint8_t *)buf, end - start < sizeof(buf) - 1 ? end - start : sizeof(buf) - 1);
+        if (read == 0) {
+            return false;
+        }
+        buf[read] = '\0';
+        record->concat(buf);
+        start += read;
+    }
+    return true;
+}
+
+bool RotatingFile::Reader::next(String *record)
+{
+    while (seg < segmentCount) {
+        Segment &s = segments[seg];
+        if (pos < s.end) {
+            int32_t t = findForward(pFile, pos, s.end, s.terminator);
+            uint32_t start = pos;
+            uint32_t end = (t == -1 ? s.end : t);
+            pos = (t == -1 ? s.end : t + 1);
+            if (end > start) {
+                return readRecord(start, end, record);
+            }
+            continue; // empty record
+        }
+        if (seg == segmentCount - 1) {
+            return false;
+        }
+        ++seg;
+        pos = segments[seg].start;
+    }
+    return false;
+}
+
+bool RotatingFile::Reader::previous(String *record)
+{
+    while (segmentCount > 0) {
+        Segment &s = segments[seg];
+        if (pos > s.start) {
+            // pos is just after the terminator of the record
+            uint32_t end = pos - 1;
+            int32_t t = findBackward(pFile, s.start, end, s.terminator);
+            uint32_t start = (t == -1 ? s.start : t + 1);
+            pos = start;
+            if (end > start) {
+                return readRecord(start, end, record);
+            }
+            continue; // empty record
+        }
+        if (seg == 0) {
+            return false;
+        }
+        --seg;
+        pos = segments[seg].end;
+    }
+    return false;
+}
+
+void RotatingFile::Reader::seekToTime(time_t ts, std::function<time_t(const String &record)> getTs)
+{
+    seekToEnd();
+    String record;
+    while (previous(&record)) {
+        time_t recordTs = getTs(record);
+        if (recordTs != 0 && recordTs < ts) {
+            next(&record); // back after it
+            return;
+        }
     }
 }
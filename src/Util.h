@@ -18,6 +18,30 @@ public:
     static void base64Encode(String *result, char *buf, size_t size);
 };
 
+/**
+ * Histogram of durations in micros, with power of 2 buckets: bucket 0 counts values
+ * below 64 us, bucket i values in [32 << i, 64 << i), the last bucket everything above.
+ * Counters are not protected, a reader may see a sample that is being added.
+ */
+class Histogram {
+public:
+    static const int BUCKET_COUNT = 16;
+private:
+    uint32_t buckets[BUCKET_COUNT];
+    uint32_t count;
+    uint32_t maxValue;
+    uint64_t sum;
+public:
+    Histogram() { clear(); }
+    void clear();
+    void add(uint32_t micros);
+    uint32_t getCount() { return count; }
+    uint32_t getMax() { return maxValue; }
+    uint32_t getAvg() { return count == 0 ? 0 : sum / count; }
+    // appends a line per non-empty bucket, prefixed by indent
+    void print(String *msg, const char *indent);
+};
+
 #if 0
 template <class T>
 class VectorRing {
@@ -70,44 +94,107 @@ public:
  *
  * There are 2 possible markers: 0x1E and 0x1F. They must not be present in user data.
  *
+ * The file starts with a checkpoint header (see Checkpoint), records follow.
+ *
  * Every time we write a record, we end by writing marker A then marker B, and reposition
  * on top of maker B (so it is overwritten on next write). We may decide to wrap around:
- * we exchange markers A and B, start from beginning, and write marker A, marker B and
- * reposition on top of marker B.
+ * we exchange markers A and B, start from just after the header, write marker B and
+ * reposition on top of it. The generation counts wrap arounds, marker A is 0x1E on even
+ * generations.
  *
- * Note: if we crash after having written a byte (overwriting a marker B) and before
- * having written the last marker A and marker B, we may no longer have a marking for
- * the last written position... and the file wouldn't be consistent. TODO. VERIFY on LittleFS.
  * LittleFS: "Additionally, file updates are not actually committed to the filesystem
- * until sync or close is called on the file." -- So should be OK.
+ * until sync or close is called on the file." -- terminateRecord() flushes, so the file
+ * always ends up with the marker B of the last written record.
+ *
+ * The checkpoint holds the generation, the write position (the position of marker B) and
+ * the end of the data of the previous generation. It is rewritten on wrap around and
+ * every CHECKPOINT_BYTES of records. When we open the file, we must find the position
+ * where we left off: it's the first marker B from the checkpoint position, as all the
+ * records written since are from the same generation and only contain marker A.
  *
- * When we open the file, we must find the position where we left off. For this,
- * first we scan the file from the beginning. The first marker we encounter (out
- * of the two possible markers) is marker A (and the other marker is marker B). We
- * keep reading until we find the first position of marker B (or EOF). Now
- * we know the position we left off is just at the first marker B.
+ * To read the file, we start from the write position, skip one record (it may well be
+ * partially overwritten) and read the records of the previous generation, terminated by
+ * its marker A (our marker B), up to its end. Then we read the records from the beginning
+ * of the file, terminated by marker A, up to the write position.
  *
- * To read the file, we start from the first marker B, skip one recod (it may well
- * be partially overwritten) and start reading from there, until we find the first
- * marker A. At that point we ignore the rest and start from the beginning of
- * the file, reading records limited by marker A, until we find a first marker B.
+ * Files without a valid checkpoint (e.g. from before checkpoints) are renamed to
+ * "<fileName>.old", and a new file is started.
  *
  ******************************/
-class RotatingFile : public Print { // this is for writing only
+class RotatingFile : public Print {
+public:
+    static const uint8_t MARKER_EVEN = 0x1E;
+    static const uint8_t MARKER_ODD = 0x1F;
+    static const uint32_t CHECKPOINT_BYTES = 256;
+
+    struct Checkpoint {
+        uint32_t magic;
+        uint32_t generation;
+        uint32_t writePos;
+        uint32_t prevGenerationEnd; // end of the records of the previous generation, 0 if none
+        uint32_t check;
+    };
+
+    /**
+     * Reads the records of a rotating file, from the oldest to the newest or backwards. The
+     * reader is positioned between two records: next() returns the record after the
+     * position and moves past it, previous() returns the record before and moves before it.
+     * The file must not be written while it is being read.
+     */
+    class Reader {
+        struct Segment {
+            uint32_t start;
+            uint32_t end; // just after the terminator of the last record
+            uint8_t terminator;
+        };
+        File pFile;
+        Segment segments[2];
+        int segmentCount;
+        int seg; // position: segment, and offset of a record start or segment end
+        uint32_t pos;
+        bool readRecord(uint32_t start, uint32_t end, String *record);
+    public:
+        Reader();
+        ~Reader();
+        bool open(const char *fileName, FS *fs);
+        void close();
+        // before the oldest record
+        void rewind();
+        // after the newest record
+        void seekToEnd();
+        bool next(String *record);
+        bool previous(String *record);
+        // Positions the reader before the first record of the last ones with a timestamp >= ts,
+        // as given by getTs (0 if the record has none). Reads backwards from the end, so the
+        // cost depends on the number of records after ts.
+        void seekToTime(time_t ts, std::function<time_t(const String &record)> getTs);
+    };
+
+private:
     File pFile;
     size_t sizeLimit;
-    int markerA;
-    int markerB;
+    uint8_t markerA;
+    uint8_t markerB;
     uint8_t markerAB[2]; // used to pFile.write() both markers at once
-    int lastMarkerAPos;
-    int firstMarkerBPos;
+    Checkpoint checkpoint;
+
+    static bool readCheckpoint(File &f, Checkpoint *cp);
+    static uint32_t checkValue(const Checkpoint &cp);
+    static void markersOf(uint32_t generation, uint8_t *markerA, uint8_t *markerB);
+    // position of the first marker in [start, end), or -1 if not found
+    static int32_t findForward(File &f, uint32_t start, uint32_t end, uint8_t marker);
+    // position of the last marker in [start, end), or -1 if not found
+    static int32_t findBackward(File &f, uint32_t start, uint32_t end, uint8_t marker);
+    void writeCheckpoint(uint32_t writePos);
+    void startFile();
+
 public:
     RotatingFile();
     void openForWrite(const char *fileName, FS *fs, size_t sizeLimit);
     virtual ~RotatingFile();
     virtual size_t write(uint8_t);
     virtual size_t write(const uint8_t *buffer, size_t size);
-    size_t write(const char *buffer, size_t size) { return write((const char *)buffer, size); };
+    size_t write(const char *buffer, size_t size) { return write((const uint8_t *)buffer, size); };
     void terminateRecord();
 };
 
@@ -0,0 +1,52 @@
+#ifndef INCL_VARINT_H
+#define INCL_VARINT_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <vector>
+
+/**
+ * Varints as in protobuf: 7 bits per byte, low bits first, the high bit set on every byte
+ * but the last. Signed values are zigzag encoded first, so that small negative values
+ * stay short.
+ */
+class Varint {
+public:
+    static void add(std::vector<uint8_t> &vect, uint32_t n) {
+        while (n & ~0x7F) {
+            vect.push_back((n & 0x7F) | 0x80);
+            n >>= 7;
+        }
+        vect.push_back(n);
+    }
+    static void addSigned(std::vector<uint8_t> &vect, int32_t n) {
+        add(vect, ((uint32_t)n << 1) ^ (uint32_t)(n >> 31));
+    }
+
+    // advances ptr, returns false if the data ends before the end of the varint
+    static bool decode(const uint8_t *&ptr, const uint8_t *end, uint32_t *n) {
+        uint32_t result = 0;
+        int b = 0;
+        uint8_t v;
+        do {
+            if (ptr == end || b > 28) {
+                return false;
+            }
+            v = *ptr++;
+            result |= (uint32_t)(v & 0x7F) << b;
+            b += 7;
+        } while (v & 0x80);
+        *n = result;
+        return true;
+    }
+    static bool decodeSigned(const uint8_t *&ptr, const uint8_t *end, int32_t *n) {
+        uint32_t u;
+        if (!decode(ptr, end, &u)) {
+            return false;
+        }
+        *n = (int32_t)(u >> 1) ^ -(int32_t)(u & 1);
+        return true;
+    }
+};
+
+#endif
@@ -0,0 +1,342 @@
+// Host benchmark of the EEPROM driver, and of littlefs on it, against the model of a 24LC256 on
+// the I2C stub (see eeprom_model.h): transfers take the time of their bytes at the bus clock,
+// and the chip doesn't answer during its write cycles.
+//
+//   eeprom_bench [-c clockHz] [-t writeCycleMicros]
+//
+// Driver: workloads of small writes, without the page cache, with it, and with it through the
+// I2C bus of the firmware. After sync(), the model must hold the bytes written, and reading
+// them back through the driver must give them too.
+//
+// littlefs (built if the littlefs sources were found, see CMakeLists.txt): appends to a log,
+// small files written, read back, listed, and read again after remounting, with the geometry
+// derived from the chip and with the former one (byte reads and programs, no page cache). The
+// device I/O of each kind of file operation is reported.
+//
+// Built with EEPROM_LFS_IN_MEMORY, the littlefs workloads run on the in-memory block device
+// instead, without the driver, to show what littlefs itself asks for.
+
+#include <Arduino.h>
+#include <map>
+#include <string>
+#include <vector>
+#include <unistd.h>
+
+#include "UEvent.h"
+#include "EEPROMDriver.h"
+#include "I2cBus.h"
+#include "eeprom_model.h"
+#if defined(HOST_LITTLEFS) || defined(EEPROM_LFS_IN_MEMORY)
+#include "EEPROMLittleFs.h"
+#endif
+
+#define EE_SIZE 32768
+#define EE_PAGE_SIZE 64
+#define EE_ADDRESS 0x50
+
+static EepromModel *model;
+static I2cBus *bus;
+
+static double millisSince(int64_t start)
+{
+  return (esp_timer_get_time() - start) / 1000.0;
+}
+
+static void printIo(const char *label, int64_t start)
+{
+  HostI2cStats bs = hostI2cGetStats(I2C_NUM_0);
+  printf("  %-22s %9.1f ms, %5u page writes, %6u transfers (%4u not acknowledged), %7u bytes on the bus\n",
+    label, millisSince(start), model->stats.pageWrites, bs.transfers, bs.nacks, bs.bytes);
+  model->resetStats();
+  hostI2cResetStats(I2C_NUM_0);
+}
+
+#ifndef EEPROM_LFS_IN_MEMORY
+
+struct Write {
+  uint16_t address;
+  uint16_t size;
+};
+
+static std::vector<Write> sequentialWrites()
+{
+  std::vector<Write> w;
+  for (int a = 0; a < 4096; a += 16) {
+    w.push_back({ (uint16_t)a, 16 });
+  }
+  return w;
+}
+
+// records that don't align with pages, as a log
+static std::vector<Write> logWrites()
+{
+  std::vector<Write> w;
+  for (int a = 8192; a + 24 <= 8192 + 4096; a += 24) {
+    w.push_back({ (uint16_t)a, 24 });
+  }
+  return w;
+}
+
+static std::vector<Write> randomWrites()
+{
+  std::vector<Write> w;
+  for (int i = 0; i < 200; i++) {
+    w.push_back({ (uint16_t)(16384 + esp_random() % (16384 / 4) * 4), 4 });
+  }
+  return w;
+}
+
+enum DriverMode { NO_CACHE, CACHE, CACHE_BUS };
+
+static bool runDriver(const char *workload, const std::vector<Write> &writes, DriverMode mode)
+{
+  static const char *modeNames[] = { "no cache", "4 pages", "4 pages, I2cBus" };
+  // never deleted, as in the firmware: the cache has a task and a timer
+  EEPROMMasterDriver *driver = new EEPROMMasterDriver();
+  if (mode == CACHE_BUS) {
+    driver->init(bus, EE_ADDRESS);
+  } else {
+    driver->init(-1, -1, 0, 0, EE_ADDRESS);
+  }
+  driver->setWritePageSize(EE_PAGE_SIZE);
+  driver->setCache(mode == NO_CACHE ? 0 : 4);
+
+  std::vector<uint8_t> expected = model->contents();
+  std::vector<uint8_t> data(64);
+  model->resetStats();
+  hostI2cResetStats(I2C_NUM_0);
+  printf("%s, %s: %d writes\n", workload, modeNames[mode], (int)writes.size());
+
+  int64_t start = esp_timer_get_time();
+  for (const Write &w : writes) {
+    for (int i = 0; i < w.size; i++) {
+      data[i] = esp_random();
+      expected[w.address + i] = data[i];
+    }
+    if (!driver->write(w.address, data.data(), w.size)) {
+      printf("  write failed at %d: %s\n", w.address, driver->lastErrorStr());
+      return false;
+    }
+  }
+  if (!driver->sync()) {
+    printf("  sync failed: %s\n", driver->lastErrorStr());
+    return false;
+  }
+  printIo("written and synced", start);
+
+  if (model->contents() != expected) {
+    printf("  the EEPROM doesn't hold the bytes written\n");
+    return false;
+  }
+  std::vector<uint8_t> back(EE_SIZE);
+  start = esp_timer_get_time();
+  for (int a = 0; a < EE_SIZE; a += 256) {
+    if (!driver->read(a, back.data() + a, 256)) {
+      printf("  read failed at %d: %s\n", a, driver->lastErrorStr());
+      return false;
+    }
+  }
+  printIo("read back", start);
+  if (back != expected) {
+    printf("  the bytes read back are not the bytes written\n");
+    return false;
+  }
+  String stats;
+  driver->getStats(&stats);
+  printf("  driver: %s\n", stats.c_str());
+  return true;
+}
+
+#endif
+
+#if defined(HOST_LITTLEFS) || defined(EEPROM_LFS_IN_MEMORY)
+
+static bool checkFile(EEPROMLittleFs *fs, const std::string &path, const std::string &content)
+{
+  File f = fs->open(path.c_str(), "r");
+  if (!f) {
+    printf("  cannot open %s\n", path.c_str());
+    return false;
+  }
+  std::string read(f.size(), '\0');
+  size_t n = f.read((uint8_t *)&read[0], read.size());
+  f.close();
+  if (n != content.size() || read != content) {
+    printf("  %s: %d bytes read, not the %d bytes written\n", path.c_str(), (int)n, (int)content.size());
+    return false;
+  }
+  return true;
+}
+
+static bool checkFiles(EEPROMLittleFs *fs, const std::map<std::string, std::string> &files)
+{
+  for (auto &f : files) {
+    if (!checkFile(fs, f.first, f.second)) {
+      return false;
+    }
+  }
+  return true;
+}
+
+static bool runLfs(const char *label, const EEPROMLittleFs::LFSConfig &lfsCfg, int cachePages)
+{
+  EEPROMLittleFs::EEPROMConfig eeCfg;
+  eeCfg.size = EE_SIZE;
+  eeCfg.writePageSize = EE_PAGE_SIZE;
+  eeCfg.cachePages = cachePages;
+  eeCfg.kvSize = 2048; // as EEPROMFsService
+#ifndef EEPROM_LFS_IN_MEMORY
+  std::fill(model->contents().begin(), model->contents().end(), 0xFF);
+  model->resetStats();
+  hostI2cResetStats(I2C_NUM_0);
+#endif
+  printf("littlefs, %s\n", label);
+  // never deleted, as in the firmware
+  EEPROMLittleFs *fs = new EEPROMLittleFs();
+  int64_t start = esp_timer_get_time();
+  if (!fs->init(I2C_NUM_0, eeCfg, lfsCfg, true, bus)) {
+    String err;
+    fs->getLastError(&err);
+    printf("  cannot mount: %s\n", err.c_str());
+    return false;
+  }
+  auto phase = [&start](const char *label) {
+#ifdef EEPROM_LFS_IN_MEMORY
+    printf("  %-22s %9.3f ms\n", label, millisSince(start));
+#else
+    printIo(label, start);
+#endif
+    start = esp_timer_get_time();
+  };
+  phase("format and mount");
+
+  std::map<std::string, std::string> files;
+  std::string &log = files["/telemetry.bin"];
+  for (int i = 0; i < 50; i++) {
+    char record[32];
+    snprintf(record, sizeof(record), "%08x %08x %012d\n", i, esp_random(), i * 1000);
+    File f = fs->open("/telemetry.bin", "a");
+    if (!f || f.write((const uint8_t *)record, 31) != 31) {
+      printf("  append %d failed\n", i);
+      return false;
+    }
+    f.close();
+    log.append(record, 31);
+  }
+  phase("50 appends of 31 B");
+
+  fs->mkdir("/cfg");
+  for (int i = 0; i < 8; i++) {
+    char path[32];
+    snprintf(path, sizeof(path), "/cfg/service%d.json", i);
+    std::string content = "{ \"enabled\": true, \"period\": " + std::to_string(esp_random() % 10000) + ", \"name\": \"";
+    content.append(40 + esp_random() % 120, 'a' + i);
+    content += "\" }\n";
+    File f = fs->open(path, "w");
+    if (!f || f.write((const uint8_t *)content.data(), content.size()) != content.size()) {
+      printf("  cannot write %s\n", path);
+      return false;
+    }
+    f.close();
+    files[path] = content;
+  }
+  phase("8 files written");
+
+  if (!checkFiles(fs, files)) {
+    return false;
+  }
+  phase("all read back");
+
+  File dir = fs->open("/cfg", "r");
+  int count = 0;
+  for (File f = dir.openNextFile(); f; f = dir.openNextFile()) {
+    ++count;
+  }
+  dir.close();
+  if (count != 8) {
+    printf("  %d files listed in /cfg, not 8\n", count);
+    return false;
+  }
+  phase("directory listed");
+
+#ifndef EEPROM_LFS_IN_MEMORY
+  // the in-memory block device doesn't survive terminate()
+  fs->terminate();
+  if (!fs->init(I2C_NUM_0, eeCfg, lfsCfg, false, bus) || !checkFiles(fs, files)) {
+    printf("  files lost after remounting\n");
+    return false;
+  }
+  phase("remounted, read back");
+#endif
+
+  String stats;
+  fs->getIoStats(&stats);
+  printf("  %s", stats.c_str());
+  stats = "";
+  fs->getDriverStats(&stats);
+  printf("  driver: %s\n", stats.c_str());
+  return true;
+}
+
+#endif
+
+int main(int argc, char **argv)
+{
+  uint32_t clockHz = 400000;
+  uint32_t writeCycleMicros = 5000;
+  int c;
+  while ((c = getopt(argc, argv, "c:t:")) != -1) {
+    switch (c) {
+      case 'c': clockHz = atoi(optarg); break;
+      case 't': writeCycleMicros = atoi(optarg); break;
+      default:
+        fprintf(stderr, "Usage: %s [-c clockHz] [-t writeCycleMicros]\n", argv[0]);
+        return 2;
+    }
+  }
+  hostSeedRandom(1);
+  model = new EepromModel(EE_SIZE, EE_PAGE_SIZE, writeCycleMicros);
+  hostI2cAttach(I2C_NUM_0, EE_ADDRESS, model);
+  hostI2cSetClock(I2C_NUM_0, clockHz);
+  printf("24LC256 model, %u Hz bus, write cycle %u us\n\n", clockHz, writeCycleMicros);
+
+  UEventLoop *eventLoop = new UEventLoop("Main");
+  bus = new I2cBus();
+  if (!bus->start(I2C_NUM_0, eventLoop)) {
+    printf("Cannot start the I2C bus\n");
+    return 1;
+  }
+
+  bool ok = true;
+#ifndef EEPROM_LFS_IN_MEMORY
+  struct { const char *name; std::vector<Write> writes; } workloads[] = {
+    { "sequential 16 B", sequentialWrites() },
+    { "log records 24 B", logWrites() },
+    { "random 4 B", randomWrites() }
+  };
+  for (auto &w : workloads) {
+    for (DriverMode mode : { NO_CACHE, CACHE, CACHE_BUS }) {
+      ok = runDriver(w.name, w.writes, mode) && ok;
+    }
+  }
+  // a chip slower than the driver assumes: transfers are retried until it answers
+  model->setWriteCycleMicros(writeCycleMicros + writeCycleMicros / 4);
+  ok = runDriver("log records 24 B, chip 25% slower", logWrites(), NO_CACHE) && ok;
+  model->setWriteCycleMicros(writeCycleMicros);
+#endif
+
+#if defined(HOST_LITTLEFS) || defined(EEPROM_LFS_IN_MEMORY)
+  EEPROMLittleFs::LFSConfig tuned;
+  EEPROMLittleFs::LFSConfig former;
+  former.autoTune = false;
+  printf("\n");
+  ok = runLfs("geometry from the chip, 4 cache pages", tuned, 4) && ok;
+  ok = runLfs("former geometry, no cache", former, 0) && ok;
+#else
+  printf("\nlittlefs workloads not built: no littlefs sources, see CMakeLists.txt\n");
+#endif
+  printf("\n%s\n", ok ? "OK" : "FAILED");
+  fflush(stdout);
+  // the tasks of the bus and of the driver caches still run: no static destructors under them
+  _exit(ok ? 0 : 1);
+}
@@ -0,0 +1,67 @@
+// See eeprom_model.h.
+#include <esp_timer.h>
+#include "eeprom_model.h"
+
+EepromModel::EepromModel(uint32_t size, uint32_t pageSize, uint32_t writeCycleMicros)
+  : mem(size, 0xFF), pageSize(pageSize), writeCycleMicros(writeCycleMicros), busyUntil(0), counter(0),
+    isWriting(false), addressBytes(0), pageBase(0), latch(pageSize, -1), stats()
+{
+}
+
+bool EepromModel::start(bool isRead)
+{
+  if (esp_timer_get_time() < busyUntil) {
+    ++stats.busyNacks;
+    return false;
+  }
+  isWriting = !isRead;
+  addressBytes = 0;
+  return true;
+}
+
+bool EepromModel::write(uint8_t data)
+{
+  if (!isWriting) {
+    return false;
+  }
+  if (addressBytes < 2) {
+    counter = ((addressBytes == 0 ? (uint32_t)data << 8 : counter | data)) % mem.size();
+    ++addressBytes;
+    if (addressBytes == 2) {
+      pageBase = counter - counter % pageSize;
+      latch.assign(pageSize, -1);
+    }
+    return true;
+  }
+  latch[counter - pageBase] = data;
+  counter = pageBase + (counter - pageBase + 1) % pageSize;
+  return true;
+}
+
+uint8_t EepromModel::read()
+{
+  uint8_t data = mem[counter];
+  counter = (counter + 1) % mem.size();
+  ++stats.bytesRead;
+  return data;
+}
+
+void EepromModel::stop()
+{
+  bool hasData = false;
+  if (isWriting && addressBytes == 2) {
+    for (uint32_t i = 0; i < pageSize; i++) {
+      if (latch[i] >= 0) {
+        mem[pageBase + i] = (uint8_t)latch[i];
+        latch[i] = -1;
+        ++stats.bytesWritten;
+        hasData = true;
+      }
+    }
+  }
+  if (hasData) {
+    ++stats.pageWrites;
+    busyUntil = esp_timer_get_time() + writeCycleMicros;
+  }
+  isWriting = false;
+}
@@ -0,0 +1,44 @@
+// Model of a 24LCxxx I2C EEPROM (24LC256 by default: 32 KB, 64-byte pages, 5 ms write cycle) on
+// the I2C stub, for the EEPROM driver and littlefs targets. Two address bytes, then data bytes:
+// a write latches them in the page, wrapping at its end, and programs them at the stop; the
+// chip then acknowledges nothing for its write cycle (t_WR). Reads continue from the address
+// counter, across pages.
+#ifndef EEPROM_MODEL_H
+#define EEPROM_MODEL_H
+
+#include <stdint.h>
+#include <vector>
+#include <driver/i2c.h>
+
+class EepromModel : public HostI2cDevice {
+  std::vector<uint8_t> mem;
+  uint32_t pageSize;
+  uint32_t writeCycleMicros;
+  int64_t busyUntil;
+  uint32_t counter; // address counter
+  bool isWriting;
+  int addressBytes; // received in the current write
+  uint32_t pageBase; // page of the current write
+  std::vector<int16_t> latch; // bytes of the current write by page offset, -1 if not written
+
+public:
+  struct Stats {
+    uint32_t pageWrites; // write cycles
+    uint32_t bytesWritten;
+    uint32_t bytesRead;
+    uint32_t busyNacks; // addressed during a write cycle
+  } stats;
+
+  EepromModel(uint32_t size = 32768, uint32_t pageSize = 64, uint32_t writeCycleMicros = 5000);
+  void setWriteCycleMicros(uint32_t micros) { writeCycleMicros = micros; }
+  // contents, as programmed: bytes of a write in progress are not there before its stop
+  std::vector<uint8_t> &contents() { return mem; }
+  void resetStats() { stats = { }; }
+
+  bool start(bool isRead) override;
+  bool write(uint8_t data) override;
+  uint8_t read() override;
+  void stop() override;
+};
+
+#endif
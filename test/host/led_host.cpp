@@ -0,0 +1,149 @@
+#include "led_host.h"
+
+#include <SPIFFS.h>
+#include <dirent.h>
+#include <errno.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+static const int pins[] = { LED_PIN_1, LED_PIN_2, LED_PIN_3, LED_PIN_4, LED_PIN_5, LED_PIN_6, LED_PIN_7 };
+static const int MAX_HARDWARE = LED_HARDWARE_COUNT - 1; // the service wants fewer than LED_HARDWARE_COUNT
+static const int MAX_PER_PIN = 2500;
+
+bool ledHostMakeDir(const std::string &dir)
+{
+  return mkdir(dir.c_str(), 0755) == 0 || errno == EEXIST;
+}
+
+String ledHostHardwareConfig(int ledCount)
+{
+  int pinCount = (ledCount + MAX_PER_PIN - 1) / MAX_PER_PIN;
+  if (pinCount > MAX_HARDWARE) {
+    pinCount = MAX_HARDWARE;
+  }
+  int perPin = (ledCount + pinCount - 1) / pinCount;
+  String cfg = "[\n";
+  for (int i = 0, pos = 0; pos < ledCount; i++, pos += perPin) {
+    int count = (ledCount - pos < perPin ? ledCount - pos : perPin);
+    cfg += String("    { \"chip\": \"WS2812\", \"rgbOrder\": \"GRB\", \"pin\": ") + pins[i] + ", \"count\": " + count + " }";
+    cfg += (pos + perPin < ledCount ? ",\n" : "\n");
+  }
+  cfg += "  ]";
+  return cfg;
+}
+
+bool ledHostPrepare(const std::string &fsRoot, const String &config)
+{
+  SPIFFS.setHostRoot(fsRoot.c_str());
+  SPIFFS.format();
+  File f = SPIFFS.open("/led-hardware.conf.json", "w");
+  if (!f) {
+    printf("Cannot write the configuration in %s\n", fsRoot.c_str());
+    return false;
+  }
+  f.print(config);
+  f.close();
+  return true;
+}
+
+bool ledHostPrepareFromDir(const std::string &fsRoot, const std::string &dataDir)
+{
+  SPIFFS.setHostRoot(fsRoot.c_str());
+  SPIFFS.format();
+  DIR *d = opendir(dataDir.c_str());
+  if (d == nullptr) {
+    printf("Cannot read %s\n", dataDir.c_str());
+    return false;
+  }
+  bool isOk = true;
+  struct dirent *e;
+  while (isOk && (e = readdir(d)) != nullptr) {
+    std::string fileName(e->d_name);
+    std::string src = dataDir + "/" + fileName;
+    struct stat st;
+    if (stat(src.c_str(), &st) != 0 || !S_ISREG(st.st_mode)) {
+      continue;
+    }
+    FILE *in = fopen(src.c_str(), "rb");
+    File out = SPIFFS.open(("/" + fileName).c_str(), "w");
+    isOk = (in != nullptr && out);
+    uint8_t buf[4096];
+    size_t n;
+    while (isOk && (n = fread(buf, 1, sizeof(buf), in)) > 0) {
+      isOk = (out.write(buf, n) == n);
+    }
+    if (in != nullptr) {
+      fclose(in);
+    }
+    out.close();
+    if (!isOk) {
+      printf("Cannot copy %s to %s\n", src.c_str(), fsRoot.c_str());
+    }
+  }
+  closedir(d);
+  return isOk;
+}
+
+void ledHostStart(LedHost *host)
+{
+  host->logMgr = new LogMgr();
+  host->logMgr->init();
+  host->eventLoop = new UEventLoop("Main");
+  host->commandMgr = new CommandMgr();
+  host->commandMgr->init(host->eventLoop);
+  host->eventLoop->runOnce(0); // makes this the loop task, so that commands are processed directly
+  host->ledService = new LedService();
+  host->ledService->init(host->eventLoop, host->commandMgr, host->logMgr);
+}
+
+bool ledHostCommand(LedHost *host, const char *line, String *out)
+{
+  String cmd(line);
+  bool rc = host->commandMgr->processCommandLine("host", &cmd);
+  if (!rc) {
+    printf("Command \"%s\" failed: %s\n", line, cmd.c_str());
+  } else if (out != nullptr) {
+    *out = cmd;
+  }
+  return rc;
+}
+
+unsigned long ledHostValue(const String &text, const char *label, int from)
+{
+  int pos = (from < 0 ? -1 : text.indexOf(label, from));
+  return (pos < 0 ? 0 : strtoul(text.c_str() + pos + strlen(label), nullptr, 10));
+}
+
+bool ledHostRun(LedHost *host, std::function<bool()> isDone, uint64_t timeoutMicros)
+{
+  uint64_t deadline = esp_timer_get_time() + timeoutMicros;
+  while (!isDone()) {
+    host->eventLoop->runOnce(1);
+    if ((uint64_t)esp_timer_get_time() > deadline) {
+      return false;
+    }
+  }
+  return true;
+}
+
+int ledHostForEach(const std::vector<int> &ledCounts, std::function<int(int ledCount)> fn)
+{
+  int failures = 0;
+  for (int ledCount : ledCounts) {
+    fflush(stdout);
+    pid_t pid = fork();
+    if (pid == 0) {
+      int rc = fn(ledCount);
+      fflush(stdout);
+      _exit(rc); // the show task is still waiting for frames
+    }
+    int status = 0;
+    if (pid < 0 || waitpid(pid, &status, 0) < 0 || !WIFEXITED(status) || WEXITSTATUS(status) != 0) {
+      printf("FAILED for %d leds\n", ledCount);
+      ++failures;
+    }
+  }
+  return failures;
+}
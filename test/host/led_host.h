@@ -0,0 +1,52 @@
+// The led service on the host, shared by led_sim and led_script_bench: the firmware's log,
+// event loop and commands, and LedService on a configuration written to SPIFFS, run in real
+// time against the FastLED stub.
+#ifndef LED_HOST_H
+#define LED_HOST_H
+
+#include <Arduino.h>
+#include <functional>
+#include <string>
+#include <vector>
+
+#include "UEvent.h"
+#include "CommandMgr.h"
+#include "LogMgr.h"
+#include "LedService.h"
+
+struct LedHost {
+  LogMgr *logMgr;
+  UEventLoop *eventLoop;
+  CommandMgr *commandMgr;
+  LedService *ledService;
+};
+
+bool ledHostMakeDir(const std::string &dir);
+
+// the "hardware" array of the configuration for ledCount leds, split over pins
+String ledHostHardwareConfig(int ledCount);
+
+// formats SPIFFS at fsRoot and writes /led-hardware.conf.json
+bool ledHostPrepare(const std::string &fsRoot, const String &config);
+
+// formats SPIFFS at fsRoot and copies the files of dataDir into it, as uploaded to the device;
+// dataDir itself is left as is
+bool ledHostPrepareFromDir(const std::string &fsRoot, const std::string &dataDir);
+
+// starts the service; the objects are never deleted, as in Main.cpp
+void ledHostStart(LedHost *host);
+
+// runs a command line, processed directly since this is the loop task; prints failures
+bool ledHostCommand(LedHost *host, const char *line, String *out = nullptr);
+
+// the number following label in text, searching from position from; 0 if not found
+unsigned long ledHostValue(const String &text, const char *label, int from = 0);
+
+// runs the event loop until isDone(), false after timeoutMicros
+bool ledHostRun(LedHost *host, std::function<bool()> isDone, uint64_t timeoutMicros);
+
+// runs fn(ledCount) in a process of its own for each led count, since the service and FastLED
+// keep their state for the life of the firmware; returns the number of failures
+int ledHostForEach(const std::vector<int> &ledCounts, std::function<int(int ledCount)> fn);
+
+#endif
@@ -0,0 +1,138 @@
+// Benchmark of the script controller against the native spark controller: both render sparks
+// on all the leds of the same frames, scripts/sparks.js for the script one, and the per-frame
+// calc times of the service are compared. Also times reloading the script from its bytecode
+// cache against compiling it.
+//
+//   led_script_bench [-f frames] [-s script] [ledCount ...]
+//
+// Led counts default to 100, 1000 and 10000.
+
+#include <Arduino.h>
+#include <FastLED.h>
+#include <SPIFFS.h>
+#include <atomic>
+#include <string>
+#include <vector>
+#include <unistd.h>
+
+#include "led_host.h"
+
+static const int RELOADS = 5;
+
+static bool copyScript(const std::string &from, const char *to)
+{
+  FILE *in = fopen(from.c_str(), "rb");
+  if (in == nullptr) {
+    printf("Cannot read %s\n", from.c_str());
+    return false;
+  }
+  File out = SPIFFS.open(to, "w");
+  char buf[512];
+  size_t n;
+  while ((n = fread(buf, 1, sizeof(buf), in)) > 0) {
+    out.write((const uint8_t *)buf, n);
+  }
+  fclose(in);
+  out.close();
+  return true;
+}
+
+// best of RELOADS "led1 reload", with or without the bytecode cache
+static uint64_t timeReload(LedHost *host, bool isCached)
+{
+  uint64_t best = UINT64_MAX;
+  for (int i = 0; i < RELOADS; i++) {
+    if (!isCached) {
+      SPIFFS.remove("/sparks.jsbc");
+    }
+    uint64_t start = esp_timer_get_time();
+    String msg;
+    if (!ledHostCommand(host, "led1 reload", &msg)) {
+      return 0;
+    }
+    uint64_t t = esp_timer_get_time() - start;
+    best = (t < best ? t : best);
+  }
+  return best;
+}
+
+static int bench(int ledCount, int frames, const std::string &script)
+{
+  std::string dir = "led_script_bench_out";
+  if (!ledHostMakeDir(dir)) {
+    return 1;
+  }
+  std::atomic<int> shownFrames(0);
+  FastLED.setHostShowHandler([&](const std::vector<CLEDController *> &controllers, uint8_t brightness) {
+    ++shownFrames;
+  });
+
+  String config = "{\n  \"hardware\": " + ledHostHardwareConfig(ledCount) + ",\n";
+  config += "  \"controllers\": [\n"
+    "    { \"type\": \"spark\", \"description\": \"native\" },\n"
+    "    { \"type\": \"script\", \"script\": \"/sparks.js\", \"description\": \"scripted\" }\n"
+    "  ]\n}\n";
+  LedHost host;
+  if (!ledHostPrepare(dir + "/" + std::to_string(ledCount), config) || !copyScript(script, "/sparks.js")) {
+    return 1;
+  }
+  ledHostStart(&host);
+
+  uint64_t compileMicros = timeReload(&host, false);
+  uint64_t cachedMicros = timeReload(&host, true);
+
+  if (!ledHostCommand(&host, "led0 enable") || !ledHostCommand(&host, "led1 enable")
+      || !ledHostCommand(&host, "led1 budgetMicros 100000")
+      || !ledHostCommand(&host, "led freq 50")
+      || !ledHostCommand(&host, "led powerLimit 999999")
+      || !ledHostCommand(&host, "led enable")) {
+    return 1;
+  }
+  if (!ledHostRun(&host, [&]() { return shownFrames >= frames; }, (uint64_t)frames * 200000 + 10000000)) {
+    printf("Only %d frames shown out of %d\n", (int)shownFrames, frames);
+    return 1;
+  }
+  String status;
+  ledHostCommand(&host, "led status", &status);
+  ledHostCommand(&host, "led disable");
+
+  int native = status.indexOf("led0 -- ");
+  int scripted = status.indexOf("led1 -- ");
+  unsigned long nativeMicros = ledHostValue(status, "calc micros: ", native);
+  unsigned long scriptMicros = ledHostValue(status, "calc micros: ", scripted);
+  unsigned long errors = ledHostValue(status, "errors: ", scripted);
+  unsigned long overBudget = ledHostValue(status, "over budget: ", scripted);
+  printf("leds %6d: native %6lu us/frame, script %6lu us/frame (x%.1f), %lu over budget, %lu errors; "
+    "load %6llu us compiling, %6llu us from bytecode\n",
+    ledCount, nativeMicros, scriptMicros, nativeMicros == 0 ? 0.0 : (double)scriptMicros / nativeMicros,
+    overBudget, errors, (unsigned long long)compileMicros, (unsigned long long)cachedMicros);
+  if (native < 0 || scripted < 0 || errors > 0 || compileMicros == 0 || cachedMicros == 0) {
+    printf("%s\n", status.c_str());
+    return 1;
+  }
+  return 0;
+}
+
+int main(int argc, char **argv)
+{
+  int frames = 100;
+  std::string script = LED_HOST_SCRIPTS "/sparks.js";
+  int c;
+  while ((c = getopt(argc, argv, "f:s:")) != -1) {
+    switch (c) {
+      case 'f': frames = atoi(optarg); break;
+      case 's': script = optarg; break;
+      default:
+        fprintf(stderr, "Usage: %s [-f frames] [-s script] [ledCount ...]\n", argv[0]);
+        return 2;
+    }
+  }
+  std::vector<int> ledCounts;
+  for (int i = optind; i < argc; i++) {
+    ledCounts.push_back(atoi(argv[i]));
+  }
+  if (ledCounts.empty()) {
+    ledCounts = { 100, 1000, 10000 };
+  }
+  return ledHostForEach(ledCounts, [&](int ledCount) { return bench(ledCount, frames, script); }) == 0 ? 0 : 1;
+}
@@ -0,0 +1,195 @@
+// Host simulator of the led service: LedService with its spark, meteor and field effects, the
+// event loop and the command dispatch of the firmware, on a ring of leds, against the FastLED
+// stub. Every "every"-th frame shown is written as a binary PPM image, one row of leds in
+// hardware order, with the brightness of the frame applied. After the run, the per-frame
+// timings of the service are printed for each led count, and a summary line per led count.
+//
+//   led_sim [-f frames] [-r fps] [-e every] [-o outdir] [ledCount ...]
+//   led_sim -d datadir [-f frames] [-r fps] [-e every] [-o outdir]
+//
+// Led counts default to 100, 1000 and 10000. Each one runs in its own process: the service and
+// FastLED keep their state for the life of the firmware.
+//
+// With -d, the files of a data directory of the firmware (e.g. data-led-sphere) are the content
+// of SPIFFS instead: the service runs on its led-hardware.conf.json, led.conf.json and
+// ledN.conf.json as on the device, with its controllers, brightness and power limit. The
+// frequency is the configured one unless -r is given.
+
+#include <Arduino.h>
+#include <FastLED.h>
+#include <atomic>
+#include <string>
+#include <vector>
+#include <unistd.h>
+
+#include "led_host.h"
+
+struct Options {
+  int frames;
+  int fps; // 0: the configured one with -d, 100 otherwise
+  int every;
+  std::string outDir;
+  std::string dataDir;
+};
+
+static void writeFrame(const std::string &path, const std::vector<CLEDController *> &controllers, uint8_t brightness)
+{
+  int count = 0;
+  for (CLEDController *c : controllers) {
+    count += c->count;
+  }
+  FILE *f = fopen(path.c_str(), "wb");
+  if (f == nullptr) {
+    return;
+  }
+  fprintf(f, "P6\n%d 1\n255\n", count);
+  for (CLEDController *c : controllers) {
+    for (int i = 0; i < c->count; i++) {
+      uint8_t rgb[3] = {
+        scale8_video(c->leds[i].r, brightness),
+        scale8_video(c->leds[i].g, brightness),
+        scale8_video(c->leds[i].b, brightness)
+      };
+      fwrite(rgb, 1, 3, f);
+    }
+  }
+  fclose(f);
+}
+
+static String ringConfig(int ledCount)
+{
+  String config = "{\n  \"hardware\": " + ledHostHardwareConfig(ledCount) + ",\n";
+  config += String("  \"geometry\": { \"type\": \"ring\", \"count\": ") + ledCount + " },\n";
+  config += "  \"controllers\": [\n"
+    "    { \"type\": \"spark\", \"description\": \"sparks\" },\n"
+    "    { \"type\": \"meteor\", \"description\": \"meteors\", \"blend\": \"add\" },\n"
+    "    { \"type\": \"field\", \"description\": \"field\", \"blend\": \"max\", \"opacity\": 160 }\n"
+    "  ]\n}\n";
+  return config;
+}
+
+// the ring of ledCount leds, or the data directory of opt if any, with ledCount unused
+static int simulate(int ledCount, const Options &opt)
+{
+  bool isDataDir = !opt.dataDir.empty();
+  std::string name = isDataDir ? opt.dataDir.substr(opt.dataDir.find_last_of('/') + 1) : std::to_string(ledCount);
+  std::string dir = opt.outDir + "/" + name;
+  if (!ledHostMakeDir(opt.outDir) || !ledHostMakeDir(dir)) {
+    printf("Cannot create %s\n", dir.c_str());
+    return 1;
+  }
+  std::atomic<bool> isRunning(false);
+  std::atomic<int> shownFrames(0);
+  FastLED.setHostShowHandler([&](const std::vector<CLEDController *> &controllers, uint8_t brightness) {
+    if (!isRunning) {
+      return;
+    }
+    int n = shownFrames++;
+    if (opt.every > 0 && n % opt.every == 0) {
+      char name[32];
+      snprintf(name, sizeof(name), "/frame-%05d.ppm", n);
+      writeFrame(dir + std::string(name), controllers, brightness);
+    }
+  });
+
+  LedHost host;
+  // the service's config files, apart from the frames
+  if (!(isDataDir ? ledHostPrepareFromDir(dir + "/fs", opt.dataDir) : ledHostPrepare(dir + "/fs", ringConfig(ledCount)))) {
+    return 1;
+  }
+  uint64_t start = 0;
+  if (isDataDir) {
+    // enabled by its config as soon as loaded
+    isRunning = true;
+    start = esp_timer_get_time();
+  }
+  ledHostStart(&host);
+
+  int fps = opt.fps;
+  if (isDataDir) {
+    String status;
+    if (!ledHostCommand(&host, "led status", &status)) {
+      return 1;
+    }
+    ledCount = ledHostValue(status, "Total led count: ");
+    if (fps == 0) {
+      unsigned long intervalMillis = ledHostValue(status, "Target interval: ");
+      fps = (intervalMillis == 0 ? 1 : 1000 / intervalMillis);
+    }
+    if (ledCount == 0) {
+      printf("No leds configured in %s\n%s\n", opt.dataDir.c_str(), status.c_str());
+      return 1;
+    }
+  } else {
+    fps = (fps == 0 ? 100 : fps);
+    if (!ledHostCommand(&host, "led0 enable") || !ledHostCommand(&host, "led1 enable") || !ledHostCommand(&host, "led2 enable")
+        // no dimming to the default power limit, which 1000 dark leds reach by themselves
+        || !ledHostCommand(&host, "led powerLimit 999999")) {
+      return 1;
+    }
+  }
+  String freq = String("led freq ") + fps;
+  if ((opt.fps != 0 || !isDataDir) && !ledHostCommand(&host, freq.c_str())) {
+    return 1;
+  }
+  if (!isDataDir) {
+    isRunning = true;
+    start = esp_timer_get_time();
+  }
+  if (!ledHostCommand(&host, "led enable")) {
+    return 1;
+  }
+  // real time, with room for a slow host
+  if (!ledHostRun(&host, [&]() { return shownFrames >= opt.frames; }, (uint64_t)opt.frames * 10000000 / fps + 10000000)) {
+    printf("Only %d frames shown out of %d\n", (int)shownFrames, opt.frames);
+    return 1;
+  }
+  uint64_t elapsed = esp_timer_get_time() - start;
+  String status, timings;
+  ledHostCommand(&host, "led status", &status);
+  ledHostCommand(&host, "led timings", &timings);
+  isRunning = false;
+  ledHostCommand(&host, "led disable");
+
+  printf("\n%s\n%s\n", status.c_str(), timings.c_str());
+  unsigned long frameMicros = ledHostValue(status, "Avg duration micros: ");
+  printf("SUMMARY leds %6d: %d frames in %.2f s, %lu micros/frame calc (%.1f ns/led), %lu micros compositing, frames written to %s\n",
+    ledCount, (int)shownFrames, elapsed / 1e6, frameMicros, frameMicros * 1000.0 / ledCount,
+    ledHostValue(status, "Avg compositing micros: "), dir.c_str());
+  return 0;
+}
+
+int main(int argc, char **argv)
+{
+  Options opt = { 300, 0, 10, "led_sim_out", "" };
+  int c;
+  while ((c = getopt(argc, argv, "f:r:e:o:d:")) != -1) {
+    switch (c) {
+      case 'f': opt.frames = atoi(optarg); break;
+      case 'r': opt.fps = atoi(optarg); break;
+      case 'e': opt.every = atoi(optarg); break;
+      case 'o': opt.outDir = optarg; break;
+      case 'd': opt.dataDir = optarg; break;
+      default:
+        fprintf(stderr, "Usage: %s [-f frames] [-r fps] [-e every] [-o outdir] [ledCount ...]\n"
+          "       %s -d datadir [-f frames] [-r fps] [-e every] [-o outdir]\n", argv[0], argv[0]);
+        return 2;
+    }
+  }
+  while (opt.dataDir.size() > 1 && opt.dataDir.back() == '/') {
+    opt.dataDir.pop_back();
+  }
+  if (!opt.dataDir.empty()) {
+    // a single run, in a process of its own as well
+    return ledHostForEach({ 0 }, [&opt](int ledCount) { return simulate(ledCount, opt); }) == 0 ? 0 : 1;
+  }
+  std::vector<int> ledCounts;
+  for (int i = optind; i < argc; i++) {
+    ledCounts.push_back(atoi(argv[i]));
+  }
+  if (ledCounts.empty()) {
+    ledCounts = { 100, 1000, 10000 };
+  }
+
+  return ledHostForEach(ledCounts, [&opt](int ledCount) { return simulate(ledCount, opt); }) == 0 ? 0 : 1;
+}
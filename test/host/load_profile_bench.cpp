@@ -0,0 +1,344 @@
+// Host benchmark of the load profile: the samples of the profiles in profiles/ are compressed
+// as the supervisor does, with the deadband of profile version 1 (as IvanSupervisorSensors.cpp
+// had it) and with the swinging door of version 2 (LoadProfileCodec.h), then decoded, and the
+// curve each decodes to is compared with the samples.
+//
+//   load_profile_bench [-i currentMaxError] [-u voltageMaxError] [-p hysteresisPct] [profile.csv ...]
+//
+// Profiles are lines of "ms since turn on,mA,mV", # for comments; the last sample is the one
+// taken 5 s after turning off, which ends the profile. They default to all of profiles/.
+//
+// The compression ratio is against the samples stored raw, 8 bytes each. Version 1 holds its
+// values until the next point, version 2 interpolates between its points; samples after the
+// end of a truncated profile are compared with its last point. Version 2 must keep every
+// sample within its max errors when it isn't truncated, also in the snapshot sent 1 s after
+// turning off, and taking the snapshot must not change the profile.
+
+#include <dirent.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <algorithm>
+#include <string>
+#include <vector>
+
+#include "Varint.h"
+#include "LoadProfileCodec.h"
+
+struct Sample {
+  uint32_t ts;
+  int32_t current;
+  int32_t voltage;
+};
+
+// a decoded profile: values at ts, interpolated or held until the next point
+struct Curve {
+  std::vector<Sample> points;
+  bool isInterpolated;
+  bool isTruncated;
+};
+
+struct Error {
+  double currentMax = 0;
+  double voltageMax = 0;
+  double currentSquares = 0;
+  double voltageSquares = 0;
+  int count = 0;
+
+  double currentRms() const { return count > 0 ? sqrt(currentSquares / count) : 0; }
+  double voltageRms() const { return count > 0 ? sqrt(voltageSquares / count) : 0; }
+};
+
+static bool readProfile(const std::string &path, std::vector<Sample> *samples)
+{
+  FILE *f = fopen(path.c_str(), "r");
+  if (f == nullptr) {
+    printf("Cannot read %s\n", path.c_str());
+    return false;
+  }
+  char line[128];
+  while (fgets(line, sizeof(line), f) != nullptr) {
+    Sample s;
+    if (line[0] == '#' || line[0] == '\n') {
+      continue;
+    }
+    if (sscanf(line, "%u,%d,%d", &s.ts, &s.current, &s.voltage) != 3
+        || (!samples->empty() && s.ts <= samples->back().ts)) {
+      printf("%s: bad sample: %s", path.c_str(), line);
+      fclose(f);
+      return false;
+    }
+    samples->push_back(s);
+  }
+  fclose(f);
+  if (samples->size() < 2) {
+    printf("%s: not enough samples\n", path.c_str());
+    return false;
+  }
+  return true;
+}
+
+// version 1, as Sensors::profileAdd() and the end of the profile in doSensorMeasurements() were
+class V1Encoder {
+  std::vector<uint8_t> &out;
+  float hystPct;
+  bool isFirst = true;
+  uint32_t lastProfileTs = 0;
+  uint32_t lastMeasureTs = 0;
+  int lastCurrent = 0;
+  int lastVoltage = 0;
+
+public:
+  V1Encoder(std::vector<uint8_t> &out, float hystPct) : out(out), hystPct(hystPct) { }
+
+  void add(uint32_t ts, int current, int voltage)
+  {
+    int currentHyst = std::max(abs(lastCurrent) * (int)(hystPct * 100) / 10000, 20);
+    int voltageHyst = std::max(abs(lastVoltage) * (int)(hystPct * 100) / 10000, 20);
+    bool isChanged = (abs(current - lastCurrent) > currentHyst) || (abs(voltage - lastVoltage) > voltageHyst);
+    if (isFirst) {
+      out.clear();
+      Varint::add(out, 1);
+      Varint::add(out, currentHyst);
+      Varint::add(out, voltageHyst);
+      isChanged = true;
+    }
+    if (isChanged) {
+      const size_t maxSize = 100 * 4;
+      if (out.size() < maxSize) {
+        addEntry(ts, current, voltage);
+        lastProfileTs = ts;
+        lastCurrent = current;
+        lastVoltage = voltage;
+      } else if (out.size() == maxSize) {
+        Varint::add(out, ts - lastProfileTs);
+        Varint::add(out, ts - lastMeasureTs);
+        Varint::addSigned(out, 999999);
+        Varint::addSigned(out, 999999);
+      }
+    }
+    lastMeasureTs = ts;
+    isFirst = false;
+  }
+
+  // the sample taken once the profile ended, added whatever the size
+  void finish(uint32_t ts, int current, int voltage)
+  {
+    addEntry(ts, current, voltage);
+  }
+
+private:
+  void addEntry(uint32_t ts, int current, int voltage)
+  {
+    Varint::add(out, ts - lastProfileTs);
+    Varint::add(out, ts - lastMeasureTs);
+    Varint::addSigned(out, (current + 5) / 10 - (lastCurrent + 5) / 10);
+    Varint::addSigned(out, (voltage + 10) / 20 - (lastVoltage + 10) / 20);
+  }
+};
+
+static bool decodeV1(const std::vector<uint8_t> &data, Curve *curve)
+{
+  const uint8_t *ptr = data.data();
+  const uint8_t *end = ptr + data.size();
+  uint32_t version, currentHyst, voltageHyst;
+  if (!Varint::decode(ptr, end, &version) || version != 1
+      || !Varint::decode(ptr, end, &currentHyst) || !Varint::decode(ptr, end, &voltageHyst)) {
+    return false;
+  }
+  curve->isInterpolated = false;
+  curve->isTruncated = false;
+  Sample p = { 0, 0, 0 };
+  while (ptr != end) {
+    uint32_t tsDelta, measureDelta;
+    int32_t c, v;
+    if (!Varint::decode(ptr, end, &tsDelta) || !Varint::decode(ptr, end, &measureDelta)
+        || !Varint::decodeSigned(ptr, end, &c) || !Varint::decodeSigned(ptr, end, &v)) {
+      return false;
+    }
+    if (c == 999999) {
+      // the entries after it are the sample that ended the profile, not part of it
+      curve->isTruncated = true;
+      break;
+    }
+    p.ts += tsDelta;
+    p.current += c * 10;
+    p.voltage += v * 20;
+    curve->points.push_back(p);
+  }
+  return !curve->points.empty();
+}
+
+static bool decodeV2(const std::vector<uint8_t> &data, Curve *curve)
+{
+  LoadProfileDecoder decoder(data.data(), data.size());
+  LoadProfileDecoder::Point p;
+  while (decoder.next(&p)) {
+    curve->points.push_back({ p.ts, p.current, p.voltage });
+  }
+  curve->isInterpolated = true;
+  curve->isTruncated = decoder.isTruncated();
+  return decoder.isValid() && !curve->points.empty();
+}
+
+static Sample valueAt(const Curve &curve, uint32_t ts)
+{
+  const std::vector<Sample> &p = curve.points;
+  auto next = std::upper_bound(p.begin(), p.end(), ts, [](uint32_t ts, const Sample &s) { return ts < s.ts; });
+  if (next == p.begin()) {
+    return p.front();
+  }
+  if (next == p.end() || !curve.isInterpolated) {
+    return *(next - 1);
+  }
+  const Sample &a = *(next - 1);
+  const Sample &b = *next;
+  double f = (double)(ts - a.ts) / (b.ts - a.ts);
+  return { ts, (int32_t)lround(a.current + (b.current - a.current) * f),
+    (int32_t)lround(a.voltage + (b.voltage - a.voltage) * f) };
+}
+
+// of the samples up to ts
+static Error measureError(const Curve &curve, const std::vector<Sample> &samples, uint32_t ts)
+{
+  Error e;
+  for (const Sample &s : samples) {
+    if (s.ts > ts) {
+      break;
+    }
+    Sample r = valueAt(curve, s.ts);
+    double dc = fabs((double)r.current - s.current);
+    double dv = fabs((double)r.voltage - s.voltage);
+    e.currentMax = std::max(e.currentMax, dc);
+    e.voltageMax = std::max(e.voltageMax, dv);
+    e.currentSquares += dc * dc;
+    e.voltageSquares += dv * dv;
+    ++e.count;
+  }
+  return e;
+}
+
+static void printRow(const char *label, size_t size, size_t rawSize, const Curve &curve, const Error &e)
+{
+  printf("  %-22s %6u %7.1f %7u %9.1f %8.1f %9.1f %8.1f%s\n", label, (unsigned)size, (double)rawSize / size,
+    (unsigned)curve.points.size(), e.currentMax, e.currentRms(), e.voltageMax, e.voltageRms(),
+    curve.isTruncated ? "  truncated" : "");
+}
+
+static bool runProfile(const std::string &path, int currentMaxError, int voltageMaxError, float hystPct)
+{
+  std::vector<Sample> samples;
+  if (!readProfile(path, &samples)) {
+    return false;
+  }
+  const Sample &last = samples.back();
+  uint32_t snapshotTs = last.ts - 4000; // readLoadProfile, 1 s after turning off
+  size_t rawSize = samples.size() * 8;
+  std::string name = path.substr(path.rfind('/') + 1);
+  printf("%s: %u samples over %.1f s, %u bytes raw\n", name.c_str(), (unsigned)samples.size(),
+    last.ts / 1000.0, (unsigned)rawSize);
+  printf("  %-22s %6s %7s %7s %9s %8s %9s %8s\n", "", "bytes", "ratio", "points",
+    "max mA", "rms mA", "max mV", "rms mV");
+
+  std::vector<uint8_t> v1;
+  V1Encoder v1Encoder(v1, hystPct);
+  std::vector<uint8_t> v2;
+  LoadProfileEncoder v2Encoder(v2);
+  v2Encoder.begin(0, currentMaxError, voltageMaxError, 1024);
+  std::vector<uint8_t> snapshot;
+  for (size_t i = 0; i + 1 < samples.size(); i++) {
+    const Sample &s = samples[i];
+    v1Encoder.add(s.ts, s.current, s.voltage);
+    v2Encoder.add(s.ts, s.current, s.voltage);
+    if (s.ts <= snapshotTs && samples[i + 1].ts > snapshotTs) {
+      v2Encoder.snapshot(&snapshot);
+    }
+  }
+  v1Encoder.finish(last.ts, last.current, last.voltage);
+  v2Encoder.add(last.ts, last.current, last.voltage);
+  v2Encoder.finish();
+
+  bool ok = true;
+  Curve v1Curve, v2Curve, snapshotCurve;
+  if (!decodeV1(v1, &v1Curve) || !decodeV2(v2, &v2Curve) || !decodeV2(snapshot, &snapshotCurve)) {
+    printf("  a profile doesn't decode\n");
+    return false;
+  }
+  Error v1Error = measureError(v1Curve, samples, last.ts);
+  Error v2Error = measureError(v2Curve, samples, last.ts);
+  Error snapshotError = measureError(snapshotCurve, samples, snapshotTs);
+  char label[32];
+  snprintf(label, sizeof(label), "v1, %.0f%% deadband", hystPct);
+  printRow(label, v1.size(), rawSize, v1Curve, v1Error);
+  snprintf(label, sizeof(label), "v2, %d mA / %d mV", currentMaxError, voltageMaxError);
+  printRow(label, v2.size(), rawSize, v2Curve, v2Error);
+  printRow("v2 snapshot at off +1s", snapshot.size(), rawSize, snapshotCurve, snapshotError);
+  printf("  v2 is %.1f%% of v1\n", 100.0 * v2.size() / v1.size());
+
+  if (!v2Curve.isTruncated && (v2Error.currentMax > currentMaxError || v2Error.voltageMax > voltageMaxError)) {
+    printf("  v2 exceeds its max errors\n");
+    ok = false;
+  }
+  if (!snapshotCurve.isTruncated
+      && (snapshotError.currentMax > currentMaxError || snapshotError.voltageMax > voltageMaxError)) {
+    printf("  the snapshot exceeds the max errors\n");
+    ok = false;
+  }
+  // the same profile without taking the snapshot
+  std::vector<uint8_t> plain;
+  LoadProfileEncoder plainEncoder(plain);
+  plainEncoder.begin(0, currentMaxError, voltageMaxError, 1024);
+  for (const Sample &s : samples) {
+    plainEncoder.add(s.ts, s.current, s.voltage);
+  }
+  plainEncoder.finish();
+  if (plain != v2) {
+    printf("  taking the snapshot changed the profile\n");
+    ok = false;
+  }
+  return ok;
+}
+
+int main(int argc, char **argv)
+{
+  int currentMaxError = 50; // the defaults of prot.profileCurrentMaxError and prot.profileVoltageMaxError
+  int voltageMaxError = 40;
+  float hystPct = 2; // the default of the former prot.currentProfileHysteresisPct
+  int c;
+  while ((c = getopt(argc, argv, "i:u:p:")) != -1) {
+    switch (c) {
+      case 'i': currentMaxError = atoi(optarg); break;
+      case 'u': voltageMaxError = atoi(optarg); break;
+      case 'p': hystPct = atof(optarg); break;
+      default:
+        fprintf(stderr, "Usage: %s [-i currentMaxError] [-u voltageMaxError] [-p hysteresisPct] [profile.csv ...]\n", argv[0]);
+        return 2;
+    }
+  }
+  std::vector<std::string> paths(argv + optind, argv + argc);
+  if (paths.empty()) {
+    DIR *dir = opendir(LOAD_PROFILES);
+    if (dir == nullptr) {
+      printf("Cannot list %s\n", LOAD_PROFILES);
+      return 1;
+    }
+    for (struct dirent *e; (e = readdir(dir)) != nullptr; ) {
+      size_t len = strlen(e->d_name);
+      if (len > 4 && strcmp(e->d_name + len - 4, ".csv") == 0) {
+        paths.push_back(std::string(LOAD_PROFILES "/") + e->d_name);
+      }
+    }
+    closedir(dir);
+    std::sort(paths.begin(), paths.end());
+  }
+
+  bool ok = true;
+  for (const std::string &path : paths) {
+    ok = runProfile(path, currentMaxError, voltageMaxError, hystPct) && ok;
+    printf("\n");
+  }
+  printf("%s\n", ok ? "OK" : "FAILED");
+  return ok ? 0 : 1;
+}
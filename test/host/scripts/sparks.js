@@ -0,0 +1,76 @@
+// Sparks, as the native "spark" controller: each led waits a random time with an exponential
+// distribution, then sparks with an attack, a full value and a decay, its hue drifting from
+// one of two base hues. Used by led_script_bench against the native effect.
+
+var SPARK_FRAMES = 16, ATTACK_FRAMES = 3, FULL_FRAMES = 1, DECAY_FRAMES = 12;
+var MEAN_OFF_FRAMES = 64;
+var HUE1 = 20, HUE2 = 150, SAT = 220, HIGH_DELTA = 16;
+
+var attack = [], decay = [];
+for (var f = 0; f < ATTACK_FRAMES; f++) {
+  attack.push(Math.round(255 * Math.pow((f + 1) / ATTACK_FRAMES, 2)));
+}
+for (f = 0; f < DECAY_FRAMES; f++) {
+  decay.push(Math.round(255 * Math.pow(1 - f / DECAY_FRAMES, 2)));
+}
+
+var lastOn = null, baseHue = null;
+var rgb = [0, 0, 0];
+
+function offFrames() {
+  return Math.floor(-Math.log(1 - Math.random()) * MEAN_OFF_FRAMES);
+}
+
+// rainbow-less hsv to rgb, hue, sat and val in 0..255
+function hsv2rgb(h, s, v) {
+  var region = Math.floor(h / 43), rem = (h - region * 43) * 6;
+  var p = (v * (255 - s)) >> 8;
+  var q = (v * (255 - ((s * rem) >> 8))) >> 8;
+  var t = (v * (255 - ((s * (255 - rem)) >> 8))) >> 8;
+  switch (region) {
+    case 0: rgb[0] = v; rgb[1] = t; rgb[2] = p; break;
+    case 1: rgb[0] = q; rgb[1] = v; rgb[2] = p; break;
+    case 2: rgb[0] = p; rgb[1] = v; rgb[2] = t; break;
+    case 3: rgb[0] = p; rgb[1] = q; rgb[2] = v; break;
+    case 4: rgb[0] = t; rgb[1] = p; rgb[2] = v; break;
+    default: rgb[0] = v; rgb[1] = p; rgb[2] = q; break;
+  }
+}
+
+function render(leds, frame, millis) {
+  var count = leds.length / 3;
+  if (lastOn === null || lastOn.length !== count) {
+    lastOn = new Int32Array(count);
+    baseHue = new Uint8Array(count);
+    for (var i = 0; i < count; i++) {
+      lastOn[i] = frame + Math.floor(Math.random() * SPARK_FRAMES) + offFrames();
+      baseHue[i] = Math.random() < 0.5 ? HUE1 : HUE2;
+    }
+  }
+  for (var i = 0; i < count; i++) {
+    var f = frame - lastOn[i];
+    if (f < 0) {
+      continue;
+    }
+    if (f >= SPARK_FRAMES) {
+      lastOn[i] = frame + offFrames();
+      continue;
+    }
+    var val, hue;
+    if (f < ATTACK_FRAMES) {
+      val = attack[f];
+      hue = baseHue[i] + ((HIGH_DELTA * f / ATTACK_FRAMES) | 0);
+    } else if (f < ATTACK_FRAMES + FULL_FRAMES) {
+      val = 255;
+      hue = baseHue[i] + HIGH_DELTA;
+    } else {
+      var d = f - ATTACK_FRAMES - FULL_FRAMES;
+      val = decay[d];
+      hue = baseHue[i] + ((HIGH_DELTA * (DECAY_FRAMES - d) / DECAY_FRAMES) | 0);
+    }
+    hsv2rgb(hue & 255, SAT, val);
+    leds[3 * i] = rgb[0];
+    leds[3 * i + 1] = rgb[1];
+    leds[3 * i + 2] = rgb[2];
+  }
+}
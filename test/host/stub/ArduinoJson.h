@@ -0,0 +1,327 @@
+// Host stand-in for the subset of ArduinoJson 5 used by the services: JsonBuffer, JsonObject,
+// JsonArray and JsonVariant, with the same conversions, "|" defaults and parsing leniency
+// (comments, unquoted keys, single quotes). Objects, arrays and strings live in their buffer.
+#ifndef HOST_ARDUINO_JSON_H
+#define HOST_ARDUINO_JSON_H
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <deque>
+#include <string>
+#include <vector>
+#include "WString.h"
+#include "Stream.h"
+
+class JsonBuffer;
+class JsonObject;
+class JsonArray;
+class JsonVariant;
+
+namespace HostJson {
+    template<typename T> struct As { typedef T type; };
+    template<> struct As<JsonObject> { typedef JsonObject &type; };
+    template<> struct As<JsonObject &> { typedef JsonObject &type; };
+    template<> struct As<JsonArray> { typedef JsonArray &type; };
+    template<> struct As<JsonArray &> { typedef JsonArray &type; };
+    template<> struct As<char *> { typedef const char *type; };
+    void print(const JsonVariant &v, std::string &out, int indent);
+}
+
+class JsonVariant {
+public:
+    enum Type { UNDEFINED, NUL, BOOL, INTEGER, FLOAT, STRING, OBJECT, ARRAY };
+protected:
+    Type type;
+    union {
+        bool asBool;
+        long long asInteger;
+        double asFloat;
+        const char *asString;
+        JsonObject *asObject;
+        JsonArray *asArray;
+    };
+    friend void HostJson::print(const JsonVariant &v, std::string &out, int indent);
+    friend class JsonBuffer;
+    friend class JsonObject;
+    friend class JsonArray;
+
+    long long toInteger() const;
+    double toFloat() const;
+    const char *toString() const { return type == STRING ? asString : nullptr; }
+    JsonObject &toObject() const;
+    JsonArray &toArray() const;
+
+    template<typename T> bool isType(const T *) const { return false; }
+    bool isType(const int *) const { return type == INTEGER; }
+    bool isType(const unsigned int *) const { return type == INTEGER; }
+    bool isType(const long *) const { return type == INTEGER; }
+    bool isType(const unsigned long *) const { return type == INTEGER; }
+    bool isType(const long long *) const { return type == INTEGER; }
+    bool isType(const unsigned long long *) const { return type == INTEGER; }
+    bool isType(const short *) const { return type == INTEGER; }
+    bool isType(const unsigned short *) const { return type == INTEGER; }
+    bool isType(const signed char *) const { return type == INTEGER; }
+    bool isType(const unsigned char *) const { return type == INTEGER; }
+    bool isType(const float *) const { return type == INTEGER || type == FLOAT; }
+    bool isType(const double *) const { return type == INTEGER || type == FLOAT; }
+    bool isType(const bool *) const { return type == BOOL; }
+    bool isType(const char *const *) const { return type == STRING; }
+    bool isType(char *const *) const { return type == STRING; }
+    bool isType(const String *) const { return type == STRING; }
+    bool isType(const JsonObject *) const { return type == OBJECT; }
+    bool isType(const JsonArray *) const { return type == ARRAY; }
+
+    void get(int *v) const { *v = (int)toInteger(); }
+    void get(unsigned int *v) const { *v = (unsigned int)toInteger(); }
+    void get(long *v) const { *v = (long)toInteger(); }
+    void get(unsigned long *v) const { *v = (unsigned long)toInteger(); }
+    void get(long long *v) const { *v = toInteger(); }
+    void get(unsigned long long *v) const { *v = (unsigned long long)toInteger(); }
+    void get(short *v) const { *v = (short)toInteger(); }
+    void get(unsigned short *v) const { *v = (unsigned short)toInteger(); }
+    void get(signed char *v) const { *v = (signed char)toInteger(); }
+    void get(unsigned char *v) const { *v = (unsigned char)toInteger(); }
+    void get(float *v) const { *v = (float)toFloat(); }
+    void get(double *v) const { *v = toFloat(); }
+    void get(bool *v) const { *v = (type == BOOL ? asBool : toInteger() != 0); }
+    void get(const char **v) const { *v = toString(); }
+    void get(String *v) const;
+    void get(JsonVariant *v) const { *v = *this; }
+
+public:
+    JsonVariant() : type(UNDEFINED) { asInteger = 0; }
+    JsonVariant(const JsonVariant &other) = default;
+    JsonVariant &operator=(const JsonVariant &other) = default;
+    JsonVariant(std::nullptr_t) : type(NUL) { asInteger = 0; }
+    JsonVariant(bool v) : type(BOOL) { asBool = v; }
+    JsonVariant(char v) : type(INTEGER) { asInteger = v; }
+    JsonVariant(signed char v) : type(INTEGER) { asInteger = v; }
+    JsonVariant(unsigned char v) : type(INTEGER) { asInteger = v; }
+    JsonVariant(short v) : type(INTEGER) { asInteger = v; }
+    JsonVariant(unsigned short v) : type(INTEGER) { asInteger = v; }
+    JsonVariant(int v) : type(INTEGER) { asInteger = v; }
+    JsonVariant(unsigned int v) : type(INTEGER) { asInteger = v; }
+    JsonVariant(long v) : type(INTEGER) { asInteger = v; }
+    JsonVariant(unsigned long v) : type(INTEGER) { asInteger = v; }
+    JsonVariant(long long v) : type(INTEGER) { asInteger = v; }
+    JsonVariant(unsigned long long v) : type(INTEGER) { asInteger = (long long)v; }
+    JsonVariant(float v) : type(FLOAT) { asFloat = v; }
+    JsonVariant(double v) : type(FLOAT) { asFloat = v; }
+    // strings are not copied, unless stored in an object or array
+    JsonVariant(const char *v) : type(v == nullptr ? NUL : STRING) { asString = v; }
+    JsonVariant(const String &v) : type(STRING) { asString = v.c_str(); }
+    JsonVariant(JsonObject &v);
+    JsonVariant(JsonArray &v);
+
+    bool success() const { return type != UNDEFINED; }
+    bool operator!() const { return type == UNDEFINED || type == NUL; }
+    template<typename T> bool is() const { return isType((const T *)nullptr); }
+    template<typename T> typename HostJson::As<T>::type as() const { typename HostJson::As<T>::type v = convert<T>(); return v; }
+    template<typename T> operator T() const { T v; get(&v); return v; }
+    operator JsonObject &() const { return toObject(); }
+    operator JsonArray &() const { return toArray(); }
+
+    // value of the variant if it has the type of the default, otherwise the default
+    const char *operator|(const char *def) const { return type == STRING ? asString : def; }
+    int operator|(int def) const { return type == INTEGER || type == FLOAT ? (int)toInteger() : def; }
+    long operator|(long def) const { return type == INTEGER || type == FLOAT ? (long)toInteger() : def; }
+    unsigned int operator|(unsigned int def) const { return type == INTEGER || type == FLOAT ? (unsigned int)toInteger() : def; }
+    float operator|(float def) const { return type == INTEGER || type == FLOAT ? (float)toFloat() : def; }
+    double operator|(double def) const { return type == INTEGER || type == FLOAT ? toFloat() : def; }
+    bool operator|(bool def) const { return type == BOOL ? asBool : def; }
+
+    JsonVariant operator[](int index) const;
+    JsonVariant operator[](const char *key) const;
+    JsonVariant operator[](const String &key) const { return (*this)[key.c_str()]; }
+    size_t size() const;
+
+    size_t printTo(char *buffer, size_t bufferSize) const;
+    size_t printTo(String &str) const;
+    size_t printTo(Print &p) const;
+    size_t prettyPrintTo(char *buffer, size_t bufferSize) const;
+    size_t prettyPrintTo(String &str) const;
+    size_t prettyPrintTo(Print &p) const;
+    size_t measureLength() const { String s; return printTo(s); }
+    size_t measurePrettyLength() const { String s; return prettyPrintTo(s); }
+
+private:
+    template<typename T> typename HostJson::As<T>::type convert() const { T v; get(&v); return v; }
+};
+
+template<> inline JsonObject &JsonVariant::convert<JsonObject>() const { return toObject(); }
+template<> inline JsonObject &JsonVariant::convert<JsonObject &>() const { return toObject(); }
+template<> inline JsonArray &JsonVariant::convert<JsonArray>() const { return toArray(); }
+template<> inline JsonArray &JsonVariant::convert<JsonArray &>() const { return toArray(); }
+template<> inline const char *JsonVariant::convert<char *>() const { return toString(); }
+
+struct JsonPair {
+    const char *key;
+    JsonVariant value;
+};
+
+class JsonObject {
+    friend class JsonBuffer;
+    friend class JsonVariant;
+    JsonBuffer *buffer;
+    std::vector<JsonPair> members;
+    JsonPair *find(const char *key);
+    const JsonPair *find(const char *key) const;
+public:
+    class Subscript;
+
+    explicit JsonObject(JsonBuffer *buffer) : buffer(buffer) {}
+    static JsonObject &invalid() { static JsonObject obj(nullptr); return obj; }
+    bool success() const { return buffer != nullptr; }
+    size_t size() const { return members.size(); }
+    bool containsKey(const char *key) const { return find(key) != nullptr; }
+    bool containsKey(const String &key) const { return containsKey(key.c_str()); }
+    void remove(const char *key);
+    void remove(const String &key) { remove(key.c_str()); }
+
+    bool set(const char *key, const JsonVariant &value);
+    bool set(const String &key, const JsonVariant &value) { return set(key.c_str(), value); }
+    JsonVariant get(const char *key) const { const JsonPair *p = find(key); return p == nullptr ? JsonVariant() : p->value; }
+    template<typename T> typename HostJson::As<T>::type get(const char *key) const { return get(key).as<T>(); }
+    template<typename T> bool is(const char *key) const { return get(key).is<T>(); }
+    JsonObject &createNestedObject(const char *key);
+    JsonObject &createNestedObject(const String &key) { return createNestedObject(key.c_str()); }
+    JsonArray &createNestedArray(const char *key);
+    JsonArray &createNestedArray(const String &key) { return createNestedArray(key.c_str()); }
+
+    Subscript operator[](const char *key);
+    Subscript operator[](const String &key);
+    JsonVariant operator[](const char *key) const { return get(key); }
+    JsonVariant operator[](const String &key) const { return get(key.c_str()); }
+
+    typedef std::vector<JsonPair>::iterator iterator;
+    typedef std::vector<JsonPair>::const_iterator const_iterator;
+    iterator begin() { return members.begin(); }
+    iterator end() { return members.end(); }
+    const_iterator begin() const { return members.begin(); }
+    const_iterator end() const { return members.end(); }
+
+    size_t printTo(char *buffer, size_t bufferSize) const { return JsonVariant(const_cast<JsonObject &>(*this)).printTo(buffer, bufferSize); }
+    size_t printTo(String &str) const { return JsonVariant(const_cast<JsonObject &>(*this)).printTo(str); }
+    size_t printTo(Print &p) const { return JsonVariant(const_cast<JsonObject &>(*this)).printTo(p); }
+    size_t prettyPrintTo(char *buffer, size_t bufferSize) const { return JsonVariant(const_cast<JsonObject &>(*this)).prettyPrintTo(buffer, bufferSize); }
+    size_t prettyPrintTo(String &str) const { return JsonVariant(const_cast<JsonObject &>(*this)).prettyPrintTo(str); }
+    size_t prettyPrintTo(Print &p) const { return JsonVariant(const_cast<JsonObject &>(*this)).prettyPrintTo(p); }
+    size_t measureLength() const { String s; return printTo(s); }
+};
+
+class JsonArray {
+    friend class JsonBuffer;
+    friend class JsonVariant;
+    JsonBuffer *buffer;
+    std::vector<JsonVariant> elements;
+public:
+    class Subscript;
+
+    explicit JsonArray(JsonBuffer *buffer) : buffer(buffer) {}
+    static JsonArray &invalid() { static JsonArray arr(nullptr); return arr; }
+    bool success() const { return buffer != nullptr; }
+    size_t size() const { return elements.size(); }
+    bool add(const JsonVariant &value);
+    bool set(size_t index, const JsonVariant &value);
+    JsonVariant get(size_t index) const { return index < elements.size() ? elements[index] : JsonVariant(); }
+    template<typename T> typename HostJson::As<T>::type get(size_t index) const { return get(index).as<T>(); }
+    template<typename T> bool is(size_t index) const { return get(index).is<T>(); }
+    void remove(size_t index) { if (index < elements.size()) elements.erase(elements.begin() + index); }
+    JsonObject &createNestedObject();
+    JsonArray &createNestedArray();
+    template<typename T, size_t N> bool copyFrom(T (&array)[N]) { for (size_t i = 0; i < N; i++) add(array[i]); return true; }
+    template<typename T, size_t N> size_t copyTo(T (&array)[N]) const {
+        size_t i = 0;
+        for (; i < N && i < elements.size(); i++) array[i] = elements[i].as<T>();
+        return i;
+    }
+
+    Subscript operator[](size_t index);
+    JsonVariant operator[](size_t index) const { return get(index); }
+
+    typedef std::vector<JsonVariant>::iterator iterator;
+    typedef std::vector<JsonVariant>::const_iterator const_iterator;
+    iterator begin() { return elements.begin(); }
+    iterator end() { return elements.end(); }
+    const_iterator begin() const { return elements.begin(); }
+    const_iterator end() const { return elements.end(); }
+
+    size_t printTo(char *buffer, size_t bufferSize) const { return JsonVariant(const_cast<JsonArray &>(*this)).printTo(buffer, bufferSize); }
+    size_t printTo(String &str) const { return JsonVariant(const_cast<JsonArray &>(*this)).printTo(str); }
+    size_t printTo(Print &p) const { return JsonVariant(const_cast<JsonArray &>(*this)).printTo(p); }
+    size_t prettyPrintTo(char *buffer, size_t bufferSize) const { return JsonVariant(const_cast<JsonArray &>(*this)).prettyPrintTo(buffer, bufferSize); }
+    size_t prettyPrintTo(String &str) const { return JsonVariant(const_cast<JsonArray &>(*this)).prettyPrintTo(str); }
+    size_t prettyPrintTo(Print &p) const { return JsonVariant(const_cast<JsonArray &>(*this)).prettyPrintTo(p); }
+    size_t measureLength() const { String s; return printTo(s); }
+};
+
+// obj["key"], that can be read as a variant or assigned
+class JsonObject::Subscript : public JsonVariant {
+    JsonObject *object;
+    const char *key;
+public:
+    Subscript(JsonObject *object, const char *key) : JsonVariant(object->get(key)), object(object), key(key) {}
+    Subscript &operator=(const JsonVariant &value) { object->set(key, value); JsonVariant::operator=(object->get(key)); return *this; }
+    Subscript &operator=(const Subscript &other) { return operator=((const JsonVariant &)other); }
+    template<typename T> bool set(const T &value) { operator=(JsonVariant(value)); return true; }
+};
+
+class JsonArray::Subscript : public JsonVariant {
+    JsonArray *array;
+    size_t index;
+public:
+    Subscript(JsonArray *array, size_t index) : JsonVariant(array->get(index)), array(array), index(index) {}
+    Subscript &operator=(const JsonVariant &value) { array->set(index, value); JsonVariant::operator=(array->get(index)); return *this; }
+    Subscript &operator=(const Subscript &other) { return operator=((const JsonVariant &)other); }
+    template<typename T> bool set(const T &value) { operator=(JsonVariant(value)); return true; }
+};
+
+inline JsonObject::Subscript JsonObject::operator[](const char *key) { return Subscript(this, key); }
+inline JsonArray::Subscript JsonArray::operator[](size_t index) { return Subscript(this, index); }
+
+class JsonBuffer {
+    std::deque<JsonObject> objects;
+    std::deque<JsonArray> arrays;
+    std::deque<std::string> strings;
+    friend class JsonObject;
+    friend class JsonArray;
+
+    JsonVariant parseValue(const char *&p, int depth);
+    JsonVariant store(const JsonVariant &v);
+public:
+    JsonBuffer() {}
+    JsonBuffer(const JsonBuffer &) = delete;
+    virtual ~JsonBuffer() {}
+
+    JsonObject &createObject() { objects.emplace_back(this); return objects.back(); }
+    JsonArray &createArray() { arrays.emplace_back(this); return arrays.back(); }
+    const char *strdup(const char *s) { strings.emplace_back(s); return strings.back().c_str(); }
+    const char *strdup(const String &s) { return strdup(s.c_str()); }
+
+    JsonVariant parse(const char *json, uint8_t nestingLimit = 10);
+    JsonVariant parse(const String &json, uint8_t nestingLimit = 10) { return parse(json.c_str(), nestingLimit); }
+    JsonVariant parse(Stream &json, uint8_t nestingLimit = 10) { String s = json.readString(); return parse(s.c_str(), nestingLimit); }
+    template<typename T> JsonObject &parseObject(T &json, uint8_t nestingLimit = 10) {
+        JsonVariant v = parse(json, nestingLimit);
+        return v.as<JsonObject>();
+    }
+    JsonObject &parseObject(const char *json, uint8_t nestingLimit = 10) { return parse(json, nestingLimit).as<JsonObject>(); }
+    template<typename T> JsonArray &parseArray(T &json, uint8_t nestingLimit = 10) {
+        JsonVariant v = parse(json, nestingLimit);
+        return v.as<JsonArray>();
+    }
+    JsonArray &parseArray(const char *json, uint8_t nestingLimit = 10) { return parse(json, nestingLimit).as<JsonArray>(); }
+    size_t size() const { return objects.size() * sizeof(JsonObject) + arrays.size() * sizeof(JsonArray) + strings.size() * 16; }
+    void clear() { objects.clear(); arrays.clear(); strings.clear(); }
+};
+
+class DynamicJsonBuffer : public JsonBuffer {
+public:
+    DynamicJsonBuffer(size_t initialSize = 256) {}
+};
+
+template<size_t CAPACITY> class StaticJsonBuffer : public JsonBuffer {
+};
+
+#endif
@@ -0,0 +1,87 @@
+// Host stand-in for the arduino-esp32 FS API, on files under a host directory: each file system
+// (SPIFFS, LITTLEFS) maps its root to a directory given with setHostRoot(). A file system made
+// from an FSImpl (see FSImpl.h) goes through it instead, as in arduino-esp32.
+#ifndef HOST_FS_H
+#define HOST_FS_H
+
+#include <stdio.h>
+#include <memory>
+#include <string>
+#include <vector>
+#include "Stream.h"
+
+namespace fs {
+
+enum SeekMode { SeekSet = 0, SeekCur = 1, SeekEnd = 2 };
+
+struct FileState;
+class FileImpl;
+typedef std::shared_ptr<FileImpl> FileImplPtr;
+class FSImpl;
+typedef std::shared_ptr<FSImpl> FSImplPtr;
+
+class File : public Stream {
+    std::shared_ptr<FileState> state;
+    FileImplPtr impl;
+public:
+    File() {}
+    File(std::shared_ptr<FileState> state) : state(state) {}
+    File(FileImplPtr impl) : impl(impl) {}
+
+    size_t write(uint8_t c) override;
+    size_t write(const uint8_t *buf, size_t size) override;
+    using Print::write;
+    int available() override;
+    int read() override;
+    int peek() override;
+    void flush() override;
+    size_t read(uint8_t *buf, size_t size);
+    size_t readBytes(char *buffer, size_t length) override { return read((uint8_t *)buffer, length); }
+    bool seek(uint32_t pos, SeekMode mode);
+    bool seek(uint32_t pos) { return seek(pos, SeekSet); }
+    size_t position() const;
+    size_t size() const;
+    void close();
+    operator bool() const;
+    const char *name() const;
+    bool isDirectory() const;
+    File openNextFile(const char *mode = "r");
+    void rewindDirectory();
+};
+
+class FS {
+protected:
+    std::string root;
+    std::string hostPath(const char *path) const;
+    FSImplPtr _impl;
+public:
+    FS() : root(".") {}
+    FS(FSImplPtr impl) : root("."), _impl(impl) {}
+    // host only: the directory of the root of this file system, created if needed
+    void setHostRoot(const char *dir);
+    const char *getHostRoot() const { return root.c_str(); }
+
+    File open(const char *path, const char *mode = "r");
+    File open(const String &path, const char *mode = "r") { return open(path.c_str(), mode); }
+    bool exists(const char *path);
+    bool exists(const String &path) { return exists(path.c_str()); }
+    bool remove(const char *path);
+    bool remove(const String &path) { return remove(path.c_str()); }
+    bool rename(const char *pathFrom, const char *pathTo);
+    bool rename(const String &pathFrom, const String &pathTo) { return rename(pathFrom.c_str(), pathTo.c_str()); }
+    bool mkdir(const char *path);
+    bool mkdir(const String &path) { return mkdir(path.c_str()); }
+    bool rmdir(const char *path);
+    bool rmdir(const String &path) { return rmdir(path.c_str()); }
+};
+
+} // namespace fs
+
+using fs::FS;
+using fs::File;
+using fs::SeekMode;
+using fs::SeekSet;
+using fs::SeekCur;
+using fs::SeekEnd;
+
+#endif
@@ -0,0 +1,292 @@
+// Host stand-in for FastLED: the pixel types and the 8-bit math used by the effects, with the
+// same rounding as FastLED 3.x. FastLED.show() sends nothing, it calls the handler given to
+// FastLED.setHostShowHandler(), with the leds of all the controllers in order.
+#ifndef HOST_FASTLED_H
+#define HOST_FASTLED_H
+
+#include <stdint.h>
+#include <string.h>
+#include <functional>
+#include <vector>
+#include "Arduino.h"
+
+typedef uint8_t fract8;
+typedef uint16_t fract16;
+
+inline uint8_t qadd8(uint8_t i, uint8_t j) { unsigned t = i + j; return t > 255 ? 255 : t; }
+inline uint8_t qsub8(uint8_t i, uint8_t j) { int t = i - j; return t < 0 ? 0 : t; }
+inline uint8_t qmul8(uint8_t i, uint8_t j) { unsigned p = (unsigned)i * j; return p > 255 ? 255 : p; }
+inline uint8_t scale8(uint8_t i, fract8 scale) { return ((uint16_t)i * (1 + (uint16_t)scale)) >> 8; }
+inline uint8_t scale8_video(uint8_t i, fract8 scale) { return (((int)i * (int)scale) >> 8) + ((i && scale) ? 1 : 0); }
+inline uint16_t scale16(uint16_t i, fract16 scale) { return ((uint32_t)i * (1 + (uint32_t)scale)) >> 16; }
+inline uint16_t scale16by8(uint16_t i, fract8 scale) { return (i * (1 + (uint16_t)scale)) >> 8; }
+inline uint8_t dim8_raw(uint8_t x) { return scale8(x, x); }
+inline uint8_t dim8_video(uint8_t x) { return scale8_video(x, x); }
+inline uint8_t brighten8_raw(uint8_t x) { uint8_t ix = 255 - x; return 255 - scale8(ix, ix); }
+inline uint8_t brighten8_video(uint8_t x) { uint8_t ix = 255 - x; return 255 - scale8_video(ix, ix); }
+inline uint8_t lerp8by8(uint8_t a, uint8_t b, fract8 frac) {
+    return b > a ? a + scale8(b - a, frac) : a - scale8(a - b, frac);
+}
+inline uint8_t ease8InOutQuad(uint8_t i) {
+    uint8_t j = i;
+    if (j & 0x80) j = 255 - j;
+    uint8_t jj = scale8(j, j);
+    uint8_t jj2 = jj << 1;
+    if (i & 0x80) jj2 = 255 - jj2;
+    return jj2;
+}
+inline int16_t sin16(uint16_t theta) {
+    static const uint16_t base[] = { 0, 6393, 12539, 18204, 23170, 27245, 30273, 32137 };
+    static const uint8_t slope[] = { 49, 48, 44, 38, 31, 23, 14, 4 };
+    uint16_t offset = (theta & 0x3FFF) >> 3;
+    if (theta & 0x4000) offset = 2047 - offset;
+    uint8_t section = offset / 256;
+    uint16_t b = base[section];
+    uint8_t m = slope[section];
+    uint8_t secoffset8 = (uint8_t)(offset) / 2;
+    uint16_t mx = m * secoffset8;
+    int16_t y = mx + b;
+    if (theta & 0x8000) y = -y;
+    return y;
+}
+inline int16_t cos16(uint16_t theta) { return sin16(theta + 16384); }
+inline uint8_t sin8(uint8_t theta) {
+    static const uint8_t b_m16_interleave[] = { 0, 49, 49, 41, 90, 27, 117, 10 };
+    uint8_t offset = theta;
+    if (theta & 0x40) offset = (uint8_t)255 - offset;
+    offset &= 0x3F;
+    uint8_t secoffset = offset & 0x0F;
+    if (theta & 0x40) ++secoffset;
+    uint8_t section = offset >> 4;
+    uint8_t s2 = section * 2;
+    uint8_t b = b_m16_interleave[s2];
+    uint8_t m16 = b_m16_interleave[s2 + 1];
+    uint8_t mx = (m16 * secoffset) >> 4;
+    int8_t y = mx + b;
+    if (theta & 0x80) y = -y;
+    y += 128;
+    return y;
+}
+inline uint8_t cos8(uint8_t theta) { return sin8(theta + 64); }
+inline uint8_t random8() { return esp_random() & 0xff; }
+inline uint8_t random8(uint8_t lim) { return (random8() * lim) >> 8; }
+inline uint8_t random8(uint8_t min, uint8_t lim) { return min + random8(lim - min); }
+inline uint16_t random16() { return esp_random() & 0xffff; }
+inline uint16_t random16(uint16_t lim) { return ((uint32_t)random16() * lim) >> 16; }
+
+struct CHSV {
+    union {
+        struct { union { uint8_t hue; uint8_t h; }; union { uint8_t saturation; uint8_t sat; uint8_t s; };
+                 union { uint8_t value; uint8_t val; uint8_t v; }; };
+        uint8_t raw[3];
+    };
+    CHSV() : h(0), s(0), v(0) {}
+    CHSV(uint8_t ih, uint8_t is, uint8_t iv) : h(ih), s(is), v(iv) {}
+    CHSV &setHSV(uint8_t ih, uint8_t is, uint8_t iv) { h = ih; s = is; v = iv; return *this; }
+};
+
+struct CRGB;
+void hsv2rgb_rainbow(const CHSV &hsv, CRGB &rgb);
+void hsv2rgb_spectrum(const CHSV &hsv, CRGB &rgb);
+
+struct CRGB {
+    union {
+        struct { union { uint8_t r; uint8_t red; }; union { uint8_t g; uint8_t green; }; union { uint8_t b; uint8_t blue; }; };
+        uint8_t raw[3];
+    };
+
+    enum HTMLColorCode {
+        Black = 0x000000, White = 0xFFFFFF, Red = 0xFF0000, Green = 0x008000, Lime = 0x00FF00,
+        Blue = 0x0000FF, Yellow = 0xFFFF00, Cyan = 0x00FFFF, Magenta = 0xFF00FF, Orange = 0xFFA500,
+        Purple = 0x800080, Gray = 0x808080
+    };
+
+    CRGB() {}
+    CRGB(uint8_t ir, uint8_t ig, uint8_t ib) : r(ir), g(ig), b(ib) {}
+    CRGB(uint32_t colorcode) : r((colorcode >> 16) & 0xFF), g((colorcode >> 8) & 0xFF), b(colorcode & 0xFF) {}
+    CRGB(HTMLColorCode colorcode) : CRGB((uint32_t)colorcode) {}
+    CRGB(const CHSV &rhs) { hsv2rgb_rainbow(rhs, *this); }
+    CRGB &operator=(const CHSV &rhs) { hsv2rgb_rainbow(rhs, *this); return *this; }
+    CRGB &operator=(uint32_t colorcode) { r = (colorcode >> 16) & 0xFF; g = (colorcode >> 8) & 0xFF; b = colorcode & 0xFF; return *this; }
+    CRGB &setRGB(uint8_t nr, uint8_t ng, uint8_t nb) { r = nr; g = ng; b = nb; return *this; }
+    CRGB &setHSV(uint8_t hue, uint8_t sat, uint8_t val) { hsv2rgb_rainbow(CHSV(hue, sat, val), *this); return *this; }
+    CRGB &setHue(uint8_t hue) { return setHSV(hue, 255, 255); }
+
+    uint8_t &operator[](uint8_t x) { return raw[x]; }
+    const uint8_t &operator[](uint8_t x) const { return raw[x]; }
+
+    CRGB &operator+=(const CRGB &rhs) { r = qadd8(r, rhs.r); g = qadd8(g, rhs.g); b = qadd8(b, rhs.b); return *this; }
+    CRGB &operator-=(const CRGB &rhs) { r = qsub8(r, rhs.r); g = qsub8(g, rhs.g); b = qsub8(b, rhs.b); return *this; }
+    CRGB &operator|=(const CRGB &rhs) { r = max(r, rhs.r); g = max(g, rhs.g); b = max(b, rhs.b); return *this; }
+    CRGB &operator&=(const CRGB &rhs) { r = min(r, rhs.r); g = min(g, rhs.g); b = min(b, rhs.b); return *this; }
+    CRGB &operator%=(uint8_t scaledown) { return nscale8_video(scaledown); }
+    CRGB &operator*=(uint8_t d) { r = qmul8(r, d); g = qmul8(g, d); b = qmul8(b, d); return *this; }
+    CRGB &operator/=(uint8_t d) { r /= d; g /= d; b /= d; return *this; }
+    CRGB &nscale8_video(uint8_t scaledown) { r = scale8_video(r, scaledown); g = scale8_video(g, scaledown); b = scale8_video(b, scaledown); return *this; }
+    CRGB &nscale8(uint8_t scaledown) { r = ::scale8(r, scaledown); g = ::scale8(g, scaledown); b = ::scale8(b, scaledown); return *this; }
+    CRGB &nscale8(const CRGB &scaledown) { r = ::scale8(r, scaledown.r); g = ::scale8(g, scaledown.g); b = ::scale8(b, scaledown.b); return *this; }
+    CRGB scale8(const CRGB &scaledown) const { return CRGB(::scale8(r, scaledown.r), ::scale8(g, scaledown.g), ::scale8(b, scaledown.b)); }
+    CRGB &fadeToBlackBy(uint8_t fadefactor) { return nscale8(255 - fadefactor); }
+    CRGB &fadeLightBy(uint8_t fadefactor) { return nscale8_video(255 - fadefactor); }
+    uint8_t getLuma() const { return ::scale8(r, 54) + ::scale8(g, 183) + ::scale8(b, 18); }
+    uint8_t getAverageLight() const { return ::scale8(r, 85) + ::scale8(g, 85) + ::scale8(b, 85); }
+    explicit operator bool() const { return r || g || b; }
+    bool operator==(const CRGB &rhs) const { return r == rhs.r && g == rhs.g && b == rhs.b; }
+    bool operator!=(const CRGB &rhs) const { return !(*this == rhs); }
+};
+
+inline CRGB operator+(const CRGB &p1, const CRGB &p2) { return CRGB(qadd8(p1.r, p2.r), qadd8(p1.g, p2.g), qadd8(p1.b, p2.b)); }
+inline CRGB operator-(const CRGB &p1, const CRGB &p2) { return CRGB(qsub8(p1.r, p2.r), qsub8(p1.g, p2.g), qsub8(p1.b, p2.b)); }
+inline CRGB operator%(const CRGB &p1, uint8_t d) { CRGB r(p1); r.nscale8_video(d); return r; }
+
+// the "rainbow" hue mapping of FastLED's hsv2rgb.cpp
+inline void hsv2rgb_rainbow(const CHSV &hsv, CRGB &rgb)
+{
+    uint8_t hue = hsv.hue, sat = hsv.sat, val = hsv.val;
+    uint8_t offset = hue & 0x1F;
+    uint8_t offset8 = offset << 3;
+    uint8_t third = scale8(offset8, (256 / 3));
+    uint8_t r, g, b;
+    if (!(hue & 0x80)) {
+        if (!(hue & 0x40)) {
+            if (!(hue & 0x20)) { r = 255 - third; g = third; b = 0; }
+            else { uint8_t twothirds = scale8(offset8, ((256 * 2) / 3)); r = 171; g = 85 + third; b = 0; (void)twothirds; }
+        } else {
+            if (!(hue & 0x20)) { uint8_t twothirds = scale8(offset8, ((256 * 2) / 3)); r = 171 - twothirds; g = 170 + third; b = 0; }
+            else { r = 0; g = 255 - third; b = third; }
+        }
+    } else {
+        if (!(hue & 0x40)) {
+            if (!(hue & 0x20)) { uint8_t twothirds = scale8(offset8, ((256 * 2) / 3)); r = 0; g = 171 - twothirds; b = 85 + twothirds; }
+            else { r = third; g = 0; b = 255 - third; }
+        } else {
+            if (!(hue & 0x20)) { r = 85 + third; g = 0; b = 171 - third; }
+            else { r = 170 + third; g = 0; b = 85 - third; }
+        }
+    }
+    if (sat != 255) {
+        if (sat == 0) {
+            r = 255; b = 255; g = 255;
+        } else {
+            uint8_t desat = 255 - sat;
+            desat = scale8_video(desat, desat);
+            uint8_t satscale = 255 - desat;
+            if (r) r = scale8(r, satscale) + 1;
+            if (g) g = scale8(g, satscale) + 1;
+            if (b) b = scale8(b, satscale) + 1;
+            uint8_t brightness_floor = desat;
+            r += brightness_floor; g += brightness_floor; b += brightness_floor;
+        }
+    }
+    if (val != 255) {
+        val = scale8_video(val, val);
+        if (val == 0) {
+            r = 0; g = 0; b = 0;
+        } else {
+            if (r) r = scale8(r, val) + 1;
+            if (g) g = scale8(g, val) + 1;
+            if (b) b = scale8(b, val) + 1;
+        }
+    }
+    rgb.r = r; rgb.g = g; rgb.b = b;
+}
+
+inline void hsv2rgb_spectrum(const CHSV &hsv, CRGB &rgb) { hsv2rgb_rainbow(hsv, rgb); }
+
+inline CRGB blend(const CRGB &p1, const CRGB &p2, fract8 amountOfP2)
+{
+    CRGB nu(p1);
+    nu.r = lerp8by8(p1.r, p2.r, amountOfP2);
+    nu.g = lerp8by8(p1.g, p2.g, amountOfP2);
+    nu.b = lerp8by8(p1.b, p2.b, amountOfP2);
+    return nu;
+}
+
+inline CRGB &nblend(CRGB &existing, const CRGB &overlay, fract8 amountOfOverlay)
+{
+    existing = blend(existing, overlay, amountOfOverlay);
+    return existing;
+}
+
+inline void fill_solid(CRGB *leds, int numToFill, const CRGB &color)
+{
+    for (int i = 0; i < numToFill; i++) {
+        leds[i] = color;
+    }
+}
+
+inline void fill_rainbow(CRGB *leds, int numToFill, uint8_t initialhue, uint8_t deltahue = 5)
+{
+    CHSV hsv(initialhue, 240, 255);
+    for (int i = 0; i < numToFill; i++) {
+        leds[i] = hsv;
+        hsv.hue += deltahue;
+    }
+}
+
+inline void fadeToBlackBy(CRGB *leds, uint16_t numLeds, uint8_t fadeBy)
+{
+    for (uint16_t i = 0; i < numLeds; i++) {
+        leds[i].nscale8(255 - fadeBy);
+    }
+}
+
+enum EOrder { RGB = 0012, RBG = 0021, GRB = 0102, GBR = 0120, BRG = 0201, BGR = 0210 };
+
+template<uint8_t DATA_PIN, EOrder RGB_ORDER> class WS2811 {};
+template<uint8_t DATA_PIN, EOrder RGB_ORDER> class WS2812 {};
+template<uint8_t DATA_PIN, EOrder RGB_ORDER> class WS2812B {};
+template<uint8_t DATA_PIN, EOrder RGB_ORDER> class PL9823 {};
+template<uint8_t DATA_PIN, EOrder RGB_ORDER> class NEOPIXEL {};
+
+class CLEDController {
+public:
+    CRGB *leds;
+    int count;
+    EOrder order;
+    CLEDController &setCorrection(uint32_t correction) { return *this; }
+    CLEDController &setTemperature(uint32_t temperature) { return *this; }
+    CLEDController &setDither(uint8_t ditherMode = 1) { return *this; }
+};
+
+class CFastLED {
+    std::vector<CLEDController *> controllers;
+    uint8_t brightness = 255;
+    std::function<void(const std::vector<CLEDController *> &controllers, uint8_t brightness)> showHandler;
+public:
+    template<template<uint8_t DATA_PIN, EOrder RGB_ORDER> class CHIPSET, uint8_t DATA_PIN, EOrder RGB_ORDER = RGB>
+    CLEDController &addLeds(CRGB *data, int nLedsOrOffset, int nLedsIfOffset = 0) {
+        CLEDController *c = new CLEDController();
+        c->leds = (nLedsIfOffset > 0 ? data + nLedsOrOffset : data);
+        c->count = (nLedsIfOffset > 0 ? nLedsIfOffset : nLedsOrOffset);
+        c->order = RGB_ORDER;
+        controllers.push_back(c);
+        return *c;
+    }
+    void setBrightness(uint8_t scale) { brightness = scale; }
+    uint8_t getBrightness() { return brightness; }
+    void setDither(uint8_t ditherMode = 1) { }
+    void show() { show(brightness); }
+    void show(uint8_t scale) {
+        if (showHandler) {
+            showHandler(controllers, scale);
+        }
+    }
+    void clear(bool writeData = false) {
+        for (CLEDController *c : controllers) {
+            fill_solid(c->leds, c->count, CRGB(0, 0, 0));
+        }
+        if (writeData) {
+            show(0);
+        }
+    }
+    int count() { return controllers.size(); }
+    // host only: called by show(), with the leds of each controller and the brightness to apply
+    void setHostShowHandler(std::function<void(const std::vector<CLEDController *> &controllers, uint8_t brightness)> handler) {
+        showHandler = handler;
+    }
+};
+
+extern CFastLED FastLED;
+
+#endif
@@ -0,0 +1,26 @@
+// Host stand-in for the serial port: output goes to stdout, unless redirected or disabled
+// (null) with setOutput(). There is no input.
+#ifndef HOST_HARDWARE_SERIAL_H
+#define HOST_HARDWARE_SERIAL_H
+
+#include <stdio.h>
+#include "esp32-hal.h"
+#include "Stream.h"
+
+class HardwareSerial : public Stream {
+    FILE *out = stdout;
+public:
+    void setOutput(FILE *f) { out = f; }
+    void begin(unsigned long baud) { }
+    size_t write(uint8_t c) override { if (out != nullptr) fputc(c, out); return 1; }
+    size_t write(const uint8_t *buffer, size_t size) override { if (out != nullptr) fwrite(buffer, 1, size, out); return size; }
+    using Print::write;
+    int available() override { return 0; }
+    int read() override { return -1; }
+    int peek() override { return -1; }
+    void flush() override { if (out != nullptr) fflush(out); }
+};
+
+extern HardwareSerial Serial;
+
+#endif
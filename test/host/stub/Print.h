@@ -0,0 +1,62 @@
+// Host stand-in for the Arduino Print class: print(), println() and printf() on top of write().
+#ifndef HOST_PRINT_H
+#define HOST_PRINT_H
+
+#include <stdio.h>
+#include <stdarg.h>
+#include <string.h>
+#include <stdint.h>
+#include "WString.h"
+
+class Print {
+public:
+    virtual ~Print() {}
+    virtual size_t write(uint8_t c) = 0;
+    virtual size_t write(const uint8_t *buffer, size_t size) {
+        size_t n = 0;
+        while (size-- > 0 && write(*buffer++) == 1) {
+            ++n;
+        }
+        return n;
+    }
+    size_t write(const char *s) { return s == nullptr ? 0 : write((const uint8_t *)s, strlen(s)); }
+    size_t write(const char *buffer, size_t size) { return write((const uint8_t *)buffer, size); }
+    virtual void flush() {}
+
+    size_t printf(const char *format, ...) __attribute__((format(printf, 2, 3))) {
+        char small[128];
+        va_list args;
+        va_start(args, format);
+        int len = vsnprintf(small, sizeof(small), format, args);
+        va_end(args);
+        if (len < 0) {
+            return 0;
+        }
+        if ((size_t)len < sizeof(small)) {
+            return write((const uint8_t *)small, len);
+        }
+        char *big = new char[len + 1];
+        va_start(args, format);
+        vsnprintf(big, len + 1, format, args);
+        va_end(args);
+        size_t n = write((const uint8_t *)big, len);
+        delete[] big;
+        return n;
+    }
+    size_t print(const char *s) { return write(s); }
+    size_t print(const String &s) { return write((const uint8_t *)s.c_str(), s.length()); }
+    size_t print(char c) { return write((uint8_t)c); }
+    size_t print(unsigned char v, int base = 10) { return print((unsigned long)v, base); }
+    size_t print(int v, int base = 10) { return print((long)v, base); }
+    size_t print(unsigned int v, int base = 10) { return print((unsigned long)v, base); }
+    size_t print(long v, int base = 10) { return base == 16 ? printf("%lx", v) : printf("%ld", v); }
+    size_t print(unsigned long v, int base = 10) { return base == 16 ? printf("%lx", v) : printf("%lu", v); }
+    size_t print(long long v, int base = 10) { return printf("%lld", v); }
+    size_t print(unsigned long long v, int base = 10) { return printf("%llu", v); }
+    size_t print(double v, int digits = 2) { return printf("%.*f", digits, v); }
+    size_t println() { return write("\r\n"); }
+    template<typename T> size_t println(const T &v) { size_t n = print(v); return n + println(); }
+    size_t println(double v, int digits) { size_t n = print(v, digits); return n + println(); }
+};
+
+#endif
@@ -0,0 +1,22 @@
+// Host stand-in for SPIFFS: a directory of the host, see FS.h.
+#ifndef HOST_SPIFFS_H
+#define HOST_SPIFFS_H
+
+#include "FS.h"
+
+namespace fs {
+
+class SPIFFSFS : public FS {
+public:
+    bool begin(bool formatOnFail = false, const char *basePath = "/spiffs", uint8_t maxOpenFiles = 10) { return true; }
+    void end() { }
+    bool format();
+    size_t totalBytes() { return 1024 * 1024; }
+    size_t usedBytes() { return 0; }
+};
+
+} // namespace fs
+
+extern fs::SPIFFSFS SPIFFS;
+
+#endif
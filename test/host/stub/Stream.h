@@ -0,0 +1,39 @@
+// Host stand-in for the Arduino Stream class, the input side of Print.
+#ifndef HOST_STREAM_H
+#define HOST_STREAM_H
+
+#include "Print.h"
+
+class Stream : public Print {
+public:
+    virtual int available() = 0;
+    virtual int read() = 0;
+    virtual int peek() = 0;
+    virtual size_t readBytes(char *buffer, size_t length) {
+        size_t n = 0;
+        int c;
+        while (n < length && (c = read()) >= 0) {
+            buffer[n++] = (char)c;
+        }
+        return n;
+    }
+    size_t readBytes(uint8_t *buffer, size_t length) { return readBytes((char *)buffer, length); }
+    String readString() {
+        String s;
+        int c;
+        while ((c = read()) >= 0) {
+            s += (char)c;
+        }
+        return s;
+    }
+    String readStringUntil(char terminator) {
+        String s;
+        int c;
+        while ((c = read()) >= 0 && c != terminator) {
+            s += (char)c;
+        }
+        return s;
+    }
+};
+
+#endif
@@ -0,0 +1,90 @@
+// Host stand-in for the TaskScheduler library, as used by UEventLoop: micros resolution,
+// std::function callbacks. A task runs its interval after it was set, then every interval
+// until its iterations are used up.
+#ifndef HOST_TASK_SCHEDULER_H
+#define HOST_TASK_SCHEDULER_H
+
+#include <functional>
+#include <vector>
+#include <algorithm>
+#include "Arduino.h"
+
+#define TASK_FOREVER (-1)
+#define TASK_ONCE 1
+
+class Task {
+    friend class Scheduler;
+    long interval = 0;
+    long iterations = 0; // remaining, -1 for forever
+    bool isEnabledFlag = false;
+    int64_t nextRun = 0;
+    long overrun = 0;
+    std::function<void()> callback;
+public:
+    Task() {}
+    void set(long aInterval, long aIterations, std::function<void()> aCallback) {
+        interval = aInterval;
+        iterations = aIterations;
+        callback = aCallback;
+        nextRun = esp_timer_get_time() + interval;
+    }
+    bool enable() { isEnabledFlag = true; nextRun = esp_timer_get_time() + interval; return true; }
+    bool enableIfNot() { if (isEnabledFlag) return true; return enable(); }
+    bool disable() { bool was = isEnabledFlag; isEnabledFlag = false; return was; }
+    bool isEnabled() { return isEnabledFlag; }
+    bool isLastIteration() { return iterations == 0; }
+    long getInterval() { return interval; }
+    long getOverrun() { return overrun; }
+};
+
+class Scheduler {
+    std::vector<Task *> tasks;
+public:
+    void init() { tasks.clear(); }
+    void addTask(Task &task) { if (std::find(tasks.begin(), tasks.end(), &task) == tasks.end()) tasks.push_back(&task); }
+    void deleteTask(Task &task) { tasks.erase(std::remove(tasks.begin(), tasks.end(), &task), tasks.end()); }
+
+    // runs the tasks that are due, returns true if none ran ("idle")
+    bool execute() {
+        bool isIdle = true;
+        int64_t now = esp_timer_get_time();
+        for (size_t i = 0; i < tasks.size(); i++) {
+            Task *t = tasks[i];
+            if (!t->isEnabledFlag || now < t->nextRun) {
+                continue;
+            }
+            if (t->iterations == 0) {
+                t->isEnabledFlag = false;
+                continue;
+            }
+            if (t->iterations > 0) {
+                --t->iterations;
+            }
+            t->overrun = (long)(t->nextRun + t->interval - now);
+            t->nextRun += t->interval;
+            isIdle = false;
+            if (t->callback) {
+                t->callback();
+            }
+        }
+        return isIdle;
+    }
+
+    // micros until the next enabled task is due, 0 if one is due, -1 if none is enabled
+    long timeUntilNextIteration() {
+        int64_t now = esp_timer_get_time();
+        long next = -1;
+        for (Task *t : tasks) {
+            if (!t->isEnabledFlag) {
+                continue;
+            }
+            long d = (t->nextRun <= now ? 0 : (long)(t->nextRun - now));
+            if (next == -1 || d < next) {
+                next = d;
+            }
+        }
+        return next;
+    }
+};
+
+#endif
@@ -0,0 +1,159 @@
+// Host stand-in for the Arduino String, with the same conversions and comparisons as the
+// arduino-esp32 one, on top of std::string. A String made from a null pointer is invalid:
+// it converts to false, as in Arduino.
+#ifndef HOST_WSTRING_H
+#define HOST_WSTRING_H
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include <string>
+
+class String {
+    std::string s;
+    bool valid;
+
+    void setNumber(long long v) { s = std::to_string(v); valid = true; }
+    void setUnsigned(unsigned long long v) { s = std::to_string(v); valid = true; }
+    static std::string fmt(double v, unsigned char decimals) {
+        char buf[64];
+        snprintf(buf, sizeof(buf), "%.*f", decimals, v);
+        return buf;
+    }
+    typedef void (String::*BoolType)() const;
+    void boolHelper() const {}
+public:
+    String(const char *cstr = "") : s(cstr == nullptr ? "" : cstr), valid(cstr != nullptr) {}
+    String(const String &other) = default;
+    String(String &&other) = default;
+    String(const std::string &str) : s(str), valid(true) {}
+    explicit String(char c) : s(1, c), valid(true) {}
+    explicit String(unsigned char v, unsigned char base = 10) { setUnsigned(v); }
+    explicit String(int v, unsigned char base = 10) { if (base == 16) { char b[16]; snprintf(b, sizeof(b), "%x", v); s = b; valid = true; } else setNumber(v); }
+    explicit String(unsigned int v, unsigned char base = 10) { if (base == 16) { char b[16]; snprintf(b, sizeof(b), "%x", v); s = b; valid = true; } else setUnsigned(v); }
+    explicit String(long v, unsigned char base = 10) { setNumber(v); }
+    explicit String(unsigned long v, unsigned char base = 10) { setUnsigned(v); }
+    explicit String(long long v) { setNumber(v); }
+    explicit String(unsigned long long v) { setUnsigned(v); }
+    explicit String(float v, unsigned char decimals = 2) : s(fmt(v, decimals)), valid(true) {}
+    explicit String(double v, unsigned char decimals = 2) : s(fmt(v, decimals)), valid(true) {}
+
+    String &operator=(const String &other) = default;
+    String &operator=(String &&other) = default;
+    String &operator=(const char *cstr) { s = (cstr == nullptr ? "" : cstr); valid = (cstr != nullptr); return *this; }
+    // arduino-esp32 converts numbers implicitly on assignment
+    String &operator=(unsigned char v) { return *this = String(v); }
+    String &operator=(int v) { return *this = String(v); }
+    String &operator=(unsigned int v) { return *this = String(v); }
+    String &operator=(long v) { return *this = String(v); }
+    String &operator=(unsigned long v) { return *this = String(v); }
+    String &operator=(short v) { return *this = String((int)v); }
+    String &operator=(unsigned short v) { return *this = String((unsigned int)v); }
+
+    operator BoolType() const { return valid ? &String::boolHelper : 0; }
+
+    unsigned int length() const { return s.length(); }
+    bool isEmpty() const { return s.empty(); }
+    void clear() { s.clear(); valid = true; }
+    const char *c_str() const { return s.c_str(); }
+    char *begin() { return &s[0]; }
+    unsigned char reserve(unsigned int size) { s.reserve(size); valid = true; return 1; }
+
+    unsigned char concat(const String &str) { s += str.s; valid = true; return 1; }
+    unsigned char concat(const char *cstr) { if (cstr == nullptr) return 0; s += cstr; valid = true; return 1; }
+    unsigned char concat(const char *cstr, unsigned int len) { if (cstr == nullptr) return 0; s.append(cstr, len); valid = true; return 1; }
+    unsigned char concat(char c) { s += c; valid = true; return 1; }
+    unsigned char concat(unsigned char v) { return concat(String(v)); }
+    unsigned char concat(int v) { return concat(String(v)); }
+    unsigned char concat(unsigned int v) { return concat(String(v)); }
+    unsigned char concat(long v) { return concat(String(v)); }
+    unsigned char concat(unsigned long v) { return concat(String(v)); }
+    unsigned char concat(long long v) { return concat(String(v)); }
+    unsigned char concat(unsigned long long v) { return concat(String(v)); }
+    unsigned char concat(float v) { return concat(String(v)); }
+    unsigned char concat(double v) { return concat(String(v)); }
+
+    String &operator+=(const String &v) { concat(v); return *this; }
+    String &operator+=(const char *v) { concat(v); return *this; }
+    String &operator+=(char v) { concat(v); return *this; }
+    String &operator+=(unsigned char v) { concat(v); return *this; }
+    String &operator+=(int v) { concat(v); return *this; }
+    String &operator+=(unsigned int v) { concat(v); return *this; }
+    String &operator+=(long v) { concat(v); return *this; }
+    String &operator+=(unsigned long v) { concat(v); return *this; }
+    String &operator+=(long long v) { concat(v); return *this; }
+    String &operator+=(unsigned long long v) { concat(v); return *this; }
+    String &operator+=(float v) { concat(v); return *this; }
+    String &operator+=(double v) { concat(v); return *this; }
+
+    int compareTo(const String &other) const { return s.compare(other.s); }
+    unsigned char equals(const String &other) const { return s == other.s; }
+    unsigned char equals(const char *cstr) const { return cstr == nullptr ? s.empty() : s == cstr; }
+    unsigned char equalsIgnoreCase(const String &other) const {
+        if (s.length() != other.s.length()) return 0;
+        for (size_t i = 0; i < s.length(); i++) {
+            if (tolower((unsigned char)s[i]) != tolower((unsigned char)other.s[i])) return 0;
+        }
+        return 1;
+    }
+    unsigned char operator==(const String &other) const { return equals(other); }
+    unsigned char operator==(const char *cstr) const { return equals(cstr); }
+    unsigned char operator!=(const String &other) const { return !equals(other); }
+    unsigned char operator!=(const char *cstr) const { return !equals(cstr); }
+    unsigned char operator<(const String &other) const { return s < other.s; }
+    unsigned char startsWith(const String &prefix) const { return s.compare(0, prefix.s.length(), prefix.s) == 0; }
+    unsigned char startsWith(const String &prefix, unsigned int offset) const { return offset <= s.length() && s.compare(offset, prefix.s.length(), prefix.s) == 0; }
+    unsigned char endsWith(const String &suffix) const { return s.length() >= suffix.s.length() && s.compare(s.length() - suffix.s.length(), suffix.s.length(), suffix.s) == 0; }
+
+    char charAt(unsigned int i) const { return i < s.length() ? s[i] : 0; }
+    void setCharAt(unsigned int i, char c) { if (i < s.length()) s[i] = c; }
+    char operator[](unsigned int i) const { return charAt(i); }
+    char &operator[](unsigned int i) { return s[i]; }
+    void getBytes(unsigned char *buf, unsigned int bufsize, unsigned int index = 0) const {
+        if (bufsize == 0) return;
+        size_t n = (index < s.length() ? s.copy((char *)buf, bufsize - 1, index) : 0);
+        buf[n] = 0;
+    }
+    void toCharArray(char *buf, unsigned int bufsize, unsigned int index = 0) const { getBytes((unsigned char *)buf, bufsize, index); }
+
+    int indexOf(char c, unsigned int from = 0) const { size_t p = s.find(c, from); return p == std::string::npos ? -1 : (int)p; }
+    int indexOf(const String &str, unsigned int from = 0) const { size_t p = s.find(str.s, from); return p == std::string::npos ? -1 : (int)p; }
+    int lastIndexOf(char c) const { size_t p = s.rfind(c); return p == std::string::npos ? -1 : (int)p; }
+    int lastIndexOf(const String &str) const { size_t p = s.rfind(str.s); return p == std::string::npos ? -1 : (int)p; }
+    String substring(unsigned int from) const { return from >= s.length() ? String("") : String(s.substr(from)); }
+    String substring(unsigned int from, unsigned int to) const {
+        if (from > to) { unsigned int t = from; from = to; to = t; }
+        if (from >= s.length()) return String("");
+        return String(s.substr(from, to - from));
+    }
+
+    void replace(const String &find, const String &repl) {
+        if (find.s.empty()) return;
+        for (size_t p = s.find(find.s); p != std::string::npos; p = s.find(find.s, p + repl.s.length())) {
+            s.replace(p, find.s.length(), repl.s);
+        }
+    }
+    void remove(unsigned int index) { if (index < s.length()) s.erase(index); }
+    void remove(unsigned int index, unsigned int count) { if (index < s.length()) s.erase(index, count); }
+    void toLowerCase() { for (char &c : s) c = tolower((unsigned char)c); }
+    void toUpperCase() { for (char &c : s) c = toupper((unsigned char)c); }
+    void trim() {
+        size_t b = 0;
+        while (b < s.length() && isspace((unsigned char)s[b])) ++b;
+        size_t e = s.length();
+        while (e > b && isspace((unsigned char)s[e - 1])) --e;
+        s = s.substr(b, e - b);
+    }
+    long toInt() const { return atol(s.c_str()); }
+    float toFloat() const { return (float)atof(s.c_str()); }
+    double toDouble() const { return atof(s.c_str()); }
+
+    const std::string &str() const { return s; }
+};
+
+template<typename T> inline String operator+(const String &lhs, const T &rhs) { String r(lhs); r.concat(rhs); return r; }
+inline String operator+(const char *lhs, const String &rhs) { String r(lhs); r.concat(rhs); return r; }
+inline bool operator==(const char *lhs, const String &rhs) { return rhs.equals(lhs); }
+
+#endif
@@ -0,0 +1,7 @@
+// Host stand-in for the Arduino Wire library: declares TwoWire only, see driver/i2c.h.
+#ifndef HOST_WIRE_H
+#define HOST_WIRE_H
+
+class TwoWire;
+
+#endif
@@ -0,0 +1,5 @@
+// Host stand-in for the <debug.h> that EEPROMLittleFs.h includes: nothing is used from it.
+#ifndef HOST_DEBUG_H
+#define HOST_DEBUG_H
+
+#endif
@@ -0,0 +1,80 @@
+// Host stand-in for the ESP-IDF I2C master driver: command links run against simulated devices
+// attached to the port with hostI2cAttach(), at the timing of the bus clock, see host_i2c.cpp.
+#ifndef HOST_DRIVER_I2C_H
+#define HOST_DRIVER_I2C_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include "esp_err.h"
+#include "freertos/FreeRTOS.h"
+
+typedef int i2c_port_t;
+#define I2C_NUM_0 0
+#define I2C_NUM_1 1
+#define I2C_NUM_MAX 2
+
+typedef int gpio_num_t;
+typedef enum { GPIO_PULLUP_DISABLE = 0, GPIO_PULLUP_ENABLE = 1 } gpio_pullup_t;
+
+typedef enum { I2C_MODE_SLAVE = 0, I2C_MODE_MASTER } i2c_mode_t;
+typedef enum { I2C_MASTER_WRITE = 0, I2C_MASTER_READ } i2c_rw_t;
+typedef enum { I2C_MASTER_ACK = 0, I2C_MASTER_NACK, I2C_MASTER_LAST_NACK } i2c_ack_type_t;
+
+typedef struct {
+    i2c_mode_t mode;
+    int sda_io_num;
+    int scl_io_num;
+    bool sda_pullup_en;
+    bool scl_pullup_en;
+    union {
+        struct {
+            uint32_t clk_speed;
+        } master;
+    };
+} i2c_config_t;
+
+typedef struct HostI2cCmd *i2c_cmd_handle_t;
+
+esp_err_t i2c_param_config(i2c_port_t port, const i2c_config_t *conf);
+esp_err_t i2c_driver_install(i2c_port_t port, i2c_mode_t mode, size_t rxBufLen, size_t txBufLen, int intrFlags);
+esp_err_t i2c_driver_delete(i2c_port_t port);
+
+i2c_cmd_handle_t i2c_cmd_link_create();
+void i2c_cmd_link_delete(i2c_cmd_handle_t cmd);
+esp_err_t i2c_master_start(i2c_cmd_handle_t cmd);
+esp_err_t i2c_master_write_byte(i2c_cmd_handle_t cmd, uint8_t data, bool ackEnable);
+esp_err_t i2c_master_write(i2c_cmd_handle_t cmd, const uint8_t *data, size_t len, bool ackEnable);
+esp_err_t i2c_master_read(i2c_cmd_handle_t cmd, uint8_t *data, size_t len, i2c_ack_type_t ack);
+esp_err_t i2c_master_stop(i2c_cmd_handle_t cmd);
+// ESP_FAIL if a byte is not acknowledged, as the ESP-IDF driver
+esp_err_t i2c_master_cmd_begin(i2c_port_t port, i2c_cmd_handle_t cmd, TickType_t ticksToWait);
+
+/**
+ * Host only: a device on the bus of a port. A transfer is start(), then the bytes written or
+ * read, then stop(); a repeated start comes without stop(). A device that doesn't acknowledge
+ * its address (returns false from start()) gets no bytes and no stop().
+ */
+class HostI2cDevice {
+public:
+    virtual ~HostI2cDevice() { }
+    virtual bool start(bool isRead) = 0;
+    // false if not acknowledged
+    virtual bool write(uint8_t data) = 0;
+    virtual uint8_t read() = 0;
+    virtual void stop() = 0;
+};
+
+// devices respond at their 7-bit address, the bus clock defaults to 100 kHz
+void hostI2cAttach(i2c_port_t port, uint8_t address, HostI2cDevice *device);
+void hostI2cSetClock(i2c_port_t port, uint32_t hz);
+
+struct HostI2cStats {
+    uint32_t transfers;
+    uint32_t nacks; // transfers ended by a byte not acknowledged
+    uint32_t bytes; // on the bus, addresses included
+    uint64_t busMicros; // time the bus was busy
+};
+HostI2cStats hostI2cGetStats(i2c_port_t port);
+void hostI2cResetStats(i2c_port_t port);
+
+#endif
@@ -0,0 +1,33 @@
+// Host stand-in for esp32-hal.h, which the Arduino headers include: time, pins and heap checks.
+#ifndef HOST_ESP32_HAL_H
+#define HOST_ESP32_HAL_H
+
+#include <stdint.h>
+#include <inttypes.h>
+#include "esp_timer.h"
+#include "esp_heap_caps.h"
+
+typedef uint8_t byte;
+typedef bool boolean;
+
+#define HIGH 0x1
+#define LOW 0x0
+#define INPUT 0x01
+#define OUTPUT 0x02
+#define INPUT_PULLUP 0x05
+#define INPUT_PULLDOWN 0x09
+
+#define IRAM_ATTR
+#define DRAM_ATTR
+
+inline unsigned long micros() { return (unsigned long)esp_timer_get_time(); }
+inline unsigned long millis() { return (unsigned long)(esp_timer_get_time() / 1000); }
+void delay(uint32_t ms);
+inline void delayMicroseconds(uint32_t us) { }
+// spins, as the ROM function does
+void ets_delay_us(uint32_t us);
+inline void pinMode(uint8_t pin, uint8_t mode) { }
+inline void digitalWrite(uint8_t pin, uint8_t val) { }
+inline int digitalRead(uint8_t pin) { return 0; }
+
+#endif
@@ -0,0 +1,17 @@
+// Host stand-in for esp_heap_caps.h: the heap is the host's, always consistent.
+#ifndef HOST_ESP_HEAP_CAPS_H
+#define HOST_ESP_HEAP_CAPS_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define MALLOC_CAP_8BIT (1 << 2)
+#define MALLOC_CAP_SPIRAM (1 << 10)
+#define MALLOC_CAP_INTERNAL (1 << 11)
+#define MALLOC_CAP_DEFAULT (1 << 12)
+
+inline bool heap_caps_check_integrity_all(bool print_errors) { return true; }
+inline size_t heap_caps_get_free_size(uint32_t caps) { return 200000; }
+inline size_t heap_caps_get_largest_free_block(uint32_t caps) { return 100000; }
+
+#endif
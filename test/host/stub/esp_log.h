@@ -0,0 +1,10 @@
+// Host stand-in for esp_log.h: the timestamp of log lines.
+#ifndef HOST_ESP_LOG_H
+#define HOST_ESP_LOG_H
+
+#include <stdint.h>
+#include "esp_timer.h"
+
+inline uint32_t esp_log_timestamp(void) { return (uint32_t)(esp_timer_get_time() / 1000); }
+
+#endif
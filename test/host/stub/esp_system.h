@@ -0,0 +1,11 @@
+// Host stand-in for esp_system.h: esp_random() is a seedable PRNG, so that runs can be repeated.
+#ifndef HOST_ESP_SYSTEM_H
+#define HOST_ESP_SYSTEM_H
+
+#include <stdint.h>
+
+uint32_t esp_random(void);
+void hostSeedRandom(uint32_t seed);
+inline uint32_t esp_get_free_heap_size(void) { return 200000; }
+
+#endif
@@ -0,0 +1,46 @@
+// Host stand-in for FreeRTOS, on std::thread: tasks, notifications, semaphores, queues and event
+// groups, implemented in host_freertos.cpp. Critical sections are a single global recursive lock.
+#ifndef HOST_FREERTOS_H
+#define HOST_FREERTOS_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <limits.h>
+#include <assert.h>
+
+typedef uint32_t TickType_t;
+typedef int BaseType_t;
+typedef unsigned int UBaseType_t;
+
+#define pdTRUE 1
+#define pdFALSE 0
+#define pdPASS 1
+#define pdFAIL 0
+#define portMAX_DELAY ((TickType_t)0xffffffffUL)
+#define portTICK_PERIOD_MS 1
+#define portTICK_RATE_MS portTICK_PERIOD_MS
+#define pdMS_TO_TICKS(ms) ((TickType_t)(ms))
+#define configTICK_RATE_HZ 1000
+#define PRO_CPU_NUM 0
+#define APP_CPU_NUM 1
+#define tskNO_AFFINITY 0x7fffffff
+#define configASSERT(x) ((void)0)
+
+typedef int portMUX_TYPE;
+#define portMUX_INITIALIZER_UNLOCKED 0
+void hostEnterCritical();
+void hostExitCritical();
+#define portENTER_CRITICAL(mux) hostEnterCritical()
+#define portEXIT_CRITICAL(mux) hostExitCritical()
+#define portENTER_CRITICAL_ISR(mux) hostEnterCritical()
+#define portEXIT_CRITICAL_ISR(mux) hostExitCritical()
+#define taskENTER_CRITICAL(mux) hostEnterCritical()
+#define taskEXIT_CRITICAL(mux) hostExitCritical()
+#define portYIELD_FROM_ISR()
+
+struct HostTask;
+typedef HostTask *TaskHandle_t;
+typedef TaskHandle_t xTaskHandle;
+
+#endif
@@ -0,0 +1,35 @@
+#ifndef HOST_FREERTOS_TASK_H
+#define HOST_FREERTOS_TASK_H
+
+#include "freertos/FreeRTOS.h"
+#include "esp_timer.h"
+
+typedef void (*TaskFunction_t)(void *);
+
+BaseType_t xTaskCreatePinnedToCore(TaskFunction_t fn, const char *name, uint32_t stackDepth, void *arg,
+    UBaseType_t priority, TaskHandle_t *handle, BaseType_t coreId);
+inline BaseType_t xTaskCreate(TaskFunction_t fn, const char *name, uint32_t stackDepth, void *arg,
+    UBaseType_t priority, TaskHandle_t *handle) {
+    return xTaskCreatePinnedToCore(fn, name, stackDepth, arg, priority, handle, tskNO_AFFINITY);
+}
+void vTaskDelete(TaskHandle_t task);
+void vTaskDelay(TickType_t ticks);
+TaskHandle_t xTaskGetCurrentTaskHandle();
+const char *pcTaskGetTaskName(TaskHandle_t task);
+inline UBaseType_t uxTaskPriorityGet(TaskHandle_t task) { return 1; }
+inline UBaseType_t uxTaskGetStackHighWaterMark(TaskHandle_t task) { return 1024; }
+inline TickType_t xTaskGetTickCount() { return (TickType_t)(esp_timer_get_time() / 1000); }
+uint32_t ulTaskNotifyTake(BaseType_t clearOnExit, TickType_t ticksToWait);
+BaseType_t xTaskNotifyGive(TaskHandle_t task);
+void vTaskNotifyGiveFromISR(TaskHandle_t task, BaseType_t *higherPriorityTaskWoken);
+
+/**
+ * Host only: waits until all the tasks created with xTaskCreate() are blocked waiting for a
+ * notification, with none pending, so that a simulation can step deterministically.
+ */
+void hostWaitTasksIdle();
+
+void hostYield();
+#define taskYIELD() hostYield()
+
+#endif
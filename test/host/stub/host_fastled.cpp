@@ -0,0 +1,4 @@
+// FastLED of the host stubs, see FastLED.h.
+#include "FastLED.h"
+
+CFastLED FastLED;
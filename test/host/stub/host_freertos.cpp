@@ -0,0 +1,487 @@
+// FreeRTOS and esp32 system calls for the host builds, see freertos/FreeRTOS.h.
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/semphr.h"
+#include "freertos/queue.h"
+#include "freertos/event_groups.h"
+#include "esp_system.h"
+#include "esp_timer.h"
+#include "HardwareSerial.h"
+
+HardwareSerial Serial;
+
+static std::chrono::steady_clock::time_point startTime = std::chrono::steady_clock::now();
+
+int64_t esp_timer_get_time(void)
+{
+    return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - startTime).count();
+}
+
+static uint64_t randomState = 0x9E3779B97F4A7C15ull;
+
+void hostSeedRandom(uint32_t seed)
+{
+    randomState = seed * 0x9E3779B97F4A7C15ull + 1;
+}
+
+uint32_t esp_random(void)
+{
+    // xorshift64*
+    randomState ^= randomState >> 12;
+    randomState ^= randomState << 25;
+    randomState ^= randomState >> 27;
+    return (uint32_t)((randomState * 0x2545F4914F6CDD1Dull) >> 32);
+}
+
+void delay(uint32_t ms)
+{
+    std::this_thread::sleep_for(std::chrono::milliseconds(ms));
+}
+
+void ets_delay_us(uint32_t us)
+{
+    int64_t end = esp_timer_get_time() + us;
+    while (esp_timer_get_time() < end) {
+    }
+}
+
+static std::recursive_mutex criticalMutex;
+
+void hostEnterCritical()
+{
+    criticalMutex.lock();
+}
+
+void hostExitCritical()
+{
+    criticalMutex.unlock();
+}
+
+// waits on cv until pred() or ticks (millis) elapse, returns pred()
+template<typename Pred>
+static bool waitFor(std::condition_variable &cv, std::unique_lock<std::mutex> &lock, TickType_t ticks, Pred pred)
+{
+    if (ticks == portMAX_DELAY) {
+        cv.wait(lock, pred);
+        return true;
+    }
+    return cv.wait_for(lock, std::chrono::milliseconds(ticks), pred);
+}
+
+// Tasks
+
+struct HostTask {
+    std::string name;
+    uint32_t notifyCount = 0;
+    bool isWaitingNotify = false;
+};
+
+static std::mutex tasksMutex;
+static std::condition_variable tasksCv;
+static std::vector<HostTask *> tasks;
+static thread_local HostTask *currentTask = nullptr;
+
+BaseType_t xTaskCreatePinnedToCore(TaskFunction_t fn, const char *name, uint32_t stackDepth, void *arg,
+    UBaseType_t priority, TaskHandle_t *handle, BaseType_t coreId)
+{
+    HostTask *task = new HostTask();
+    task->name = name;
+    {
+        std::lock_guard<std::mutex> lock(tasksMutex);
+        tasks.push_back(task);
+    }
+    if (handle != nullptr) {
+        *handle = task;
+    }
+    std::thread([task, fn, arg]() {
+        currentTask = task;
+        fn(arg);
+    }).detach();
+    return pdPASS;
+}
+
+void vTaskDelete(TaskHandle_t task)
+{
+    if (task == nullptr || task == currentTask) {
+        // the thread can't be stopped from here; the task stays blocked forever
+        std::unique_lock<std::mutex> lock(tasksMutex);
+        tasksCv.wait(lock, []() { return false; });
+    }
+}
+
+void vTaskDelay(TickType_t ticks)
+{
+    std::this_thread::sleep_for(std::chrono::milliseconds(ticks));
+}
+
+TaskHandle_t xTaskGetCurrentTaskHandle()
+{
+    if (currentTask == nullptr) {
+        currentTask = new HostTask();
+        currentTask->name = "main";
+    }
+    return currentTask;
+}
+
+const char *pcTaskGetTaskName(TaskHandle_t task)
+{
+    return (task == nullptr ? xTaskGetCurrentTaskHandle() : task)->name.c_str();
+}
+
+uint32_t ulTaskNotifyTake(BaseType_t clearOnExit, TickType_t ticksToWait)
+{
+    HostTask *task = xTaskGetCurrentTaskHandle();
+    std::unique_lock<std::mutex> lock(tasksMutex);
+    task->isWaitingNotify = true;
+    tasksCv.notify_all();
+    waitFor(tasksCv, lock, ticksToWait, [task]() { return task->notifyCount > 0; });
+    task->isWaitingNotify = false;
+    uint32_t count = task->notifyCount;
+    if (count > 0) {
+        task->notifyCount = (clearOnExit ? 0 : count - 1);
+    }
+    return count;
+}
+
+BaseType_t xTaskNotifyGive(TaskHandle_t task)
+{
+    std::lock_guard<std::mutex> lock(tasksMutex);
+    ++task->notifyCount;
+    tasksCv.notify_all();
+    return pdPASS;
+}
+
+void vTaskNotifyGiveFromISR(TaskHandle_t task, BaseType_t *higherPriorityTaskWoken)
+{
+    xTaskNotifyGive(task);
+}
+
+void hostWaitTasksIdle()
+{
+    std::unique_lock<std::mutex> lock(tasksMutex);
+    tasksCv.wait(lock, []() {
+        for (HostTask *t : tasks) {
+            if (!t->isWaitingNotify || t->notifyCount > 0) {
+                return false;
+            }
+        }
+        return true;
+    });
+}
+
+// Semaphores
+
+struct HostSemaphore {
+    std::mutex mutex;
+    std::condition_variable cv;
+    UBaseType_t count;
+    UBaseType_t maxCount;
+    HostTask *owner = nullptr; // of a recursive mutex
+    int depth = 0;
+};
+
+static SemaphoreHandle_t newSemaphore(UBaseType_t maxCount, UBaseType_t initialCount)
+{
+    HostSemaphore *sem = new HostSemaphore();
+    sem->count = initialCount;
+    sem->maxCount = maxCount;
+    return sem;
+}
+
+SemaphoreHandle_t xSemaphoreCreateBinary() { return newSemaphore(1, 0); }
+SemaphoreHandle_t xSemaphoreCreateMutex() { return newSemaphore(1, 1); }
+SemaphoreHandle_t xSemaphoreCreateRecursiveMutex() { return newSemaphore(1, 1); }
+SemaphoreHandle_t xSemaphoreCreateCounting(UBaseType_t maxCount, UBaseType_t initialCount) { return newSemaphore(maxCount, initialCount); }
+void vSemaphoreDelete(SemaphoreHandle_t sem) { delete sem; }
+
+BaseType_t xSemaphoreTake(SemaphoreHandle_t sem, TickType_t ticksToWait)
+{
+    std::unique_lock<std::mutex> lock(sem->mutex);
+    if (!waitFor(sem->cv, lock, ticksToWait, [sem]() { return sem->count > 0; })) {
+        return pdFALSE;
+    }
+    --sem->count;
+    return pdTRUE;
+}
+
+BaseType_t xSemaphoreGive(SemaphoreHandle_t sem)
+{
+    std::lock_guard<std::mutex> lock(sem->mutex);
+    if (sem->count >= sem->maxCount) {
+        return pdFALSE;
+    }
+    ++sem->count;
+    sem->cv.notify_one();
+    return pdTRUE;
+}
+
+BaseType_t xSemaphoreTakeRecursive(SemaphoreHandle_t sem, TickType_t ticksToWait)
+{
+    HostTask *task = xTaskGetCurrentTaskHandle();
+    std::unique_lock<std::mutex> lock(sem->mutex);
+    if (sem->owner == task) {
+        ++sem->depth;
+        return pdTRUE;
+    }
+    if (!waitFor(sem->cv, lock, ticksToWait, [sem]() { return sem->count > 0; })) {
+        return pdFALSE;
+    }
+    --sem->count;
+    sem->owner = task;
+    sem->depth = 1;
+    return pdTRUE;
+}
+
+BaseType_t xSemaphoreGiveRecursive(SemaphoreHandle_t sem)
+{
+    std::lock_guard<std::mutex> lock(sem->mutex);
+    if (sem->owner != xTaskGetCurrentTaskHandle()) {
+        return pdFALSE;
+    }
+    if (--sem->depth == 0) {
+        sem->owner = nullptr;
+        ++sem->count;
+        sem->cv.notify_one();
+    }
+    return pdTRUE;
+}
+
+// Queues
+
+struct HostQueue {
+    std::mutex mutex;
+    std::condition_variable cv;
+    std::deque<std::vector<uint8_t>> items;
+    UBaseType_t length;
+    UBaseType_t itemSize;
+};
+
+QueueHandle_t xQueueCreate(UBaseType_t length, UBaseType_t itemSize)
+{
+    HostQueue *q = new HostQueue();
+    q->length = length;
+    q->itemSize = itemSize;
+    return q;
+}
+
+void vQueueDelete(QueueHandle_t queue) { delete queue; }
+
+static BaseType_t queueSend(QueueHandle_t q, const void *item, TickType_t ticksToWait, bool isFront)
+{
+    std::unique_lock<std::mutex> lock(q->mutex);
+    if (!waitFor(q->cv, lock, ticksToWait, [q]() { return q->items.size() < q->length; })) {
+        return pdFALSE;
+    }
+    std::vector<uint8_t> v((const uint8_t *)item, (const uint8_t *)item + q->itemSize);
+    if (isFront) {
+        q->items.push_front(std::move(v));
+    } else {
+        q->items.push_back(std::move(v));
+    }
+    q->cv.notify_all();
+    return pdTRUE;
+}
+
+BaseType_t xQueueSend(QueueHandle_t q, const void *item, TickType_t ticksToWait) { return queueSend(q, item, ticksToWait, false); }
+BaseType_t xQueueSendToFront(QueueHandle_t q, const void *item, TickType_t ticksToWait) { return queueSend(q, item, ticksToWait, true); }
+
+BaseType_t xQueueReceive(QueueHandle_t q, void *item, TickType_t ticksToWait)
+{
+    std::unique_lock<std::mutex> lock(q->mutex);
+    if (!waitFor(q->cv, lock, ticksToWait, [q]() { return !q->items.empty(); })) {
+        return pdFALSE;
+    }
+    memcpy(item, q->items.front().data(), q->itemSize);
+    q->items.pop_front();
+    q->cv.notify_all();
+    return pdTRUE;
+}
+
+UBaseType_t uxQueueMessagesWaiting(QueueHandle_t q)
+{
+    std::lock_guard<std::mutex> lock(q->mutex);
+    return q->items.size();
+}
+
+// Event groups
+
+struct HostEventGroup {
+    std::mutex mutex;
+    std::condition_variable cv;
+    EventBits_t bits = 0;
+};
+
+EventGroupHandle_t xEventGroupCreate() { return new HostEventGroup(); }
+void vEventGroupDelete(EventGroupHandle_t group) { delete group; }
+
+EventBits_t xEventGroupSetBits(EventGroupHandle_t group, EventBits_t bits)
+{
+    std::lock_guard<std::mutex> lock(group->mutex);
+    group->bits |= bits;
+    group->cv.notify_all();
+    return group->bits;
+}
+
+EventBits_t xEventGroupClearBits(EventGroupHandle_t group, EventBits_t bits)
+{
+    std::lock_guard<std::mutex> lock(group->mutex);
+    EventBits_t before = group->bits;
+    group->bits &= ~bits;
+    return before;
+}
+
+EventBits_t xEventGroupGetBits(EventGroupHandle_t group)
+{
+    std::lock_guard<std::mutex> lock(group->mutex);
+    return group->bits;
+}
+
+static EventBits_t waitBits(EventGroupHandle_t group, std::unique_lock<std::mutex> &lock, EventBits_t bits,
+    BaseType_t clearOnExit, BaseType_t waitForAll, TickType_t ticksToWait)
+{
+    auto isSet = [group, bits, waitForAll]() {
+        return waitForAll ? (group->bits & bits) == bits : (group->bits & bits) != 0;
+    };
+    bool ok = waitFor(group->cv, lock, ticksToWait, isSet);
+    EventBits_t result = group->bits;
+    if (ok && clearOnExit) {
+        group->bits &= ~bits;
+    }
+    return result;
+}
+
+EventBits_t xEventGroupWaitBits(EventGroupHandle_t group, EventBits_t bits, BaseType_t clearOnExit,
+    BaseType_t waitForAll, TickType_t ticksToWait)
+{
+    std::unique_lock<std::mutex> lock(group->mutex);
+    return waitBits(group, lock, bits, clearOnExit, waitForAll, ticksToWait);
+}
+
+EventBits_t xEventGroupSync(EventGroupHandle_t group, EventBits_t bitsToSet, EventBits_t bitsToWaitFor,
+    TickType_t ticksToWait)
+{
+    std::unique_lock<std::mutex> lock(group->mutex);
+    group->bits |= bitsToSet;
+    group->cv.notify_all();
+    return waitBits(group, lock, bitsToWaitFor, pdTRUE, pdTRUE, ticksToWait);
+}
+
+void hostYield()
+{
+    std::this_thread::yield();
+}
+
+// esp_timer: a dispatch thread runs the callbacks of the timers that are due, one at a time
+
+struct esp_timer {
+    esp_timer_cb_t callback;
+    void *arg;
+    bool isActive = false;
+    int64_t due = 0;
+    uint64_t period = 0; // 0 if one-shot
+};
+
+static std::mutex timersMutex;
+static std::condition_variable timersCv;
+static std::vector<esp_timer *> timers;
+static bool isTimerThreadStarted = false;
+
+static void timerThreadFn()
+{
+    std::unique_lock<std::mutex> lock(timersMutex);
+    while (true) {
+        esp_timer *next = nullptr;
+        for (esp_timer *t : timers) {
+            if (t->isActive && (next == nullptr || t->due < next->due)) {
+                next = t;
+            }
+        }
+        if (next == nullptr) {
+            timersCv.wait(lock);
+            continue;
+        }
+        int64_t now = esp_timer_get_time();
+        if (next->due > now) {
+            timersCv.wait_for(lock, std::chrono::microseconds(next->due - now));
+            continue;
+        }
+        if (next->period > 0) {
+            next->due += next->period;
+        } else {
+            next->isActive = false;
+        }
+        esp_timer_cb_t cb = next->callback;
+        void *arg = next->arg;
+        lock.unlock();
+        cb(arg);
+        lock.lock();
+    }
+}
+
+esp_err_t esp_timer_create(const esp_timer_create_args_t *args, esp_timer_handle_t *handle)
+{
+    std::lock_guard<std::mutex> lock(timersMutex);
+    esp_timer *t = new esp_timer();
+    t->callback = args->callback;
+    t->arg = args->arg;
+    timers.push_back(t);
+    if (!isTimerThreadStarted) {
+        isTimerThreadStarted = true;
+        std::thread(timerThreadFn).detach();
+    }
+    *handle = t;
+    return ESP_OK;
+}
+
+static esp_err_t startTimer(esp_timer_handle_t timer, uint64_t micros, uint64_t period)
+{
+    std::lock_guard<std::mutex> lock(timersMutex);
+    if (timer->isActive) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    timer->isActive = true;
+    timer->due = esp_timer_get_time() + micros;
+    timer->period = period;
+    timersCv.notify_all();
+    return ESP_OK;
+}
+
+esp_err_t esp_timer_start_once(esp_timer_handle_t timer, uint64_t timeoutMicros)
+{
+    return startTimer(timer, timeoutMicros, 0);
+}
+
+esp_err_t esp_timer_start_periodic(esp_timer_handle_t timer, uint64_t periodMicros)
+{
+    return startTimer(timer, periodMicros, periodMicros);
+}
+
+esp_err_t esp_timer_stop(esp_timer_handle_t timer)
+{
+    std::lock_guard<std::mutex> lock(timersMutex);
+    if (!timer->isActive) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    timer->isActive = false;
+    return ESP_OK;
+}
+
+esp_err_t esp_timer_delete(esp_timer_handle_t timer)
+{
+    std::lock_guard<std::mutex> lock(timersMutex);
+    for (auto t = timers.begin(); t != timers.end(); ++t) {
+        if (*t == timer) {
+            timers.erase(t);
+            break;
+        }
+    }
+    delete timer;
+    return ESP_OK;
+}
@@ -0,0 +1,318 @@
+// File systems of the host stubs, see FS.h.
+#include <sys/stat.h>
+#include <dirent.h>
+#include <unistd.h>
+#include <errno.h>
+#include <string.h>
+#include "FS.h"
+#include "FSImpl.h"
+#include "SPIFFS.h"
+
+fs::SPIFFSFS SPIFFS;
+
+namespace fs {
+
+struct FileState {
+    FILE *f = nullptr;
+    DIR *dir = nullptr;
+    std::string path; // as seen by the sketch
+    std::string hostPath;
+    std::string root;
+
+    ~FileState() {
+        if (f != nullptr) {
+            fclose(f);
+        }
+        if (dir != nullptr) {
+            closedir(dir);
+        }
+    }
+};
+
+size_t File::write(uint8_t c)
+{
+    return write(&c, 1);
+}
+
+size_t File::write(const uint8_t *buf, size_t size)
+{
+    if (impl) {
+        return impl->write(buf, size);
+    }
+    if (!state || state->f == nullptr) {
+        return 0;
+    }
+    return fwrite(buf, 1, size, state->f);
+}
+
+int File::available()
+{
+    if (impl) {
+        return (int)(impl->size() - impl->position());
+    }
+    if (!state || state->f == nullptr) {
+        return 0;
+    }
+    long n = (long)size() - (long)position();
+    return n < 0 ? 0 : (int)n;
+}
+
+int File::read()
+{
+    uint8_t c;
+    return read(&c, 1) == 1 ? c : -1;
+}
+
+size_t File::read(uint8_t *buf, size_t size)
+{
+    if (impl) {
+        return impl->read(buf, size);
+    }
+    if (!state || state->f == nullptr) {
+        return 0;
+    }
+    return fread(buf, 1, size, state->f);
+}
+
+int File::peek()
+{
+    if (impl) {
+        uint8_t c;
+        size_t pos = impl->position();
+        if (impl->read(&c, 1) != 1) {
+            return -1;
+        }
+        impl->seek(pos, SeekSet);
+        return c;
+    }
+    if (!state || state->f == nullptr) {
+        return -1;
+    }
+    int c = fgetc(state->f);
+    if (c != EOF) {
+        ungetc(c, state->f);
+    }
+    return c == EOF ? -1 : c;
+}
+
+void File::flush()
+{
+    if (impl) {
+        impl->flush();
+    }
+    if (state && state->f != nullptr) {
+        fflush(state->f);
+    }
+}
+
+bool File::seek(uint32_t pos, SeekMode mode)
+{
+    if (impl) {
+        return impl->seek(pos, mode);
+    }
+    if (!state || state->f == nullptr) {
+        return false;
+    }
+    int whence = (mode == SeekSet ? SEEK_SET : mode == SeekCur ? SEEK_CUR : SEEK_END);
+    return fseek(state->f, mode == SeekEnd ? -(long)pos : (long)pos, whence) == 0;
+}
+
+size_t File::position() const
+{
+    if (impl) {
+        return impl->position();
+    }
+    if (!state || state->f == nullptr) {
+        return 0;
+    }
+    return ftell(state->f);
+}
+
+size_t File::size() const
+{
+    if (impl) {
+        return impl->size();
+    }
+    if (!state || state->f == nullptr) {
+        return 0;
+    }
+    fflush(state->f);
+    struct stat st;
+    return fstat(fileno(state->f), &st) == 0 ? st.st_size : 0;
+}
+
+void File::close()
+{
+    if (impl) {
+        impl->close();
+        impl.reset();
+    }
+    state.reset();
+}
+
+File::operator bool() const
+{
+    if (impl) {
+        return (bool)*impl;
+    }
+    return state && (state->f != nullptr || state->dir != nullptr);
+}
+
+const char *File::name() const
+{
+    if (impl) {
+        return impl->name();
+    }
+    return state ? state->path.c_str() : nullptr;
+}
+
+bool File::isDirectory() const
+{
+    if (impl) {
+        return impl->isDirectory();
+    }
+    return state && state->dir != nullptr;
+}
+
+File File::openNextFile(const char *mode)
+{
+    if (impl) {
+        return File(impl->openNextFile(mode));
+    }
+    if (!state || state->dir == nullptr) {
+        return File();
+    }
+    struct dirent *e;
+    while ((e = readdir(state->dir)) != nullptr) {
+        if (strcmp(e->d_name, ".") == 0 || strcmp(e->d_name, "..") == 0) {
+            continue;
+        }
+        std::shared_ptr<FileState> s = std::make_shared<FileState>();
+        s->path = state->path + (state->path.length() > 0 && state->path.back() == '/' ? "" : "/") + std::string(e->d_name);
+        s->hostPath = state->hostPath + "/" + std::string(e->d_name);
+        s->root = state->root;
+        struct stat st;
+        if (stat(s->hostPath.c_str(), &st) == 0 && S_ISDIR(st.st_mode)) {
+            s->dir = opendir(s->hostPath.c_str());
+        } else {
+            std::string m = std::string(mode) + "b";
+            s->f = fopen(s->hostPath.c_str(), m.c_str());
+        }
+        return File(s);
+    }
+    return File();
+}
+
+void File::rewindDirectory()
+{
+    if (impl) {
+        impl->rewindDirectory();
+    }
+    if (state && state->dir != nullptr) {
+        rewinddir(state->dir);
+    }
+}
+
+std::string FS::hostPath(const char *path) const
+{
+    return root + (path[0] == '/' ? "" : "/") + path;
+}
+
+static void makeDirs(const std::string &dir)
+{
+    for (size_t p = dir.find('/', 1); ; p = dir.find('/', p + 1)) {
+        std::string d = dir.substr(0, p);
+        ::mkdir(d.c_str(), 0755);
+        if (p == std::string::npos) {
+            break;
+        }
+    }
+}
+
+void FS::setHostRoot(const char *dir)
+{
+    root = dir;
+    while (root.length() > 1 && root.back() == '/') {
+        root.pop_back();
+    }
+    makeDirs(root);
+}
+
+File FS::open(const char *path, const char *mode)
+{
+    if (_impl) {
+        FileImplPtr f = _impl->open(path, mode);
+        return f ? File(f) : File();
+    }
+    std::shared_ptr<FileState> s = std::make_shared<FileState>();
+    s->path = path;
+    s->hostPath = hostPath(path);
+    s->root = root;
+    struct stat st;
+    if (stat(s->hostPath.c_str(), &st) == 0 && S_ISDIR(st.st_mode)) {
+        s->dir = opendir(s->hostPath.c_str());
+        return s->dir == nullptr ? File() : File(s);
+    }
+    if (mode[0] != 'r') {
+        size_t slash = s->hostPath.rfind('/');
+        if (slash != std::string::npos && slash > 0) {
+            makeDirs(s->hostPath.substr(0, slash));
+        }
+    }
+    std::string m = std::string(mode) + "b";
+    s->f = fopen(s->hostPath.c_str(), m.c_str());
+    return s->f == nullptr ? File() : File(s);
+}
+
+bool FS::exists(const char *path)
+{
+    if (_impl) {
+        return _impl->exists(path);
+    }
+    struct stat st;
+    return stat(hostPath(path).c_str(), &st) == 0;
+}
+
+bool FS::remove(const char *path)
+{
+    if (_impl) {
+        return _impl->remove(path);
+    }
+    return unlink(hostPath(path).c_str()) == 0;
+}
+
+bool FS::rename(const char *pathFrom, const char *pathTo)
+{
+    if (_impl) {
+        return _impl->rename(pathFrom, pathTo);
+    }
+    return ::rename(hostPath(pathFrom).c_str(), hostPath(pathTo).c_str()) == 0;
+}
+
+bool FS::mkdir(const char *path)
+{
+    if (_impl) {
+        return _impl->mkdir(path);
+    }
+    return ::mkdir(hostPath(path).c_str(), 0755) == 0 || errno == EEXIST;
+}
+
+bool FS::rmdir(const char *path)
+{
+    if (_impl) {
+        return _impl->rmdir(path);
+    }
+    return ::rmdir(hostPath(path).c_str()) == 0;
+}
+
+bool SPIFFSFS::format()
+{
+    std::string cmd = "rm -rf '" + root + "'";
+    if (system(cmd.c_str()) != 0) {
+        return false;
+    }
+    makeDirs(root);
+    return true;
+}
+
+} // namespace fs
@@ -0,0 +1,180 @@
+// I2C master driver of the host stubs, see driver/i2c.h. A command link is run in one go, bus
+// held, then the caller spins for the time the bytes take on the bus: 9 clocks per byte, one
+// for each start and stop.
+#include <map>
+#include <mutex>
+#include <vector>
+#include "driver/i2c.h"
+#include "esp_timer.h"
+
+struct HostI2cCmd {
+    enum Type { START, WRITE, READ, STOP };
+    struct Op {
+        Type type;
+        std::vector<uint8_t> data; // WRITE
+        bool ackEnable;
+        uint8_t *readData; // READ
+        size_t readLen;
+    };
+    std::vector<Op> ops;
+};
+
+struct HostI2cPort {
+    std::mutex mutex;
+    uint32_t hz = 100000;
+    std::map<uint8_t, HostI2cDevice *> devices;
+    HostI2cStats stats = { };
+};
+
+static HostI2cPort ports[I2C_NUM_MAX];
+
+void hostI2cAttach(i2c_port_t port, uint8_t address, HostI2cDevice *device)
+{
+    std::lock_guard<std::mutex> lock(ports[port].mutex);
+    ports[port].devices[address] = device;
+}
+
+void hostI2cSetClock(i2c_port_t port, uint32_t hz)
+{
+    std::lock_guard<std::mutex> lock(ports[port].mutex);
+    ports[port].hz = hz;
+}
+
+HostI2cStats hostI2cGetStats(i2c_port_t port)
+{
+    std::lock_guard<std::mutex> lock(ports[port].mutex);
+    return ports[port].stats;
+}
+
+void hostI2cResetStats(i2c_port_t port)
+{
+    std::lock_guard<std::mutex> lock(ports[port].mutex);
+    ports[port].stats = { };
+}
+
+esp_err_t i2c_param_config(i2c_port_t port, const i2c_config_t *conf)
+{
+    if (port < 0 || port >= I2C_NUM_MAX) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (conf->mode == I2C_MODE_MASTER) {
+        hostI2cSetClock(port, conf->master.clk_speed);
+    }
+    return ESP_OK;
+}
+
+esp_err_t i2c_driver_install(i2c_port_t port, i2c_mode_t mode, size_t rxBufLen, size_t txBufLen, int intrFlags)
+{
+    return (port < 0 || port >= I2C_NUM_MAX ? ESP_ERR_INVALID_ARG : ESP_OK);
+}
+
+esp_err_t i2c_driver_delete(i2c_port_t port)
+{
+    return (port < 0 || port >= I2C_NUM_MAX ? ESP_ERR_INVALID_ARG : ESP_OK);
+}
+
+i2c_cmd_handle_t i2c_cmd_link_create()
+{
+    return new HostI2cCmd();
+}
+
+void i2c_cmd_link_delete(i2c_cmd_handle_t cmd)
+{
+    delete cmd;
+}
+
+esp_err_t i2c_master_start(i2c_cmd_handle_t cmd)
+{
+    cmd->ops.push_back({ HostI2cCmd::START, { }, false, nullptr, 0 });
+    return ESP_OK;
+}
+
+esp_err_t i2c_master_write_byte(i2c_cmd_handle_t cmd, uint8_t data, bool ackEnable)
+{
+    return i2c_master_write(cmd, &data, 1, ackEnable);
+}
+
+esp_err_t i2c_master_write(i2c_cmd_handle_t cmd, const uint8_t *data, size_t len, bool ackEnable)
+{
+    cmd->ops.push_back({ HostI2cCmd::WRITE, std::vector<uint8_t>(data, data + len), ackEnable, nullptr, 0 });
+    return ESP_OK;
+}
+
+esp_err_t i2c_master_read(i2c_cmd_handle_t cmd, uint8_t *data, size_t len, i2c_ack_type_t ack)
+{
+    cmd->ops.push_back({ HostI2cCmd::READ, { }, false, data, len });
+    return ESP_OK;
+}
+
+esp_err_t i2c_master_stop(i2c_cmd_handle_t cmd)
+{
+    cmd->ops.push_back({ HostI2cCmd::STOP, { }, false, nullptr, 0 });
+    return ESP_OK;
+}
+
+esp_err_t i2c_master_cmd_begin(i2c_port_t port, i2c_cmd_handle_t cmd, TickType_t ticksToWait)
+{
+    if (port < 0 || port >= I2C_NUM_MAX) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    HostI2cPort *p = &ports[port];
+    std::lock_guard<std::mutex> lock(p->mutex);
+    int64_t start = esp_timer_get_time();
+    HostI2cDevice *device = nullptr;
+    bool isAddressNext = false;
+    uint32_t clocks = 0;
+    uint32_t bytes = 0;
+    esp_err_t err = ESP_OK;
+
+    for (const HostI2cCmd::Op &op : cmd->ops) {
+        if (op.type == HostI2cCmd::START) {
+            isAddressNext = true;
+            ++clocks;
+        } else if (op.type == HostI2cCmd::WRITE) {
+            for (size_t i = 0; i < op.data.size() && err == ESP_OK; i++) {
+                clocks += 9;
+                ++bytes;
+                uint8_t b = op.data[i];
+                if (isAddressNext) {
+                    isAddressNext = false;
+                    auto d = p->devices.find(b >> 1);
+                    device = (d == p->devices.end() ? nullptr : d->second);
+                    if (device == nullptr || !device->start((b & 1) == I2C_MASTER_READ)) {
+                        device = nullptr;
+                        err = (op.ackEnable ? ESP_FAIL : ESP_OK);
+                    }
+                } else if (device != nullptr && !device->write(b) && op.ackEnable) {
+                    err = ESP_FAIL;
+                }
+            }
+        } else if (op.type == HostI2cCmd::READ) {
+            for (size_t i = 0; i < op.readLen; i++) {
+                op.readData[i] = (device != nullptr ? device->read() : 0xFF);
+            }
+            clocks += 9 * op.readLen;
+            bytes += op.readLen;
+        } else {
+            ++clocks;
+        }
+        if (err != ESP_OK || op.type == HostI2cCmd::STOP) {
+            // the driver ends the transfer with a stop on a byte not acknowledged
+            if (device != nullptr) {
+                device->stop();
+                device = nullptr;
+            }
+            if (err != ESP_OK) {
+                ++clocks;
+                break;
+            }
+        }
+    }
+
+    ++p->stats.transfers;
+    p->stats.nacks += (err != ESP_OK);
+    p->stats.bytes += bytes;
+    uint64_t busMicros = (uint64_t)clocks * 1000000 / p->hz;
+    p->stats.busMicros += busMicros;
+    while (esp_timer_get_time() < start + (int64_t)busMicros) {
+    }
+    return err;
+}
@@ -0,0 +1,522 @@
+// JSON of the host stubs, see ArduinoJson.h.
+#include <stdio.h>
+#include <ctype.h>
+#include "ArduinoJson.h"
+
+JsonVariant::JsonVariant(JsonObject &v) : type(v.success() ? OBJECT : UNDEFINED)
+{
+    asObject = &v;
+}
+
+JsonVariant::JsonVariant(JsonArray &v) : type(v.success() ? ARRAY : UNDEFINED)
+{
+    asArray = &v;
+}
+
+long long JsonVariant::toInteger() const
+{
+    switch (type) {
+    case BOOL: return asBool ? 1 : 0;
+    case INTEGER: return asInteger;
+    case FLOAT: return (long long)asFloat;
+    case STRING: return strtoll(asString, nullptr, 10);
+    default: return 0;
+    }
+}
+
+double JsonVariant::toFloat() const
+{
+    switch (type) {
+    case BOOL: return asBool ? 1 : 0;
+    case INTEGER: return (double)asInteger;
+    case FLOAT: return asFloat;
+    case STRING: return strtod(asString, nullptr);
+    default: return 0;
+    }
+}
+
+JsonObject &JsonVariant::toObject() const
+{
+    return type == OBJECT ? *asObject : JsonObject::invalid();
+}
+
+JsonArray &JsonVariant::toArray() const
+{
+    return type == ARRAY ? *asArray : JsonArray::invalid();
+}
+
+void JsonVariant::get(String *v) const
+{
+    if (type == STRING) {
+        *v = asString;
+    } else if (type == UNDEFINED || type == NUL) {
+        *v = (const char *)nullptr;
+    } else {
+        v->clear();
+        printTo(*v);
+    }
+}
+
+JsonVariant JsonVariant::operator[](int index) const
+{
+    return type == ARRAY ? asArray->get(index) : JsonVariant();
+}
+
+JsonVariant JsonVariant::operator[](const char *key) const
+{
+    return type == OBJECT ? asObject->get(key) : JsonVariant();
+}
+
+size_t JsonVariant::size() const
+{
+    return type == ARRAY ? asArray->size() : type == OBJECT ? asObject->size() : 0;
+}
+
+namespace HostJson {
+
+static void printString(const char *s, std::string &out)
+{
+    out += '"';
+    for (; *s != '\0'; s++) {
+        switch (*s) {
+        case '"': out += "\\\""; break;
+        case '\\': out += "\\\\"; break;
+        case '\b': out += "\\b"; break;
+        case '\f': out += "\\f"; break;
+        case '\n': out += "\\n"; break;
+        case '\r': out += "\\r"; break;
+        case '\t': out += "\\t"; break;
+        default: out += *s; break;
+        }
+    }
+    out += '"';
+}
+
+static void newLine(std::string &out, int indent)
+{
+    if (indent >= 0) {
+        out += '\n';
+        out.append(indent * 2, ' ');
+    }
+}
+
+// indent < 0 for compact output
+void print(const JsonVariant &v, std::string &out, int indent)
+{
+    char buf[32];
+    int inner = (indent < 0 ? -1 : indent + 1);
+    switch (v.type) {
+    case JsonVariant::UNDEFINED:
+    case JsonVariant::NUL:
+        out += "null";
+        break;
+    case JsonVariant::BOOL:
+        out += (v.asBool ? "true" : "false");
+        break;
+    case JsonVariant::INTEGER:
+        snprintf(buf, sizeof(buf), "%lld", v.asInteger);
+        out += buf;
+        break;
+    case JsonVariant::FLOAT:
+        snprintf(buf, sizeof(buf), "%.9g", v.asFloat);
+        out += buf;
+        break;
+    case JsonVariant::STRING:
+        printString(v.asString, out);
+        break;
+    case JsonVariant::OBJECT: {
+        const JsonObject &obj = *v.asObject;
+        out += '{';
+        bool isFirst = true;
+        for (const JsonPair &p : obj) {
+            if (!isFirst) {
+                out += ',';
+            }
+            isFirst = false;
+            newLine(out, inner);
+            printString(p.key, out);
+            out += (indent < 0 ? ":" : ": ");
+            print(p.value, out, inner);
+        }
+        if (!isFirst) {
+            newLine(out, indent);
+        }
+        out += '}';
+        break;
+    }
+    case JsonVariant::ARRAY: {
+        const JsonArray &arr = *v.asArray;
+        out += '[';
+        bool isFirst = true;
+        for (const JsonVariant &e : arr) {
+            if (!isFirst) {
+                out += ',';
+            }
+            isFirst = false;
+            newLine(out, inner);
+            print(e, out, inner);
+        }
+        if (!isFirst) {
+            newLine(out, indent);
+        }
+        out += ']';
+        break;
+    }
+    }
+}
+
+static size_t copyOut(const std::string &s, char *buffer, size_t bufferSize)
+{
+    if (bufferSize == 0) {
+        return 0;
+    }
+    size_t n = (s.length() < bufferSize - 1 ? s.length() : bufferSize - 1);
+    memcpy(buffer, s.data(), n);
+    buffer[n] = '\0';
+    return n;
+}
+
+} // namespace HostJson
+
+size_t JsonVariant::printTo(char *buffer, size_t bufferSize) const
+{
+    std::string s;
+    HostJson::print(*this, s, -1);
+    return HostJson::copyOut(s, buffer, bufferSize);
+}
+
+size_t JsonVariant::printTo(String &str) const
+{
+    std::string s;
+    HostJson::print(*this, s, -1);
+    str.concat(s.c_str(), s.length());
+    return s.length();
+}
+
+size_t JsonVariant::printTo(Print &p) const
+{
+    std::string s;
+    HostJson::print(*this, s, -1);
+    return p.write((const uint8_t *)s.data(), s.length());
+}
+
+size_t JsonVariant::prettyPrintTo(char *buffer, size_t bufferSize) const
+{
+    std::string s;
+    HostJson::print(*this, s, 0);
+    return HostJson::copyOut(s, buffer, bufferSize);
+}
+
+size_t JsonVariant::prettyPrintTo(String &str) const
+{
+    std::string s;
+    HostJson::print(*this, s, 0);
+    str.concat(s.c_str(), s.length());
+    return s.length();
+}
+
+size_t JsonVariant::prettyPrintTo(Print &p) const
+{
+    std::string s;
+    HostJson::print(*this, s, 0);
+    return p.write((const uint8_t *)s.data(), s.length());
+}
+
+JsonPair *JsonObject::find(const char *key)
+{
+    for (JsonPair &p : members) {
+        if (strcmp(p.key, key) == 0) {
+            return &p;
+        }
+    }
+    return nullptr;
+}
+
+const JsonPair *JsonObject::find(const char *key) const
+{
+    return const_cast<JsonObject *>(this)->find(key);
+}
+
+void JsonObject::remove(const char *key)
+{
+    for (auto p = members.begin(); p != members.end(); ++p) {
+        if (strcmp(p->key, key) == 0) {
+            members.erase(p);
+            return;
+        }
+    }
+}
+
+bool JsonObject::set(const char *key, const JsonVariant &value)
+{
+    if (buffer == nullptr) {
+        return false;
+    }
+    JsonPair *p = find(key);
+    if (p == nullptr) {
+        members.push_back(JsonPair { buffer->strdup(key), JsonVariant() });
+        p = &members.back();
+    }
+    p->value = buffer->store(value);
+    return true;
+}
+
+JsonObject &JsonObject::createNestedObject(const char *key)
+{
+    if (buffer == nullptr) {
+        return invalid();
+    }
+    JsonObject &obj = buffer->createObject();
+    set(key, obj);
+    return obj;
+}
+
+JsonArray &JsonObject::createNestedArray(const char *key)
+{
+    if (buffer == nullptr) {
+        return JsonArray::invalid();
+    }
+    JsonArray &arr = buffer->createArray();
+    set(key, arr);
+    return arr;
+}
+
+JsonObject::Subscript JsonObject::operator[](const String &key)
+{
+    // the key must outlive the subscript
+    return Subscript(this, buffer == nullptr ? "" : buffer->strdup(key));
+}
+
+bool JsonArray::add(const JsonVariant &value)
+{
+    if (buffer == nullptr) {
+        return false;
+    }
+    elements.push_back(buffer->store(value));
+    return true;
+}
+
+bool JsonArray::set(size_t index, const JsonVariant &value)
+{
+    if (buffer == nullptr || index >= elements.size()) {
+        return false;
+    }
+    elements[index] = buffer->store(value);
+    return true;
+}
+
+JsonObject &JsonArray::createNestedObject()
+{
+    if (buffer == nullptr) {
+        return JsonObject::invalid();
+    }
+    JsonObject &obj = buffer->createObject();
+    add(obj);
+    return obj;
+}
+
+JsonArray &JsonArray::createNestedArray()
+{
+    if (buffer == nullptr) {
+        return invalid();
+    }
+    JsonArray &arr = buffer->createArray();
+    add(arr);
+    return arr;
+}
+
+JsonVariant JsonBuffer::store(const JsonVariant &v)
+{
+    JsonVariant r = v;
+    if (r.type == JsonVariant::STRING) {
+        r.asString = strdup(r.asString);
+    }
+    return r;
+}
+
+static void skipSpaces(const char *&p)
+{
+    while (true) {
+        if (isspace((unsigned char)*p)) {
+            ++p;
+        } else if (p[0] == '/' && p[1] == '/') {
+            while (*p != '\0' && *p != '\n') {
+                ++p;
+            }
+        } else if (p[0] == '/' && p[1] == '*') {
+            p += 2;
+            while (*p != '\0' && !(p[0] == '*' && p[1] == '/')) {
+                ++p;
+            }
+            if (*p != '\0') {
+                p += 2;
+            }
+        } else {
+            return;
+        }
+    }
+}
+
+static bool isWordChar(char c)
+{
+    return isalnum((unsigned char)c) || c == '_' || c == '-' || c == '+' || c == '.';
+}
+
+// a quoted string, or an unquoted word
+static bool parseString(const char *&p, std::string *s)
+{
+    s->clear();
+    if (*p == '"' || *p == '\'') {
+        char quote = *p++;
+        while (*p != quote) {
+            if (*p == '\0') {
+                return false;
+            }
+            if (*p == '\\') {
+                ++p;
+                switch (*p) {
+                case 'b': *s += '\b'; break;
+                case 'f': *s += '\f'; break;
+                case 'n': *s += '\n'; break;
+                case 'r': *s += '\r'; break;
+                case 't': *s += '\t'; break;
+                case 'u': {
+                    unsigned code = 0;
+                    for (int i = 1; i <= 4; i++) {
+                        if (!isxdigit((unsigned char)p[i])) {
+                            return false;
+                        }
+                        code = code * 16 + (isdigit((unsigned char)p[i]) ? p[i] - '0' : tolower(p[i]) - 'a' + 10);
+                    }
+                    p += 4;
+                    if (code < 0x80) {
+                        *s += (char)code;
+                    } else if (code < 0x800) {
+                        *s += (char)(0xc0 | (code >> 6));
+                        *s += (char)(0x80 | (code & 0x3f));
+                    } else {
+                        *s += (char)(0xe0 | (code >> 12));
+                        *s += (char)(0x80 | ((code >> 6) & 0x3f));
+                        *s += (char)(0x80 | (code & 0x3f));
+                    }
+                    break;
+                }
+                case '\0': return false;
+                default: *s += *p; break;
+                }
+                ++p;
+            } else {
+                *s += *p++;
+            }
+        }
+        ++p;
+        return true;
+    }
+    while (isWordChar(*p)) {
+        *s += *p++;
+    }
+    return !s->empty();
+}
+
+JsonVariant JsonBuffer::parseValue(const char *&p, int depth)
+{
+    if (depth < 0) {
+        return JsonVariant();
+    }
+    skipSpaces(p);
+    if (*p == '{') {
+        ++p;
+        JsonObject &obj = createObject();
+        skipSpaces(p);
+        if (*p == '}') {
+            ++p;
+            return obj;
+        }
+        std::string key;
+        while (true) {
+            skipSpaces(p);
+            if (!parseString(p, &key)) {
+                return JsonVariant();
+            }
+            skipSpaces(p);
+            if (*p++ != ':') {
+                return JsonVariant();
+            }
+            JsonVariant v = parseValue(p, depth - 1);
+            if (!v.success()) {
+                return JsonVariant();
+            }
+            obj.set(key.c_str(), v);
+            skipSpaces(p);
+            if (*p == ',') {
+                ++p;
+            } else if (*p == '}') {
+                ++p;
+                return obj;
+            } else {
+                return JsonVariant();
+            }
+        }
+    }
+    if (*p == '[') {
+        ++p;
+        JsonArray &arr = createArray();
+        skipSpaces(p);
+        if (*p == ']') {
+            ++p;
+            return arr;
+        }
+        while (true) {
+            JsonVariant v = parseValue(p, depth - 1);
+            if (!v.success()) {
+                return JsonVariant();
+            }
+            arr.add(v);
+            skipSpaces(p);
+            if (*p == ',') {
+                ++p;
+            } else if (*p == ']') {
+                ++p;
+                return arr;
+            } else {
+                return JsonVariant();
+            }
+        }
+    }
+    bool isQuoted = (*p == '"' || *p == '\'');
+    std::string s;
+    if (!parseString(p, &s)) {
+        return JsonVariant();
+    }
+    if (isQuoted) {
+        return JsonVariant(strdup(s.c_str()));
+    }
+    if (s == "true") {
+        return JsonVariant(true);
+    }
+    if (s == "false") {
+        return JsonVariant(false);
+    }
+    if (s == "null") {
+        return JsonVariant(nullptr);
+    }
+    char *end;
+    long long i = strtoll(s.c_str(), &end, 10);
+    if (*end == '\0') {
+        return JsonVariant(i);
+    }
+    double d = strtod(s.c_str(), &end);
+    if (*end == '\0') {
+        return JsonVariant(d);
+    }
+    return JsonVariant(strdup(s.c_str()));
+}
+
+JsonVariant JsonBuffer::parse(const char *json, uint8_t nestingLimit)
+{
+    if (json == nullptr) {
+        return JsonVariant();
+    }
+    const char *p = json;
+    return parseValue(p, nestingLimit);
+}
@@ -0,0 +1,224 @@
+// Host benchmark of the telemetry upload formats: a synthetic supervisor log (wakeups with
+// sensor data, load runs, commands, uploads and shutdowns) is appended to the telemetry log,
+// then read back as the upload does and sent as JSON lines and in the compact encoding of
+// TelemetryCodec.h. The decoded records must be the records read from the log.
+//
+//   telemetry_codec_bench [-w wakeups] [-r repeats] [-o dir]
+//
+// Sizes are those of the upload text; encoding and decoding times are averaged over the
+// repeats.
+
+#include <Arduino.h>
+#include <SPIFFS.h>
+#include <string>
+#include <vector>
+#include <unistd.h>
+
+#include "UEvent.h"
+#include "LogMgr.h"
+#include "Util.h"
+#include "TelemetryLog.h"
+#include "TelemetryCodec.h"
+
+struct Fields {
+  std::vector<std::string> keys;
+  std::vector<std::string> values;
+
+  void add(const char *key, long value) { keys.push_back(key); values.push_back(std::to_string(value)); }
+  void addStr(const char *key, const char *value) { keys.push_back(key); values.push_back(value); }
+};
+
+static void append(TelemetryLog *log, const char *type, uint32_t ts, const Fields &fields)
+{
+  const char *keys[TelemetryLog::MAX_FIELDS + 1] = { nullptr };
+  const char *values[TelemetryLog::MAX_FIELDS + 1] = { nullptr };
+  for (size_t i = 0; i < fields.keys.size(); i++) {
+    keys[i] = fields.keys[i].c_str();
+    values[i] = fields.values[i].c_str();
+  }
+  log->append(type, ts, keys, values, false);
+}
+
+// as IvanSupervisor: a wakeup every 2 hours, the load run every 4th, an upload every 12th
+static void generate(TelemetryLog *log, int wakeups)
+{
+  uint32_t ts = 1700000000;
+  long mainMv = 12800;
+  long caseTemp = 2150;
+  for (int w = 0; w < wakeups; w++) {
+    Fields none;
+    append(log, "TS", ts, none);
+    mainMv += (long)(esp_random() % 61) - 30;
+    caseTemp += (long)(esp_random() % 41) - 20;
+    Fields sensors;
+    sensors.add("SV", mainMv);
+    sensors.add("SC", 40 + esp_random() % 8);
+    sensors.add("SW", 0);
+    sensors.add("SU", 0);
+    sensors.add("ST", caseTemp);
+    sensors.add("SE", caseTemp - 300 + (long)(esp_random() % 50));
+    sensors.add("SH", 6000 + esp_random() % 500);
+    sensors.add("SB", 97);
+    sensors.add("SI", -(long)(60 + esp_random() % 20));
+    append(log, "SA", ts + 2, sensors);
+    if (w % 4 == 0) {
+      append(log, "LB", ts + 5, none);
+      Fields profile;
+      profile.addStr("PL", "AQIDBAUGBwgJCgsMDQ4P");
+      append(log, "PS", ts + 126, profile);
+      append(log, "LE", ts + 127, none);
+    }
+    if (w % 12 == 11) {
+      Fields cmd;
+      cmd.addStr("CT", "sleepDuration 7200");
+      cmd.addStr("CR", "Set sleepDuration to 7200");
+      append(log, "CS", ts + 40, cmd);
+      Fields upload;
+      upload.add("UR", 18 + esp_random() % 6);
+      upload.addStr("UO", "");
+      append(log, "UC", ts + 60, upload);
+    }
+    Fields shutdown;
+    shutdown.add("SL", 7200);
+    append(log, "TD", ts + 130, shutdown);
+    ts += 7200 + esp_random() % 5;
+  }
+  log->commit();
+}
+
+// as IvanSupervisorService::telemetryToJson: all values as strings
+static void toJson(const TelemetryLog::Record &rec, String *text)
+{
+  *text += "{\"type\":\""; *text += rec.type; *text += "\",\"ts\":"; *text += rec.ts;
+  for (int i = 0; i < rec.fieldCount; i++) {
+    *text += ",\""; *text += rec.fields[i].key; *text += "\":\""; *text += rec.fields[i].strValue; *text += "\"";
+  }
+  *text += "}\n";
+}
+
+static void encode(TelemetryEncoder &encoder, const TelemetryLog::Record &rec)
+{
+  encoder.beginRecord(rec.type, rec.ts, rec.fieldCount);
+  for (int i = 0; i < rec.fieldCount; i++) {
+    const TelemetryLog::Field &field = rec.fields[i];
+    if (field.isInt) {
+      encoder.addInt(field.key, field.intValue);
+    } else {
+      encoder.addString(field.key, field.strValue, strlen(field.strValue));
+    }
+  }
+}
+
+// one line per record, values as strings, to compare what was logged with what was decoded
+static std::string describe(const char *type, uint32_t ts)
+{
+  return std::string(type) + " " + std::to_string(ts);
+}
+
+static bool decodeAll(const std::vector<uint8_t> &data, std::vector<std::string> *out)
+{
+  TelemetryDecoder decoder(data.data(), data.size());
+  char type[3];
+  uint32_t ts;
+  int fieldCount;
+  while (decoder.isValid() && !decoder.isAtEnd()) {
+    if (!decoder.nextRecord(type, &ts, &fieldCount)) {
+      return false;
+    }
+    std::string line = describe(type, ts);
+    for (int i = 0; i < fieldCount; i++) {
+      char key[3];
+      bool isInt;
+      int32_t intValue;
+      const char *str;
+      size_t len;
+      if (!decoder.nextField(key, &isInt, &intValue, &str, &len)) {
+        return false;
+      }
+      line += " " + std::string(key) + "=" + (isInt ? std::to_string(intValue) : std::string(str, len));
+    }
+    out->push_back(line);
+  }
+  return decoder.isValid();
+}
+
+int main(int argc, char **argv)
+{
+  int wakeups = 40;
+  int repeats = 200;
+  std::string dir = "telemetry_codec_bench_fs";
+  int c;
+  while ((c = getopt(argc, argv, "w:r:o:")) != -1) {
+    switch (c) {
+      case 'w': wakeups = atoi(optarg); break;
+      case 'r': repeats = atoi(optarg); break;
+      case 'o': dir = optarg; break;
+      default:
+        fprintf(stderr, "Usage: %s [-w wakeups] [-r repeats] [-o dir]\n", argv[0]);
+        return 2;
+    }
+  }
+  hostSeedRandom(1);
+  SPIFFS.setHostRoot(dir.c_str());
+  SPIFFS.format();
+
+  UEventLoop *eventLoop = new UEventLoop("Main");
+  LogMgr *logMgr = new LogMgr();
+  TelemetryLog *log = new TelemetryLog();
+  log->init(eventLoop, logMgr->newLogger("telemetry"), &SPIFFS, "/telemetry.log");
+  log->setCommitPolicy(1000, 60);
+  generate(log, wakeups);
+
+  std::vector<std::string> logged;
+  String json;
+  log->forEach(0, log->getCommittedSize(), [&logged, &json](const TelemetryLog::Record &rec, size_t offset) {
+    std::string line = describe(rec.type, rec.ts);
+    for (int i = 0; i < rec.fieldCount; i++) {
+      line += " " + std::string(rec.fields[i].key) + "=" + rec.fields[i].strValue;
+    }
+    logged.push_back(line);
+    toJson(rec, &json);
+    return true;
+  });
+
+  std::vector<uint8_t> encoded;
+  int64_t start = esp_timer_get_time();
+  for (int r = 0; r < repeats; r++) {
+    encoded.clear();
+    TelemetryEncoder encoder(encoded);
+    log->forEach(0, log->getCommittedSize(), [&encoder](const TelemetryLog::Record &rec, size_t offset) {
+      encode(encoder, rec);
+      return true;
+    });
+  }
+  double encodeMicros = (double)(esp_timer_get_time() - start) / repeats;
+  String text = TELEMETRY_CODEC_TEXT_PREFIX;
+  Util::base64Encode(&text, (char *)encoded.data(), encoded.size());
+
+  std::vector<std::string> decoded;
+  start = esp_timer_get_time();
+  bool ok = true;
+  for (int r = 0; r < repeats && ok; r++) {
+    decoded.clear();
+    ok = decodeAll(encoded, &decoded);
+  }
+  double decodeMicros = (double)(esp_timer_get_time() - start) / repeats;
+
+  printf("%d wakeups, %d records, %u bytes in the telemetry log\n",
+    wakeups, (int)logged.size(), (unsigned)log->getCommittedSize());
+  printf("  JSON lines:      %6u bytes\n", json.length());
+  printf("  encoded:         %6u bytes, %.1f%% of JSON\n", (unsigned)encoded.size(), 100.0 * encoded.size() / json.length());
+  printf("  uploaded (text): %6u bytes, %.1f%% of JSON\n", text.length(), 100.0 * text.length() / json.length());
+  printf("  encode from the log: %.1f us, decode: %.1f us\n", encodeMicros, decodeMicros);
+
+  if (!ok) {
+    printf("the encoded data doesn't decode\n");
+  } else if (decoded != logged) {
+    printf("the records decoded are not the records logged\n");
+    ok = false;
+  }
+  printf("\n%s\n", ok ? "OK" : "FAILED");
+  fflush(stdout);
+  // the event loop task still runs: no static destructors under it
+  _exit(ok ? 0 : 1);
+}
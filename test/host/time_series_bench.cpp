@@ -0,0 +1,201 @@
+// Host test and benchmark of the time series store (TimeSeries.h). The checks feed metrics with
+// samples at known times and compare the queries with what they must return: minute and hour
+// buckets and their boundaries, the open bucket, the rings once full, the since filter, raw
+// times across the wrap of their low 32 bits, samples out of order, and the memory cap. Then
+// ingest and query times, on a metric sized as the INA3221 ones.
+//
+//   time_series_bench [-n samples] [-r repeats]
+//
+// Ingest is timed over the samples, one per milli; queries are averaged over the repeats.
+
+#include <Arduino.h>
+#include <string>
+#include <vector>
+#include <unistd.h>
+
+#include "TimeSeries.h"
+
+static int failures = 0;
+
+static void check(bool isOk, const char *what)
+{
+  if (!isOk) {
+    printf("  FAILED: %s\n", what);
+    ++failures;
+  }
+}
+
+static bool isPoint(const TimeSeries::Point &p, int64_t ts, int32_t min, int32_t max, int32_t avg, uint32_t count)
+{
+  bool isOk = p.tsMillis == ts && p.min == min && p.max == max && p.avg == avg && p.count == count;
+  if (!isOk) {
+    printf("  point %lld %d %d %d %u, expected %lld %d %d %d %u\n", (long long)p.tsMillis, (int)p.min,
+      (int)p.max, (int)p.avg, (unsigned)p.count, (long long)ts, (int)min, (int)max, (int)avg, (unsigned)count);
+  }
+  return isOk;
+}
+
+static void checkBuckets()
+{
+  printf("buckets\n");
+  TimeSeries store;
+  store.setMaxMemory(4096);
+  TimeSeries::Metric *m = store.addMetric("buckets", "mV", 8, 4, 2);
+  // a sample a second for 150 s, value = the second: minutes [0, 60), [60, 120), then open
+  for (int s = 0; s <= 150; s++) {
+    TimeSeries::add(m, s * 1000, s);
+  }
+  TimeSeries::Point p[8];
+  int n = TimeSeries::query(m, TimeSeries::MINUTE, 0, p, 8);
+  check(n == 3, "3 minute points, the last one open");
+  check(n == 3 && isPoint(p[0], 0, 0, 59, 29, 60), "first minute");
+  check(n == 3 && isPoint(p[1], 60000, 60, 119, 89, 60), "second minute, starting with the sample at 60000");
+  check(n == 3 && isPoint(p[2], 120000, 120, 150, 135, 31), "open minute");
+  n = TimeSeries::query(m, TimeSeries::HOUR, 0, p, 8);
+  check(n == 1 && isPoint(p[0], 0, 0, 150, 75, 151), "open hour");
+
+  n = TimeSeries::query(m, TimeSeries::RAW, 0, p, 8);
+  check(n == 8 && isPoint(p[0], 143000, 143, 143, 143, 1) && isPoint(p[7], 150000, 150, 150, 150, 1),
+    "last 8 raw samples, oldest first");
+  n = TimeSeries::query(m, TimeSeries::RAW, 0, p, 3);
+  check(n == 3 && p[0].tsMillis == 148000, "maxCount keeps the latest");
+
+  // since: raw samples from it, buckets that end after it
+  n = TimeSeries::query(m, TimeSeries::RAW, 148000, p, 8);
+  check(n == 3 && p[0].tsMillis == 148000, "raw since");
+  n = TimeSeries::query(m, TimeSeries::MINUTE, 60000, p, 8);
+  check(n == 2 && p[0].tsMillis == 60000, "minutes since the end of the first one");
+  n = TimeSeries::query(m, TimeSeries::MINUTE, 59999, p, 8);
+  check(n == 3, "minutes since before the end of the first one");
+
+  // 10 more minutes, a sample each: the ring of 4 keeps the latest closed ones
+  for (int i = 3; i < 13; i++) {
+    TimeSeries::add(m, i * 60000, -i);
+  }
+  n = TimeSeries::query(m, TimeSeries::MINUTE, 0, p, 8);
+  check(n == 5, "4 closed minutes and the open one");
+  check(n == 5 && isPoint(p[0], 8 * 60000, -8, -8, -8, 1) && isPoint(p[4], 12 * 60000, -12, -12, -12, 1),
+    "oldest minutes dropped");
+  n = TimeSeries::query(m, TimeSeries::MINUTE, 0, p, 2);
+  check(n == 2 && p[0].tsMillis == 11 * 60000 && p[1].tsMillis == 12 * 60000, "maxCount with the open minute");
+
+  // negative values: the average is the truncated quotient
+  TimeSeries::Metric *neg = store.addMetric("negative", "mA", 0, 2, 0);
+  TimeSeries::add(neg, 0, -1);
+  TimeSeries::add(neg, 1, -2);
+  n = TimeSeries::query(neg, TimeSeries::MINUTE, 0, p, 8);
+  check(n == 1 && isPoint(p[0], 0, -2, -1, -1, 2), "negative average");
+  n = TimeSeries::query(neg, TimeSeries::RAW, 0, p, 8);
+  check(n == 0, "no raw tier");
+}
+
+static void checkTimes()
+{
+  printf("times\n");
+  TimeSeries store;
+  store.setMaxMemory(4096);
+  TimeSeries::Metric *m = store.addMetric("wrap", "mV", 8, 0, 0);
+  int64_t wrap = (int64_t)1 << 32;
+  for (int i = -2; i <= 2; i++) {
+    TimeSeries::add(m, wrap + i, i);
+  }
+  TimeSeries::Point p[8];
+  int n = TimeSeries::query(m, TimeSeries::RAW, 0, p, 8);
+  bool isOk = (n == 5);
+  for (int i = 0; i < n && isOk; i++) {
+    isOk = (p[i].tsMillis == wrap + i - 2 && p[i].avg == i - 2);
+  }
+  check(isOk, "raw times across 2^32 millis");
+
+  TimeSeries::Metric *late = store.addMetric("late", "mV", 8, 4, 0);
+  TimeSeries::add(late, 61000, 1);
+  TimeSeries::add(late, 59000, 2);
+  n = TimeSeries::query(late, TimeSeries::RAW, 0, p, 8);
+  check(n == 2 && p[1].tsMillis == 61000, "a sample out of order is at the time of the previous one");
+  n = TimeSeries::query(late, TimeSeries::MINUTE, 0, p, 8);
+  check(n == 1 && isPoint(p[0], 60000, 1, 2, 1, 2), "and in its bucket");
+  check(late->getSampleCount() == 2 && late->getLastValue() == 2 && late->getLastTsMillis() == 61000, "last sample");
+}
+
+static void checkMemory()
+{
+  printf("memory\n");
+  TimeSeries store;
+  store.setMaxMemory(8192);
+  TimeSeries::Metric *first = store.addMetric("ina3221.ch1.voltage", "mV", 32, 60, 24);
+  check(first != nullptr, "a metric within the max memory");
+  size_t size = first->getMemorySize();
+  check(store.getUsedMemory() == size, "used memory");
+  check(store.addMetric("ina3221.ch1.voltage", "mV", 32, 60, 24) == first && store.getUsedMemory() == size,
+    "adding it again gives the same metric");
+  int count = 1;
+  while (store.addMetric(("metric" + std::to_string(count)).c_str(), "mV", 32, 60, 24) != nullptr) {
+    ++count;
+  }
+  check(count == (int)(8192 / size), "metrics up to the max memory");
+  check(store.getUsedMemory() <= store.getMaxMemory(), "within the max memory");
+  check(store.getMetricCount() == count, "metric count");
+  check(store.find("ina3221.ch1.voltage") == first && store.find("none") == nullptr, "find");
+
+  TimeSeries disabled;
+  disabled.setMaxMemory(0);
+  TimeSeries::Metric *none = disabled.addMetric("none", "mV", 32, 60, 24);
+  check(none == nullptr, "no metric with no memory");
+  TimeSeries::add(none, 1);
+  TimeSeries::Point p[1];
+  check(TimeSeries::query(none, TimeSeries::RAW, 0, p, 1) == 0, "a null metric is a no-op");
+
+  TimeSeries::Tier tier;
+  check(TimeSeries::parseTier("1m", &tier) && tier == TimeSeries::MINUTE && !TimeSeries::parseTier("1d", &tier),
+    "tier names");
+  printf("  metric with 32/60/24 entries: %u bytes\n", (unsigned)size);
+}
+
+static void bench(int samples, int repeats)
+{
+  printf("benchmark\n");
+  TimeSeries store;
+  store.setMaxMemory(32768);
+  TimeSeries::Metric *m = store.addMetric("ina3221.ch2.current", "mA", 32, 60, 24);
+  int64_t start = esp_timer_get_time();
+  for (int i = 0; i < samples; i++) {
+    TimeSeries::add(m, i, 1000 + (i & 0xFF));
+  }
+  double ingestNanos = (esp_timer_get_time() - start) * 1000.0 / samples;
+  printf("  ingest: %.1f ns/sample, %d samples, one per milli\n", ingestNanos, samples);
+  check(m->getSampleCount() == (uint32_t)samples, "all samples counted");
+
+  std::vector<TimeSeries::Point> points(61);
+  for (int t = 0; t < TimeSeries::TIER_COUNT; t++) {
+    TimeSeries::Tier tier = (TimeSeries::Tier)t;
+    int n = 0;
+    start = esp_timer_get_time();
+    for (int r = 0; r < repeats; r++) {
+      n = TimeSeries::query(m, tier, 0, points.data(), points.size());
+    }
+    double queryNanos = (esp_timer_get_time() - start) * 1000.0 / repeats;
+    printf("  query %-3s %2d points: %.0f ns\n", TimeSeries::TIER_NAMES[t], n, queryNanos);
+  }
+}
+
+int main(int argc, char **argv)
+{
+  int samples = 4000000; // over an hour: the minute ring is full
+  int repeats = 100000;
+  int c;
+  while ((c = getopt(argc, argv, "n:r:")) != -1) {
+    switch (c) {
+      case 'n': samples = atoi(optarg); break;
+      case 'r': repeats = atoi(optarg); break;
+      default:
+        fprintf(stderr, "Usage: %s [-n samples] [-r repeats]\n", argv[0]);
+        return 2;
+    }
+  }
+  checkBuckets();
+  checkTimes();
+  checkMemory();
+  bench(samples, repeats);
+  printf("\n%s\n", failures == 0 ? "OK" : "FAILED");
+  return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,174 @@
+// Benchmark of WebSocketsServer::broadcast(): 16 clients subscribed to the log, at 100 messages
+// per second, against a model of AsyncWebSocket's per-client message queue (at most 32 queued
+// messages, as WS_MAX_QUEUED_MESSAGES). Compares a copy of the message for every client, as
+// textAll() does, with a single reference-counted buffer queued to every client. Two of the
+// clients are slow, to exercise the drop accounting.
+//
+//   ws_broadcast_bench [seconds]
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <chrono>
+#include <deque>
+#include <memory>
+#include <string>
+#include <vector>
+
+static const int CLIENT_COUNT = 16;
+static const int RATE_HZ = 100;
+static const size_t MAX_QUEUED = 32;
+
+struct Buffer {
+  std::vector<uint8_t> data;
+  int refs;
+};
+
+struct Client {
+  std::deque<Buffer *> queue;
+  int drainPerTick; // messages the client's TCP window takes per tick
+  uint32_t sent;
+  uint32_t dropped;
+  uint32_t unreportedDrops;
+};
+
+struct Stats {
+  uint64_t allocations;
+  uint64_t bytesCopied;
+  uint64_t sent;
+  uint64_t dropped;
+  double nanosPerBroadcast;
+};
+
+static Buffer *makeBuffer(const char *msg, size_t len, Stats *stats)
+{
+  Buffer *b = new Buffer();
+  b->data.assign((const uint8_t *)msg, (const uint8_t *)msg + len);
+  b->refs = 0;
+  ++stats->allocations;
+  stats->bytesCopied += len;
+  return b;
+}
+
+static void release(Buffer *b)
+{
+  if (--b->refs == 0) {
+    delete b;
+  }
+}
+
+static void drain(std::vector<Client> &clients)
+{
+  for (Client &c : clients) {
+    for (int i = 0; i < c.drainPerTick && !c.queue.empty(); i++) {
+      release(c.queue.front());
+      c.queue.pop_front();
+    }
+  }
+}
+
+static void queueTo(Client &c, Buffer *b, Stats *stats)
+{
+  if (c.queue.size() >= MAX_QUEUED) {
+    ++c.dropped;
+    ++c.unreportedDrops;
+    ++stats->dropped;
+    return;
+  }
+  if (c.unreportedDrops > 0) {
+    std::string dropped = "@dropped:" + std::to_string(c.unreportedDrops);
+    Buffer *d = makeBuffer(dropped.c_str(), dropped.length(), stats);
+    d->refs = 1;
+    c.queue.push_back(d);
+    c.unreportedDrops = 0;
+  }
+  ++b->refs;
+  c.queue.push_back(b);
+  ++c.sent;
+  ++stats->sent;
+}
+
+static Stats run(bool isShared, int seconds)
+{
+  Stats stats = {};
+  std::vector<Client> clients(CLIENT_COUNT);
+  for (int i = 0; i < CLIENT_COUNT; i++) {
+    clients[i] = Client();
+    // a tick per message; the first two clients take only one message every 3 ticks
+    clients[i].drainPerTick = (i < 2 ? 0 : 2);
+  }
+  char msg[160];
+  double totalNanos = 0;
+  int count = seconds * RATE_HZ;
+  for (int n = 0; n < count; n++) {
+    int len = snprintf(msg, sizeof(msg), "@log:%d Sensors DEBUG Load current %d mA, voltage %d mV, bus ok, capture idle",
+      n * 10, 1200 + n % 97, 12000 + n % 31);
+    auto start = std::chrono::steady_clock::now();
+    if (isShared) {
+      Buffer *b = nullptr;
+      for (Client &c : clients) {
+        if (c.queue.size() >= MAX_QUEUED) {
+          queueTo(c, nullptr, &stats); // counted as dropped, no buffer needed
+          continue;
+        }
+        if (b == nullptr) {
+          b = makeBuffer(msg, len, &stats);
+          b->refs = 1; // held while queueing
+        }
+        queueTo(c, b, &stats);
+      }
+      if (b != nullptr) {
+        release(b);
+      }
+    } else {
+      for (Client &c : clients) {
+        if (c.queue.size() >= MAX_QUEUED) {
+          queueTo(c, nullptr, &stats);
+          continue;
+        }
+        Buffer *b = makeBuffer(msg, len, &stats);
+        queueTo(c, b, &stats);
+      }
+    }
+    totalNanos += std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+    drain(clients);
+    if (n % 3 == 0) {
+      for (int i = 0; i < 2; i++) {
+        if (!clients[i].queue.empty()) {
+          release(clients[i].queue.front());
+          clients[i].queue.pop_front();
+        }
+      }
+    }
+  }
+  for (Client &c : clients) {
+    while (!c.queue.empty()) {
+      release(c.queue.front());
+      c.queue.pop_front();
+    }
+  }
+  stats.nanosPerBroadcast = totalNanos / count;
+  return stats;
+}
+
+int main(int argc, char **argv)
+{
+  int seconds = (argc > 1 ? atoi(argv[1]) : 60);
+  printf("%d clients, %d Hz, %d s of messages\n", CLIENT_COUNT, RATE_HZ, seconds);
+  Stats copied = run(false, seconds);
+  Stats shared = run(true, seconds);
+  const char *names[] = { "copy per client", "shared buffer" };
+  Stats *all[] = { &copied, &shared };
+  for (int i = 0; i < 2; i++) {
+    printf("%-16s %8.0f ns/broadcast, %8llu allocations, %10llu bytes copied, %8llu sent, %6llu dropped\n",
+      names[i], all[i]->nanosPerBroadcast, (unsigned long long)all[i]->allocations,
+      (unsigned long long)all[i]->bytesCopied, (unsigned long long)all[i]->sent,
+      (unsigned long long)all[i]->dropped);
+  }
+  // the same messages reach the same clients, with one allocation per message instead of one per client
+  if (copied.sent != shared.sent || copied.dropped != shared.dropped || shared.allocations >= copied.allocations) {
+    printf("FAILED\n");
+    return 1;
+  }
+  return 0;
+}